@@ -135,6 +135,7 @@ static bool AnimateActionDie(CUnit &unit)
 	//Wyrmgus start
 	const unsigned int var_size = UnitTypeVar.GetNumberVariable();
 	std::copy(corpseType.Stats[unit.Player->Index].Variables, corpseType.Stats[unit.Player->Index].Variables + var_size, unit.Variable);
+	unit.VariablesIncrease = true;
 	//Wyrmgus end
 	UpdateUnitSightRange(unit);
 	//Wyrmgus start
@@ -210,6 +210,7 @@ int TransformUnitIntoType(CUnit &unit, const CUnitType &newtype)
 			unit.Variable[i].Max += newstats.Variables[i].Max - oldstats.Variables[i].Max;
 			unit.Variable[i].Increase += newstats.Variables[i].Increase - oldstats.Variables[i].Increase;
 			unit.Variable[i].Enable = newstats.Variables[i].Enable;
+			unit.VariablesIncrease = true;
 		}
 		//Wyrmgus end
 	}
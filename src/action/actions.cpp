@@ -72,6 +72,9 @@
 #include "missile.h"
 #include "pathfinder.h"
 #include "player.h"
+//Wyrmgus start
+#include "profile.h"
+//Wyrmgus end
 #include "script.h"
 #include "spells.h"
 //Wyrmgus start
@@ -290,6 +293,34 @@ void CclParseOrder(lua_State *l, CUnit &unit, COrderPtr *orderPtr)
 --  Actions
 ----------------------------------------------------------------------------*/
 
+//Wyrmgus start
+/// Variables of the spell effects, which decay each cycle instead of each second
+static const int SpellEffects[] = {BLOODLUST_INDEX, HASTE_INDEX, SLOW_INDEX, INVISIBLE_INDEX, UNHOLYARMOR_INDEX, POISON_INDEX, STUN_INDEX, BLEEDING_INDEX, LEADERSHIP_INDEX, BLESSING_INDEX, INSPIRE_INDEX, PRECISION_INDEX, REGENERATION_INDEX, TERROR_INDEX, WITHER_INDEX, DEHYDRATION_INDEX, HYDRATING_INDEX};
+
+/**
+**  Get the variables handled each second, which are all of them but the spell effects.
+**
+**  The list is built again only when the number of variables changes, so the buffs
+**  of each unit go through it without checking every variable against the spell effects.
+*/
+static const std::vector<int> &GetVariablesEachSecond()
+{
+	static std::vector<int> variables;
+	static unsigned int variable_count = 0;
+
+	if (variable_count != UnitTypeVar.GetNumberVariable()) {
+		variable_count = UnitTypeVar.GetNumberVariable();
+		variables.clear();
+		for (unsigned int i = 0; i < variable_count; ++i) {
+			if (std::find(SpellEffects, SpellEffects + sizeof(SpellEffects) / sizeof(int), (int) i) == SpellEffects + sizeof(SpellEffects) / sizeof(int)) {
+				variables.push_back(i);
+			}
+		}
+	}
+	return variables;
+}
+//Wyrmgus end
+
 static inline void IncreaseVariable(CUnit &unit, int index)
 {
 	unit.Variable[index].Value += unit.Variable[index].Increase;
@@ -374,7 +405,6 @@ static void HandleBuffsEachCycle(CUnit &unit)
 	
 	//Wyrmgus start
 //	const int SpellEffects[] = {BLOODLUST_INDEX, HASTE_INDEX, SLOW_INDEX, INVISIBLE_INDEX, UNHOLYARMOR_INDEX, POISON_INDEX};
-	const int SpellEffects[] = {BLOODLUST_INDEX, HASTE_INDEX, SLOW_INDEX, INVISIBLE_INDEX, UNHOLYARMOR_INDEX, POISON_INDEX, STUN_INDEX, BLEEDING_INDEX, LEADERSHIP_INDEX, BLESSING_INDEX, INSPIRE_INDEX, PRECISION_INDEX, REGENERATION_INDEX, TERROR_INDEX, WITHER_INDEX, DEHYDRATION_INDEX, HYDRATING_INDEX};
 	//Wyrmgus end
 	//  decrease spells effects time.
 	for (unsigned int i = 0; i < sizeof(SpellEffects) / sizeof(int); ++i) {
@@ -442,6 +472,8 @@ static void HandleBuffsEachSecond(CUnit &unit)
 	//Wyrmgus end
 	
 	// User defined variables
+	//Wyrmgus start
+	/*
 	for (unsigned int i = 0; i < UnitTypeVar.GetNumberVariable(); i++) {
 		if (i == BLOODLUST_INDEX || i == HASTE_INDEX || i == SLOW_INDEX
 			//Wyrmgus start
@@ -450,7 +482,18 @@ static void HandleBuffsEachSecond(CUnit &unit)
 			//Wyrmgus end
 			continue;
 		}
+	*/
+	// if none of the variables has an increase, only burning, poison and regeneration may change the hit points
+	static const std::vector<int> hit_points(1, HP_INDEX);
+	const std::vector<int> &variables = unit.VariablesIncrease ? GetVariablesEachSecond() : hit_points;
+	unit.VariablesIncrease = false; // set again below, or by anything giving a variable an increase
+	for (size_t j = 0; j < variables.size(); ++j) {
+		const int i = variables[j];
+		//Wyrmgus end
 		if (i == HP_INDEX && HandleBurnAndPoison(unit)) {
+			//Wyrmgus start
+			unit.VariablesIncrease = unit.VariablesIncrease || (unit.Variable[i].Enable && unit.Variable[i].Increase);
+			//Wyrmgus end
 			continue;
 		}
 		//Wyrmgus start
@@ -460,23 +503,18 @@ static void HandleBuffsEachSecond(CUnit &unit)
 		}
 		//Wyrmgus end
 		if (unit.Variable[i].Enable && unit.Variable[i].Increase) {
+			//Wyrmgus start
+			unit.VariablesIncrease = true;
+			//Wyrmgus end
 			IncreaseVariable(unit, i);
 		}
 	}
 	
 	//Wyrmgus start
+	//apply the auras covering the unit
+	unit.ApplyAuras();
+	
 	if (unit.IsAlive() && unit.CurrentAction() != UnitActionBuilt) {
-		//apply auras
-		if (unit.Variable[LEADERSHIPAURA_INDEX].Value > 0) {
-			unit.ApplyAura(LEADERSHIPAURA_INDEX);
-		}
-		if (unit.Variable[REGENERATIONAURA_INDEX].Value > 0) {
-			unit.ApplyAura(REGENERATIONAURA_INDEX);
-		}
-		if (unit.Variable[HYDRATINGAURA_INDEX].Value > 0) {
-			unit.ApplyAura(HYDRATINGAURA_INDEX);
-		}
-		
 		//apply "-stalk" abilities
 		if ((unit.Variable[DESERTSTALK_INDEX].Value > 0 || unit.Variable[FORESTSTALK_INDEX].Value > 0 || unit.Variable[SWAMPSTALK_INDEX].Value > 0) && Map.Info.IsPointOnMap(unit.tilePos.x, unit.tilePos.y, unit.MapLayer)) {
 			if (
@@ -519,6 +557,49 @@ static void HandleBuffsEachSecond(CUnit &unit)
 	//Wyrmgus end
 }
 
+//Wyrmgus start
+/// Names under which the execution of the orders is profiled, indexed by UnitAction
+static const char *OrderProfileNames[] = {
+	"COrder::Execute (none)",
+	"COrder::Execute (still)",
+	"COrder::Execute (stand-ground)",
+	"COrder::Execute (follow)",
+	"COrder::Execute (defend)",
+	"COrder::Execute (move)",
+	"COrder::Execute (attack)",
+	"COrder::Execute (attack-ground)",
+	"COrder::Execute (pick-up)",
+	"COrder::Execute (use)",
+	"COrder::Execute (trade)",
+	"COrder::Execute (die)",
+	"COrder::Execute (spell-cast)",
+	"COrder::Execute (train)",
+	"COrder::Execute (upgrade-to)",
+	"COrder::Execute (research)",
+	"COrder::Execute (built)",
+	"COrder::Execute (board)",
+	"COrder::Execute (unload)",
+	"COrder::Execute (patrol)",
+	"COrder::Execute (build)",
+	"COrder::Execute (repair)",
+	"COrder::Execute (resource)",
+	"COrder::Execute (transform-into)"
+};
+static_assert(sizeof(OrderProfileNames) / sizeof(*OrderProfileNames) == UnitActionTransformInto + 1, "OrderProfileNames must have a name for each UnitAction");
+
+/**
+**  Execute an order of a unit, timing it if profiling is enabled.
+**
+**  @param order  Order to execute.
+**  @param unit   Unit executing the order.
+*/
+static void ExecuteOrder(COrder &order, CUnit &unit)
+{
+	PROFILE_SCOPE(OrderProfileNames[order.Action]);
+	order.Execute(unit);
+}
+//Wyrmgus end
+
 /**
 **  Handle the action of a unit.
 **
@@ -529,7 +610,10 @@ static void HandleUnitAction(CUnit &unit)
 	// If current action is breakable proceed with next one.
 	if (!unit.Anim.Unbreakable) {
 		if (unit.CriticalOrder != NULL) {
-			unit.CriticalOrder->Execute(unit);
+			//Wyrmgus start
+//			unit.CriticalOrder->Execute(unit);
+			ExecuteOrder(*unit.CriticalOrder, unit);
+			//Wyrmgus end
 			delete unit.CriticalOrder;
 			unit.CriticalOrder = NULL;
 		}
@@ -563,7 +647,10 @@ static void HandleUnitAction(CUnit &unit)
 			}
 		}
 	}
-	unit.Orders[0]->Execute(unit);
+	//Wyrmgus start
+//	unit.Orders[0]->Execute(unit);
+	ExecuteOrder(*unit.Orders[0], unit);
+	//Wyrmgus end
 }
 
 template <typename UNITP_ITERATOR>
@@ -720,18 +807,32 @@ static void UnitActionsEachMinute(UNITP_ITERATOR begin, UNITP_ITERATOR end)
 */
 void UnitActions()
 {
+	//Wyrmgus start
+	PROFILE_SCOPE("UnitActions");
+	//Wyrmgus end
+	
 	const bool isASecondCycle = !(GameCycle % CYCLES_PER_SECOND);
 	// Unit list may be modified during loop... so make a copy
 	std::vector<CUnit *> table(UnitManager.begin(), UnitManager.end());
+	//Wyrmgus start
+	Profiler.Count("Units", table.size());
+	//Wyrmgus end
 
 	// Check for things that only happen every second
 	if (isASecondCycle) {
+		//Wyrmgus start
+		UpdateAuraInfluence();
+		//Wyrmgus end
 		UnitActionsEachSecond(table.begin(), table.end());
 	}
 	
 	if ((GameCycle % (CYCLES_PER_SECOND * 5)) == 0) {
 		UnitActionsEachFiveSeconds(table.begin(), table.end());
 	}
+	//Wyrmgus start
+	// Compute the paths needed this cycle on the worker threads
+	FindPendingPaths(table);
+	//Wyrmgus end
 	// Do all actions
 	UnitActionsEachCycle(table.begin(), table.end());
 	
@@ -1487,6 +1487,11 @@ void CommandSharedVision(int player, bool state, int opponent)
 			MapMarkUnitSight(unit);
 		}
 	}
+
+	//Wyrmgus start
+	// the players now know the tiles explored by each other
+	AStarMapExplorationChanged();
+	//Wyrmgus end
 }
 
 /**
@@ -161,6 +161,7 @@
 #include "pathfinder.h"
 #include "player.h"
 //Wyrmgus start
+#include "profile.h"
 #include "quest.h"
 //Wyrmgus end
 #include "script.h"
@@ -192,6 +193,10 @@ PlayerAi *AiPlayer;             /// Current AI player
 */
 static void AiExecuteScript()
 {
+	//Wyrmgus start
+	PROFILE_SCOPE("AiExecuteScript");
+	//Wyrmgus end
+	
 	if (AiPlayer->Script.empty()) {
 		return;
 	}
@@ -207,6 +212,10 @@ static void AiExecuteScript()
 */
 static void AiCheckUnits()
 {
+	//Wyrmgus start
+	PROFILE_SCOPE("AiCheckUnits");
+	//Wyrmgus end
+	
 	//  Count the already made build requests.
 	int counter[UnitTypeMax];
 	AiGetBuildRequestsCount(*AiPlayer, counter);
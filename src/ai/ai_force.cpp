@@ -44,6 +44,9 @@
 #include "depend.h"
 #include "map.h"
 #include "pathfinder.h"
+//Wyrmgus start
+#include "profile.h"
+//Wyrmgus end
 #include "tileset.h"
 #include "unit.h"
 #include "unit_find.h"
@@ -377,7 +380,10 @@ int AiFindAvailableUnitTypeEquiv(const CUnitType &unittype, int *usableTypes)
 	int usableTypesCount = AiFindUnitTypeEquiv(unittype, usableTypes);
 	// 2 - Remove unavailable unittypes
 	for (int i = 0; i < usableTypesCount;) {
-		if (!CheckDependByIdent(*AiPlayer->Player, UnitTypes[usableTypes[i]]->Ident)) {
+		//Wyrmgus start
+//		if (!CheckDependByIdent(*AiPlayer->Player, UnitTypes[usableTypes[i]]->Ident)) {
+		if (!CheckDependByType(*AiPlayer->Player, *UnitTypes[usableTypes[i]])) {
+		//Wyrmgus end
 			// Not available, remove it
 			usableTypes[i] = usableTypes[usableTypesCount - 1];
 			--usableTypesCount;
@@ -2136,17 +2142,29 @@ void AiForceManager::UpdatePerMinute()
 */
 void AiForceManager()
 {
+	//Wyrmgus start
+	PROFILE_SCOPE("AiForceManager");
+	//Wyrmgus end
+	
 	AiPlayer->Force.Update();
 	AiAssignFreeUnitsToForce();
 }
 
 void AiForceManagerEachHalfMinute()
 {
+	//Wyrmgus start
+	PROFILE_SCOPE("AiForceManagerEachHalfMinute");
+	//Wyrmgus end
+	
 	AiPlayer->Force.UpdatePerHalfMinute();
 }
 
 void AiForceManagerEachMinute()
 {
+	//Wyrmgus start
+	PROFILE_SCOPE("AiForceManagerEachMinute");
+	//Wyrmgus end
+	
 	AiPlayer->Force.UpdatePerMinute();
 }
 
@@ -39,6 +39,9 @@
 #include "spells.h"
 #include "actions.h"
 #include "ai_local.h"
+//Wyrmgus start
+#include "profile.h"
+//Wyrmgus end
 
 /*----------------------------------------------------------------------------
 --  Functions
@@ -50,6 +53,10 @@
 */
 void AiCheckMagic()
 {
+	//Wyrmgus start
+	PROFILE_SCOPE("AiCheckMagic");
+	//Wyrmgus end
+	
 	CPlayer &player = *AiPlayer->Player;
 	const int n = player.GetUnitCount();
 
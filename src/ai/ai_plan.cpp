@@ -42,6 +42,9 @@
 #include "map.h"
 #include "missile.h"
 #include "pathfinder.h"
+//Wyrmgus start
+#include "profile.h"
+//Wyrmgus end
 #include "tileset.h"
 #include "unit.h"
 #include "unit_find.h"
@@ -671,6 +674,10 @@ static CUnit *GetBestScout(int unit_type)
 */
 void AiSendExplorers()
 {
+	//Wyrmgus start
+	PROFILE_SCOPE("AiSendExplorers");
+	//Wyrmgus end
+	
 	//Wyrmgus start
 	/*
 	// Count requests...
@@ -762,6 +769,10 @@ void AiSendExplorers()
 //Wyrmgus start
 void AiCheckTransporters()
 {
+	//Wyrmgus start
+	PROFILE_SCOPE("AiCheckTransporters");
+	//Wyrmgus end
+	
 	//Wyrmgus start
 	for (std::map<int, std::vector<CUnit *>>::const_iterator iterator = AiPlayer->Transporters.begin(); iterator != AiPlayer->Transporters.end(); ++iterator) {
 		for (size_t i = 0; i != iterator->second.size(); ++i) {
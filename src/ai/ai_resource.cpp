@@ -46,6 +46,9 @@
 #include "map.h"
 #include "pathfinder.h"
 #include "player.h"
+//Wyrmgus start
+#include "profile.h"
+//Wyrmgus end
 #include "tileset.h"
 #include "unit.h"
 #include "unit_find.h"
@@ -475,7 +478,7 @@ static bool AiRequestedUpgradeAllowed(const CPlayer &player, const CUpgrade *upg
 	for (size_t i = 0; i < size; ++i) {
 		CUnitType &researcher = *AiHelpers.Research[upgrade->ID][i];
 
-		if ((player.GetUnitTypeAiActiveCount(&researcher) > 0 || (allow_can_build_researcher && AiRequestedTypeAllowed(player, researcher))) && CheckDependByIdent(player, upgrade->Ident)) {
+		if ((player.GetUnitTypeAiActiveCount(&researcher) > 0 || (allow_can_build_researcher && AiRequestedTypeAllowed(player, researcher))) && CheckDependByUpgrade(player, *upgrade)) {
 			return true;
 		}
 	}
@@ -2204,6 +2207,7 @@ static void AiCheckPathwayConstruction()
 						for (size_t z = 1; z < first_path_tiles.size(); ++z) {
 							if (!(Map.Field(first_path_tiles[z], unit.MapLayer)->Flags & MapFieldForest) && !(Map.Field(first_path_tiles[z], unit.MapLayer)->Flags & MapFieldRocks) && !(Map.Field(first_path_tiles[z], unit.MapLayer)->Flags & MapFieldWall)) {
 								Map.Field(first_path_tiles[z], unit.MapLayer)->Flags |= MapFieldUnpassable;
+								AStarTerrainChanged(first_path_tiles[z], Vec2i(1, 1), unit.MapLayer);
 							}
 						}
 						
@@ -2223,6 +2227,7 @@ static void AiCheckPathwayConstruction()
 						for (size_t z = 1; z < first_path_tiles.size(); ++z) {
 							if (!(Map.Field(first_path_tiles[z], unit.MapLayer)->Flags & MapFieldForest) && !(Map.Field(first_path_tiles[z], unit.MapLayer)->Flags & MapFieldRocks) && !(Map.Field(first_path_tiles[z], unit.MapLayer)->Flags & MapFieldWall)) {
 								Map.Field(first_path_tiles[z], unit.MapLayer)->Flags &= ~(MapFieldUnpassable);
+								AStarTerrainChanged(first_path_tiles[z], Vec2i(1, 1), unit.MapLayer);
 							}
 						}
 						
@@ -2315,6 +2320,10 @@ static void AiCheckPathwayConstruction()
 */
 void AiCheckSettlementConstruction()
 {
+	//Wyrmgus start
+	PROFILE_SCOPE("AiCheckSettlementConstruction");
+	//Wyrmgus end
+	
 	if (AiPlayer->Player->AiName == "passive") {
 		return;
 	}
@@ -2404,6 +2413,10 @@ void AiCheckSettlementConstruction()
 */
 void AiCheckDockConstruction()
 {
+	//Wyrmgus start
+	PROFILE_SCOPE("AiCheckDockConstruction");
+	//Wyrmgus end
+	
 	if (AiPlayer->Player->NumTownHalls < 1) { //don't build docks if has no town hall yet
 		return;
 	}
@@ -2485,6 +2498,10 @@ void AiCheckDockConstruction()
 
 void AiCheckUpgrades()
 {
+	//Wyrmgus start
+	PROFILE_SCOPE("AiCheckUpgrades");
+	//Wyrmgus end
+	
 	if (AiPlayer->Player->AiName == "passive") {
 		return;
 	}
@@ -2526,6 +2543,10 @@ void AiCheckUpgrades()
 
 void AiCheckBuildings()
 {
+	//Wyrmgus start
+	PROFILE_SCOPE("AiCheckBuildings");
+	//Wyrmgus end
+	
 	if (AiPlayer->Player->Race == -1 || AiPlayer->Player->Faction == -1) {
 		return;
 	}
@@ -2724,6 +2745,10 @@ static void AiCheckMinecartSalvaging()
 	
 void AiCheckWorkers()
 {
+	//Wyrmgus start
+	PROFILE_SCOPE("AiCheckWorkers");
+	//Wyrmgus end
+	
 	if (AiPlayer->Player->Race == -1 || AiPlayer->Player->Faction == -1) {
 		return;
 	}
@@ -2790,6 +2815,10 @@ void AiExplore(const Vec2i &pos, int mask)
 */
 void AiResourceManager()
 {
+	//Wyrmgus start
+	PROFILE_SCOPE("AiResourceManager");
+	//Wyrmgus end
+	
 	// Check if something needs to be build / trained.
 	AiCheckingWork();
 
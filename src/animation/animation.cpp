@@ -274,6 +274,124 @@ int ParseAnimInt(const CUnit &unit, const char *parseint)
 	return atoi(parseint);
 }
 
+//Wyrmgus start
+/**
+**  Parse the field of a unit variable in animation frame.
+**
+**  @param field  Name of the field.
+**
+**  @return  The field, AnimVarNone if the name is unknown.
+*/
+AnimationVariableField ParseAnimVariableField(const char *field)
+{
+	if (!strcmp(field, "Value")) {
+		return AnimVarValue;
+	} else if (!strcmp(field, "Max")) {
+		return AnimVarMax;
+	} else if (!strcmp(field, "Increase")) {
+		return AnimVarIncrease;
+	} else if (!strcmp(field, "Enable")) {
+		return AnimVarEnable;
+	} else if (!strcmp(field, "Percent")) {
+		return AnimVarPercent;
+	}
+	return AnimVarNone;
+}
+
+/**
+**  Decode an integer operand of an animation frame.
+**
+**  @param text  Operand, in the format of ParseAnimInt.
+*/
+void CAnimationOperand::Init(const std::string &text)
+{
+	this->Text = text;
+	this->Kind = OperandText;
+	this->Index = -1;
+	this->Field = AnimVarNone;
+	this->Constant = 0;
+
+	if (text.empty()) {
+		this->Kind = OperandConstant;
+		return;
+	}
+
+	const char type = text[0];
+	const std::string name = text.size() > 2 ? text.substr(2) : std::string();
+	if (type == 'v' || type == 't') {
+		const size_t dot = name.find('.');
+		if (dot == std::string::npos) {
+			return;
+		}
+		const int index = UnitTypeVar.VariableNameLookup[name.substr(0, dot).c_str()];
+		if (index == -1) {
+			return;
+		}
+		this->Kind = type == 'v' ? OperandVariable : OperandGoalVariable;
+		this->Index = index;
+		this->Field = ParseAnimVariableField(name.c_str() + dot + 1);
+	} else if (type == 'b' || type == 'g') {
+		const int index = UnitTypeVar.BoolFlagNameLookup[name.c_str()];
+		if (index == -1) {
+			return;
+		}
+		this->Kind = type == 'b' ? OperandBoolFlag : OperandGoalBoolFlag;
+		this->Index = index;
+	} else if (isdigit(type) || type == '-') {
+		this->Kind = OperandConstant;
+		this->Constant = atoi(text.c_str());
+	}
+}
+
+/**
+**  Evaluate an integer operand of an animation frame.
+**
+**  @param unit  Unit of the animation.
+**
+**  @return  The value of the operand, as ParseAnimInt would return it.
+*/
+int CAnimationOperand::Evaluate(const CUnit &unit) const
+{
+	const CUnit *goal = &unit;
+
+	switch (this->Kind) {
+		case OperandConstant:
+			return this->Constant;
+		case OperandGoalVariable:
+			if (!unit.CurrentOrder()->HasGoal()) {
+				return 0;
+			}
+			goal = unit.CurrentOrder()->GetGoal();
+			// fall through
+		case OperandVariable:
+			switch (this->Field) {
+				case AnimVarValue:
+					return goal->GetModifiedVariable(this->Index, VariableValue);
+				case AnimVarMax:
+					return goal->GetModifiedVariable(this->Index, VariableMax);
+				case AnimVarIncrease:
+					return goal->GetModifiedVariable(this->Index, VariableIncrease);
+				case AnimVarEnable:
+					return goal->Variable[this->Index].Enable;
+				case AnimVarPercent:
+					return goal->GetModifiedVariable(this->Index, VariableValue) * 100 / goal->GetModifiedVariable(this->Index, VariableMax);
+				default:
+					return 0;
+			}
+		case OperandGoalBoolFlag:
+			if (!unit.CurrentOrder()->HasGoal()) {
+				return 0;
+			}
+			goal = unit.CurrentOrder()->GetGoal();
+			// fall through
+		case OperandBoolFlag:
+			return goal->Type->BoolFlag[this->Index].value;
+		default:
+			return ParseAnimInt(unit, this->Text.c_str());
+	}
+}
+//Wyrmgus end
+
 /**
 **  Parse flags list in animation frame.
 **
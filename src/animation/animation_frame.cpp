@@ -52,15 +52,24 @@
 
 /* virtual */ void CAnimation_Frame::Init(const char *s, lua_State *)
 {
-	this->frame = s;
+	//Wyrmgus start
+//	this->frame = s;
+	this->frame.Init(s);
+	//Wyrmgus end
 }
 
 int CAnimation_Frame::ParseAnimInt(const CUnit *unit) const
 {
 	if (unit == NULL) {
-		return atoi(this->frame.c_str());
+		//Wyrmgus start
+//		return atoi(this->frame.c_str());
+		return atoi(this->frame.GetText().c_str());
+		//Wyrmgus end
 	} else {
-		return ::ParseAnimInt(*unit, this->frame.c_str());
+		//Wyrmgus start
+//		return ::ParseAnimInt(*unit, this->frame.c_str());
+		return this->frame.Evaluate(*unit);
+		//Wyrmgus end
 	}
 }
 
@@ -69,8 +69,14 @@ static bool returnFalse(int, int) { return false; }
 {
 	Assert(unit.Anim.Anim == this);
 
-	const int lop = ParseAnimInt(unit, this->leftVar.c_str());
-	const int rop = ParseAnimInt(unit, this->rightVar.c_str());
+	//Wyrmgus start
+//	const int lop = ParseAnimInt(unit, this->leftVar.c_str());
+	const int lop = this->leftVar.Evaluate(unit);
+	//Wyrmgus end
+	//Wyrmgus start
+//	const int rop = ParseAnimInt(unit, this->rightVar.c_str());
+	const int rop = this->rightVar.Evaluate(unit);
+	//Wyrmgus end
 	const bool cond = this->binOpFunc(lop, rop);
 
 	if (cond) {
@@ -88,7 +94,10 @@ static bool returnFalse(int, int) { return false; }
 
 	size_t begin = 0;
 	size_t end = std::min(len, str.find(' ', begin));
-	this->leftVar.assign(str, begin, end - begin);
+	//Wyrmgus start
+//	this->leftVar.assign(str, begin, end - begin);
+	this->leftVar.Init(std::string(str, begin, end - begin));
+	//Wyrmgus end
 
 	begin = std::min(len, str.find_first_not_of(' ', end));
 	end = std::min(len, str.find(' ', begin));
@@ -134,7 +143,10 @@ static bool returnFalse(int, int) { return false; }
 
 	begin = std::min(len, str.find_first_not_of(' ', end));
 	end = std::min(len, str.find(' ', begin));
-	this->rightVar.assign(str, begin, end - begin);
+	//Wyrmgus start
+//	this->rightVar.assign(str, begin, end - begin);
+	this->rightVar.Init(std::string(str, begin, end - begin));
+	//Wyrmgus end
 
 	begin = std::min(len, str.find_first_not_of(' ', end));
 	end = std::min(len, str.find(' ', begin));
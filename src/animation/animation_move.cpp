@@ -44,12 +44,18 @@
 	Assert(unit.Anim.Anim == this);
 	Assert(!move);
 
-	move = ParseAnimInt(unit, this->moveStr.c_str());
+	//Wyrmgus start
+//	move = ParseAnimInt(unit, this->moveStr.c_str());
+	move = this->moveStr.Evaluate(unit);
+	//Wyrmgus end
 }
 
 /* virtual */ void CAnimation_Move::Init(const char *s, lua_State *)
 {
-	this->moveStr = s;
+	//Wyrmgus start
+//	this->moveStr = s;
+	this->moveStr.Init(s);
+	//Wyrmgus end
 }
 
 //@}
@@ -43,7 +43,10 @@
 {
 	Assert(unit.Anim.Anim == this);
 
-	if (SyncRand() % 100 < ParseAnimInt(unit, this->randomStr.c_str())) {
+	//Wyrmgus start
+//	if (SyncRand() % 100 < ParseAnimInt(unit, this->randomStr.c_str())) {
+	if (SyncRand() % 100 < this->randomStr.Evaluate(unit)) {
+	//Wyrmgus end
 		unit.Anim.Anim = this->gotoLabel;
 	}
 }
@@ -58,7 +61,10 @@
 
 	size_t begin = 0;
 	size_t end = str.find(' ', begin);
-	this->randomStr.assign(str, begin, end - begin);
+	//Wyrmgus start
+//	this->randomStr.assign(str, begin, end - begin);
+	this->randomStr.Init(std::string(str, begin, end - begin));
+	//Wyrmgus end
 
 	begin = std::min(len, str.find_first_not_of(' ', end));
 	end = std::min(len, str.find(' ', begin));
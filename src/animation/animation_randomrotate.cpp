@@ -45,15 +45,24 @@
 	Assert(unit.Anim.Anim == this);
 
 	if ((SyncRand() >> 8) & 1) {
-		UnitRotate(unit, -ParseAnimInt(unit, this->rotateStr.c_str()));
+		//Wyrmgus start
+//		UnitRotate(unit, -ParseAnimInt(unit, this->rotateStr.c_str()));
+		UnitRotate(unit, -this->rotateStr.Evaluate(unit));
+		//Wyrmgus end
 	} else {
-		UnitRotate(unit, ParseAnimInt(unit, this->rotateStr.c_str()));
+		//Wyrmgus start
+//		UnitRotate(unit, ParseAnimInt(unit, this->rotateStr.c_str()));
+		UnitRotate(unit, this->rotateStr.Evaluate(unit));
+		//Wyrmgus end
 	}
 }
 
 /* virtual */ void CAnimation_RandomRotate::Init(const char *s, lua_State *)
 {
-	this->rotateStr = s;
+	//Wyrmgus start
+//	this->rotateStr = s;
+	this->rotateStr.Init(s);
+	//Wyrmgus end
 }
 
 //@}
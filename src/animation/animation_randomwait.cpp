@@ -43,8 +43,14 @@
 {
 	Assert(unit.Anim.Anim == this);
 
-	const int arg1 = ParseAnimInt(unit, this->minWait.c_str());
-	const int arg2 = ParseAnimInt(unit, this->maxWait.c_str());
+	//Wyrmgus start
+//	const int arg1 = ParseAnimInt(unit, this->minWait.c_str());
+	const int arg1 = this->minWait.Evaluate(unit);
+	//Wyrmgus end
+	//Wyrmgus start
+//	const int arg2 = ParseAnimInt(unit, this->maxWait.c_str());
+	const int arg2 = this->maxWait.Evaluate(unit);
+	//Wyrmgus end
 
 	unit.Anim.Wait = arg1 + SyncRand() % (arg2 - arg1 + 1);
 }
@@ -59,11 +65,17 @@
 
 	size_t begin = 0;
 	size_t end = str.find(' ', begin);
-	this->minWait.assign(str, begin, end - begin);
+	//Wyrmgus start
+//	this->minWait.assign(str, begin, end - begin);
+	this->minWait.Init(std::string(str, begin, end - begin));
+	//Wyrmgus end
 
 	begin = std::min(len, str.find_first_not_of(' ', end));
 	end = std::min(len, str.find(' ', begin));
-	this->maxWait.assign(str, begin, end - begin);
+	//Wyrmgus start
+//	this->maxWait.assign(str, begin, end - begin);
+	this->maxWait.Init(std::string(str, begin, end - begin));
+	//Wyrmgus end
 }
 
 //@}
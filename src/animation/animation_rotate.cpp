@@ -56,7 +56,10 @@ void UnitRotate(CUnit &unit, int rotate)
 {
 	Assert(unit.Anim.Anim == this);
 
-	if (!strcmp(this->rotateStr.c_str(), "target") && unit.CurrentOrder()->HasGoal()) {
+	//Wyrmgus start
+//	if (!strcmp(this->rotateStr.c_str(), "target") && unit.CurrentOrder()->HasGoal()) {
+	if (this->rotateToTarget && unit.CurrentOrder()->HasGoal()) {
+	//Wyrmgus end
 		COrder &order = *unit.CurrentOrder();
 		const CUnit &target = *order.GetGoal();
 		if (target.Destroyed) {
@@ -66,13 +69,20 @@ void UnitRotate(CUnit &unit, int rotate)
 		const Vec2i pos = target.tilePos + target.Type->GetHalfTileSize() - unit.tilePos;
 		UnitHeadingFromDeltaXY(unit, pos);
 	} else {
-		UnitRotate(unit, ParseAnimInt(unit, this->rotateStr.c_str()));
+		//Wyrmgus start
+//		UnitRotate(unit, ParseAnimInt(unit, this->rotateStr.c_str()));
+		UnitRotate(unit, this->rotateStr.Evaluate(unit));
+		//Wyrmgus end
 	}
 }
 
 /* virtual */ void CAnimation_Rotate::Init(const char *s, lua_State *)
 {
-	this->rotateStr = s;
+	//Wyrmgus start
+//	this->rotateStr = s;
+	this->rotateStr.Init(s);
+	this->rotateToTarget = !strcmp(s, "target");
+	//Wyrmgus end
 }
 
 //@}
@@ -51,9 +51,13 @@
 {
 	Assert(unit.Anim.Anim == this);
 
-	char arg1[128];
+	//Wyrmgus start
+//	char arg1[128];
+	//Wyrmgus end
 	CUnit *goal = &unit;
-	strcpy(arg1, this->varStr.c_str());
+	//Wyrmgus start
+//	strcpy(arg1, this->varStr.c_str());
+	//Wyrmgus end
 
 	if (this->unitSlotStr.empty() == false) {
 		switch (this->unitSlotStr[0]) {
@@ -72,6 +76,8 @@
 		return;
 	}
 
+	//Wyrmgus start
+	/*
 	char *next = strchr(arg1, '.');
 	if (next == NULL) {
 		// Special case for non-CVariable variables
@@ -111,6 +117,63 @@
 	} else if (!strcmp(next + 1, "Percent")) {
 		value = goal->Variable[index].Value * 100 / goal->Variable[index].Max;
 	}
+	*/
+	int index = this->varIndex;
+	AnimationVariableField field = this->varField;
+	if (index == -1) {
+		// the variable wasn't defined yet when the animation was, so look it up by name
+		char arg1[128];
+		strcpy(arg1, this->varStr.c_str());
+		char *next = strchr(arg1, '.');
+		if (next == NULL) {
+			// Special case for non-CVariable variables
+			if (!strcmp(arg1, "DamageType")) {
+				int death = ExtraDeathIndex(this->valueStr.GetText().c_str());
+				if (death == ANIMATIONS_DEATHTYPES) {
+					fprintf(stderr, "Incorrect death type : %s \n" _C_ this->valueStr.GetText().c_str());
+					Exit(1);
+					return;
+				}
+				goal->Type->DamageType = this->valueStr.GetText();
+				return;
+			}
+			fprintf(stderr, "Need also specify the variable '%s' tag \n" _C_ arg1);
+			Exit(1);
+			return;
+		} else {
+			*next = '\0';
+		}
+		index = UnitTypeVar.VariableNameLookup[arg1];// User variables
+		if (index == -1) {
+			fprintf(stderr, "Bad variable name '%s'\n" _C_ arg1);
+			Exit(1);
+			return;
+		}
+		field = ParseAnimVariableField(next + 1);
+	}
+
+	const int rop = this->valueStr.Evaluate(unit);
+	int value = 0;
+	switch (field) {
+		case AnimVarValue:
+			value = goal->Variable[index].Value;
+			break;
+		case AnimVarMax:
+			value = goal->Variable[index].Max;
+			break;
+		case AnimVarIncrease:
+			value = goal->Variable[index].Increase;
+			break;
+		case AnimVarEnable:
+			value = goal->Variable[index].Enable;
+			break;
+		case AnimVarPercent:
+			value = goal->Variable[index].Value * 100 / goal->Variable[index].Max;
+			break;
+		default:
+			break;
+	}
+	//Wyrmgus end
 	switch (this->mod) {
 		case modAdd:
 			value += rop;
@@ -152,6 +215,8 @@
 		default:
 			value = rop;
 	}
+	//Wyrmgus start
+	/*
 	if (!strcmp(next + 1, "Value")) {
 		goal->Variable[index].Value = value;
 	} else if (!strcmp(next + 1, "Max")) {
@@ -163,6 +228,29 @@
 	} else if (!strcmp(next + 1, "Percent")) {
 		goal->Variable[index].Value = goal->Variable[index].Max * value / 100;
 	}
+	*/
+	switch (field) {
+		case AnimVarValue:
+			goal->Variable[index].Value = value;
+			break;
+		case AnimVarMax:
+			goal->Variable[index].Max = value;
+			break;
+		case AnimVarIncrease:
+			goal->Variable[index].Increase = value;
+			goal->VariablesIncrease = true;
+			break;
+		case AnimVarEnable:
+			goal->Variable[index].Enable = value;
+			goal->VariablesIncrease = true;
+			break;
+		case AnimVarPercent:
+			goal->Variable[index].Value = goal->Variable[index].Max * value / 100;
+			break;
+		default:
+			break;
+	}
+	//Wyrmgus end
 	//Wyrmgus start
 //	clamp(&goal->Variable[index].Value, 0, goal->Variable[index].Max);
 	clamp(&goal->Variable[index].Value, 0, goal->GetModifiedVariable(index, VariableMax));
@@ -193,6 +281,13 @@
 	size_t begin = 0;
 	size_t end = str.find(' ', begin);
 	this->varStr.assign(str, begin, end - begin);
+	//Wyrmgus start
+	const size_t dot = this->varStr.find('.');
+	if (dot != std::string::npos) {
+		this->varIndex = UnitTypeVar.VariableNameLookup[this->varStr.substr(0, dot).c_str()];
+		this->varField = ParseAnimVariableField(this->varStr.c_str() + dot + 1);
+	}
+	//Wyrmgus end
 
 	begin = std::min(len, str.find_first_not_of(' ', end));
 	end = std::min(len, str.find(' ', begin));
@@ -224,7 +319,10 @@
 
 	begin = std::min(len, str.find_first_not_of(' ', end));
 	end = std::min(len, str.find(' ', begin));
-	this->valueStr.assign(str, begin, end - begin);
+	//Wyrmgus start
+//	this->valueStr.assign(str, begin, end - begin);
+	this->valueStr.Init(std::string(str, begin, end - begin));
+	//Wyrmgus end
 
 	begin = std::min(len, str.find_first_not_of(' ', end));
 	end = std::min(len, str.find(' ', begin));
@@ -42,7 +42,10 @@
 /* virtual */ void CAnimation_Wait::Action(CUnit &unit, int &/*move*/, int scale) const
 {
 	Assert(unit.Anim.Anim == this);
-	unit.Anim.Wait = ParseAnimInt(unit, this->wait.c_str()) << scale >> 8;
+	//Wyrmgus start
+//	unit.Anim.Wait = ParseAnimInt(unit, this->wait.c_str()) << scale >> 8;
+	unit.Anim.Wait = this->wait.Evaluate(unit) << scale >> 8;
+	//Wyrmgus end
 	if (unit.Variable[SLOW_INDEX].Value) { // unit is slowed down
 		unit.Anim.Wait <<= 1;
 	}
@@ -56,7 +59,10 @@
 
 /* virtual */ void CAnimation_Wait::Init(const char *s, lua_State *)
 {
-	this->wait = s;
+	//Wyrmgus start
+//	this->wait = s;
+	this->wait.Init(s);
+	//Wyrmgus end
 }
 
 //@}
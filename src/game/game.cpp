@@ -66,6 +66,7 @@
 #include "pathfinder.h"
 #include "player.h"
 //Wyrmgus start
+#include "profile.h"
 #include "province.h"
 #include "quest.h"
 //Wyrmgus end
@@ -2031,6 +2032,48 @@ static int CclGetGodMode(lua_State *l)
 	return 1;
 }
 
+//Wyrmgus start
+/**
+**  Start or stop profiling.
+**
+**  @param l  Lua state.
+*/
+static int CclSetProfiling(lua_State *l)
+{
+	LuaCheckArgs(l, 1);
+	Profiler.SetEnabled(LuaToBoolean(l, 1));
+	return 0;
+}
+
+/**
+**  Get whether profiling is enabled.
+**
+**  @param l  Lua state.
+**
+**  @return   Whether profiling is enabled.
+*/
+static int CclGetProfiling(lua_State *l)
+{
+	LuaCheckArgs(l, 0);
+	lua_pushboolean(l, Profiler.IsEnabled());
+	return 1;
+}
+
+/**
+**  Save the profiled frames as a Chrome trace file in the user directory.
+**
+**  @param l  Lua state.
+**
+**  @return   Whether the file could be saved.
+*/
+static int CclSaveProfileTrace(lua_State *l)
+{
+	LuaCheckArgs(l, 1);
+	lua_pushboolean(l, Profiler.SaveTrace(LuaToString(l, 1)));
+	return 1;
+}
+//Wyrmgus end
+
 /**
 **  Set resource harvesting speed (deprecated).
 **
@@ -2367,6 +2410,11 @@ void LuaRegisterModules()
 
 	lua_register(Lua, "SetGodMode", CclSetGodMode);
 	lua_register(Lua, "GetGodMode", CclGetGodMode);
+	//Wyrmgus start
+	lua_register(Lua, "SetProfiling", CclSetProfiling);
+	lua_register(Lua, "GetProfiling", CclGetProfiling);
+	lua_register(Lua, "SaveProfileTrace", CclSaveProfileTrace);
+	//Wyrmgus end
 
 	lua_register(Lua, "SetSpeedResourcesHarvest", CclSetSpeedResourcesHarvest);
 	lua_register(Lua, "SetSpeedResourcesReturn", CclSetSpeedResourcesReturn);
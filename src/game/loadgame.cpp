@@ -174,6 +174,23 @@ void InitModules()
 	Map.Init();
 }
 
+//Wyrmgus start
+/**
+**  Decode the graphics of the modules in advance, spreading the work over the worker threads.
+*/
+static void DecodeModuleGraphics()
+{
+	std::vector<std::string> files;
+
+	GetIconFiles(files);
+	GetMissileSpriteFiles(files);
+	GetConstructionFiles(files);
+	GetUnitTypeFiles(files);
+
+	DecodeGraphicFiles(files);
+}
+//Wyrmgus end
+
 /**
 **  Load all.
 **
@@ -182,6 +199,9 @@ void InitModules()
 void LoadModules()
 {
 	LoadFonts();
+	//Wyrmgus start
+	DecodeModuleGraphics();
+	//Wyrmgus end
 	LoadIcons();
 	//Wyrmgus start
 //	LoadCursors(PlayerRaces.Name[ThisPlayer->Race]);
@@ -212,6 +232,7 @@ void LoadModules()
 	SetDefaultTextColors(UI.NormalFontColor, UI.ReverseFontColor);
 	
 	//Wyrmgus start
+	FreeDecodedGraphicFiles();
 	ResetItemsToLoad();
 	//Wyrmgus end
 }
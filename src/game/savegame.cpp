@@ -50,6 +50,9 @@
 //Wyrmgus end
 #include "replay.h"
 #include "spells.h"
+//Wyrmgus start
+#include "translate.h"
+//Wyrmgus end
 #include "trigger.h"
 #include "ui.h"
 #include "unit.h"
@@ -60,6 +63,12 @@
 
 #include <time.h>
 
+//Wyrmgus start
+#include <atomic>
+
+#include "SDL.h"
+//Wyrmgus end
+
 extern void StartMap(const std::string &filename, bool clean);
 
 
@@ -67,6 +76,22 @@ extern void StartMap(const std::string &filename, bool clean);
 --  Variables
 ----------------------------------------------------------------------------*/
 
+//Wyrmgus start
+bool SaveGameInBackground = false;	/// If true, SaveGame() leaves the compression and writing of the file to a background thread
+
+enum BackgroundSaveStates {
+	BackgroundSaveIdle,
+	BackgroundSaveRunning,
+	BackgroundSaveSucceeded,
+	BackgroundSaveFailed
+};
+
+static SDL_Thread *BackgroundSaveThread = NULL;	/// thread writing the last save game started in the background
+static std::string BackgroundSavePath;			/// path of the save game being written in the background
+static std::string BackgroundSaveData;			/// uncompressed save game being written in the background
+static std::atomic<int> BackgroundSaveState(BackgroundSaveIdle);
+//Wyrmgus end
+
 /*----------------------------------------------------------------------------
 --  Functions
 ----------------------------------------------------------------------------*/
@@ -103,6 +128,100 @@ static std::string GetSaveDir()
 	return dir;
 }
 
+//Wyrmgus start
+/**
+**  Compress and write already serialized save game data to a file.
+**
+**  @param fullpath  Path of the save game.
+**  @param data      Serialized save game.
+**
+**  @return  -1 if saving failed, 0 if all OK
+*/
+static int WriteSaveGameFile(const std::string &fullpath, const std::string &data)
+{
+	CFile file;
+	if (file.open(fullpath.c_str(), CL_WRITE_GZ | CL_OPEN_WRITE) == -1) {
+		fprintf(stderr, "Can't save to '%s'\n", fullpath.c_str());
+		return -1;
+	}
+	const bool written = data.empty() || file.write(data.c_str(), data.size()) > 0;
+	file.close();
+	if (!written) {
+		fprintf(stderr, "Can't write to '%s'\n", fullpath.c_str());
+		return -1;
+	}
+	return 0;
+}
+
+static int BackgroundSaveThreadFunction(void *)
+{
+	const int ret = WriteSaveGameFile(BackgroundSavePath, BackgroundSaveData);
+	BackgroundSaveData.clear();
+	BackgroundSaveState = ret == 0 ? BackgroundSaveSucceeded : BackgroundSaveFailed;
+	return ret;
+}
+
+/**
+**  Hand serialized save game data to the background save thread.
+**
+**  Falls back to writing the file directly if the thread can't be started.
+**
+**  @param fullpath  Path of the save game.
+**  @param data      Serialized save game, taken over by the thread.
+**
+**  @return  -1 if saving failed, 0 if all OK or still in progress
+*/
+static int StartBackgroundSave(const std::string &fullpath, std::string &data)
+{
+	Assert(BackgroundSaveThread == NULL);
+
+	BackgroundSavePath = fullpath;
+	BackgroundSaveData.swap(data);
+	BackgroundSaveState = BackgroundSaveRunning;
+	BackgroundSaveThread = SDL_CreateThread(BackgroundSaveThreadFunction, NULL);
+	if (BackgroundSaveThread == NULL) {
+		fprintf(stderr, "Could not create background save thread: %s\n", SDL_GetError());
+		BackgroundSaveState = BackgroundSaveIdle;
+		const int ret = WriteSaveGameFile(BackgroundSavePath, BackgroundSaveData);
+		BackgroundSaveData.clear();
+		return ret;
+	}
+	return 0;
+}
+
+/**
+**  Wait until the save game being written in the background, if any, is on disk.
+*/
+void WaitForBackgroundSave()
+{
+	if (BackgroundSaveThread != NULL) {
+		SDL_WaitThread(BackgroundSaveThread, NULL);
+		BackgroundSaveThread = NULL;
+	}
+}
+
+/**
+**  Report on the status line when the save game written in the background is done.
+**
+**  Called once per game cycle.
+*/
+void CheckBackgroundSave()
+{
+	const int state = BackgroundSaveState;
+	if (state != BackgroundSaveSucceeded && state != BackgroundSaveFailed) {
+		return;
+	}
+
+	WaitForBackgroundSave();
+	BackgroundSaveState = BackgroundSaveIdle;
+	if (state == BackgroundSaveSucceeded) {
+		UI.StatusLine.Set(_("Autosave complete"));
+	} else {
+		UI.StatusLine.Set(_("Autosave failed"));
+	}
+}
+//Wyrmgus end
+
 /**
 **  Save a game to file.
 **
@@ -118,7 +237,15 @@ int SaveGame(const std::string &filename)
 
 	fullpath += "/";
 	fullpath += filename;
-	if (file.open(fullpath.c_str(), CL_WRITE_GZ | CL_OPEN_WRITE) == -1) {
+	//Wyrmgus start
+	// don't let two saves write at the same time, the previous one may even be to the same file
+	WaitForBackgroundSave();
+
+	// a background save only serializes the game state here, the slow compression and disk access happen in another thread
+	const bool background = SaveGameInBackground;
+//	if (file.open(fullpath.c_str(), CL_WRITE_GZ | CL_OPEN_WRITE) == -1) {
+	if (file.open(fullpath.c_str(), (background ? CL_WRITE_MEMORY : CL_WRITE_GZ) | CL_OPEN_WRITE) == -1) {
+	//Wyrmgus end
 		fprintf(stderr, "Can't save to '%s'\n", filename.c_str());
 		return -1;
 	}
@@ -189,6 +316,12 @@ int SaveGame(const std::string &filename)
 	}
 	SaveTriggers(file); //Triggers are saved in SaveGlobal, so load it after Global
 	file.close();
+	//Wyrmgus start
+	if (background) {
+		std::string data = file.TakeMemoryData();
+		return StartBackgroundSave(fullpath, data);
+	}
+	//Wyrmgus end
 	return 0;
 }
 
@@ -214,6 +347,9 @@ void StartSavedGame(const std::string &filename)
 {
 	std::string path;
 
+	//Wyrmgus start
+	WaitForBackgroundSave();
+	//Wyrmgus end
 	SaveGameLoading = true;
 	CleanPlayers();
 	ExpandPath(path, filename);
@@ -45,6 +45,7 @@
 #include "map.h"
 #include "player.h"
 //Wyrmgus start
+#include "profile.h"
 #include "quest.h" // for saving quests
 //Wyrmgus end
 #include "results.h"
@@ -53,6 +54,10 @@
 #include "unit_find.h"
 #include "unittype.h"
 
+//Wyrmgus start
+#include <deque>
+//Wyrmgus end
+
 /*----------------------------------------------------------------------------
 --  Variables
 ----------------------------------------------------------------------------*/
@@ -68,6 +73,13 @@ TriggerDataType TriggerData;
 std::vector<CTrigger *> Triggers;
 std::vector<std::string> DeactivatedTriggers;
 std::map<std::string, CTrigger *> TriggerIdentToPointer;
+
+static const int WokenTriggersPerCycle = 8;     /// maximum number of woken triggers checked each cycle
+
+static std::map<const CUnitType *, std::vector<CTrigger *>> UnitTypeCountTriggers; /// triggers depending on the count of each unit type
+static std::vector<CTrigger *> ResourceTriggers[MaxCosts];  /// triggers depending on each resource
+static std::vector<CTrigger *> IntervalTriggers;            /// triggers checked periodically
+static std::deque<CTrigger *> WokenTriggers;                /// triggers waiting to be checked, in the order they were woken
 //Wyrmgus end
 
 /*----------------------------------------------------------------------------
@@ -474,6 +486,161 @@ void ActionStopTimer()
 	GameTimer.Running = false;
 }
 
+//Wyrmgus start
+/**
+**  Queue a trigger to be checked, if it isn't already.
+*/
+static void WakeTrigger(CTrigger *trigger)
+{
+	if (!trigger->Woken) {
+		trigger->Woken = true;
+		WokenTriggers.push_back(trigger);
+	}
+}
+
+/**
+**  Remove a trigger from the lists of the things it depends on, and from the woken triggers.
+*/
+static void RemoveTriggerDependencies(CTrigger *trigger)
+{
+	for (size_t i = 0; i < trigger->UnitTypeDependencies.size(); ++i) {
+		std::vector<CTrigger *> &triggers = UnitTypeCountTriggers[trigger->UnitTypeDependencies[i]];
+		triggers.erase(std::remove(triggers.begin(), triggers.end(), trigger), triggers.end());
+	}
+	for (size_t i = 0; i < trigger->ResourceDependencies.size(); ++i) {
+		std::vector<CTrigger *> &triggers = ResourceTriggers[trigger->ResourceDependencies[i]];
+		triggers.erase(std::remove(triggers.begin(), triggers.end(), trigger), triggers.end());
+	}
+	IntervalTriggers.erase(std::remove(IntervalTriggers.begin(), IntervalTriggers.end(), trigger), IntervalTriggers.end());
+	if (trigger->Woken) {
+		WokenTriggers.erase(std::remove(WokenTriggers.begin(), WokenTriggers.end(), trigger), WokenTriggers.end());
+		trigger->Woken = false;
+	}
+	
+	trigger->UnitTypeDependencies.clear();
+	trigger->ResourceDependencies.clear();
+	trigger->Interval = 0;
+}
+
+/**
+**  Parse the dependencies of a trigger, and add it to the lists of the things it depends on.
+**
+**  @param l          Lua state.
+**  @param trigger    Trigger.
+**  @param arg_index  Index of the table of the dependencies in the Lua stack.
+*/
+static void ParseTriggerDependencies(lua_State *l, CTrigger *trigger, int arg_index)
+{
+	if (!lua_istable(l, arg_index)) {
+		LuaError(l, "incorrect argument");
+	}
+	
+	for (lua_pushnil(l); lua_next(l, arg_index); lua_pop(l, 1)) {
+		const char *value = LuaToString(l, -2);
+		
+		if (!strcmp(value, "Interval")) {
+			trigger->Interval = std::max(1, LuaToNumber(l, -1) * CYCLES_PER_SECOND);
+		} else if (!strcmp(value, "UnitTypes")) {
+			if (!lua_istable(l, -1)) {
+				LuaError(l, "incorrect argument");
+			}
+			const int subargs = lua_rawlen(l, -1);
+			for (int j = 0; j < subargs; ++j) {
+				const CUnitType *unit_type = UnitTypeByIdent(LuaToString(l, -1, j + 1));
+				if (!unit_type) {
+					LuaError(l, "Unit type doesn't exist.");
+				}
+				trigger->UnitTypeDependencies.push_back(unit_type);
+			}
+		} else if (!strcmp(value, "Resources")) {
+			if (!lua_istable(l, -1)) {
+				LuaError(l, "incorrect argument");
+			}
+			const int subargs = lua_rawlen(l, -1);
+			for (int j = 0; j < subargs; ++j) {
+				const int resource = GetResourceIdByName(l, LuaToString(l, -1, j + 1));
+				if (resource == -1) {
+					LuaError(l, "Resource doesn't exist.");
+				}
+				trigger->ResourceDependencies.push_back(resource);
+			}
+		} else {
+			LuaError(l, "Unsupported tag: %s" _C_ value);
+		}
+	}
+	
+	for (size_t i = 0; i < trigger->UnitTypeDependencies.size(); ++i) {
+		UnitTypeCountTriggers[trigger->UnitTypeDependencies[i]].push_back(trigger);
+	}
+	for (size_t i = 0; i < trigger->ResourceDependencies.size(); ++i) {
+		ResourceTriggers[trigger->ResourceDependencies[i]].push_back(trigger);
+	}
+	if (trigger->Interval > 0) {
+		trigger->NextCycle = GameCycle + trigger->Interval;
+		IntervalTriggers.push_back(trigger);
+	}
+}
+
+/**
+**  Check the conditions of a trigger, and apply its effects if they are fulfilled.
+**
+**  The trigger is deleted if its effects return false.
+*/
+static void CheckTrigger(CTrigger *trigger)
+{
+	if (!trigger->Conditions || !trigger->Effects) {
+		return;
+	}
+	
+	trigger->Conditions->pushPreamble();
+	trigger->Conditions->run(1);
+	if (trigger->Conditions->popBoolean()) {
+		trigger->Effects->pushPreamble();
+		trigger->Effects->run(1);
+		if (trigger->Effects->popBoolean() == false) {
+			DeactivatedTriggers.push_back(trigger->Ident);
+			RemoveTriggerDependencies(trigger);
+			Triggers.erase(std::remove(Triggers.begin(), Triggers.end(), trigger), Triggers.end());
+			TriggerIdentToPointer.erase(trigger->Ident);
+			delete trigger;
+		}
+	}
+}
+
+/**
+**  Wake the triggers depending on the count of a unit type.
+**
+**  @param type  Unit type whose count changed.
+*/
+void TriggerUnitTypeCountChanged(const CUnitType *type)
+{
+	std::map<const CUnitType *, std::vector<CTrigger *>>::const_iterator find_iterator = UnitTypeCountTriggers.find(type);
+	if (find_iterator == UnitTypeCountTriggers.end()) {
+		return;
+	}
+	
+	for (size_t i = 0; i < find_iterator->second.size(); ++i) {
+		WakeTrigger(find_iterator->second[i]);
+	}
+}
+
+/**
+**  Wake the triggers depending on a resource.
+**
+**  @param resource  Resource which changed for a player.
+*/
+void TriggerResourceChanged(int resource)
+{
+	if (resource < 0 || resource >= MaxCosts) {
+		return;
+	}
+	
+	for (size_t i = 0; i < ResourceTriggers[resource].size(); ++i) {
+		WakeTrigger(ResourceTriggers[resource][i]);
+	}
+}
+//Wyrmgus end
+
 /**
 **  Add a trigger.
 */
@@ -518,7 +685,10 @@ static int CclAddTrigger(lua_State *l)
 	//Wyrmgus end
 	
 	//Wyrmgus start
-	LuaCheckArgs(l, 3);
+	const int args = lua_gettop(l);
+	if (args != 3 && args != 4) {
+		LuaError(l, "incorrect argument");
+	}
 	
 	if (!lua_isfunction(l, 2) || !lua_isfunction(l, 3)) {
 		LuaError(l, "incorrect argument");
@@ -544,6 +714,15 @@ static int CclAddTrigger(lua_State *l)
 	if (trigger->Conditions == NULL || trigger->Effects == NULL) {
 		fprintf(stderr, "Trigger \"%s\" has no conditions or no effects.\n", trigger->Ident.c_str());
 	}
+	
+	RemoveTriggerDependencies(trigger);
+	if (args == 4) {
+		ParseTriggerDependencies(l, trigger, 4);
+	}
+	if (trigger->HasDependencies()) {
+		// check the trigger once for the current state, after that only when what it depends on changes
+		WakeTrigger(trigger);
+	}
 	//Wyrmgus end
 
 	return 0;
@@ -635,6 +814,10 @@ static void TriggerRemoveTrigger(int trig)
 void TriggersEachCycle()
 {
 	//Wyrmgus start
+	PROFILE_SCOPE("TriggersEachCycle");
+	//Wyrmgus end
+	
+	//Wyrmgus start
 //	const int base = lua_gettop(Lua);
 	//Wyrmgus end
 
@@ -668,7 +851,15 @@ void TriggersEachCycle()
 	}
 	*/
 	//Wyrmgus end
-	if (Trigger < triggers) {
+	//Wyrmgus start
+	// the triggers with dependencies are skipped, as they are checked when woken
+	for (int checked = 0; checked < triggers && Trigger < triggers && Triggers[Trigger]->HasDependencies(); ++checked) {
+		Trigger = (Trigger + 1) % triggers;
+	}
+	
+//	if (Trigger < triggers) {
+	if (Trigger < triggers && !Triggers[Trigger]->HasDependencies()) {
+	//Wyrmgus end
 		//Wyrmgus start
 //		int currentTrigger = Trigger;
 		CTrigger *current_trigger = Triggers[Trigger];
@@ -688,22 +879,26 @@ void TriggersEachCycle()
 		lua_settop(Lua, base + 1);
 		*/
 		
-		if (current_trigger->Conditions && current_trigger->Effects) {
-			current_trigger->Conditions->pushPreamble();
-			current_trigger->Conditions->run(1);
-			if (current_trigger->Conditions->popBoolean()) {
-				current_trigger->Effects->pushPreamble();
-				current_trigger->Effects->run(1);
-				if (current_trigger->Effects->popBoolean() == false) {
-					DeactivatedTriggers.push_back(current_trigger->Ident);
-					Triggers.erase(std::remove(Triggers.begin(), Triggers.end(), current_trigger), Triggers.end());
-					TriggerIdentToPointer.erase(current_trigger->Ident);
-					delete current_trigger;
-				}
-			}
-		}
+		CheckTrigger(current_trigger);
 		//Wyrmgus end
 	}
+	
+	//Wyrmgus start
+	for (size_t i = 0; i < IntervalTriggers.size(); ++i) {
+		if (GameCycle >= IntervalTriggers[i]->NextCycle) {
+			IntervalTriggers[i]->NextCycle = GameCycle + IntervalTriggers[i]->Interval;
+			WakeTrigger(IntervalTriggers[i]);
+		}
+	}
+	
+	// check the triggers woken by changes to what they depend on, within a budget so that a burst of changes is spread over several cycles
+	for (int i = 0; i < WokenTriggersPerCycle && !WokenTriggers.empty(); ++i) {
+		CTrigger *woken_trigger = WokenTriggers.front();
+		WokenTriggers.pop_front();
+		woken_trigger->Woken = false;
+		CheckTrigger(woken_trigger);
+	}
+	//Wyrmgus end
 	//Wyrmgus start
 //	lua_pop(Lua, 1);
 	//Wyrmgus end
@@ -845,6 +1040,12 @@ void CleanTriggers()
 	Triggers.clear();
 	TriggerIdentToPointer.clear();
 	DeactivatedTriggers.clear();
+	UnitTypeCountTriggers.clear();
+	for (int i = 0; i < MaxCosts; ++i) {
+		ResourceTriggers[i].clear();
+	}
+	IntervalTriggers.clear();
+	WokenTriggers.clear();
 	
 	for (size_t i = 0; i < Quests.size(); ++i) {
 		Quests[i]->CurrentCompleted = false;
@@ -99,7 +99,11 @@ struct lua_State;
 class COrder
 {
 public:
-	explicit COrder(int action) : Goal(), Action(action), Finished(false)
+	//Wyrmgus start
+//	explicit COrder(int action) : Goal(), Action(action), Finished(false)
+	explicit COrder(int action) : Goal(), Action(action), Finished(false),
+		PathFinderUsed(false), HasPathFinderResult(false), PathFinderResult(0), PathFinderResultCycle(0)
+	//Wyrmgus end
 	{
 	}
 	virtual ~COrder();
@@ -203,6 +207,12 @@ private:
 public:
 	const unsigned char Action;   /// global action
 	bool Finished; /// true when order is finish
+	//Wyrmgus start
+	bool PathFinderUsed;                 /// true once the order has asked the path finder for a path
+	bool HasPathFinderResult;            /// true if a path search was done in advance for the order, see FindPendingPaths
+	int PathFinderResult;                /// result of the path search done in advance
+	unsigned long PathFinderResultCycle; /// game cycle of the path search done in advance, the result is only valid during it
+	//Wyrmgus end
 };
 
 typedef COrder *COrderPtr;
@@ -90,6 +90,52 @@ enum SetVar_ModifyTypes {
 	modNot,          /// Bitwise NOT
 };
 
+//Wyrmgus start
+/// Field of a unit variable read or written by an animation
+enum AnimationVariableField {
+	AnimVarValue = 0,  /// Value of the variable
+	AnimVarMax,        /// Max of the variable
+	AnimVarIncrease,   /// Increase of the variable
+	AnimVarEnable,     /// Enable of the variable
+	AnimVarPercent,    /// Value of the variable as a percentage of its Max
+	AnimVarNone        /// Unknown field, read as 0 and never written
+};
+
+/**
+**  Integer operand of an animation, decoded when the animation is defined.
+**
+**  Numbers, unit variables and unit bool flags are resolved to indexes once, so that
+**  evaluating them needs no string handling. The other operands, and names which are
+**  not defined yet, keep their text and go through ParseAnimInt.
+*/
+class CAnimationOperand
+{
+public:
+	CAnimationOperand() : Kind(OperandText), Index(-1), Field(AnimVarNone), Constant(0) {}
+
+	void Init(const std::string &text);
+	int Evaluate(const CUnit &unit) const;
+
+	const std::string &GetText() const { return this->Text; }
+
+private:
+	enum OperandKind {
+		OperandConstant,       /// a number
+		OperandVariable,       /// a variable of the unit
+		OperandGoalVariable,   /// a variable of the goal of the unit
+		OperandBoolFlag,       /// a bool flag of the unit type
+		OperandGoalBoolFlag,   /// a bool flag of the type of the goal of the unit
+		OperandText            /// anything else, parsed each time
+	};
+
+	std::string Text;             /// text of the operand
+	OperandKind Kind;             /// kind of the operand
+	int Index;                    /// index of the variable or bool flag
+	AnimationVariableField Field; /// field of the variable
+	int Constant;                 /// value of a constant operand
+};
+//Wyrmgus end
+
 class CAnimation
 {
 public:
@@ -176,6 +222,9 @@ extern int UnitShowAnimation(CUnit &unit, const CAnimation *anim);
 
 extern int ParseAnimInt(const CUnit &unit, const char *parseint);
 extern int ParseAnimFlags(const CUnit &unit, const char *parseflag);
+//Wyrmgus start
+extern AnimationVariableField ParseAnimVariableField(const char *field);
+//Wyrmgus end
 
 extern void FindLabelLater(CAnimation **anim, const std::string &name);
 
@@ -45,7 +45,10 @@ public:
 
 	int ParseAnimInt(const CUnit *unit) const;
 private:
-	std::string frame;
+	//Wyrmgus start
+//	std::string frame;
+	CAnimationOperand frame;
+	//Wyrmgus end
 };
 
 //@}
@@ -47,8 +47,14 @@ private:
 	typedef bool BinOpFunc(int lhs, int rhs);
 
 private:
-	std::string leftVar;
-	std::string rightVar;
+	//Wyrmgus start
+//	std::string leftVar;
+	CAnimationOperand leftVar;
+	//Wyrmgus end
+	//Wyrmgus start
+//	std::string rightVar;
+	CAnimationOperand rightVar;
+	//Wyrmgus end
 	BinOpFunc *binOpFunc;
 	CAnimation *gotoLabel;
 };
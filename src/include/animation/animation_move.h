@@ -44,7 +44,10 @@ public:
 	virtual void Init(const char *s, lua_State *l);
 
 private:
-	std::string moveStr;
+	//Wyrmgus start
+//	std::string moveStr;
+	CAnimationOperand moveStr;
+	//Wyrmgus end
 };
 
 //@}
@@ -44,7 +44,10 @@ public:
 	virtual void Init(const char *s, lua_State *l);
 
 private:
-	std::string randomStr;
+	//Wyrmgus start
+//	std::string randomStr;
+	CAnimationOperand randomStr;
+	//Wyrmgus end
 	CAnimation *gotoLabel;
 };
 
@@ -44,7 +44,10 @@ public:
 	virtual void Init(const char *s, lua_State *l);
 
 private:
-	std::string rotateStr;
+	//Wyrmgus start
+//	std::string rotateStr;
+	CAnimationOperand rotateStr;
+	//Wyrmgus end
 };
 
 //@}
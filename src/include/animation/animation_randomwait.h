@@ -44,8 +44,14 @@ public:
 	virtual void Init(const char *s, lua_State *l);
 
 private:
-	std::string minWait;
-	std::string maxWait;
+	//Wyrmgus start
+//	std::string minWait;
+	CAnimationOperand minWait;
+	//Wyrmgus end
+	//Wyrmgus start
+//	std::string maxWait;
+	CAnimationOperand maxWait;
+	//Wyrmgus end
 };
 
 //@}
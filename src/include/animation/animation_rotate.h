@@ -38,13 +38,20 @@
 class CAnimation_Rotate : public CAnimation
 {
 public:
-	CAnimation_Rotate() : CAnimation(AnimationRotate) {}
+	//Wyrmgus start
+//	CAnimation_Rotate() : CAnimation(AnimationRotate) {}
+	CAnimation_Rotate() : CAnimation(AnimationRotate), rotateToTarget(false) {}
+	//Wyrmgus end
 
 	virtual void Action(CUnit &unit, int &move, int scale) const;
 	virtual void Init(const char *s, lua_State *l);
 
 private:
-	std::string rotateStr;
+	//Wyrmgus start
+//	std::string rotateStr;
+	CAnimationOperand rotateStr;
+	bool rotateToTarget;       /// rotate towards the goal of the unit
+	//Wyrmgus end
 };
 
 extern void UnitRotate(CUnit &unit, int rotate);
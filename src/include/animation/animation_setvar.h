@@ -38,7 +38,10 @@
 class CAnimation_SetVar : public CAnimation
 {
 public:
-	CAnimation_SetVar() : CAnimation(AnimationSetVar) {}
+	//Wyrmgus start
+//	CAnimation_SetVar() : CAnimation(AnimationSetVar) {}
+	CAnimation_SetVar() : CAnimation(AnimationSetVar), varIndex(-1), varField(AnimVarNone) {}
+	//Wyrmgus end
 
 	virtual void Action(CUnit &unit, int &move, int scale) const;
 	virtual void Init(const char *s, lua_State *l);
@@ -46,7 +49,12 @@ public:
 private:
 	SetVar_ModifyTypes mod;
 	std::string varStr;
-	std::string valueStr;
+	//Wyrmgus start
+//	std::string valueStr;
+	int varIndex;                   /// index of the variable, -1 if it has to be looked up when run
+	AnimationVariableField varField;  /// field of the variable
+	CAnimationOperand valueStr;
+	//Wyrmgus end
 	std::string unitSlotStr;
 };
 
@@ -44,7 +44,10 @@ public:
 	virtual void Init(const char *s, lua_State *l);
 
 private:
-	std::string wait;
+	//Wyrmgus start
+//	std::string wait;
+	CAnimationOperand wait;
+	//Wyrmgus end
 };
 
 //@}
@@ -201,7 +201,7 @@ extern bool LoadingPersistentHeroes;
 
 extern int GetAttributeVariableIndex(int attribute);
 extern void CleanCharacters();
-extern CCharacter *GetCharacter(std::string character_full_name);
+extern CCharacter *GetCharacter(const std::string &character_full_name);
 extern CCharacter *GetCustomHero(std::string hero_full_name);
 extern void SaveHero(CCharacter *hero);
 extern void SaveHeroes();
@@ -32,6 +32,10 @@
 
 //@{
 
+//Wyrmgus start
+#include <vector>
+//Wyrmgus end
+
 /*----------------------------------------------------------------------------
 --  Documentation
 ----------------------------------------------------------------------------*/
@@ -174,6 +178,10 @@ extern void InitConstructions();
 extern void LoadConstructions();
 /// Count the amount of constructions to load
 extern int GetConstructionsCount();
+//Wyrmgus start
+/// Get the graphic files of the constructions to load
+extern void GetConstructionFiles(std::vector<std::string> &files);
+//Wyrmgus end
 /// Clean up the constructions module
 extern void CleanConstructions();
 /// Get construction by identifier
@@ -137,12 +137,16 @@ extern std::string PrintDependencies(const CPlayer &player, const ButtonAction &
 //extern bool CheckDependByIdent(const CPlayer &player, const std::string &target);
 extern bool CheckDependByIdent(const CPlayer &player, const std::string &target, bool ignore_units = false, bool is_predependency = false, bool is_neutral_use = false);
 extern bool CheckDependByIdent(const CUnit &unit, const std::string &target, bool ignore_units = false, bool is_predependency = false);
+/// Check a dependency by upgrade
+extern bool CheckDependByUpgrade(const CPlayer &player, const CUpgrade &upgrade, bool ignore_units = false, bool is_predependency = false, bool is_neutral_use = false);
 //Wyrmgus end
 /// Check a dependency by unit type
 //Wyrmgus start
 //extern bool CheckDependByType(const CPlayer &player, const CUnitType &type);
 extern bool CheckDependByType(const CPlayer &player, const CUnitType &type, bool ignore_units = false, bool is_predependency = false);
 extern bool CheckDependByType(const CUnit &unit, const CUnitType &type, bool ignore_units = false, bool is_predependency = false);
+/// Throw away the cached dependency check results of a player
+extern void InvalidateDependCache(const CPlayer &player);
 //Wyrmgus end
 //@}
 
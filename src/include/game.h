@@ -40,6 +40,11 @@ extern void LoadGame(const std::string &filename); /// Load saved game
 extern int SaveGame(const std::string &filename); /// Save game
 extern void DeleteSaveGame(const std::string &filename); /// Delete save game
 extern bool SaveGameLoading;                 /// Save game is in progress of loading
+//Wyrmgus start
+extern bool SaveGameInBackground;            /// SaveGame() writes the file in a background thread
+extern void WaitForBackgroundSave();         /// Wait until the background save is written
+extern void CheckBackgroundSave();           /// Report a finished background save
+//Wyrmgus end
 
 extern void InitModules();              /// Initialize all modules
 extern void LuaRegisterModules();       /// Register lua script of each modules
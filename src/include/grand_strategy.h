@@ -311,7 +311,7 @@ public:
 	void PerformTrade(CGrandStrategyFaction &importer_faction, CGrandStrategyFaction &exporter_faction, int resource);
 	void CreateWork(CUpgrade *work, CGrandStrategyHero *author, CGrandStrategyProvince *province);
 	bool TradePriority(CGrandStrategyFaction &faction_a, CGrandStrategyFaction &faction_b);
-	CGrandStrategyHero *GetHero(std::string hero_full_name);
+	CGrandStrategyHero *GetHero(const std::string &hero_full_name);
 
 public:
 	int WorldMapWidth;
@@ -338,7 +338,7 @@ extern int GrandStrategyMonth;
 extern std::string GrandStrategyWorld;
 extern int PopulationGrowthThreshold;					/// How much population growth progress must be accumulated before a new worker unit is created in the province
 extern CGrandStrategyGame GrandStrategyGame;			/// Grand strategy game
-extern std::map<std::string, int> GrandStrategyHeroStringToIndex;
+extern std::unordered_map<std::string, int> GrandStrategyHeroStringToIndex;
 extern std::vector<CGrandStrategyEvent *> GrandStrategyEvents;
 extern std::map<std::string, CGrandStrategyEvent *> GrandStrategyEventStringToPointer;
 
@@ -36,6 +36,7 @@
 #include <string>
 //Wyrmgus start
 #include <map>
+#include <vector>
 //Wyrmgus end
 
 /*----------------------------------------------------------------------------
@@ -166,6 +167,9 @@ public:
 
 extern void LoadIcons();   /// Load icons
 extern int  GetIconsCount();
+//Wyrmgus start
+extern void GetIconFiles(std::vector<std::string> &files);  /// Get the graphic files of the icons to load
+//Wyrmgus end
 extern void CleanIcons();  /// Cleanup icons
 
 //Wyrmgus start
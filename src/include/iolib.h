@@ -36,6 +36,9 @@
 --  Includes
 ----------------------------------------------------------------------------*/
 
+//Wyrmgus start
+#include <string>
+//Wyrmgus end
 #include <vector>
 
 /*----------------------------------------------------------------------------
@@ -115,6 +118,10 @@ public:
 	int read(void *buf, size_t len);
 	int seek(long offset, int whence);
 	long tell();
+	//Wyrmgus start
+	int write(const void *buf, size_t len);
+	std::string TakeMemoryData();
+	//Wyrmgus end
 
 	int printf(const char *format, ...) PRINTF_VAARG_ATTRIBUTE(2, 3); // Don't forget to count this
 private:
@@ -130,13 +137,67 @@ enum {
 	CLF_TYPE_PLAIN,    /// plain text file handle
 	CLF_TYPE_GZIP,     /// gzip file handle
 	CLF_TYPE_BZIP2,    /// bzip2 file handle
-	CLF_TYPE_PHYSFS    /// physfs file handle
+	//Wyrmgus start
+//	CLF_TYPE_PHYSFS    /// physfs file handle
+	CLF_TYPE_PHYSFS,   /// physfs file handle
+	CLF_TYPE_MEMORY    /// file kept in memory
+	//Wyrmgus end
 };
 
 #define CL_OPEN_READ 0x1
 #define CL_OPEN_WRITE 0x2
 #define CL_WRITE_GZ 0x4
 #define CL_WRITE_BZ2 0x8
+//Wyrmgus start
+#define CL_WRITE_MEMORY 0x10
+//Wyrmgus end
+
+//Wyrmgus start
+/**
+**  Writer for compact binary data, used for the packed sections of save games.
+**
+**  Unsigned integers are stored as variable length quantities of 7 bits per byte,
+**  signed integers are zigzag encoded first so that small negative values stay short.
+*/
+class CBinaryWriter
+{
+public:
+	void WriteByte(unsigned char value) { this->Data.push_back(value); }
+	void WriteUnsigned(unsigned long long value);
+	void WriteSigned(long long value);
+	void WriteString(const std::string &value);
+
+	const std::vector<unsigned char> &GetData() const { return this->Data; }
+
+private:
+	std::vector<unsigned char> Data;
+};
+
+/**
+**  Reader for data written by CBinaryWriter.
+**
+**  Reading past the end of the data or a malformed value sets the failure flag,
+**  after which every read returns 0 or an empty string.
+*/
+class CBinaryReader
+{
+public:
+	CBinaryReader(const std::vector<unsigned char> &data) : Data(data), Position(0), Failed(false) {}
+
+	unsigned char ReadByte();
+	unsigned long long ReadUnsigned();
+	long long ReadSigned();
+	std::string ReadString();
+
+	bool AtEnd() const { return this->Position >= this->Data.size(); }
+	bool HasFailed() const { return this->Failed; }
+
+private:
+	const std::vector<unsigned char> &Data;
+	size_t Position;	/// position of the next byte to be read
+	bool Failed;		/// whether a read went past the end of the data
+};
+//Wyrmgus end
 
 /*----------------------------------------------------------------------------
 --  Functions
@@ -150,6 +211,13 @@ extern bool CanAccessFile(const char *filename);
 /// Read the contents of a directory
 extern int ReadDataDirectory(const char *dirname, std::vector<FileList> &flp, int sortmode = 0);
 
+//Wyrmgus start
+/// Encode binary data as base64 text
+extern std::string EncodeBase64(const std::vector<unsigned char> &data);
+/// Decode base64 text, return false if the text is not valid base64
+extern bool DecodeBase64(const std::string &text, std::vector<unsigned char> &data);
+//Wyrmgus end
+
 //@}
 
 #endif // !__IOLIB_H__
@@ -85,6 +85,7 @@
 #include <string>
 //Wyrmgus start
 #include <map>
+#include <unordered_map>
 //Wyrmgus end
 
 #ifndef __MAP_TILE_H__
@@ -429,6 +430,10 @@ public:
 	//Wyrmgus end
 	/// Save the map.
 	void Save(CFile &file) const;
+	//Wyrmgus start
+	void SaveFieldsBinary(std::vector<unsigned char> &data) const;
+	bool LoadFieldsBinary(const std::vector<unsigned char> &data);
+	//Wyrmgus end
 
 	//
 	// Wall
@@ -488,6 +493,14 @@ public:
 	/// Remove unit from cache
 	void Remove(CUnit &unit);
 
+	//Wyrmgus start
+	/// Update the unit buckets for the new owner of a unit
+	void ChangeUnitOwner(CUnit &unit);
+	
+	/// Get the unit buckets of a map layer
+	const CUnitBucketGrid *GetUnitBuckets(int z) const;
+	//Wyrmgus end
+
 	//Wyrmgus start
 //	void Clamp(Vec2i &pos) const;
 	void Clamp(Vec2i &pos, int z) const;
@@ -551,6 +564,7 @@ public:
 	std::vector<std::vector<CUnit *>> LayerConnectors;	/// connectors in a layer which lead to other layers
 	std::map<int, std::vector<std::tuple<Vec2i, Vec2i, CMapTemplate *>>> SubtemplateAreas;
 	std::vector<CUnit *> SettlementUnits;	/// the town hall / settlement site units
+	std::vector<CUnitBucketGrid *> UnitBuckets;	/// the unit buckets (if any) for each map layer
 	//Wyrmgus end
 
 	CMapInfo Info;             /// descriptive information
@@ -563,11 +577,11 @@ public:
 
 //Wyrmgus start
 extern std::vector<CMapTemplate *>  MapTemplates;
-extern std::map<std::string, CMapTemplate *> MapTemplateIdentToPointer;
+extern std::unordered_map<std::string, CMapTemplate *> MapTemplateIdentToPointer;
 extern std::vector<CSettlement *>  Settlements;
-extern std::map<std::string, CSettlement *> SettlementIdentToPointer;
+extern std::unordered_map<std::string, CSettlement *> SettlementIdentToPointer;
 extern std::vector<CTerrainFeature *> TerrainFeatures;
-extern std::map<std::string, CTerrainFeature *> TerrainFeatureIdentToPointer;
+extern std::unordered_map<std::string, CTerrainFeature *> TerrainFeatureIdentToPointer;
 extern std::map<std::tuple<int, int, int>, int> TerrainFeatureColorToIndex;
 extern std::vector<CTimeline *> Timelines;
 extern std::map<std::string, CTimeline *> TimelineIdentToPointer;
@@ -595,9 +609,9 @@ extern int ReplayRevealMap;
 ----------------------------------------------------------------------------*/
 
 //Wyrmgus start
-extern CMapTemplate *GetMapTemplate(std::string map_ident);
-extern CSettlement *GetSettlement(std::string settlement_ident);
-extern CTerrainFeature *GetTerrainFeature(std::string terrain_feature_ident);
+extern CMapTemplate *GetMapTemplate(const std::string &map_ident);
+extern CSettlement *GetSettlement(const std::string &settlement_ident);
+extern CTerrainFeature *GetTerrainFeature(const std::string &terrain_feature_ident);
 extern CTimeline *GetTimeline(std::string timeline_ident);
 extern std::string GetDegreeLevelNameById(int degree_level);
 extern int GetDegreeLevelIdByName(std::string degree_level);
@@ -648,6 +662,12 @@ extern void MapSight(const CPlayer &player, const Vec2i &pos, int w,
 //					 int h, int range, MapMarkerFunc *marker);
 					 int h, int range, MapMarkerFunc *marker, int z);
 					 //Wyrmgus end
+//Wyrmgus start
+/// Check whether the sight of a unit can be moved by marking only the tiles which change
+extern bool CanMoveSight(const Vec2i &old_pos, int old_z, const Vec2i &pos, int z);
+/// Mark sight changes of a unit moving by one tile
+extern void MapSightMove(const CPlayer &player, const Vec2i &old_pos, const Vec2i &pos, int w, int h, int range, MapMarkerFunc *unmarker, MapMarkerFunc *marker, int z);
+//Wyrmgus end
 /// Update fog of war
 extern void UpdateFogOfWarChange();
 
@@ -764,9 +784,17 @@ extern void SetTimeOfDay(int time_of_day, int z = 0);
 // in unit.c
 
 /// Mark on vision table the Sight of the unit.
-void MapMarkUnitSight(CUnit &unit);
+//Wyrmgus start
+//void MapMarkUnitSight(CUnit &unit);
+void MapMarkUnitSight(CUnit &unit, bool vision = true);
+//Wyrmgus end
 /// Unmark on vision table the Sight of the unit.
-void MapUnmarkUnitSight(CUnit &unit);
+//Wyrmgus start
+//void MapUnmarkUnitSight(CUnit &unit);
+void MapUnmarkUnitSight(CUnit &unit, bool vision = true);
+/// Move on vision table the Sight of the unit, after it moved by one tile.
+void MapMoveUnitSight(CUnit &unit, const Vec2i &old_pos);
+//Wyrmgus end
 
 /*----------------------------------------------------------------------------
 --  Defines
@@ -614,6 +614,10 @@ extern void MissileCclRegister();
 extern void LoadMissileSprites();
 /// count missile sprites
 extern int GetMissileSpritesCount();
+//Wyrmgus start
+/// get the graphic files of the missile sprites to load
+extern void GetMissileSpriteFiles(std::vector<std::string> &files);
+//Wyrmgus end
 /// allocate an empty missile-type slot
 extern MissileType *NewMissileTypeSlot(const std::string &ident);
 /// Get missile-type by ident
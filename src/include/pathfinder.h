@@ -43,6 +43,11 @@
 ----------------------------------------------------------------------------*/
 
 #include <queue>
+//Wyrmgus start
+#include <vector>
+
+#include "profile.h"
+//Wyrmgus end
 #include "vec2i.h"
 
 class CUnit;
@@ -143,12 +148,25 @@ enum VisitResult {
 	VisitResult_Cancel
 };
 
+//Wyrmgus start
+/**
+**  Breadth first traversal of the map tiles.
+**
+**  The memory of a traversal is borrowed from a pool for the lifetime of the object
+**  and kept for the next traversals. Each value is stamped with the traversal
+**  it was set in, so Init() doesn't have to clear the whole map.
+*/
+//Wyrmgus end
 class TerrainTraversal
 {
 public:
 	typedef short int dataType;
 public:
-	TerrainTraversal() : allow_diagonal(true) {}
+	//Wyrmgus start
+//	TerrainTraversal() : allow_diagonal(true) {}
+	TerrainTraversal();
+	~TerrainTraversal();
+	//Wyrmgus end
 	void SetSize(unsigned int width, unsigned int height);
 	void SetDiagonalAllowed(const bool allowed);
 	void Init();
@@ -169,6 +187,9 @@ public:
 
 private:
 	void Set(const Vec2i &pos, dataType value);
+	//Wyrmgus start
+	void SetIndex(unsigned int index, dataType value);
+	//Wyrmgus end
 
 	struct PosNode {
 		PosNode(const Vec2i &pos, const Vec2i &from) : pos(pos), from(from) {}
@@ -176,9 +197,35 @@ private:
 		Vec2i from;
 	};
 
+	//Wyrmgus start
+	/// Memory of a traversal, reused by the next traversals
+	class Storage
+	{
+	public:
+		Storage() : generation(0) {}
+
+		std::vector<dataType> values;
+		std::vector<unsigned int> generations; /// traversal in which each value was set
+		std::vector<PosNode> queue;            /// tiles to visit, never shrunk
+		unsigned int generation;               /// number of the current traversal
+	};
+
+	static Storage *BorrowStorage();
+	static void ReturnStorage(Storage *storage);
+
+	static std::vector<Storage *> FreeStorages; /// storages not used by a traversal
+
+	TerrainTraversal(const TerrainTraversal &);
+	TerrainTraversal &operator =(const TerrainTraversal &);
+	//Wyrmgus end
+
 private:
-	std::vector<dataType> m_values;
-	std::queue<PosNode> m_queue;
+	//Wyrmgus start
+//	std::vector<dataType> m_values;
+//	std::queue<PosNode> m_queue;
+	Storage *m_storage;
+	size_t m_queue_head;
+	//Wyrmgus end
 	unsigned int m_extented_width;
 	unsigned int m_height;
 	bool allow_diagonal;
@@ -187,8 +234,16 @@ private:
 template <typename T>
 bool TerrainTraversal::Run(T &context)
 {
-	for (; m_queue.empty() == false; m_queue.pop()) {
-		const PosNode &posNode = m_queue.front();
+	//Wyrmgus start
+	PROFILE_SCOPE("TerrainTraversal::Run");
+	
+//	for (; m_queue.empty() == false; m_queue.pop()) {
+//		const PosNode &posNode = m_queue.front();
+	std::vector<PosNode> &queue = m_storage->queue;
+	for (; m_queue_head < queue.size(); ++m_queue_head) {
+		// copy it, as visiting may add tiles to the queue
+		const PosNode posNode = queue[m_queue_head];
+	//Wyrmgus end
 
 		switch (context.Visit(*this, posNode.pos, posNode.from)) {
 			case VisitResult_Finished: return true;
@@ -214,6 +269,10 @@ extern int AStarMovingUnitCrossingCost;
 extern bool AStarKnowUnseenTerrain;
 /// Cost of using a square we haven't seen before.
 extern int AStarUnknownTerrainCost;
+//Wyrmgus start
+/// Whether long searches go through the hierarchical abstraction of the map first
+extern bool AStarHierarchical;
+//Wyrmgus end
 
 //
 //  Convert heading into direction.
@@ -231,6 +290,10 @@ extern void InitPathfinder();
 /// Free the pathfinder
 extern void FreePathfinder();
 
+//Wyrmgus start
+/// Compute in parallel the new paths the units are about to ask for
+extern void FindPendingPaths(const std::vector<CUnit *> &units);
+//Wyrmgus end
 /// Returns the next element of the path
 extern int NextPathElement(CUnit &unit, short int *xdp, short int *ydp);
 /// Return distance to unit.
@@ -266,6 +329,12 @@ extern int AStarFindPath(const Vec2i &startPos, const Vec2i &goalPos, int gw, in
 //						 int maxrange, char *path, int pathlen, const CUnit &unit);
 						 int maxrange, char *path, int pathlen, const CUnit &unit, int max_length, int z, bool allow_diagonal = true);
 						 //Wyrmgus end
+/// Mark the hierarchical abstraction of an area as outdated
+extern void AStarTerrainChanged(const Vec2i &pos, const Vec2i &size, int z);
+/// Mark the hierarchical abstraction of an area as outdated for the players who don't know all the terrain
+extern void AStarExplorationChanged(const Vec2i &pos, const Vec2i &size, int z);
+/// Mark the hierarchical abstraction of the whole map as outdated for the players who don't know all the terrain
+extern void AStarMapExplorationChanged();
 //Wyrmgus end
 
 extern void PathfinderCclRegister();
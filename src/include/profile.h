@@ -0,0 +1,166 @@
+//       _________ __                 __
+//      /   _____//  |_____________ _/  |______     ____  __ __  ______
+//      \_____  \\   __\_  __ \__  \\   __\__  \   / ___\|  |  \/  ___/
+//      /        \|  |  |  | \// __ \|  |  / __ \_/ /_/  >  |  /\___ |
+//     /_______  /|__|  |__|  (____  /__| (____  /\___  /|____//____  >
+//             \/                  \/          \//_____/            \/
+//  ______________________                           ______________________
+//                        T H E   W A R   B E G I N S
+//         Stratagus - A free fantasy real time strategy game engine
+//
+/**@name profile.h - The profiler headerfile. */
+//
+//      (c) Copyright 2018 by Andrettin
+//
+//      This program is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; only version 2 of the License.
+//
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+//      02111-1307, USA.
+//
+
+
+#ifndef __PROFILE_H__
+#define __PROFILE_H__
+
+//@{
+
+/*----------------------------------------------------------------------------
+--  Includes
+----------------------------------------------------------------------------*/
+
+#include <string>
+#include <vector>
+
+/*----------------------------------------------------------------------------
+--  Definitions
+----------------------------------------------------------------------------*/
+
+/// Number of frames kept by the profiler
+#define PROFILE_FRAME_COUNT 256
+
+/// Maximum number of timed scopes kept for a frame, the others only count in the frame totals
+#define PROFILE_MAX_FRAME_EVENTS 16384
+
+/*----------------------------------------------------------------------------
+--  Declarations
+----------------------------------------------------------------------------*/
+
+/**
+**  Profiler recording the time spent in named scopes of the main thread.
+**
+**  The scopes and counters of each frame are kept in a ring buffer holding the last
+**  frames, together with the slowest frame since profiling was enabled, and can be
+**  saved in the Chrome trace event format (viewable in chrome://tracing).
+**
+**  Scope and counter names must be string literals, as only their pointers are kept.
+*/
+class CProfiler
+{
+public:
+	/// Timed scope
+	struct Event {
+		const char *Name;
+		long long Start;      /// start time, in nanoseconds
+		long long Duration;   /// duration, in nanoseconds
+	};
+
+	/// Counter value
+	struct Counter {
+		const char *Name;
+		long long Value;
+	};
+
+	/// Recorded frame
+	struct Frame {
+		Frame() : Cycle(0), Start(0), Duration(0), DroppedEvents(0) {}
+
+		unsigned long Cycle;           /// game cycle at the end of the frame
+		long long Start;               /// start time, in nanoseconds
+		long long Duration;            /// duration, in nanoseconds
+		std::vector<Event> Events;     /// timed scopes, in the order in which they ended
+		std::vector<Counter> Counters; /// counter values
+		int DroppedEvents;             /// number of timed scopes not kept in Events
+	};
+
+	CProfiler() : Enabled(false), ThreadId(0), FrameCount(0), NextFrame(0) {}
+
+	void SetEnabled(bool enabled);
+	/// Whether scopes and counters are being recorded
+	bool IsEnabled() const { return this->Enabled; }
+
+	void EndFrame();
+	long long BeginScope() const;
+	void EndScope(const char *name, long long start);
+	void Count(const char *name, long long value = 1);
+
+	bool SaveTrace(const std::string &filename) const;
+
+private:
+	bool Enabled;
+	unsigned long ThreadId;          /// identifier of the thread whose scopes are recorded
+	Frame CurrentFrame;              /// frame being recorded
+	std::vector<Frame> Frames;       /// ring buffer of the last frames
+	int FrameCount;                  /// number of frames in the ring buffer
+	int NextFrame;                   /// index of the ring buffer slot for the next frame
+	Frame SlowestFrame;              /// slowest frame since profiling was enabled
+};
+
+/**
+**  Time the enclosing scope, if profiling is enabled.
+*/
+class CProfileScope
+{
+public:
+	explicit CProfileScope(const char *name);
+	~CProfileScope();
+
+private:
+	const char *Name;
+	long long Start;    /// start time, negative if the scope is not timed
+};
+
+/*----------------------------------------------------------------------------
+--  Variables
+----------------------------------------------------------------------------*/
+
+extern CProfiler Profiler;
+
+/*----------------------------------------------------------------------------
+--  Functions
+----------------------------------------------------------------------------*/
+
+/// Current time of the profiling clock, in nanoseconds
+extern long long GetProfileTime();
+
+inline CProfileScope::CProfileScope(const char *name) : Name(name), Start(-1)
+{
+	if (Profiler.IsEnabled()) {
+		this->Start = Profiler.BeginScope();
+	}
+}
+
+inline CProfileScope::~CProfileScope()
+{
+	if (this->Start >= 0) {
+		Profiler.EndScope(this->Name, this->Start);
+	}
+}
+
+#define PROFILE_SCOPE_NAME(line) profile_scope_##line
+#define PROFILE_SCOPE_LINE(name, line) CProfileScope PROFILE_SCOPE_NAME(line)(name)
+
+/// Time the rest of the enclosing scope under the given name
+#define PROFILE_SCOPE(name) PROFILE_SCOPE_LINE(name, __LINE__)
+
+//@}
+
+#endif // !__PROFILE_H__
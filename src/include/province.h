@@ -39,6 +39,7 @@
 #include <vector>
 #include <map>
 #include <tuple>
+#include <unordered_map>
 
 #include "vec2i.h"
 
@@ -217,7 +218,7 @@ extern std::vector<CWorld *> Worlds;
 extern std::vector<CRegion *> Regions;
 extern std::vector<CProvince *> Provinces;
 extern std::vector<CWorldMapTerrainType *>  WorldMapTerrainTypes;
-extern std::map<std::string, int> WorldMapTerrainTypeStringToIndex;
+extern std::unordered_map<std::string, int> WorldMapTerrainTypeStringToIndex;
 
 /*----------------------------------------------------------------------------
 -- Functions
@@ -201,6 +201,10 @@ extern std::string PlayerFaction;
 
 extern unsigned long GameCycle;             /// Game simulation cycle counter
 extern unsigned long FastForwardCycle;      /// Game Replay Fast Forward Counter
+//Wyrmgus start
+extern bool HeadlessMode;                   /// Run only the game logic, without display, sound or input
+extern unsigned long HeadlessCycles;        /// Number of cycles to run in headless mode, 0 until the game ends
+//Wyrmgus end
 
 extern void Exit(int err);                  /// Exit
 extern void ExitFatal(int err);             /// Exit with fatal error
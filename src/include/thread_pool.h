@@ -0,0 +1,113 @@
+//       _________ __                 __
+//      /   _____//  |_____________ _/  |______     ____  __ __  ______
+//      \_____  \\   __\_  __ \__  \\   __\__  \   / ___\|  |  \/  ___/
+//      /        \|  |  |  | \// __ \|  |  / __ \_/ /_/  >  |  /\___ |
+//     /_______  /|__|  |__|  (____  /__| (____  /\___  /|____//____  >
+//             \/                  \/          \//_____/            \/
+//  ______________________                           ______________________
+//                        T H E   W A R   B E G I N S
+//         Stratagus - A free fantasy real time strategy game engine
+//
+/**@name thread_pool.h - The worker thread pool headerfile. */
+//
+//      (c) Copyright 2018 by Andrettin
+//
+//      This program is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; only version 2 of the License.
+//
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+//      02111-1307, USA.
+//
+
+#ifndef __THREAD_POOL_H__
+#define __THREAD_POOL_H__
+
+//@{
+
+/*----------------------------------------------------------------------------
+--  Includes
+----------------------------------------------------------------------------*/
+
+#include <vector>
+
+/*----------------------------------------------------------------------------
+--  Declarations
+----------------------------------------------------------------------------*/
+
+struct SDL_Thread;
+struct SDL_mutex;
+struct SDL_cond;
+
+/**
+**  Pool of worker threads used to split independent jobs over the available processors.
+**
+**  A batch of jobs is started with Run(), which only returns once every job of the batch
+**  has been executed. The calling thread takes part in the work, so with no worker threads
+**  the jobs are simply run in sequence. RunRows() splits the rows of an image into
+**  slices run as one batch.
+**
+**  Jobs must not touch state shared with other jobs of the same batch, and must not
+**  start batches of their own.
+*/
+class CThreadPool
+{
+public:
+	typedef void (*JobFunction)(void *data, int index);
+	typedef void (*RowsFunction)(void *data, int first_row, int last_row);
+
+	CThreadPool() :
+		Lock(NULL), JobCond(NULL), DoneCond(NULL),
+		Function(NULL), Data(NULL), JobCount(0), NextJob(0), PendingJobs(0),
+		Running(false)
+	{
+	}
+
+	void Init(int thread_count = -1);
+	void Exit();
+
+	/// Number of threads working on a batch, including the calling one
+	int GetThreadCount() const { return (int) this->Threads.size() + 1; }
+
+	void Run(JobFunction function, void *data, int count);
+	void RunRows(RowsFunction function, void *data, int row_count, int min_rows = 16);
+
+private:
+	static int WorkerThread(void *data);
+	void WorkerLoop();
+
+	std::vector<SDL_Thread *> Threads;
+	SDL_mutex *Lock;          /// protects everything below
+	SDL_cond *JobCond;        /// signaled when a new batch is available or on exit
+	SDL_cond *DoneCond;       /// signaled when the last job of a batch is done
+	JobFunction Function;     /// job function of the current batch
+	void *Data;               /// user data of the current batch
+	int JobCount;             /// number of jobs in the current batch
+	int NextJob;              /// index of the next job to be taken
+	int PendingJobs;          /// number of jobs not finished yet
+	bool Running;             /// false when the workers have to quit
+};
+
+/*----------------------------------------------------------------------------
+--  Variables
+----------------------------------------------------------------------------*/
+
+extern CThreadPool ThreadPool;
+
+/*----------------------------------------------------------------------------
+--  Functions
+----------------------------------------------------------------------------*/
+
+/// Number of processors available to the process
+extern int GetProcessorCount();
+
+//@}
+
+#endif // !__THREAD_POOL_H__
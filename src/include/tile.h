@@ -139,9 +139,14 @@
 #include <vec2i.h>
 
 //Wyrmgus start
+#include <map>
 #include <tuple>
 //Wyrmgus end
 
+//Wyrmgus start
+class CBinaryReader;
+class CBinaryWriter;
+//Wyrmgus end
 class CFile;
 class CPlayer;
 class CTileset;
@@ -215,6 +220,10 @@ public:
 
 	void Save(CFile &file) const;
 	void parse(lua_State *l);
+	//Wyrmgus start
+	void SaveBinary(CBinaryWriter &writer, std::map<std::string, int> &ident_indexes) const;
+	void LoadBinary(CBinaryReader &reader, const std::vector<CTerrainType *> &terrains, const std::vector<CTerrainFeature *> &features);
+	//Wyrmgus end
 
 	//Wyrmgus start
 	void SetTerrain(CTerrainType *terrain);
@@ -264,6 +273,9 @@ public:
 	bool IsSeenTileCorrect() const;
 	
 	int GetResource() const;
+	
+	int GetAnimationFrame() const;
+	int GetOverlayAnimationFrame() const;
 	//Wyrmgus end
 
 	unsigned char getCost() const { return cost; }
@@ -284,8 +296,8 @@ public:
 	//Wyrmgus start
 //	unsigned short Flags;      /// field flags
 	unsigned long Flags;      /// field flags
-	unsigned char AnimationFrame;		/// current frame of the tile's animation
-	unsigned char OverlayAnimationFrame;		/// current frame of the overlay tile's animation
+	unsigned char AnimationFrame;		/// frame of the tile's animation at the start of the game, the current one is given by GetAnimationFrame()
+	unsigned char OverlayAnimationFrame;		/// frame of the overlay tile's animation at the start of the game, the current one is given by GetOverlayAnimationFrame()
 	CTerrainType *Terrain;
 	CTerrainType *OverlayTerrain;
 	CTerrainFeature *TerrainFeature;
@@ -41,6 +41,7 @@
 //Wyrmgus start
 #include <map>
 #include <tuple>
+#include <unordered_map>
 
 #include "color.h"
 //Wyrmgus end
@@ -398,7 +399,7 @@ private:
 ----------------------------------------------------------------------------*/
 
 extern std::vector<CTerrainType *>  TerrainTypes;
-extern std::map<std::string, int> TerrainTypeStringToIndex;
+extern std::unordered_map<std::string, int> TerrainTypeStringToIndex;
 extern std::map<std::string, int> TerrainTypeCharacterToIndex;
 extern std::map<std::tuple<int, int, int>, int> TerrainTypeColorToIndex;
 //Wyrmgus end
@@ -411,7 +412,7 @@ extern void ParseTilesetTileFlags(lua_State *l, int *back, int *j);
 //Wyrmgus start
 extern std::string GetTransitionTypeNameById(int transition_type);
 extern int GetTransitionTypeIdByName(std::string transition_type);
-extern CTerrainType *GetTerrainType(std::string terrain_ident);
+extern CTerrainType *GetTerrainType(const std::string &terrain_ident);
 extern void LoadTerrainTypes();
 //Wyrmgus end
 
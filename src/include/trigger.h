@@ -89,14 +89,25 @@ class CTrigger
 {
 public:
 	CTrigger() :
-		Conditions(NULL), Effects(NULL)
+		Conditions(NULL), Effects(NULL), Interval(0), NextCycle(0), Woken(false)
 	{
 	}
 	~CTrigger();
 	
+	/// Whether the trigger is only checked when something it depends on changes
+	bool HasDependencies() const
+	{
+		return this->Interval > 0 || !this->UnitTypeDependencies.empty() || !this->ResourceDependencies.empty();
+	}
+	
 	std::string Ident;
 	LuaCallback *Conditions;
 	LuaCallback *Effects;
+	std::vector<const CUnitType *> UnitTypeDependencies;  /// unit types whose counts the conditions depend on
+	std::vector<int> ResourceDependencies;               /// resources the conditions depend on
+	int Interval;                                        /// cycles between two checks of the trigger, 0 if it isn't checked periodically
+	unsigned long NextCycle;                             /// cycle of the next periodic check
+	bool Woken;                                          /// whether the trigger is waiting to be checked
 };
 //Wyrmgus end
 
@@ -148,6 +159,8 @@ extern void TriggersEachCycle();    /// test triggers
 
 //Wyrmgus start
 extern CTrigger *GetTrigger(std::string trigger_ident);
+extern void TriggerUnitTypeCountChanged(const CUnitType *type); /// wake the triggers depending on the count of a unit type
+extern void TriggerResourceChanged(int resource); /// wake the triggers depending on a resource
 //Wyrmgus end
 
 extern void TriggerCclRegister();   /// Register ccl features
@@ -218,7 +218,7 @@ public:
 	void DeequipItem(CUnit &item, bool affect_character = true);
 	void ReadWork(CUpgrade *work, bool affect_character = true);
 	void ConsumeElixir(CUpgrade *elixir, bool affect_character = true);
-	void ApplyAura(int aura_index);
+	void ApplyAuras();
 	void ApplyAuraEffect(int aura_index);
 	void SetPrefix(CUpgrade *prefix);
 	void SetSuffix(CUpgrade *suffix);
@@ -420,6 +420,8 @@ public:
 	int GetTotalInsideCount(const CPlayer *player = NULL, const bool ignore_items = true, const bool ignore_saved_cargo = false, const CUnitType *type = NULL) const;
 	bool CanAttack(bool count_inside = true) const;
 	bool IsInCombat() const;
+	bool HasActiveAura(int aura_index) const;
+	bool IsUnderAura(int aura_index) const;
 	bool CanHarvest(const CUnit *dest, bool only_harvestable = true) const;
 	bool CanReturnGoodsTo(const CUnit *dest, int resource = 0) const;
 	bool CanCastAnySpell() const;
@@ -586,6 +588,9 @@ unsigned    ByPlayer : PlayerMax;   /// Track unit seen by player
 	} Seen;
 
 	CVariable *Variable; /// array of User Defined variables.
+	//Wyrmgus start
+	bool VariablesIncrease; /// whether a variable may be enabled with an increase, so that it changes each second
+	//Wyrmgus end
 
 	unsigned long TTL;  /// time to live
 
@@ -636,7 +641,7 @@ public:
 		DeselectInMine(false), NoStatusLineTooltips(false),
 		//Wyrmgus start
 		PlayerColorCircle(false), SepiaForGrayscale(false),
-		ShowPathlines(false),
+		ShowPathlines(false), SaveMapFieldsAsText(false), CacheGraphics(true),
 //		ShowOrders(0), ShowNameDelay(0), ShowNameTime(0), AutosaveMinutes(5) {};
 		ShowOrders(0), ShowNameDelay(0), ShowNameTime(0), AutosaveMinutes(5), HotkeySetup(0),
 		IconFrameG(NULL), PressedIconFrameG(NULL), CommandButtonFrameG(NULL), BarFrameG(NULL), InfoPanelFrameG(NULL), ProgressBarG(NULL) {};
@@ -659,6 +664,8 @@ public:
 	bool SepiaForGrayscale;		/// Use a sepia filter for grayscale icons
 	bool PlayerColorCircle;		/// Show a player color circle below each unit
 	bool ShowPathlines;			/// Show order pathlines
+	bool SaveMapFieldsAsText;	/// Save the map fields as readable Lua tables instead of the packed binary section
+	bool CacheGraphics;			/// Keep decoded and processed graphics in a disk cache to speed up loading
 	//Wyrmgus end
 
 	int ShowOrders;			/// How many second show orders of unit on map.
@@ -749,6 +756,10 @@ extern void UnitCountSeen(CUnit &unit);
 
 /// Check for rescue each second
 extern void RescueUnits();
+//Wyrmgus start
+/// Update the aura influence grids from the aura carriers, each second
+extern void UpdateAuraInfluence();
+//Wyrmgus end
 
 /// Convert direction (dx,dy) to heading (0-255)
 extern int DirectionToHeading(const Vec2i &dir);
@@ -50,30 +50,78 @@ class CMap;
 class CUnitCache
 {
 public:
-	typedef std::vector<CUnit *>::iterator iterator;
-	typedef std::vector<CUnit *>::const_iterator const_iterator;
+	//Wyrmgus start
+//	typedef std::vector<CUnit *>::iterator iterator;
+//	typedef std::vector<CUnit *>::const_iterator const_iterator;
+	typedef CUnit **iterator;
+	typedef CUnit *const *const_iterator;
+	//Wyrmgus end
 
 public:
-	CUnitCache() : Units() {}
+	//Wyrmgus start
+//	CUnitCache() : Units() {}
+	CUnitCache() : Count(0), Capacity(InlineCapacity) {}
+	CUnitCache(const CUnitCache &other) : Count(0), Capacity(InlineCapacity)
+	{
+		*this = other;
+	}
+	~CUnitCache()
+	{
+		if (!IsInline()) {
+			FreeBuffer(Heap, Capacity);
+		}
+	}
 
-	size_t size() const { return Units.size(); }
+	CUnitCache &operator =(const CUnitCache &other)
+	{
+		if (this != &other) {
+			Count = 0;
+			Reserve(other.Count);
+			std::copy(other.begin(), other.end(), Data());
+			Count = other.Count;
+		}
+		return *this;
+	}
+	//Wyrmgus end
 
-	void clear() { Units.clear(); }
+	//Wyrmgus start
+//	size_t size() const { return Units.size(); }
+	size_t size() const { return Count; }
+	//Wyrmgus end
 
-	const_iterator begin() const { return Units.begin(); }
-	iterator begin() { return Units.begin(); }
-	const_iterator end() const { return Units.end(); }
-	iterator end() { return Units.end(); }
+	//Wyrmgus start
+//	void clear() { Units.clear(); }
+	void clear() { Count = 0; }
+	//Wyrmgus end
+
+	//Wyrmgus start
+//	const_iterator begin() const { return Units.begin(); }
+//	iterator begin() { return Units.begin(); }
+//	const_iterator end() const { return Units.end(); }
+//	iterator end() { return Units.end(); }
+	const_iterator begin() const { return Data(); }
+	iterator begin() { return Data(); }
+	const_iterator end() const { return Data() + Count; }
+	iterator end() { return Data() + Count; }
+	//Wyrmgus end
 
 	CUnit *operator[](const unsigned int index) const
 	{
-		//Assert(index < Units.size());
-		return Units[index];
+		//Wyrmgus start
+//		//Assert(index < Units.size());
+//		return Units[index];
+		//Assert(index < Count);
+		return Data()[index];
+		//Wyrmgus end
 	}
 	CUnit *operator[](const unsigned int index)
 	{
-		//Assert(index < Units.size());
-		return Units[index];
+		//Wyrmgus start
+//		//Assert(index < Units.size());
+//		return Units[index];
+		//Assert(index < Count);
+		return Data()[index];
+		//Wyrmgus end
 	}
 
 	/**
@@ -85,9 +133,15 @@ public:
 	template<typename _T>
 	CUnit *find(const _T &pred) const
 	{
-		std::vector<CUnit *>::const_iterator ret = std::find_if(Units.begin(), Units.end(), pred);
+		//Wyrmgus start
+//		std::vector<CUnit *>::const_iterator ret = std::find_if(Units.begin(), Units.end(), pred);
+		const_iterator ret = std::find_if(begin(), end(), pred);
+		//Wyrmgus end
 
-		return ret != Units.end() ? (*ret) : NULL;
+		//Wyrmgus start
+//		return ret != Units.end() ? (*ret) : NULL;
+		return ret != end() ? (*ret) : NULL;
+		//Wyrmgus end
 	}
 
 	/**
@@ -101,10 +155,17 @@ public:
 	template<typename _T>
 	void for_each(const _T functor)
 	{
-		const size_t size = Units.size();
+		//Wyrmgus start
+//		const size_t size = Units.size();
+		const size_t size = Count;
+		CUnit *const *units = Data();
+		//Wyrmgus end
 
 		for (size_t i = 0; i != size; ++i) {
-			functor(Units[i]);
+			//Wyrmgus start
+//			functor(Units[i]);
+			functor(units[i]);
+			//Wyrmgus end
 		}
 	}
 
@@ -123,10 +184,17 @@ public:
 	int for_each_if(_T &functor)
 	//Wyrmgus end
 	{
-		const size_t size = Units.size();
+		//Wyrmgus start
+//		const size_t size = Units.size();
+		const size_t size = Count;
+		CUnit *const *units = Data();
+		//Wyrmgus end
 
 		for (size_t count = 0; count != size; ++count) {
-			if (functor(Units[count]) == false) {
+			//Wyrmgus start
+//			if (functor(Units[count]) == false) {
+			if (functor(units[count]) == false) {
+			//Wyrmgus end
 				return count;
 			}
 		}
@@ -142,6 +210,8 @@ public:
 	*/
 	CUnit *Remove(const unsigned int index)
 	{
+		//Wyrmgus start
+		/*
 		const size_t size = Units.size();
 		Assert(index < size);
 		CUnit *tmp = Units[index];
@@ -149,6 +219,13 @@ public:
 			Units[index] = Units[size - 1];
 		}
 		Units.pop_back();
+		*/
+		Assert(index < Count);
+		CUnit **units = Data();
+		CUnit *tmp = units[index];
+		units[index] = units[Count - 1];
+		PopBack();
+		//Wyrmgus end
 		return tmp;
 	}
 
@@ -159,7 +236,12 @@ public:
 	*/
 	bool Remove(CUnit *const unit)
 	{
+		//Wyrmgus start
+		CUnit **units = Data();
+		//Wyrmgus end
 #ifndef SECURE_UNIT_REMOVING
+		//Wyrmgus start
+		/*
 		const size_t size = Units.size();
 		if (size == 1 && unit == Units[0]) {
 			Units.pop_back();
@@ -174,13 +256,34 @@ public:
 				}
 			}
 		}
+		*/
+		for (unsigned int i = 0; i < Count; ++i) {
+			// Do we care on unit sequence in tile cache ?
+			if (units[i] == unit) {
+				units[i] = units[Count - 1];
+				PopBack();
+				return true;
+			}
+		}
+		//Wyrmgus end
 #else
+		//Wyrmgus start
+		/*
 		for (std::vector<CUnit *>::iterator i(Units.begin()), end(Units.end()); i != end; ++i) {
 			if ((*i) == unit) {
 				Units.erase(i);
 				return true;
 			}
 		}
+		*/
+		for (unsigned int i = 0; i < Count; ++i) {
+			if (units[i] == unit) {
+				std::copy(units + i + 1, units + Count, units + i);
+				PopBack();
+				return true;
+			}
+		}
+		//Wyrmgus end
 #endif
 		return false;
 	}
@@ -192,12 +295,24 @@ public:
 	*/
 	void RemoveS(CUnit *const unit)
 	{
+		//Wyrmgus start
+		/*
 		for (std::vector<CUnit *>::iterator i(Units.begin()), end(Units.end()); i != end; ++i) {
 			if ((*i) == unit) {
 				Units.erase(i);
 				return;
 			}
 		}
+		*/
+		CUnit **units = Data();
+		for (unsigned int i = 0; i < Count; ++i) {
+			if (units[i] == unit) {
+				std::copy(units + i + 1, units + Count, units + i);
+				PopBack();
+				return;
+			}
+		}
+		//Wyrmgus end
 	}
 
 	/**
@@ -209,11 +324,26 @@ public:
 	*/
 	bool InsertS(CUnit *unit)
 	{
+		//Wyrmgus start
+		/*
 		if (!binary_search(Units.begin(), Units.end(), unit)) {
 			Units.insert(std::lower_bound(Units.begin(), Units.end(), unit), unit);
 			return true;
 		}
 		return false;
+		*/
+		iterator it = std::lower_bound(begin(), end(), unit);
+		if (it != end() && *it == unit) {
+			return false;
+		}
+		const size_t index = it - begin();
+		Reserve(Count + 1);
+		CUnit **units = Data();
+		std::copy_backward(units + index, units + Count, units + Count + 1);
+		units[index] = unit;
+		++Count;
+		return true;
+		//Wyrmgus end
 	}
 
 	/**
@@ -223,12 +353,125 @@ public:
 	*/
 	void Insert(CUnit *unit)
 	{
-		Units.push_back(unit);
+		//Wyrmgus start
+//		Units.push_back(unit);
+		Reserve(Count + 1);
+		Data()[Count++] = unit;
+		//Wyrmgus end
 	}
 
+	//Wyrmgus start
+//public:
+//	std::vector<CUnit *> Units;
+private:
+	bool IsInline() const { return Capacity == InlineCapacity; }
+	CUnit **Data() { return IsInline() ? Inline : Heap; }
+	CUnit *const *Data() const { return IsInline() ? Inline : Heap; }
+
+	/// Make room for capacity units, moving to a bigger buffer if needed
+	void Reserve(unsigned int capacity)
+	{
+		if (capacity <= Capacity) {
+			return;
+		}
+		unsigned int new_capacity = Capacity * 2;
+		while (new_capacity < capacity) {
+			new_capacity *= 2;
+		}
+		CUnit **buffer = AllocateBuffer(new_capacity);
+		std::copy(begin(), end(), buffer);
+		if (!IsInline()) {
+			FreeBuffer(Heap, Capacity);
+		}
+		Heap = buffer;
+		Capacity = new_capacity;
+	}
+
+	/// Remove the last unit, going back to the inline storage once empty
+	void PopBack()
+	{
+		--Count;
+		if (Count == 0 && !IsInline()) {
+			FreeBuffer(Heap, Capacity);
+			Capacity = InlineCapacity;
+		}
+	}
+
+	static CUnit **AllocateBuffer(unsigned int capacity);
+	static void FreeBuffer(CUnit **buffer, unsigned int capacity);
+
+private:
+	/// Number of units stored in the cache itself, without allocating memory
+	static const unsigned int InlineCapacity = 2;
+
+	union {
+		CUnit *Inline[InlineCapacity];  /// units, while they fit in the cache
+		CUnit **Heap;                   /// units, once there are too many of them
+	};
+	unsigned int Count;                 /// number of units in the cache
+	unsigned int Capacity;              /// number of units which fit in the current storage
+	//Wyrmgus end
+};
+
+//Wyrmgus start
+/// Side in tiles of the square covered by each unit bucket
+#define UNIT_BUCKET_SIZE 8
+
+/// Smallest area in tiles for which unit selections go through the buckets instead of through each tile
+#define UNIT_BUCKET_SELECT_AREA 64
+
+/**
+**  Coarse grid over the units placed on a map layer.
+**
+**  Each bucket covers UNIT_BUCKET_SIZE x UNIT_BUCKET_SIZE tiles and holds the units whose
+**  top-left tile lies in it, with how many of them each player owns. Searches over large
+**  areas then only go through the units near the area, instead of through all of its tiles.
+*/
+class CUnitBucketGrid
+{
 public:
-	std::vector<CUnit *> Units;
+	/// A unit placed in a bucket
+	struct Entry {
+		CUnit *Unit;     /// the unit
+		short X;         /// left tile of the unit
+		short Y;         /// top tile of the unit
+		short Width;     /// tiles covered by the unit horizontally, clipped to the map
+		short Height;    /// tiles covered by the unit vertically, clipped to the map
+		int Player;      /// owner of the unit, as counted by the bucket
+	};
+
+	/// Units of a part of the map layer
+	struct Bucket {
+		Bucket() { std::fill(PlayerUnits, PlayerUnits + PlayerMax, 0); }
+
+		std::vector<Entry> Entries;    /// units whose top-left tile is in the bucket
+		int PlayerUnits[PlayerMax];    /// number of units of each player in the bucket
+	};
+
+public:
+	CUnitBucketGrid(int map_width, int map_height);
+
+	void Insert(CUnit &unit);
+	void Remove(CUnit &unit);
+	void ChangeOwner(CUnit &unit);
+
+	void FindUnits(int min_x, int min_y, int max_x, int max_y, std::vector<const Entry *> &entries) const;
+	bool HasUnitsNotOwnedBy(int min_x, int min_y, int max_x, int max_y, int player) const;
+
+private:
+	Bucket &GetBucket(int x, int y) { return Buckets[(y / UNIT_BUCKET_SIZE) * Width + x / UNIT_BUCKET_SIZE]; }
+	void GetBucketArea(int min_x, int min_y, int max_x, int max_y, int &bucket_min_x, int &bucket_min_y, int &bucket_max_x, int &bucket_max_y) const;
+
+private:
+	int MapWidth;                  /// width of the map layer in tiles
+	int MapHeight;                 /// height of the map layer in tiles
+	int Width;                     /// number of buckets horizontally
+	int Height;                    /// number of buckets vertically
+	int MaxUnitWidth;              /// widest unit ever placed in the grid
+	int MaxUnitHeight;             /// tallest unit ever placed in the grid
+	std::vector<Bucket> Buckets;   /// buckets, row by row
 };
+//Wyrmgus end
 
 
 //@}
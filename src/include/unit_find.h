@@ -290,6 +290,19 @@ void SelectFixed(const Vec2i &ltPos, const Vec2i &rbPos, std::vector<CUnit *> &u
 void SelectAroundUnit(const CUnit &unit, int range, std::vector<CUnit *> &around, bool circle = false);
 //Wyrmgus end
 
+//Wyrmgus start
+/**
+**  Check whether a tile is inside the circle of a circular selection.
+*/
+inline bool IsInSelectionCircle(const Vec2i &pos, double middle_x, double middle_y, double radius)
+{
+	double rel_x = pos.x - middle_x;
+	double rel_y = pos.y - middle_y;
+	double my = radius * radius - rel_x * rel_x;
+	return (rel_y * rel_y) <= my;
+}
+//Wyrmgus end
+
 template <typename Pred>
 //Wyrmgus start
 //void SelectFixed(const Vec2i &ltPos, const Vec2i &rbPos, std::vector<CUnit *> &units, Pred pred)
@@ -313,18 +326,49 @@ void SelectFixed(const Vec2i &ltPos, const Vec2i &rbPos, std::vector<CUnit *> &u
 		middle_y = (rbPos.y + ltPos.y) / 2;
 		radius = ((middle_x - ltPos.x) + (middle_y - ltPos.y)) / 2;
 	}
+	
+	const CUnitBucketGrid *buckets = Map.GetUnitBuckets(z);
+	if (buckets != NULL && (rbPos.x - ltPos.x + 1) * (rbPos.y - ltPos.y + 1) >= UNIT_BUCKET_SELECT_AREA) {
+		std::vector<const CUnitBucketGrid::Entry *> entries;
+		buckets->FindUnits(ltPos.x, ltPos.y, rbPos.x, rbPos.y, entries);
+		
+		// sort the units found by the tile where the loop below would have found each of them first, and by their place in its cache, so that the result is the same
+		std::vector<std::pair<std::pair<int, int>, CUnit *>> found;
+		for (size_t i = 0; i != entries.size(); ++i) {
+			const CUnitBucketGrid::Entry &entry = *entries[i];
+			const Vec2i minPos(std::max(entry.X, ltPos.x), std::max(entry.Y, ltPos.y));
+			const Vec2i maxPos(std::min<short>(entry.X + entry.Width - 1, rbPos.x), std::min<short>(entry.Y + entry.Height - 1, rbPos.y));
+			int first_index = -1;
+			for (Vec2i posIt = minPos; posIt.y != maxPos.y + 1 && first_index == -1; ++posIt.y) {
+				for (posIt.x = minPos.x; posIt.x != maxPos.x + 1; ++posIt.x) {
+					if (circle && !IsInSelectionCircle(posIt, middle_x, middle_y, radius)) {
+						continue;
+					}
+					first_index = Map.getIndex(posIt, z);
+					break;
+				}
+			}
+			if (first_index == -1 || !pred(entry.Unit)) {
+				continue;
+			}
+			const CUnitCache &cache = Map.Field(first_index, z)->UnitCache;
+			const int cache_index = std::find(cache.begin(), cache.end(), entry.Unit) - cache.begin();
+			found.push_back(std::make_pair(std::make_pair(first_index, cache_index), entry.Unit));
+		}
+		std::sort(found.begin(), found.end());
+		units.reserve(found.size());
+		for (size_t i = 0; i != found.size(); ++i) {
+			units.push_back(found[i].second);
+		}
+		return;
+	}
 	//Wyrmgus end
 
 	for (Vec2i posIt = ltPos; posIt.y != rbPos.y + 1; ++posIt.y) {
 		for (posIt.x = ltPos.x; posIt.x != rbPos.x + 1; ++posIt.x) {
 			//Wyrmgus start
-			if (circle) {
-				double rel_x = posIt.x - middle_x;
-				double rel_y = posIt.y - middle_y;
-				double my = radius * radius - rel_x * rel_x;
-				if ((rel_y * rel_y) > my) {
-					continue;
-				}
+			if (circle && !IsInSelectionCircle(posIt, middle_x, middle_y, radius)) {
+				continue;
 			}
 			//Wyrmgus end
 			//Wyrmgus start
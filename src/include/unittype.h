@@ -60,6 +60,9 @@
 #include <algorithm>
 #include <map>
 #include <cstring>
+//Wyrmgus start
+#include <unordered_map>
+//Wyrmgus end
 
 /*----------------------------------------------------------------------------
 --  Declarations
@@ -1324,6 +1327,9 @@ extern void LoadUnitTypeSprite(CUnitType &unittype); /// Load the sprite for a u
 extern int GetUnitTypesCount();                     /// Get the amount of unit-types
 extern void LoadUnitTypes();                     /// Load the unit-type data
 //Wyrmgus start
+extern void GetUnitTypeFiles(std::vector<std::string> &files);	/// Get the graphic files of the unit-types to load
+//Wyrmgus end
+//Wyrmgus start
 extern void LoadUnitType(CUnitType &unittype);	/// Load a unittype
 //Wyrmgus end
 extern void CleanUnitTypes();                    /// Cleanup unit-type module
@@ -1343,7 +1349,10 @@ extern void SetModSound(std::string mod_file, std::string ident, std::string sou
 extern std::string GetImageLayerNameById(int image_layer);
 extern int GetImageLayerIdByName(std::string image_layer);
 
-extern std::map<std::string, CUnitType *> UnitTypeMap;
+//Wyrmgus start
+//extern std::map<std::string, CUnitType *> UnitTypeMap;
+extern std::unordered_map<std::string, CUnitType *> UnitTypeMap;
+//Wyrmgus end
 //Wyrmgus end
 
 //@}
@@ -80,7 +80,7 @@ protected:
 		Width(0), Height(0), NumFrames(1), GraphicWidth(0), GraphicHeight(0),
 		//Wyrmgus start
 //		Refs(1), Resized(false)
-		Refs(1), TimeOfDay(0), Resized(false), Grayscale(false)
+		Refs(1), TimeOfDay(0), Resized(false), Grayscale(false), HasCacheKey(false)
 		//Wyrmgus end
 #if defined(USE_OPENGL) || defined(USE_GLES)
 		//Wyrmgus start
@@ -174,6 +174,7 @@ public:
 	virtual std::string getFile() const { return File; }
 	virtual int getGraphicWidth() const { return GraphicWidth; }
 	virtual int getGraphicHeight() const { return GraphicHeight; }
+	const std::string &GetCacheKey();
 	//Wyrmgus end
 
 	std::string File;          /// Filename
@@ -191,6 +192,9 @@ public:
 	frame_pos_t *frame_map;
 	frame_pos_t *frameFlip_map;
 	void GenFramesMap();
+	//Wyrmgus start
+	void GenFlipFramesMap();
+	//Wyrmgus end
 	int Width;                 /// Width of a frame
 	int Height;                /// Height of a frame
 	int NumFrames;             /// Number of frames
@@ -203,6 +207,8 @@ public:
 	bool Resized;              /// Image has been resized
 	//Wyrmgus start
 	bool Grayscale;
+	std::string CacheKey;      /// Key of the file in the graphic cache, see GetCacheKey
+	bool HasCacheKey;          /// Whether CacheKey has been computed
 	//Wyrmgus end
 
 #if defined(USE_OPENGL) || defined(USE_GLES)
@@ -565,6 +571,12 @@ extern int VideoValidResolution(int w, int h);
 
 /// Load graphic from PNG file
 extern int LoadGraphicPNG(CGraphic *g);
+//Wyrmgus start
+/// Decode graphic files in advance on the worker threads
+extern void DecodeGraphicFiles(const std::vector<std::string> &files);
+/// Free the graphic files decoded in advance which have not been used
+extern void FreeDecodedGraphicFiles();
+//Wyrmgus end
 
 #if defined(USE_OPENGL) || defined(USE_GLES)
 
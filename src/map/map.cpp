@@ -47,6 +47,9 @@
 #include "game.h" // for the SaveGameLoading variable
 //Wyrmgus end
 #include "iolib.h"
+//Wyrmgus start
+#include "pathfinder.h"
+//Wyrmgus end
 #include "player.h"
 //Wyrmgus start
 #include "province.h"
@@ -75,11 +78,11 @@
 
 //Wyrmgus start
 std::vector<CMapTemplate *> MapTemplates;
-std::map<std::string, CMapTemplate *> MapTemplateIdentToPointer;
+std::unordered_map<std::string, CMapTemplate *> MapTemplateIdentToPointer;
 std::vector<CSettlement *> Settlements;
-std::map<std::string, CSettlement *> SettlementIdentToPointer;
+std::unordered_map<std::string, CSettlement *> SettlementIdentToPointer;
 std::vector<CTerrainFeature *> TerrainFeatures;
-std::map<std::string, CTerrainFeature *> TerrainFeatureIdentToPointer;
+std::unordered_map<std::string, CTerrainFeature *> TerrainFeatureIdentToPointer;
 std::map<std::tuple<int, int, int>, int> TerrainFeatureColorToIndex;
 std::vector<CTimeline *> Timelines;
 std::map<std::string, CTimeline *> TimelineIdentToPointer;
@@ -97,14 +100,15 @@ char CurrentMapPath[1024];  /// Path of the current map
 /**
 **  Get a map template
 */
-CMapTemplate *GetMapTemplate(std::string map_ident)
+CMapTemplate *GetMapTemplate(const std::string &map_ident)
 {
 	if (map_ident.empty()) {
 		return NULL;
 	}
 	
-	if (MapTemplateIdentToPointer.find(map_ident) != MapTemplateIdentToPointer.end()) {
-		return MapTemplateIdentToPointer[map_ident];
+	std::unordered_map<std::string, CMapTemplate *>::const_iterator find_iterator = MapTemplateIdentToPointer.find(map_ident);
+	if (find_iterator != MapTemplateIdentToPointer.end()) {
+		return find_iterator->second;
 	}
 	
 	return NULL;
@@ -113,14 +117,15 @@ CMapTemplate *GetMapTemplate(std::string map_ident)
 /**
 **  Get a settlement
 */
-CSettlement *GetSettlement(std::string settlement_ident)
+CSettlement *GetSettlement(const std::string &settlement_ident)
 {
 	if (settlement_ident.empty()) {
 		return NULL;
 	}
 	
-	if (SettlementIdentToPointer.find(settlement_ident) != SettlementIdentToPointer.end()) {
-		return SettlementIdentToPointer[settlement_ident];
+	std::unordered_map<std::string, CSettlement *>::const_iterator find_iterator = SettlementIdentToPointer.find(settlement_ident);
+	if (find_iterator != SettlementIdentToPointer.end()) {
+		return find_iterator->second;
 	}
 	
 	return NULL;
@@ -129,14 +134,15 @@ CSettlement *GetSettlement(std::string settlement_ident)
 /**
 **  Get a terrain feature
 */
-CTerrainFeature *GetTerrainFeature(std::string terrain_feature_ident)
+CTerrainFeature *GetTerrainFeature(const std::string &terrain_feature_ident)
 {
 	if (terrain_feature_ident.empty()) {
 		return NULL;
 	}
 	
-	if (TerrainFeatureIdentToPointer.find(terrain_feature_ident) != TerrainFeatureIdentToPointer.end()) {
-		return TerrainFeatureIdentToPointer[terrain_feature_ident];
+	std::unordered_map<std::string, CTerrainFeature *>::const_iterator find_iterator = TerrainFeatureIdentToPointer.find(terrain_feature_ident);
+	if (find_iterator != TerrainFeatureIdentToPointer.end()) {
+		return find_iterator->second;
 	}
 	
 	return NULL;
@@ -561,6 +567,7 @@ void CMapTemplate::Apply(Vec2i template_start_pos, Vec2i map_start_pos, int z)
 			unit->Variable[GIVERESOURCE_INDEX].Value = std::get<1>(iterator->second);
 			unit->Variable[GIVERESOURCE_INDEX].Max = std::get<1>(iterator->second);
 			unit->Variable[GIVERESOURCE_INDEX].Enable = 1;
+			unit->VariablesIncrease = true;
 		}
 		
 		if (std::get<2>(iterator->second)) {
@@ -735,6 +742,7 @@ void CMapTemplate::ApplySettlements(Vec2i template_start_pos, Vec2i map_start_po
 					unit->Variable[GIVERESOURCE_INDEX].Value = resource_quantity;
 					unit->Variable[GIVERESOURCE_INDEX].Max = resource_quantity;
 					unit->Variable[GIVERESOURCE_INDEX].Enable = 1;
+					unit->VariablesIncrease = true;
 				}
 			}
 		}
@@ -1360,6 +1368,7 @@ void CMap::Reveal(bool only_person_players)
 			MarkSeenTile(mf, z);
 		}
 	}
+	AStarMapExplorationChanged();
 	//Wyrmgus end
 	//  Global seen recount. Simple and effective.
 	for (CUnitManager::Iterator it = UnitManager.begin(); it != UnitManager.end(); ++it) {
@@ -2207,6 +2216,10 @@ void CMap::Clean()
 	this->SurfaceLayers.clear();
 	this->LayerConnectors.clear();
 	this->SettlementUnits.clear();
+	for (size_t z = 0; z < this->UnitBuckets.size(); ++z) {
+		delete this->UnitBuckets[z];
+	}
+	this->UnitBuckets.clear();
 	//Wyrmgus end
 
 	// Tileset freed by Tileset?
@@ -2275,6 +2288,19 @@ void CMap::Save(CFile &file) const
 	file.printf("  },\n");
 	//Wyrmgus end
 
+	//Wyrmgus start
+	if (!Preference.SaveMapFieldsAsText) {
+		std::vector<unsigned char> data;
+		this->SaveFieldsBinary(data);
+		const std::string encoded_data = EncodeBase64(data);
+		file.printf("  \"map-fields-data\", \"");
+		file.write(encoded_data.c_str(), encoded_data.size());
+		file.printf("\"\n");
+		file.printf("}})\n");
+		return;
+	}
+	//Wyrmgus end
+
 	file.printf("  \"map-fields\", {\n");
 	//Wyrmgus start
 	/*
@@ -2313,6 +2339,111 @@ void CMap::Save(CFile &file) const
 	file.printf("}})\n");
 }
 
+//Wyrmgus start
+/**
+**  Version of the packed binary map field format, to be increased whenever the layout changes.
+*/
+static const int MapFieldsBinaryVersion = 1;
+
+/**
+**  Pack the fields of all map layers into the binary format of the "map-fields-data" save game section.
+**
+**  The data starts with the format version, the number of layers and the size of each layer,
+**  followed by the table of terrain identifiers referenced by the fields and then the fields themselves.
+**
+**  @param data  Receives the packed data.
+*/
+void CMap::SaveFieldsBinary(std::vector<unsigned char> &data) const
+{
+	std::map<std::string, int> ident_indexes;
+	CBinaryWriter fields_writer;
+	for (size_t z = 0; z < this->Fields.size(); ++z) {
+		const int field_count = this->Info.MapWidths[z] * this->Info.MapHeights[z];
+		for (int i = 0; i < field_count; ++i) {
+			this->Fields[z][i].SaveBinary(fields_writer, ident_indexes);
+		}
+	}
+
+	std::vector<std::string> idents(ident_indexes.size());
+	for (std::map<std::string, int>::const_iterator it = ident_indexes.begin(); it != ident_indexes.end(); ++it) {
+		idents[it->second] = it->first;
+	}
+
+	CBinaryWriter writer;
+	writer.WriteUnsigned(MapFieldsBinaryVersion);
+	writer.WriteUnsigned(this->Fields.size());
+	for (size_t z = 0; z < this->Fields.size(); ++z) {
+		writer.WriteUnsigned(this->Info.MapWidths[z]);
+		writer.WriteUnsigned(this->Info.MapHeights[z]);
+	}
+	writer.WriteUnsigned(idents.size());
+	for (size_t i = 0; i < idents.size(); ++i) {
+		writer.WriteString(idents[i]);
+	}
+
+	data = writer.GetData();
+	data.insert(data.end(), fields_writer.GetData().begin(), fields_writer.GetData().end());
+}
+
+/**
+**  Load the fields of all map layers from data packed by SaveFieldsBinary().
+**
+**  The map layers must already have been created with the same sizes as when saving.
+**
+**  @param data  Packed data.
+**
+**  @return      True if the data could be loaded.
+*/
+bool CMap::LoadFieldsBinary(const std::vector<unsigned char> &data)
+{
+	CBinaryReader reader(data);
+	const unsigned long long version = reader.ReadUnsigned();
+	if (version != MapFieldsBinaryVersion) {
+		fprintf(stderr, "Unsupported map field data version: %llu\n", version);
+		return false;
+	}
+
+	if (reader.ReadUnsigned() != this->Fields.size()) {
+		fprintf(stderr, "Wrong number of map layers in the map field data\n");
+		return false;
+	}
+	for (size_t z = 0; z < this->Fields.size(); ++z) {
+		const unsigned long long width = reader.ReadUnsigned();
+		const unsigned long long height = reader.ReadUnsigned();
+		if (width != (unsigned long long) this->Info.MapWidths[z] || height != (unsigned long long) this->Info.MapHeights[z]) {
+			fprintf(stderr, "Wrong map layer size in the map field data: %llux%llu\n", width, height);
+			return false;
+		}
+	}
+
+	//resolve every identifier once instead of once per field
+	const unsigned long long ident_count = reader.ReadUnsigned();
+	if (ident_count > data.size()) {
+		return false;
+	}
+	std::vector<CTerrainType *> terrains(ident_count, NULL);
+	std::vector<CTerrainFeature *> features(ident_count, NULL);
+	for (unsigned long long i = 0; i < ident_count; ++i) {
+		const std::string ident = reader.ReadString();
+		terrains[i] = GetTerrainType(ident);
+		features[i] = GetTerrainFeature(ident);
+	}
+
+	for (size_t z = 0; z < this->Fields.size() && !reader.HasFailed(); ++z) {
+		const int field_count = this->Info.MapWidths[z] * this->Info.MapHeights[z];
+		for (int i = 0; i < field_count && !reader.HasFailed(); ++i) {
+			this->Fields[z][i].LoadBinary(reader, terrains, features);
+		}
+	}
+
+	if (reader.HasFailed() || !reader.AtEnd()) {
+		fprintf(stderr, "Corrupted map field data\n");
+		return false;
+	}
+	return true;
+}
+//Wyrmgus end
+
 /*----------------------------------------------------------------------------
 -- Map Tile Update Functions
 ----------------------------------------------------------------------------*/
@@ -2466,6 +2597,7 @@ void CMap::SetTileTerrain(const Vec2i &pos, CTerrainType *terrain, int z)
 	}
 	
 	mf.SetTerrain(terrain);
+	AStarTerrainChanged(pos, Vec2i(1, 1), z);
 	
 	if (terrain->Overlay) {
 		//remove decorations if the overlay terrain has changed
@@ -2546,6 +2678,9 @@ void CMap::RemoveTileOverlayTerrain(const Vec2i &pos, int z)
 	CTerrainType *old_terrain = mf.OverlayTerrain;
 	
 	mf.RemoveOverlayTerrain();
+	//Wyrmgus start
+	AStarTerrainChanged(pos, Vec2i(1, 1), z);
+	//Wyrmgus end
 	
 	this->CalculateTileTransitions(pos, true, z);
 	this->CalculateTileTerrainFeature(pos, z);
@@ -2621,6 +2756,7 @@ void CMap::SetOverlayTerrainDestroyed(const Vec2i &pos, bool destroyed, int z)
 			mf.Value = Resources[WoodCost].DefaultAmount;
 		}
 	}
+	AStarTerrainChanged(pos, Vec2i(1, 1), z);
 	
 	this->CalculateTileTransitions(pos, true, z);
 	
@@ -40,6 +40,7 @@
 #include "pathfinder.h"
 #include "player.h"
 //Wyrmgus start
+#include "profile.h"
 #include "tileset.h"
 #include "translate.h"
 //Wyrmgus end
@@ -249,6 +250,10 @@ void CViewport::Center(const PixelPos &mapPixelPos)
 */
 void CViewport::DrawMapBackgroundInViewport() const
 {
+	//Wyrmgus start
+	PROFILE_SCOPE("CViewport::DrawMapBackgroundInViewport");
+	//Wyrmgus end
+	
 	int ex = this->BottomRightPos.x;
 	int ey = this->BottomRightPos.y;
 	int sy = this->MapPos.y;
@@ -298,7 +303,7 @@ void CViewport::DrawMapBackgroundInViewport() const
 			if (ReplayRevealMap) {
 				bool is_unpassable = mf.OverlayTerrain && (mf.OverlayTerrain->Flags & MapFieldUnpassable) && std::find(mf.OverlayTerrain->DestroyedTiles.begin(), mf.OverlayTerrain->DestroyedTiles.end(), mf.OverlaySolidTile) == mf.OverlayTerrain->DestroyedTiles.end();
 				if (mf.Terrain && mf.Terrain->Graphics) {
-					mf.Terrain->Graphics->DrawFrameClip(mf.SolidTile + (mf.Terrain == mf.Terrain ? mf.AnimationFrame : 0), dx, dy, false);
+					mf.Terrain->Graphics->DrawFrameClip(mf.SolidTile + (mf.Terrain == mf.Terrain ? mf.GetAnimationFrame() : 0), dx, dy, false);
 				}
 				for (size_t i = 0; i != mf.TransitionTiles.size(); ++i) {
 					if (mf.TransitionTiles[i].first->Graphics) {
@@ -315,10 +320,10 @@ void CViewport::DrawMapBackgroundInViewport() const
 				}
 				if (mf.OverlayTerrain && mf.OverlayTransitionTiles.size() == 0) {
 					if (mf.OverlayTerrain->Graphics) {
-						mf.OverlayTerrain->Graphics->DrawFrameClip(mf.OverlaySolidTile + (mf.OverlayTerrain == mf.OverlayTerrain ? mf.OverlayAnimationFrame : 0), dx, dy, false);
+						mf.OverlayTerrain->Graphics->DrawFrameClip(mf.OverlaySolidTile + (mf.OverlayTerrain == mf.OverlayTerrain ? mf.GetOverlayAnimationFrame() : 0), dx, dy, false);
 					}
 					if (mf.OverlayTerrain->PlayerColorGraphics) {
-						mf.OverlayTerrain->PlayerColorGraphics->DrawPlayerColorFrameClip((mf.Owner != -1) ? mf.Owner : PlayerNumNeutral, mf.OverlaySolidTile + (mf.OverlayTerrain == mf.OverlayTerrain ? mf.OverlayAnimationFrame : 0), dx, dy, false);
+						mf.OverlayTerrain->PlayerColorGraphics->DrawPlayerColorFrameClip((mf.Owner != -1) ? mf.Owner : PlayerNumNeutral, mf.OverlaySolidTile + (mf.OverlayTerrain == mf.OverlayTerrain ? mf.GetOverlayAnimationFrame() : 0), dx, dy, false);
 					}
 				}
 				for (size_t i = 0; i != mf.OverlayTransitionTiles.size(); ++i) {
@@ -345,7 +350,7 @@ void CViewport::DrawMapBackgroundInViewport() const
 			} else {
 				bool is_unpassable_seen = mf.playerInfo.SeenOverlayTerrain && (mf.playerInfo.SeenOverlayTerrain->Flags & MapFieldUnpassable) && std::find(mf.playerInfo.SeenOverlayTerrain->DestroyedTiles.begin(), mf.playerInfo.SeenOverlayTerrain->DestroyedTiles.end(), mf.playerInfo.SeenOverlaySolidTile) == mf.playerInfo.SeenOverlayTerrain->DestroyedTiles.end();
 				if (mf.playerInfo.SeenTerrain && mf.playerInfo.SeenTerrain->Graphics) {
-					mf.playerInfo.SeenTerrain->Graphics->DrawFrameClip(mf.playerInfo.SeenSolidTile + (mf.playerInfo.SeenTerrain == mf.Terrain ? mf.AnimationFrame : 0), dx, dy, false);
+					mf.playerInfo.SeenTerrain->Graphics->DrawFrameClip(mf.playerInfo.SeenSolidTile + (mf.playerInfo.SeenTerrain == mf.Terrain ? mf.GetAnimationFrame() : 0), dx, dy, false);
 				}
 				for (size_t i = 0; i != mf.playerInfo.SeenTransitionTiles.size(); ++i) {
 					if (mf.playerInfo.SeenTransitionTiles[i].first->Graphics) {
@@ -362,10 +367,10 @@ void CViewport::DrawMapBackgroundInViewport() const
 				}
 				if (mf.playerInfo.SeenOverlayTerrain && mf.playerInfo.SeenOverlayTransitionTiles.size() == 0) {
 					if (mf.playerInfo.SeenOverlayTerrain->Graphics) {
-						mf.playerInfo.SeenOverlayTerrain->Graphics->DrawFrameClip(mf.playerInfo.SeenOverlaySolidTile + (mf.playerInfo.SeenOverlayTerrain == mf.OverlayTerrain ? mf.OverlayAnimationFrame : 0), dx, dy, false);
+						mf.playerInfo.SeenOverlayTerrain->Graphics->DrawFrameClip(mf.playerInfo.SeenOverlaySolidTile + (mf.playerInfo.SeenOverlayTerrain == mf.OverlayTerrain ? mf.GetOverlayAnimationFrame() : 0), dx, dy, false);
 					}
 					if (mf.playerInfo.SeenOverlayTerrain->PlayerColorGraphics) {
-						mf.playerInfo.SeenOverlayTerrain->PlayerColorGraphics->DrawPlayerColorFrameClip((mf.Owner != -1) ? mf.Owner : PlayerNumNeutral, mf.playerInfo.SeenOverlaySolidTile + (mf.playerInfo.SeenOverlayTerrain == mf.OverlayTerrain ? mf.OverlayAnimationFrame : 0), dx, dy, false);
+						mf.playerInfo.SeenOverlayTerrain->PlayerColorGraphics->DrawPlayerColorFrameClip((mf.Owner != -1) ? mf.Owner : PlayerNumNeutral, mf.playerInfo.SeenOverlaySolidTile + (mf.playerInfo.SeenOverlayTerrain == mf.OverlayTerrain ? mf.GetOverlayAnimationFrame() : 0), dx, dy, false);
 					}
 				}
 				for (size_t i = 0; i != mf.playerInfo.SeenOverlayTransitionTiles.size(); ++i) {
@@ -457,6 +462,10 @@ static void ShowUnitName(const CViewport &vp, PixelPos pos, CUnit *unit, bool hi
 */
 void CViewport::Draw() const
 {
+	//Wyrmgus start
+	PROFILE_SCOPE("CViewport::Draw");
+	//Wyrmgus end
+	
 	PushClipping();
 	this->SetClipping();
 
@@ -40,8 +40,12 @@
 
 #include "actions.h"
 #include "minimap.h"
+//Wyrmgus start
+#include "pathfinder.h"
+//Wyrmgus end
 #include "player.h"
 //Wyrmgus start
+#include "profile.h"
 #include "tileset.h"
 //Wyrmgus end
 #include "ui.h"
@@ -81,6 +85,51 @@ static std::vector<std::vector<unsigned short>> VisibleTable;
 static SDL_Surface *OnlyFogSurface;
 static CGraphic *AlphaFogG;
 
+//Wyrmgus start
+/**
+**  Tiles hidden by obstacles, for the sight on underground layers.
+**
+**  For each offset of a tile from the tile a unit sees from, holds the mask of the offsets
+**  which can't be seen if that tile is an obstacle: those whose line of sight, as traced by
+**  CheckObstaclesBetweenTiles, goes through it more than one tile away from its end.
+*/
+class CSightShadows
+{
+public:
+	explicit CSightShadows(int extent);
+
+	/// Get the bit of an offset in the masks
+	int GetBit(int offset_x, int offset_y) const { return (offset_y + Extent) * Side + offset_x + Extent; }
+	/// Get the mask of the tiles hidden by an obstacle at an offset
+	const Uint64 *GetShadow(int offset_x, int offset_y) const { return &Shadows[GetBit(offset_x, offset_y) * Words]; }
+
+	int Extent;                   /// greatest offset covered, in every direction
+	int Side;                     /// number of offsets along each axis
+	int Words;                    /// number of words of each mask
+	std::vector<Uint64> Shadows;  /// mask of the hidden tiles, for each offset of an obstacle
+};
+
+/// Shadow tables, by extent
+static std::vector<CSightShadows *> SightShadows;
+
+/// Masks of the tiles hidden from each tile of the unit whose sight is being marked
+static std::vector<Uint64> SightBlocked;
+
+/**
+**  Tiles which come into and go out of the sight of a unit moving by one tile.
+*/
+struct SightDelta {
+	std::vector<Vec2i> Entering;  /// offsets from the new position of the tiles coming into sight
+	std::vector<Vec2i> Leaving;   /// offsets from the new position of the tiles going out of sight
+};
+
+/// Half widths of the rows of the sight circle, by sight range and distance of the row from the unit
+static std::vector<std::vector<int>> SightSpans;
+
+/// Sight deltas, by sight range, unit width, unit height and direction of the move
+static std::map<std::tuple<int, int, int, int>, SightDelta> SightDeltas;
+//Wyrmgus end
+
 /*----------------------------------------------------------------------------
 --  Functions
 ----------------------------------------------------------------------------*/
@@ -283,6 +332,12 @@ void MapMarkTileSight(const CPlayer &player, const unsigned int index, int z)
 	//Wyrmgus end
 	unsigned short *v = &(mf.playerInfo.Visible[player.Index]);
 	if (*v == 0 || *v == 1) { // Unexplored or unseen
+		//Wyrmgus start
+		// the tiles seen by a revealed player are only explored for the others while they are visible
+		if (*v == 0 || player.Revealed) {
+			AStarExplorationChanged(Vec2i(index % Map.Info.MapWidths[z], index / Map.Info.MapWidths[z]), Vec2i(1, 1), z);
+		}
+		//Wyrmgus end
 		// When there is no fog only unexplored tiles are marked.
 		if (!Map.NoFogOfWar || *v == 0) {
 			//Wyrmgus start
@@ -338,6 +393,11 @@ void MapUnmarkTileSight(const CPlayer &player, const unsigned int index, int z)
 			// This happens when we unmark everything in CommandSharedVision
 			break;
 		case 2:
+			//Wyrmgus start
+			if (player.Revealed) {
+				AStarExplorationChanged(Vec2i(index % Map.Info.MapWidths[z], index / Map.Info.MapWidths[z]), Vec2i(1, 1), z);
+			}
+			//Wyrmgus end
 			// When there is NoFogOfWar units never get unmarked.
 			if (!Map.NoFogOfWar) {
 				//Wyrmgus start
@@ -491,6 +551,225 @@ void MapUnmarkTileDetectEthereal(const CPlayer &player, const Vec2i &pos, int z)
 }
 //Wyrmgus end
 
+//Wyrmgus start
+CSightShadows::CSightShadows(int extent) : Extent(extent), Side(2 * extent + 1)
+{
+	this->Words = (this->Side * this->Side + 63) / 64;
+	this->Shadows.resize(this->Side * this->Side * this->Words, 0);
+
+	// trace the line to each offset the same way as CheckObstaclesBetweenTiles does
+	for (int goal_y = -extent; goal_y <= extent; ++goal_y) {
+		for (int goal_x = -extent; goal_x <= extent; ++goal_x) {
+			const int goal_bit = this->GetBit(goal_x, goal_y);
+			const Vec2i delta(abs(goal_x), abs(goal_y));
+			const Vec2i sign(0 < goal_x ? 1 : -1, 0 < goal_y ? 1 : -1);
+			int error = delta.x - delta.y;
+			Vec2i pos(0, 0);
+
+			while (pos.x != goal_x || pos.y != goal_y) {
+				const int error2 = error * 2;
+
+				if (error2 > -delta.y) {
+					error -= delta.y;
+					pos.x += sign.x;
+				}
+				if (error2 < delta.x) {
+					error += delta.x;
+					pos.y += sign.y;
+				}
+
+				// obstacles next to the goal don't hide it, so that the obstacle tiles themselves don't have fog drawn over them
+				if (abs(pos.x - goal_x) > 1 || abs(pos.y - goal_y) > 1) {
+					this->Shadows[this->GetBit(pos.x, pos.y) * this->Words + goal_bit / 64] |= (Uint64) 1 << (goal_bit % 64);
+				}
+			}
+		}
+	}
+}
+
+/**
+**  Get the shadow table covering offsets up to an extent, building it if needed.
+*/
+static const CSightShadows &GetSightShadows(int extent)
+{
+	if ((int) SightShadows.size() <= extent) {
+		SightShadows.resize(extent + 1, NULL);
+	}
+	if (SightShadows[extent] == NULL) {
+		SightShadows[extent] = new CSightShadows(extent);
+	}
+	return *SightShadows[extent];
+}
+
+/**
+**  Find the tiles hidden by obstacles from each tile of a unit.
+**
+**  Goes once over the obstacles in sight, adding the shadow of each of them to the mask of every tile of the unit.
+**
+**  @param shadows  Shadow table covering the sight of the unit.
+**  @param pos      Top-left tile of the unit.
+**  @param w        Width of the unit.
+**  @param h        Height of the unit.
+*/
+static void FindSightBlocked(const CSightShadows &shadows, const Vec2i &pos, int w, int h, int z)
+{
+	const int words = shadows.Words;
+	SightBlocked.assign(w * h * words, 0);
+
+	const int minx = std::max(0, pos.x - shadows.Extent);
+	const int miny = std::max(0, pos.y - shadows.Extent);
+	const int maxx = std::min(Map.Info.MapWidths[z] - 1, pos.x + w - 1 + shadows.Extent);
+	const int maxy = std::min(Map.Info.MapHeights[z] - 1, pos.y + h - 1 + shadows.Extent);
+
+	for (int y = miny; y <= maxy; ++y) {
+		const CMapField *mf = Map.Field(minx, y, z);
+		for (int x = minx; x <= maxx; ++x, ++mf) {
+			if (!(mf->Flags & MapFieldAirUnpassable)) {
+				continue;
+			}
+			for (int sy = 0; sy < h; ++sy) {
+				const int offset_y = y - pos.y - sy;
+				if (abs(offset_y) > shadows.Extent) {
+					continue;
+				}
+				for (int sx = 0; sx < w; ++sx) {
+					const int offset_x = x - pos.x - sx;
+					if (abs(offset_x) > shadows.Extent) {
+						continue;
+					}
+					const Uint64 *shadow = shadows.GetShadow(offset_x, offset_y);
+					Uint64 *blocked = &SightBlocked[(sy * w + sx) * words];
+					for (int i = 0; i < words; ++i) {
+						blocked[i] |= shadow[i];
+					}
+				}
+			}
+		}
+	}
+}
+
+/**
+**  Check whether a tile is hidden by obstacles from all tiles of a unit, as found by FindSightBlocked.
+*/
+static bool IsSightBlocked(const CSightShadows &shadows, const Vec2i &pos, int w, int h, const Vec2i &mpos)
+{
+	for (int sy = 0; sy < h; ++sy) {
+		for (int sx = 0; sx < w; ++sx) {
+			const int bit = shadows.GetBit(mpos.x - pos.x - sx, mpos.y - pos.y - sy);
+			if (!((SightBlocked[(sy * w + sx) * shadows.Words + bit / 64] >> (bit % 64)) & 1)) {
+				return false; //the obstacle must be avoidable from at least one of the unit's tiles
+			}
+		}
+	}
+	return true;
+}
+//Wyrmgus end
+
+//Wyrmgus start
+/**
+**  Get the half widths of the rows of the sight circle for a sight range, computing them the first time.
+**
+**  @return  For each distance of a row from the unit, how many tiles are seen on each side of the unit.
+*/
+static const std::vector<int> &GetSightSpans(int range)
+{
+	if ((int) SightSpans.size() <= range) {
+		SightSpans.resize(range + 1);
+	}
+	std::vector<int> &spans = SightSpans[range];
+	if (spans.empty()) {
+		spans.resize(range + 1);
+		spans[0] = range;
+		for (int distance = 1; distance <= range; ++distance) {
+			spans[distance] = isqrt(square(range + 1) - square(distance) - 1);
+		}
+	}
+	return spans;
+}
+
+/**
+**  Marker calling a marker function known at compile time, so that it can be inlined.
+*/
+template <MapMarkerFunc *MARKER>
+class _MarkerCall
+{
+public:
+	void operator()(const CPlayer &player, const Vec2i &pos, unsigned int index, int z) const
+	{
+#ifdef MARKER_ON_INDEX
+		MARKER(player, index, z);
+#else
+		MARKER(player, pos, z);
+#endif
+	}
+};
+
+/**
+**  Marker for the ownership influence, which also updates the owner of the tile.
+*/
+template <MapMarkerFunc *MARKER>
+class _OwnershipMarkerCall
+{
+public:
+	void operator()(const CPlayer &player, const Vec2i &pos, unsigned int index, int z) const
+	{
+		_MarkerCall<MARKER>()(player, pos, index, z);
+		Map.CalculateTileOwnership(pos, z);
+	}
+};
+
+/**
+**  Marker calling any marker function through a pointer.
+*/
+class _MarkerFuncCall
+{
+public:
+	explicit _MarkerFuncCall(MapMarkerFunc *m) : marker(m) {}
+
+	void operator()(const CPlayer &player, const Vec2i &pos, unsigned int index, int z) const
+	{
+#ifdef MARKER_ON_INDEX
+		marker(player, index, z);
+#else
+		marker(player, pos, z);
+#endif
+	}
+private:
+	MapMarkerFunc *marker;
+};
+
+/**
+**  Go through the sight circle of a unit row by row, calling the marker on each tile seen.
+**
+**  @param shadows  Shadow table if the tiles hidden by obstacles mustn't be marked, NULL otherwise.
+*/
+template <typename MARKER>
+static void MapSightSweep(const CPlayer &player, const Vec2i &pos, int w, int h, int range, const MARKER &marker, const CSightShadows *shadows, int z)
+{
+	const std::vector<int> &spans = GetSightSpans(range);
+	const int map_width = Map.Info.MapWidths[z];
+	const int miny = std::max(-range, 0 - pos.y);
+	const int maxy = std::min(h + range, Map.Info.MapHeights[z] - pos.y);
+
+	for (int offsety = miny; offsety < maxy; ++offsety) {
+		// rows beside the unit are at distance 0, the others at their distance from its nearest row
+		const int distance = offsety < 0 ? -offsety : std::max(0, offsety - h + 1);
+		const int offsetx = spans[distance];
+		const int minx = std::max(0, pos.x - offsetx);
+		const int maxx = std::min(map_width, pos.x + w + offsetx);
+		Vec2i mpos(minx, pos.y + offsety);
+		const unsigned int index = mpos.y * map_width;
+
+		for (; mpos.x < maxx; ++mpos.x) {
+			if (shadows != NULL && IsSightBlocked(*shadows, pos, w, h, mpos)) {
+				continue;
+			}
+			marker(player, mpos, mpos.x + index, z);
+		}
+	}
+}
+//Wyrmgus end
+
 /**
 **  Mark the sight of unit. (Explore and make visible.)
 **
@@ -506,205 +785,146 @@ void MapUnmarkTileDetectEthereal(const CPlayer &player, const Vec2i &pos, int z)
 void MapSight(const CPlayer &player, const Vec2i &pos, int w, int h, int range, MapMarkerFunc *marker, int z)
 //Wyrmgus end
 {
+	//Wyrmgus start
+	PROFILE_SCOPE("MapSight");
+	//Wyrmgus end
+	
 	// Units under construction have no sight range.
 	if (!range) {
 		return;
 	}
 	
 	//Wyrmgus start
-	std::vector<unsigned long> obstacle_flags;
-	int max_obstacle_difference = 1; //how many tiles are seen after the obstacle; set to 1 here so that the obstacle tiles themselves don't have fog drawn over them
+	if (marker == MapMarkTileOwnership) {
+		MapSightSweep(player, pos, w, h, range, _OwnershipMarkerCall<MapMarkTileOwnership>(), NULL, z);
+		return;
+	} else if (marker == MapUnmarkTileOwnership) {
+		MapSightSweep(player, pos, w, h, range, _OwnershipMarkerCall<MapUnmarkTileOwnership>(), NULL, z);
+		return;
+	}
+	
+	// underground, tiles hidden by obstacles from all of the unit's tiles aren't seen
+	const CSightShadows *shadows = NULL;
 	
-	if (marker == MapMarkTileOwnership || marker == MapUnmarkTileOwnership) {
+	if (Map.IsLayerUnderground(z)) {
+		shadows = &GetSightShadows(range + std::max(w, h) - 1);
+		FindSightBlocked(*shadows, pos, w, h, z);
+	}
+	
+	if (marker == static_cast<MapMarkerFunc *>(MapMarkTileSight)) {
+		MapSightSweep(player, pos, w, h, range, _MarkerCall<MapMarkTileSight>(), shadows, z);
+	} else if (marker == static_cast<MapMarkerFunc *>(MapUnmarkTileSight)) {
+		MapSightSweep(player, pos, w, h, range, _MarkerCall<MapUnmarkTileSight>(), shadows, z);
+	} else if (marker == static_cast<MapMarkerFunc *>(MapMarkTileDetectCloak)) {
+		MapSightSweep(player, pos, w, h, range, _MarkerCall<MapMarkTileDetectCloak>(), shadows, z);
+	} else if (marker == static_cast<MapMarkerFunc *>(MapUnmarkTileDetectCloak)) {
+		MapSightSweep(player, pos, w, h, range, _MarkerCall<MapUnmarkTileDetectCloak>(), shadows, z);
+	} else if (marker == static_cast<MapMarkerFunc *>(MapMarkTileDetectEthereal)) {
+		MapSightSweep(player, pos, w, h, range, _MarkerCall<MapMarkTileDetectEthereal>(), shadows, z);
+	} else if (marker == static_cast<MapMarkerFunc *>(MapUnmarkTileDetectEthereal)) {
+		MapSightSweep(player, pos, w, h, range, _MarkerCall<MapUnmarkTileDetectEthereal>(), shadows, z);
 	} else {
-		if (Map.IsLayerUnderground(z)) {
-			obstacle_flags.push_back(MapFieldAirUnpassable);
-		}
+		MapSightSweep(player, pos, w, h, range, _MarkerFuncCall(marker), shadows, z);
 	}
 	//Wyrmgus end
-	
-	// Up hemi-cyle
-	const int miny = std::max(-range, 0 - pos.y);
-	
-	for (int offsety = miny; offsety != 0; ++offsety) {
-		const int offsetx = isqrt(square(range + 1) - square(-offsety) - 1);
-		const int minx = std::max(0, pos.x - offsetx);
-		//Wyrmgus start
-//		const int maxx = std::min(Map.Info.MapWidth, pos.x + w + offsetx);
-		const int maxx = std::min(Map.Info.MapWidths[z], pos.x + w + offsetx);
-		//Wyrmgus end
-		Vec2i mpos(minx, pos.y + offsety);
-#ifdef MARKER_ON_INDEX
-		//Wyrmgus start
-//		const unsigned int index = mpos.y * Map.Info.MapWidth;
-		const unsigned int index = mpos.y * Map.Info.MapWidths[z];
-		//Wyrmgus end
-#endif
+}
 
-		for (mpos.x = minx; mpos.x < maxx; ++mpos.x) {
-			//Wyrmgus start
-			bool obstacle_check = true;
-			for (size_t i = 0; i < obstacle_flags.size(); ++i) {
-				bool obstacle_subcheck = false;
-				for (int x = 0; x < w; ++x) {
-					for (int y = 0; y < h; ++y) {
-						if (CheckObstaclesBetweenTiles(pos + Vec2i(x, y), mpos, obstacle_flags[i], z, max_obstacle_difference)) { //the obstacle must be avoidable from at least one of the unit's tiles
-							obstacle_subcheck = true;
-							break;
-						}
-					}
-					if (obstacle_subcheck) {
-						break;
-					}
-				}
-				if (!obstacle_subcheck) {
-					obstacle_check = false;
-					break;
-				}
-			}
-			if (!obstacle_check) {
-				continue;
-			}
-			//Wyrmgus end
-#ifdef MARKER_ON_INDEX
-			//Wyrmgus start
-//			marker(player, mpos.x + index);
-			marker(player, mpos.x + index, z);
-			//Wyrmgus end
-#else
-			//Wyrmgus start
-//			marker(player, mpos);
-			marker(player, mpos, z);
-			//Wyrmgus end
-#endif
-			//Wyrmgus start
-			if (marker == MapMarkTileOwnership || marker == MapUnmarkTileOwnership) {
-				Map.CalculateTileOwnership(mpos, z);
+//Wyrmgus start
+/**
+**  Check whether an offset from the top-left tile of a unit is within the sight marked by MapSight.
+*/
+static bool IsInSight(int offset_x, int offset_y, int w, int h, int range)
+{
+	if (offset_y < -range || offset_y >= h + range) {
+		return false;
+	}
+	const int distance = offset_y < 0 ? -offset_y : std::max(0, offset_y - h + 1);
+	const int offsetx = GetSightSpans(range)[distance];
+	return offset_x >= -offsetx && offset_x < w + offsetx;
+}
+
+/**
+**  Get the tiles coming into and going out of sight when a unit moves by one tile, computing them the first time.
+*/
+static const SightDelta &GetSightDelta(int w, int h, int range, const Vec2i &dir)
+{
+	const std::tuple<int, int, int, int> key(range, w, h, (dir.y + 1) * 3 + dir.x + 1);
+	std::map<std::tuple<int, int, int, int>, SightDelta>::iterator it = SightDeltas.find(key);
+	if (it != SightDeltas.end()) {
+		return it->second;
+	}
+
+	SightDelta &delta = SightDeltas[key];
+	for (int y = -range - 1; y <= h + range; ++y) {
+		for (int x = -range - 1; x <= w + range; ++x) {
+			const bool new_sight = IsInSight(x, y, w, h, range);
+			const bool old_sight = IsInSight(x + dir.x, y + dir.y, w, h, range);
+			if (new_sight && !old_sight) {
+				delta.Entering.push_back(Vec2i(x, y));
+			} else if (old_sight && !new_sight) {
+				delta.Leaving.push_back(Vec2i(x, y));
 			}
-			//Wyrmgus end
 		}
 	}
-	for (int offsety = 0; offsety < h; ++offsety) {
-		const int minx = std::max(0, pos.x - range);
-		//Wyrmgus start
-//		const int maxx = std::min(Map.Info.MapWidth, pos.x + w + range);
-		const int maxx = std::min(Map.Info.MapWidths[z], pos.x + w + range);
-		//Wyrmgus end
-		Vec2i mpos(minx, pos.y + offsety);
-#ifdef MARKER_ON_INDEX
-		//Wyrmgus start
-//		const unsigned int index = mpos.y * Map.Info.MapWidth;
-		const unsigned int index = mpos.y * Map.Info.MapWidths[z];
-		//Wyrmgus end
-#endif
+	return delta;
+}
 
-		for (mpos.x = minx; mpos.x < maxx; ++mpos.x) {
-			//Wyrmgus start
-			bool obstacle_check = true;
-			for (size_t i = 0; i < obstacle_flags.size(); ++i) {
-				bool obstacle_subcheck = false;
-				for (int x = 0; x < w; ++x) {
-					for (int y = 0; y < h; ++y) {
-						if (CheckObstaclesBetweenTiles(pos + Vec2i(x, y), mpos, obstacle_flags[i], z, max_obstacle_difference)) { //the obstacle must be avoidable from at least one of the unit's tiles
-							obstacle_subcheck = true;
-							break;
-						}
-					}
-					if (obstacle_subcheck) {
-						break;
-					}
-				}
-				if (!obstacle_subcheck) {
-					obstacle_check = false;
-					break;
-				}
-			}
-			if (!obstacle_check) {
-				continue;
-			}
-			//Wyrmgus end
+/**
+**  Check whether the sight of a unit can be moved with MapSightMove.
+**
+**  That is the case for moves of one tile on a layer which isn't underground, since sight there doesn't depend on the terrain.
+*/
+bool CanMoveSight(const Vec2i &old_pos, int old_z, const Vec2i &pos, int z)
+{
+	return old_z == z && abs(pos.x - old_pos.x) <= 1 && abs(pos.y - old_pos.y) <= 1 && !Map.IsLayerUnderground(z);
+}
+
+/**
+**  Move the sight of a unit by one tile, only unmarking the tiles which go out of sight and marking the ones which come into it.
+**
+**  Gives the same result as unmarking the sight at the old position and marking it at the new one.
+**
+**  @param player    player to mark the sight for (not unit owner)
+**  @param old_pos   old location of the unit
+**  @param pos       new location of the unit
+**  @param w         width of the unit
+**  @param h         height of the unit
+**  @param range     Radius of the sight.
+**  @param unmarker  Function to unmark sight
+**  @param marker    Function to mark sight
+*/
+void MapSightMove(const CPlayer &player, const Vec2i &old_pos, const Vec2i &pos, int w, int h, int range, MapMarkerFunc *unmarker, MapMarkerFunc *marker, int z)
+{
+	PROFILE_SCOPE("MapSightMove");
+
+	if (!range) {
+		return;
+	}
+	
+	const SightDelta &delta = GetSightDelta(w, h, range, pos - old_pos);
+	
+	for (size_t i = 0; i < delta.Leaving.size(); ++i) {
+		const Vec2i mpos = pos + delta.Leaving[i];
+		if (Map.Info.IsPointOnMap(mpos, z)) {
 #ifdef MARKER_ON_INDEX
-			//Wyrmgus start
-//			marker(player, mpos.x + index);
-			marker(player, mpos.x + index, z);
-			//Wyrmgus end
+			unmarker(player, Map.getIndex(mpos, z), z);
 #else
-			//Wyrmgus start
-//			marker(player, mpos);
-			marker(player, mpos, z);
-			//Wyrmgus end
+			unmarker(player, mpos, z);
 #endif
-			//Wyrmgus start
-			if (marker == MapMarkTileOwnership || marker == MapUnmarkTileOwnership) {
-				Map.CalculateTileOwnership(mpos, z);
-			}
-			//Wyrmgus end
 		}
 	}
-	// bottom hemi-cycle
-	//Wyrmgus start
-//	const int maxy = std::min(range, Map.Info.MapHeight - pos.y - h);
-	const int maxy = std::min(range, Map.Info.MapHeights[z] - pos.y - h);
-	//Wyrmgus end
-	for (int offsety = 0; offsety < maxy; ++offsety) {
-		const int offsetx = isqrt(square(range + 1) - square(offsety + 1) - 1);
-		const int minx = std::max(0, pos.x - offsetx);
-		//Wyrmgus start
-//		const int maxx = std::min(Map.Info.MapWidth, pos.x + w + offsetx);
-		const int maxx = std::min(Map.Info.MapWidths[z], pos.x + w + offsetx);
-		//Wyrmgus end
-		Vec2i mpos(minx, pos.y + h + offsety);
-#ifdef MARKER_ON_INDEX
-		//Wyrmgus start
-//		const unsigned int index = mpos.y * Map.Info.MapWidth;
-		const unsigned int index = mpos.y * Map.Info.MapWidths[z];
-		//Wyrmgus end
-#endif
-
-		for (mpos.x = minx; mpos.x < maxx; ++mpos.x) {
-			//Wyrmgus start
-			bool obstacle_check = true;
-			for (size_t i = 0; i < obstacle_flags.size(); ++i) {
-				bool obstacle_subcheck = false;
-				for (int x = 0; x < w; ++x) {
-					for (int y = 0; y < h; ++y) {
-						if (CheckObstaclesBetweenTiles(pos + Vec2i(x, y), mpos, obstacle_flags[i], z, max_obstacle_difference)) { //the obstacle must be avoidable from at least one of the unit's tiles
-							obstacle_subcheck = true;
-							break;
-						}
-					}
-					if (obstacle_subcheck) {
-						break;
-					}
-				}
-				if (!obstacle_subcheck) {
-					obstacle_check = false;
-					break;
-				}
-			}
-			if (!obstacle_check) {
-				continue;
-			}
-			//Wyrmgus end
+	for (size_t i = 0; i < delta.Entering.size(); ++i) {
+		const Vec2i mpos = pos + delta.Entering[i];
+		if (Map.Info.IsPointOnMap(mpos, z)) {
 #ifdef MARKER_ON_INDEX
-			//Wyrmgus start
-//			marker(player, mpos.x + index);
-			marker(player, mpos.x + index, z);
-			//Wyrmgus end
+			marker(player, Map.getIndex(mpos, z), z);
 #else
-			//Wyrmgus start
-//			marker(player, mpos);
 			marker(player, mpos, z);
-			//Wyrmgus end
 #endif
-			//Wyrmgus start
-			if (marker == MapMarkTileOwnership || marker == MapUnmarkTileOwnership) {
-				Map.CalculateTileOwnership(mpos, z);
-			}
-			//Wyrmgus end
 		}
 	}
 }
+//Wyrmgus end
 
 /**
 **  Update fog of war.
@@ -1041,6 +1261,10 @@ static void DrawFogOfWarTile(int sx, int sy, int dx, int dy)
 */
 void CViewport::DrawMapFogOfWar() const
 {
+	//Wyrmgus start
+	PROFILE_SCOPE("CViewport::DrawMapFogOfWar");
+	//Wyrmgus end
+	
 	// flags must redraw or not
 	if (ReplayRevealMap) {
 		return;
@@ -1218,6 +1442,14 @@ void CMap::InitFogOfWar()
 void CMap::CleanFogOfWar()
 {
 	VisibleTable.clear();
+	//Wyrmgus start
+	for (size_t i = 0; i < SightShadows.size(); ++i) {
+		delete SightShadows[i];
+	}
+	SightShadows.clear();
+	SightDeltas.clear();
+	SightSpans.clear();
+	//Wyrmgus end
 
 	CGraphic::Free(Map.FogGraphic);
 	FogGraphic = NULL;
@@ -111,6 +111,38 @@ int CMapField::GetResource() const
 	
 	return -1;
 }
+
+/**
+**  Get how many times tile animations have advanced since the start of the game.
+**
+**  They advance at the same speed as color-cycling.
+*/
+static int GetTileAnimationTicks()
+{
+	return GameCycle / (CYCLES_PER_SECOND / 4);
+}
+
+/**
+**  Get the current frame of the tile's animation.
+*/
+int CMapField::GetAnimationFrame() const
+{
+	if (!this->Terrain || this->Terrain->SolidAnimationFrames <= 0) {
+		return 0;
+	}
+	return (this->AnimationFrame + GetTileAnimationTicks()) % this->Terrain->SolidAnimationFrames;
+}
+
+/**
+**  Get the current frame of the overlay tile's animation.
+*/
+int CMapField::GetOverlayAnimationFrame() const
+{
+	if (!this->OverlayTerrain || this->OverlayTerrain->SolidAnimationFrames <= 0) {
+		return 0;
+	}
+	return (this->OverlayAnimationFrame + GetTileAnimationTicks()) % this->OverlayTerrain->SolidAnimationFrames;
+}
 //Wyrmgus end
 
 //Wyrmgus start
@@ -165,10 +197,13 @@ void CMapField::SetTerrain(CTerrainType *terrain)
 	}
 	
 	if (Editor.Running == EditorNotRunning && terrain->SolidAnimationFrames > 0) {
+		// store the frame the animation would have had at the start of the game, so that it can be derived from the game cycle
+		const int frame = SyncRand(terrain->SolidAnimationFrames);
+		const int start_frame = (frame + terrain->SolidAnimationFrames - GetTileAnimationTicks() % terrain->SolidAnimationFrames) % terrain->SolidAnimationFrames;
 		if (terrain->Overlay) {
-			this->OverlayAnimationFrame = SyncRand(terrain->SolidAnimationFrames);
+			this->OverlayAnimationFrame = start_frame;
 		} else {
-			this->AnimationFrame = SyncRand(terrain->SolidAnimationFrames);
+			this->AnimationFrame = start_frame;
 		}
 	} else {
 		if (terrain->Overlay) {
@@ -482,6 +517,132 @@ void CMapField::Save(CFile &file) const
 }
 
 
+static int GetIdentIndex(std::map<std::string, int> &ident_indexes, const std::string &ident)
+{
+	std::map<std::string, int>::iterator it = ident_indexes.find(ident);
+	if (it != ident_indexes.end()) {
+		return it->second;
+	}
+	const int index = ident_indexes.size();
+	ident_indexes[ident] = index;
+	return index;
+}
+
+static void SaveTransitionTilesBinary(CBinaryWriter &writer, std::map<std::string, int> &ident_indexes, const std::vector<std::pair<CTerrainType *, short>> &transition_tiles)
+{
+	writer.WriteUnsigned(transition_tiles.size());
+	for (size_t i = 0; i != transition_tiles.size(); ++i) {
+		writer.WriteUnsigned(GetIdentIndex(ident_indexes, transition_tiles[i].first->Ident));
+		writer.WriteSigned(transition_tiles[i].second);
+	}
+}
+
+/**
+**  Save the map field in the packed binary format used by the "map-fields-data" section of save games.
+**
+**  Holds the same data as Save(), with the terrain identifiers replaced by indexes into a table shared by the whole map.
+**
+**  @param writer         Writer receiving the data.
+**  @param ident_indexes  Indexes of the identifiers in the table, new identifiers are added to it.
+*/
+void CMapField::SaveBinary(CBinaryWriter &writer, std::map<std::string, int> &ident_indexes) const
+{
+	writer.WriteUnsigned(GetIdentIndex(ident_indexes, (TerrainFeature && !TerrainFeature->TerrainType->Overlay) ? TerrainFeature->Ident : (Terrain ? Terrain->Ident : "")));
+	writer.WriteUnsigned(GetIdentIndex(ident_indexes, (TerrainFeature && TerrainFeature->TerrainType->Overlay) ? TerrainFeature->Ident : (OverlayTerrain ? OverlayTerrain->Ident : "")));
+	writer.WriteUnsigned(GetIdentIndex(ident_indexes, playerInfo.SeenTerrain ? playerInfo.SeenTerrain->Ident : ""));
+	writer.WriteUnsigned(GetIdentIndex(ident_indexes, playerInfo.SeenOverlayTerrain ? playerInfo.SeenOverlayTerrain->Ident : ""));
+	writer.WriteByte((OverlayTerrainDamaged ? 1 : 0) | (OverlayTerrainDestroyed ? 2 : 0));
+	writer.WriteSigned(SolidTile);
+	writer.WriteSigned(OverlaySolidTile);
+	writer.WriteSigned(playerInfo.SeenSolidTile);
+	writer.WriteSigned(playerInfo.SeenOverlaySolidTile);
+	writer.WriteSigned(Value);
+	writer.WriteUnsigned(cost);
+	writer.WriteSigned(Landmass);
+	writer.WriteSigned(Owner);
+	SaveTransitionTilesBinary(writer, ident_indexes, TransitionTiles);
+	SaveTransitionTilesBinary(writer, ident_indexes, OverlayTransitionTiles);
+	SaveTransitionTilesBinary(writer, ident_indexes, playerInfo.SeenTransitionTiles);
+	SaveTransitionTilesBinary(writer, ident_indexes, playerInfo.SeenOverlayTransitionTiles);
+
+	unsigned long long explored = 0;
+	for (int i = 0; i != PlayerMax; ++i) {
+		if (playerInfo.Visible[i] == 1) {
+			explored |= 1ULL << i;
+		}
+	}
+	writer.WriteUnsigned(explored);
+	writer.WriteUnsigned(Flags);
+}
+
+static CTerrainType *GetBinaryTerrain(CBinaryReader &reader, const std::vector<CTerrainType *> &terrains)
+{
+	const unsigned long long index = reader.ReadUnsigned();
+	return index < terrains.size() ? terrains[index] : NULL;
+}
+
+static void LoadTransitionTilesBinary(CBinaryReader &reader, const std::vector<CTerrainType *> &terrains, std::vector<std::pair<CTerrainType *, short>> &transition_tiles)
+{
+	const unsigned long long count = reader.ReadUnsigned();
+	for (unsigned long long i = 0; i < count && !reader.HasFailed(); ++i) {
+		CTerrainType *terrain = GetBinaryTerrain(reader, terrains);
+		const short tile_number = reader.ReadSigned();
+		transition_tiles.push_back(std::pair<CTerrainType *, short>(terrain, tile_number));
+	}
+}
+
+/**
+**  Load the map field from the packed binary format written by SaveBinary().
+**
+**  @param reader     Reader providing the data, its failure flag is set if the data is truncated.
+**  @param terrains   Terrain type of each identifier of the table, or null.
+**  @param features   Terrain feature of each identifier of the table, or null.
+*/
+void CMapField::LoadBinary(CBinaryReader &reader, const std::vector<CTerrainType *> &terrains, const std::vector<CTerrainFeature *> &features)
+{
+	const unsigned long long terrain_index = reader.ReadUnsigned();
+	if (terrain_index < features.size() && features[terrain_index]) {
+		this->Terrain = features[terrain_index]->TerrainType;
+		this->TerrainFeature = features[terrain_index];
+	} else {
+		this->Terrain = terrain_index < terrains.size() ? terrains[terrain_index] : NULL;
+	}
+
+	const unsigned long long overlay_terrain_index = reader.ReadUnsigned();
+	if (overlay_terrain_index < features.size() && features[overlay_terrain_index]) {
+		this->OverlayTerrain = features[overlay_terrain_index]->TerrainType;
+		this->TerrainFeature = features[overlay_terrain_index];
+	} else {
+		this->OverlayTerrain = overlay_terrain_index < terrains.size() ? terrains[overlay_terrain_index] : NULL;
+	}
+
+	this->playerInfo.SeenTerrain = GetBinaryTerrain(reader, terrains);
+	this->playerInfo.SeenOverlayTerrain = GetBinaryTerrain(reader, terrains);
+	const unsigned char overlay_state = reader.ReadByte();
+	this->SetOverlayTerrainDamaged((overlay_state & 1) != 0);
+	this->SetOverlayTerrainDestroyed((overlay_state & 2) != 0);
+	this->SolidTile = reader.ReadSigned();
+	this->OverlaySolidTile = reader.ReadSigned();
+	this->playerInfo.SeenSolidTile = reader.ReadSigned();
+	this->playerInfo.SeenOverlaySolidTile = reader.ReadSigned();
+	this->Value = reader.ReadSigned();
+	this->cost = reader.ReadUnsigned();
+	this->Landmass = reader.ReadSigned();
+	this->Owner = reader.ReadSigned();
+	LoadTransitionTilesBinary(reader, terrains, this->TransitionTiles);
+	LoadTransitionTilesBinary(reader, terrains, this->OverlayTransitionTiles);
+	LoadTransitionTilesBinary(reader, terrains, this->playerInfo.SeenTransitionTiles);
+	LoadTransitionTilesBinary(reader, terrains, this->playerInfo.SeenOverlayTransitionTiles);
+
+	const unsigned long long explored = reader.ReadUnsigned();
+	for (int i = 0; i != PlayerMax; ++i) {
+		if (explored & (1ULL << i)) {
+			this->playerInfo.Visible[i] = 1;
+		}
+	}
+	this->Flags = reader.ReadUnsigned();
+}
+
 void CMapField::parse(lua_State *l)
 {
 	if (!lua_istable(l, -1)) {
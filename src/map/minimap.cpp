@@ -43,6 +43,7 @@
 #include "map.h"
 #include "player.h"
 //Wyrmgus start
+#include "profile.h"
 #include "province.h"
 //Wyrmgus end
 //Wyrmgus start
@@ -919,6 +920,10 @@ static void DrawUnitOn(CUnit &unit, int red_phase)
 */
 void CMinimap::Update()
 {
+	//Wyrmgus start
+	PROFILE_SCOPE("CMinimap::Update");
+	//Wyrmgus end
+	
 	static int red_phase;
 
 	int red_phase_changed = red_phase != (int)((FrameCounter / FRAMES_PER_SECOND) & 1);
@@ -1116,6 +1121,10 @@ static void DrawEvents()
 */
 void CMinimap::Draw() const
 {
+	//Wyrmgus start
+	PROFILE_SCOPE("CMinimap::Draw");
+	//Wyrmgus end
+	
 #if defined(USE_OPENGL) || defined(USE_GLES)
 	if (UseOpenGL) {
 		//Wyrmgus start
@@ -254,6 +254,13 @@ static int CclStratagusMap(lua_State *l)
 					}
 					lua_pop(l, 1);
 					//Wyrmgus end
+				//Wyrmgus start
+				} else if (!strcmp(value, "map-fields-data")) {
+					std::vector<unsigned char> data;
+					if (!DecodeBase64(LuaToString(l, j + 1, k + 1), data) || !Map.LoadFieldsBinary(data)) {
+						LuaError(l, "incorrect argument for \"map-fields-data\"");
+					}
+				//Wyrmgus end
 				} else {
 					LuaError(l, "Unsupported tag: %s" _C_ value);
 				}
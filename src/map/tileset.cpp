@@ -200,7 +200,7 @@ PixelSize PixelTileSize(32, 32);
 
 //Wyrmgus start
 std::vector<CTerrainType *> TerrainTypes;
-std::map<std::string, int> TerrainTypeStringToIndex;
+std::unordered_map<std::string, int> TerrainTypeStringToIndex;
 std::map<std::string, int> TerrainTypeCharacterToIndex;
 std::map<std::tuple<int, int, int>, int> TerrainTypeColorToIndex;
 //Wyrmgus end
@@ -1025,14 +1025,15 @@ int GetTransitionTypeIdByName(std::string transition_type)
 /**
 **  Get a terrain type
 */
-CTerrainType *GetTerrainType(std::string terrain_ident)
+CTerrainType *GetTerrainType(const std::string &terrain_ident)
 {
 	if (terrain_ident.empty()) {
 		return NULL;
 	}
 	
-	if (TerrainTypeStringToIndex.find(terrain_ident) != TerrainTypeStringToIndex.end()) {
-		return TerrainTypes[TerrainTypeStringToIndex[terrain_ident]];
+	std::unordered_map<std::string, int>::const_iterator find_iterator = TerrainTypeStringToIndex.find(terrain_ident);
+	if (find_iterator != TerrainTypeStringToIndex.end()) {
+		return TerrainTypes[find_iterator->second];
 	}
 	
 	return NULL;
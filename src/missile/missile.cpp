@@ -48,6 +48,7 @@
 #include "map.h"
 #include "player.h"
 //Wyrmgus start
+#include "profile.h"
 #include "settings.h"
 //Wyrmgus end
 #include "sound.h"
@@ -111,6 +112,24 @@ int GetMissileSpritesCount()
 #endif
 }
 
+/**
+**  Get the graphic files of the missile sprites which have not been loaded yet.
+**
+**  @param files  Vector to which the files are added.
+*/
+void GetMissileSpriteFiles(std::vector<std::string> &files)
+{
+#ifndef DYNAMIC_LOAD
+	for (MissileTypeMap::iterator it = MissileTypes.begin(); it != MissileTypes.end(); ++it) {
+		const MissileType &mtype = *(*it).second;
+
+		if (mtype.G && !mtype.G->IsLoaded()) {
+			files.push_back(mtype.G->File);
+		}
+	}
+#endif
+}
+
 /**
 **  Load the graphics for all missiles types
 */
@@ -1779,6 +1798,10 @@ static void MissilesActionLoop(std::vector<Missile *> &missiles)
 */
 void MissileActions()
 {
+	//Wyrmgus start
+	PROFILE_SCOPE("MissileActions");
+	//Wyrmgus end
+	
 	MissilesActionLoop(GlobalMissiles);
 	MissilesActionLoop(LocalMissiles);
 }
@@ -37,6 +37,9 @@
 #include "stratagus.h"
 
 #include "map.h"
+//Wyrmgus start
+#include "profile.h"
+//Wyrmgus end
 #include "settings.h"
 #include "tileset.h"
 #include "unit.h"
@@ -44,7 +47,14 @@
 
 #include "pathfinder.h"
 
+#include "SDL.h"
+
 #include <stdio.h>
+//Wyrmgus start
+#include <algorithm>
+#include <functional>
+#include <queue>
+//Wyrmgus end
 
 /*----------------------------------------------------------------------------
 --  Declarations
@@ -55,12 +65,19 @@ struct Node {
 	short int CostToGoal;     /// Estimated cost to goal
 	char InGoal;        /// is this point in the goal
 	char Direction;     /// Direction for trace back
+	//Wyrmgus start
+	int OpenIndex;      /// Position in the open set heap plus one, 0 if not in the open set
+	//Wyrmgus end
 };
 
 struct Open {
 	Vec2i pos;
 	short int Costs; /// complete costs to goal
 	//Wyrmgus start
+	short int CostToGoal; /// estimated cost to goal, first tie-breaker
+	int Distance;         /// manhattan distance to goal, second tie-breaker
+	//Wyrmgus end
+	//Wyrmgus start
 //	unsigned short int O;     /// Offset into matrix
 	unsigned int O;     /// Offset into matrix
 	//Wyrmgus end
@@ -90,33 +107,19 @@ std::vector<int> Heading2O[9];//heading to offset
 //Wyrmgus end
 const int XY2Heading[3][3] = { {7, 6, 5}, {0, 0, 4}, {1, 2, 3}};
 
-/// cost matrix
-//Wyrmgus start
-//static Node *AStarMatrix;
-static std::vector<Node *> AStarMatrix;
-//Wyrmgus end
-
-/// a list of close nodes, helps to speed up the matrix cleaning
+#define MAX_CLOSE_SET_RATIO 4
 //Wyrmgus start
-//static int *CloseSet;
-//static int CloseSetSize;
-//static int Threshold;
-//static int OpenSetMaxSize;
-//static int AStarMatrixSize;
-static std::vector<int *> CloseSet;
-static std::vector<int> CloseSetSize;
-static std::vector<int> Threshold;
-static std::vector<int> OpenSetMaxSize;
-static std::vector<int> AStarMatrixSize;
+//#define MAX_OPEN_SET_RATIO 8 // 10,16 to small
 //Wyrmgus end
-#define MAX_CLOSE_SET_RATIO 4
-#define MAX_OPEN_SET_RATIO 8 // 10,16 to small
 
 /// see pathfinder.h
 int AStarFixedUnitCrossingCost;// = MaxMapWidth * MaxMapHeight;
 int AStarMovingUnitCrossingCost = 5;
 bool AStarKnowUnseenTerrain = false;
 int AStarUnknownTerrainCost = 2;
+//Wyrmgus start
+bool AStarHierarchical = true;
+//Wyrmgus end
 
 //Wyrmgus start
 //static int AStarMapWidth;
@@ -125,154 +128,242 @@ static std::vector<int> AStarMapWidth;
 static std::vector<int> AStarMapHeight;
 //Wyrmgus end
 
-static int AStarGoalX;
-static int AStarGoalY;
+static const int CacheNotSet = -5;
 
+//Wyrmgus start
 /**
-**  The Open set is handled by a stored array
-**  the end of the array holds the item with the smallest cost.
+**  The Open set is handled by a binary min-heap,
+**  the first element of the array holds the item with the smallest cost.
+**
+**  Each node of the matrix knows its position in the heap (Node::OpenIndex),
+**  so that finding a node and decreasing its key don't need a linear search.
+**  A tile is never present twice in the heap, so its size is bound by the map size.
 */
 
-/// The set of Open nodes
-//Wyrmgus start
-//static Open *OpenSet;
-static std::vector<Open *> OpenSet;
-//Wyrmgus end
-/// The size of the open node set
-//Wyrmgus start
-//static int OpenSetSize;
-static std::vector<int> OpenSetSize;
-//Wyrmgus end
+/**
+**  Working state of one path search.
+**
+**  The matrices are only allocated for a map layer the first time a search is done on it.
+**  A context is used by a single thread at a time, so several contexts allow
+**  paths to be computed in parallel.
+*/
+class AStarContext
+{
+public:
+	AStarContext();
+	~AStarContext();
+
+	void InitLayer(int z);
+
+	std::vector<Node *> Matrix;          /// cost matrix
+	std::vector<int> MatrixSize;         /// size of the cost matrix in bytes
+	std::vector<int *> CloseSet;         /// a list of close nodes, helps to speed up the matrix cleaning
+	std::vector<int> CloseSetSize;       /// the size of the close node set
+	std::vector<int> Threshold;          /// the maximum size of the close node set
+	std::vector<Open *> OpenSet;         /// the set of Open nodes
+	std::vector<int> OpenSetSize;        /// the size of the open node set
+	std::vector<int> OpenSetMaxSize;     /// the maximum size of the open node set
+	std::vector<int *> CostMoveToCache;  /// cache of the cost to move to each tile
+	Vec2i GoalPos;                       /// goal of the current search
+
+	std::vector<int> HPACost;            /// cost from the start to each node of the abstract graph
+	std::vector<int> HPALength;          /// number of steps from the start to each node of the abstract graph
+	std::vector<int> HPAParent;          /// node each node of the abstract graph was reached from
+	std::vector<unsigned int> HPAVisit;  /// abstract search in which each node was last reached
+	unsigned int HPASearch;              /// number of the current abstract search
+};
 
-//Wyrmgus start
-//static int *CostMoveToCache;
-static std::vector<int *> CostMoveToCache;
-//Wyrmgus end
-static const int CacheNotSet = -5;
+/// Every context created so far
+static std::vector<AStarContext *> AStarContexts;
+/// Contexts not borrowed by a search
+static std::vector<AStarContext *> AStarFreeContexts;
+/// Protects the context lists
+static SDL_mutex *AStarContextLock = NULL;
 
-/*----------------------------------------------------------------------------
---  Profile
-----------------------------------------------------------------------------*/
+/**
+**  Hierarchical path finding (HPA*).
+**
+**  Each map layer is cut into square clusters. Passable tiles on both
+**  sides of a cluster border form entrances, and the abstract graph links
+**  the entrances of the same cluster with the cost of the path between
+**  them. Long searches are first done on this graph, and only the part of
+**  the path up to the next few entrances is then searched tile by tile.
+**
+**  The graph only looks at the terrain, not at the moving units, and is
+**  built for each movement mask the first time it is needed. When the
+**  terrain changes, the clusters around it are rebuilt before the next search.
+**
+**  Unless AStarKnowUnseenTerrain is set, the tile by tile search treats the
+**  tiles a player hasn't explored as passable, so each player then gets its
+**  own graphs, rebuilt around the tiles whose exploration changes.
+*/
+#define HPA_CLUSTER_SIZE 16
+/// borders with more passable tiles in a row than this get an entrance at each end of the row
+#define HPA_LONG_ENTRANCE 6
+/// searches with a shorter distance than this don't use the abstract graph
+#define HPA_MIN_DISTANCE (HPA_CLUSTER_SIZE * 3)
+/// the tile by tile search goes to the furthest entrance which is at most this number of steps away
+#define HPA_WAYPOINT_LENGTH (HPA_CLUSTER_SIZE * 2)
+/// maximum number of nodes the tile by tile search to the waypoint may expand
+#define HPA_REFINE_MAX_LENGTH (HPA_CLUSTER_SIZE * HPA_CLUSTER_SIZE * 8)
+
+/// Path between two entrances of the same cluster
+struct HPAEdge {
+	int Node;    /// entrance the path leads to
+	int Cost;    /// cost of the path, as counted by the A* search
+	int Length;  /// number of steps of the path
+};
 
-#ifdef ASTAR_PROFILE
+/// Entrance of a cluster, the tile next to it in the neighbor cluster is another entrance
+struct HPANode {
+	Vec2i Pos;                   /// position of the tile
+	int Cluster;                 /// cluster of the tile
+	int Border;                  /// border the entrance is on, -1 if the node is unused
+	int Pair;                    /// entrance on the other side of the border
+	int PairCost;                /// cost of stepping to the other side of the border
+	std::vector<HPAEdge> Edges;  /// paths to the other entrances of the cluster
+};
 
-#include <map>
-#ifdef USE_WIN32
-#include <windows.h>
-#else
+struct HPACluster {
+	HPACluster() : Dirty(true) {}
 
-union LARGE_INTEGER {
-	uint64_t QuadPart;
-	uint32_t DoublePart[2];
-};
-inline int QueryPerformanceCounter(LARGE_INTEGER *ptr)
-{
-	unsigned int lo, hi;
-	__asm__ __volatile__(       // serialize
-		"xorl %%eax,%%eax \n        cpuid"
-		::: "%rax", "%rbx", "%rcx", "%rdx");
-	/* We cannot use "=A", since this would use %rax on x86_64 */
-	__asm__ __volatile__("rdtsc" : "=a"(lo), "=d"(hi));
-	ptr->DoublePart[0] = lo;
-	ptr->DoublePart[1] = hi;
-	return 1;
+	std::vector<int> Nodes;  /// entrances of the cluster, sorted by position
+	bool Dirty;              /// whether the terrain of the cluster has changed
 };
 
-inline int QueryPerformanceFrequency(LARGE_INTEGER *ptr)
+/// Abstract graph of a map layer for a movement mask
+class HPAGraph
 {
-	ptr->QuadPart = 1000;
-	return 1;
-}
+public:
+	HPAGraph(int mask, bool allow_diagonal, int player, int z);
 
-#endif
+	void Update();
+	void Search(int cluster, const Vec2i &from, int *costs, int *lengths) const;
+	void GetClusterArea(int cluster, Vec2i &pos, Vec2i &size) const;
+	int GetCluster(const Vec2i &pos) const { return (pos.y / HPA_CLUSTER_SIZE) * this->Width + pos.x / HPA_CLUSTER_SIZE; }
+	bool IsPassable(const Vec2i &pos) const;
+	int GetStepCost(const Vec2i &pos) const;
 
-#undef max
-#undef min
-static std::map<const char *const, LARGE_INTEGER> functionTimerMap;
-struct ProfileData {
-	unsigned long Calls;
-	unsigned long TotalTime;
+private:
+	bool IsExplored(const CMapField &mf) const;
+
+	int NewNode(const Vec2i &pos, int cluster, int border);
+	void AddEntrance(const Vec2i &pos, const Vec2i &step, int cluster, int neighbor, int border);
+	void RemoveBorder(int border);
+	void BuildBorder(int border);
+	void BuildEdges(int cluster);
+
+public:
+	int MovementMask;                  /// movement mask the graph is made for
+	bool AllowDiagonal;                /// whether diagonal moves are allowed
+	int Player;                        /// player whose explored terrain the graph is made for, -1 if it knows all the terrain
+	int MapLayer;                      /// map layer of the graph
+	int Width;                         /// number of clusters in a row
+	int Height;                        /// number of clusters in a column
+	std::vector<HPACluster> Clusters;
+	std::vector<HPANode> Nodes;
+	std::vector<int> FreeNodes;        /// unused nodes, to be reused
+	bool Dirty;                        /// whether any cluster is dirty
 };
-static std::map<const char *const, ProfileData> functionProfiles;
 
-inline void ProfileInit()
+/// Abstract graphs of each map layer
+static std::vector<std::vector<HPAGraph *> > HPAGraphs;
+/// Protects the abstract graphs while they are created or updated
+static SDL_mutex *HPALock = NULL;
+//Wyrmgus end
+
+/*----------------------------------------------------------------------------
+--  Functions
+----------------------------------------------------------------------------*/
+
+//Wyrmgus start
+static void CostMoveToCacheCleanUp(AStarContext &ctx, int z);
+
+AStarContext::AStarContext() :
+	Matrix(AStarMapWidth.size(), (Node *) NULL), MatrixSize(AStarMapWidth.size(), 0),
+	CloseSet(AStarMapWidth.size(), (int *) NULL), CloseSetSize(AStarMapWidth.size(), 0), Threshold(AStarMapWidth.size(), 0),
+	OpenSet(AStarMapWidth.size(), (Open *) NULL), OpenSetSize(AStarMapWidth.size(), 0), OpenSetMaxSize(AStarMapWidth.size(), 0),
+	CostMoveToCache(AStarMapWidth.size(), (int *) NULL), HPASearch(0)
 {
-	functionTimerMap.clear();
-	functionProfiles.clear();
 }
 
-inline void ProfileBegin(const char *const function)
+AStarContext::~AStarContext()
 {
-	LARGE_INTEGER counter;
-	if (!QueryPerformanceCounter(&counter)) {
-		return;
+	for (size_t z = 0; z < this->Matrix.size(); ++z) {
+		delete[] this->Matrix[z];
+		delete[] this->CloseSet[z];
+		delete[] this->OpenSet[z];
+		delete[] this->CostMoveToCache[z];
 	}
-	functionTimerMap[function] = counter;
 }
 
-inline void ProfileEnd(const char *const function)
+/**
+**  Allocate the matrices of a map layer, if not yet done.
+*/
+void AStarContext::InitLayer(int z)
 {
-	LARGE_INTEGER counter;
-	if (!QueryPerformanceCounter(&counter)) {
+	if (this->Matrix[z] != NULL) {
 		return;
 	}
-	unsigned long time = (unsigned long)(counter.QuadPart - functionTimerMap[function].QuadPart);
-	ProfileData *data = &functionProfiles[function];
-	data->Calls++;
-	data->TotalTime += time;
-}
 
-static bool compProfileData(const ProfileData *lhs, const ProfileData *rhs)
-{
-	return (lhs->TotalTime > rhs->TotalTime);
-}
+	const int size = AStarMapWidth[z] * AStarMapHeight[z];
 
+	this->MatrixSize[z] = sizeof(Node) * size;
+	this->Matrix[z] = new Node[size];
+	memset(this->Matrix[z], 0, this->MatrixSize[z]);
 
-inline void ProfilePrint()
-{
-	LARGE_INTEGER frequency;
-	if (!QueryPerformanceFrequency(&frequency)) {
-		return;
-	}
-	std::vector<ProfileData *> prof;
-	for (std::map<const char *const, ProfileData>::iterator i = functionProfiles.begin();
-		 i != functionProfiles.end(); ++i) {
-		ProfileData *data = &i->second;
-		prof.insert(std::upper_bound(prof.begin(), prof.end(), data, compProfileData), data);
-	}
-
-	FILE *fd = fopen("profile.txt", "wb");
-	fprintf(fd, "    total\t    calls\t      per\tname\n");
-
-	for (std::vector<ProfileData *>::iterator i = prof.begin(); i != prof.end(); ++i) {
-		ProfileData *data = (*i);
-		fprintf(fd, "%9.3f\t%9lu\t%9.3f\t",
-				(double)data->TotalTime / frequency.QuadPart * 1000.0,
-				data->Calls,
-				(double)data->TotalTime / frequency.QuadPart * 1000.0 / data->Calls);
-		for (std::map<const char *const, ProfileData>::iterator j =
-				 functionProfiles.begin(); j != functionProfiles.end(); ++j) {
-			ProfileData *data2 = &j->second;
-			if (data == data2) {
-				fprintf(fd, "%s\n", j->first);
-			}
-		}
+	this->Threshold[z] = size / MAX_CLOSE_SET_RATIO;
+	this->CloseSet[z] = new int[this->Threshold[z]];
+	this->CloseSetSize[z] = 0;
+
+	this->OpenSetMaxSize[z] = size;
+	this->OpenSet[z] = new Open[this->OpenSetMaxSize[z]];
+	this->OpenSetSize[z] = 0;
+
+	this->CostMoveToCache[z] = new int[size];
+	CostMoveToCacheCleanUp(*this, z);
+}
 
+/**
+**  Borrow a context from the pool, creating a new one if all of them are in use.
+*/
+static AStarContext &AStarBorrowContext()
+{
+	SDL_LockMutex(AStarContextLock);
+	AStarContext *ctx;
+	if (AStarFreeContexts.empty()) {
+		ctx = new AStarContext;
+		AStarContexts.push_back(ctx);
+	} else {
+		ctx = AStarFreeContexts.back();
+		AStarFreeContexts.pop_back();
 	}
+	SDL_UnlockMutex(AStarContextLock);
+	return *ctx;
+}
 
-	fclose(fd);
+/**
+**  Give a context back to the pool.
+*/
+static void AStarReturnContext(AStarContext &ctx)
+{
+	SDL_LockMutex(AStarContextLock);
+	AStarFreeContexts.push_back(&ctx);
+	SDL_UnlockMutex(AStarContextLock);
 }
 
-#else
-#define ProfileInit()
-#define ProfileBegin(f)
-#define ProfileEnd(f)
-#define ProfilePrint()
-#endif
+/**
+**  Borrows a context for the lifetime of the object.
+*/
+class AStarContextGuard
+{
+public:
+	AStarContextGuard() : ctx(AStarBorrowContext()) {}
+	~AStarContextGuard() { AStarReturnContext(ctx); }
 
-/*----------------------------------------------------------------------------
---  Functions
-----------------------------------------------------------------------------*/
+	AStarContext &ctx;
+};
+//Wyrmgus end
 
 /**
 **  Init A* data structures
@@ -307,34 +398,29 @@ void InitAStar()
 	}
 	*/
 
+	// Should only be called once
+	Assert(AStarContexts.empty());
+
 	for (size_t z = 0; z < Map.Fields.size(); ++z) {
-		// Should only be called once
-		Assert(AStarMatrix.size() <= z);
-	
 		AStarMapWidth.push_back(Map.Info.MapWidths[z]);
 		AStarMapHeight.push_back(Map.Info.MapHeights[z]);
-		
-		AStarMatrixSize.push_back(sizeof(Node) * AStarMapWidth[z] * AStarMapHeight[z]);
-		AStarMatrix.push_back(new Node[AStarMapWidth[z] * AStarMapHeight[z]]);
-		memset(AStarMatrix[z], 0, AStarMatrixSize[z]);
-
-		Threshold.push_back(AStarMapWidth[z] * AStarMapHeight[z] / MAX_CLOSE_SET_RATIO);
-		CloseSet.push_back(new int[Threshold[z]]);
-		CloseSetSize.push_back(0);
-
-		OpenSetMaxSize.push_back(AStarMapWidth[z] * AStarMapHeight[z] / MAX_OPEN_SET_RATIO);
-		OpenSet.push_back(new Open[OpenSetMaxSize[z]]);
-		OpenSetSize.push_back(0);
-
-		CostMoveToCache.push_back(new int[AStarMapWidth[z] * AStarMapHeight[z]]);
 
 		for (int i = 0; i < 9; ++i) {
 			Heading2O[i].push_back(Heading2Y[i] * AStarMapWidth[z]);
 		}
 	}
-	//Wyrmgus end
 
-	ProfileInit();
+	if (AStarContextLock == NULL) {
+		AStarContextLock = SDL_CreateMutex();
+	}
+	if (HPALock == NULL) {
+		HPALock = SDL_CreateMutex();
+	}
+	HPAGraphs.resize(Map.Fields.size());
+
+	// the context of the game thread is always needed, so create it right away
+	AStarReturnContext(AStarBorrowContext());
+	//Wyrmgus end
 }
 
 /**
@@ -342,10 +428,6 @@ void InitAStar()
 */
 void FreeAStar()
 {
-	//Wyrmgus start
-	AStarMapWidth.clear();
-	AStarMapHeight.clear();
-	//Wyrmgus end
 	//Wyrmgus start
 	/*
 	delete[] AStarMatrix;
@@ -359,38 +441,29 @@ void FreeAStar()
 	delete[] CostMoveToCache;
 	CostMoveToCache = NULL;
 	*/
-	for (size_t z = 0; z < AStarMatrix.size(); ++z) {
-		delete[] AStarMatrix[z];
-		AStarMatrix[z] = NULL;
-	}
-	AStarMatrix.clear();
-	AStarMatrixSize.clear();
-	Threshold.clear();
-	for (size_t z = 0; z < CloseSet.size(); ++z) {
-		delete[] CloseSet[z];
-		CloseSet[z] = NULL;
-	}
-	CloseSet.clear();
-	CloseSetSize.clear();
-	for (size_t z = 0; z < OpenSet.size(); ++z) {
-		delete[] OpenSet[z];
-		OpenSet[z] = NULL;
-	}
-	OpenSet.clear();
-	OpenSetSize.clear();
-	OpenSetMaxSize.clear();
-	for (size_t z = 0; z < CostMoveToCache.size(); ++z) {
-		delete[] CostMoveToCache[z];
-		CostMoveToCache[z] = NULL;
-	}
-	CostMoveToCache.clear();
-	
+	// no search may be running while the pathfinder is freed
+	Assert(AStarFreeContexts.size() == AStarContexts.size());
+
+	for (size_t i = 0; i < AStarContexts.size(); ++i) {
+		delete AStarContexts[i];
+	}
+	AStarContexts.clear();
+	AStarFreeContexts.clear();
+
+	for (size_t z = 0; z < HPAGraphs.size(); ++z) {
+		for (size_t i = 0; i < HPAGraphs[z].size(); ++i) {
+			delete HPAGraphs[z][i];
+		}
+	}
+	HPAGraphs.clear();
+
+	AStarMapWidth.clear();
+	AStarMapHeight.clear();
+
 	for (int i = 0; i < 9; ++i) {
 		Heading2O[i].clear();
 	}
 	//Wyrmgus end
-
-	ProfilePrint();
 }
 
 /**
@@ -398,12 +471,12 @@ void FreeAStar()
 */
 //Wyrmgus start
 //static void AStarPrepare()
-static void AStarPrepare(int z)
+static void AStarPrepare(AStarContext &ctx, int z)
 //Wyrmgus end
 {
 	//Wyrmgus start
 //	memset(AStarMatrix, 0, AStarMatrixSize);
-	memset(AStarMatrix[z], 0, AStarMatrixSize[z]);
+	memset(ctx.Matrix[z], 0, ctx.MatrixSize[z]);
 	//Wyrmgus end
 }
 
@@ -412,38 +485,38 @@ static void AStarPrepare(int z)
 */
 //Wyrmgus start
 //static void AStarCleanUp()
-static void AStarCleanUp(int z)
+static void AStarCleanUp(AStarContext &ctx, int z)
 //Wyrmgus end
 {
-	ProfileBegin("AStarCleanUp");
+	PROFILE_SCOPE("AStarCleanUp");
 
 	//Wyrmgus start
 //	if (CloseSetSize >= Threshold) {
-	if (CloseSetSize[z] >= Threshold[z]) {
+	if (ctx.CloseSetSize[z] >= ctx.Threshold[z]) {
 	//Wyrmgus end
 		//Wyrmgus start
 //		AStarPrepare();
-		AStarPrepare(z);
+		AStarPrepare(ctx, z);
 		//Wyrmgus end
 	} else {
-		for (int i = 0; i < CloseSetSize[z]; ++i) {
+		for (int i = 0; i < ctx.CloseSetSize[z]; ++i) {
 			//Wyrmgus start
 //			AStarMatrix[CloseSet[i]].CostFromStart = 0;
 //			AStarMatrix[CloseSet[i]].InGoal = 0;
-			AStarMatrix[z][CloseSet[z][i]].CostFromStart = 0;
-			AStarMatrix[z][CloseSet[z][i]].InGoal = 0;
+			ctx.Matrix[z][ctx.CloseSet[z][i]].CostFromStart = 0;
+			ctx.Matrix[z][ctx.CloseSet[z][i]].InGoal = 0;
+			ctx.Matrix[z][ctx.CloseSet[z][i]].OpenIndex = 0;
 			//Wyrmgus end
 		}
 	}
-	ProfileEnd("AStarCleanUp");
 }
 
 //Wyrmgus start
 //static void CostMoveToCacheCleanUp()
-static void CostMoveToCacheCleanUp(int z)
+static void CostMoveToCacheCleanUp(AStarContext &ctx, int z)
 //Wyrmgus end
 {
-	ProfileBegin("CostMoveToCacheCleanUp");
+	PROFILE_SCOPE("CostMoveToCacheCleanUp");
 	//Wyrmgus start
 //	int AStarMapMax =  AStarMapWidth * AStarMapHeight;
 	int AStarMapMax =  AStarMapWidth[z] * AStarMapHeight[z];
@@ -451,7 +524,7 @@ static void CostMoveToCacheCleanUp(int z)
 #if 1
 	//Wyrmgus start
 //	int *ptr = CostMoveToCache;
-	int *ptr = CostMoveToCache[z];
+	int *ptr = ctx.CostMoveToCache[z];
 	//Wyrmgus end
 #ifdef __x86_64__
 	union {
@@ -487,11 +560,10 @@ static void CostMoveToCacheCleanUp(int z)
 	for (int i = 0; i < AStarMapMax; ++i) {
 		//Wyrmgus start
 //		CostMoveToCache[i] = CacheNotSet;
-		CostMoveToCache[z][i] = CacheNotSet;
+		ctx.CostMoveToCache[z][i] = CacheNotSet;
 		//Wyrmgus end
 	}
 #endif
-	ProfileEnd("CostMoveToCacheCleanUp");
 }
 
 /**
@@ -500,7 +572,84 @@ static void CostMoveToCacheCleanUp(int z)
 */
 //Wyrmgus start
 //#define AStarFindMinimum() (OpenSetSize - 1)
-#define AStarFindMinimum(z) (OpenSetSize[(z)] - 1)
+#define AStarFindMinimum(z) (0)
+//Wyrmgus end
+
+//Wyrmgus start
+/**
+**  Compare two nodes of the open set
+**
+**  Nodes are ordered by their complete costs, then by the estimated cost to the goal,
+**  then by their distance to the goal. The matrix offset is used as a last resort,
+**  so that the order of extraction never depends on the order of insertion.
+**
+**  @return  true if lhs must be extracted before rhs
+*/
+static inline bool AStarOpenLess(const Open &lhs, const Open &rhs)
+{
+	if (lhs.Costs != rhs.Costs) {
+		return lhs.Costs < rhs.Costs;
+	}
+	if (lhs.CostToGoal != rhs.CostToGoal) {
+		return lhs.CostToGoal < rhs.CostToGoal;
+	}
+	if (lhs.Distance != rhs.Distance) {
+		return lhs.Distance < rhs.Distance;
+	}
+	return lhs.O < rhs.O;
+}
+
+/**
+**  Place an open set element at the given heap position and update its handle
+*/
+static inline void AStarHeapSet(AStarContext &ctx, int pos, const Open &open, int z)
+{
+	ctx.OpenSet[z][pos] = open;
+	ctx.Matrix[z][open.O].OpenIndex = pos + 1;
+}
+
+/**
+**  Move the element at the given heap position towards the root until the heap is valid
+*/
+static void AStarHeapSiftUp(AStarContext &ctx, int pos, int z)
+{
+	const Open open = ctx.OpenSet[z][pos];
+
+	while (pos > 0) {
+		const int parent = (pos - 1) >> 1;
+		if (!AStarOpenLess(open, ctx.OpenSet[z][parent])) {
+			break;
+		}
+		AStarHeapSet(ctx, pos, ctx.OpenSet[z][parent], z);
+		pos = parent;
+	}
+	AStarHeapSet(ctx, pos, open, z);
+}
+
+/**
+**  Move the element at the given heap position towards the leaves until the heap is valid
+*/
+static void AStarHeapSiftDown(AStarContext &ctx, int pos, int z)
+{
+	const Open open = ctx.OpenSet[z][pos];
+	const int size = ctx.OpenSetSize[z];
+
+	while (true) {
+		int child = (pos << 1) + 1;
+		if (child >= size) {
+			break;
+		}
+		if (child + 1 < size && AStarOpenLess(ctx.OpenSet[z][child + 1], ctx.OpenSet[z][child])) {
+			++child;
+		}
+		if (!AStarOpenLess(ctx.OpenSet[z][child], open)) {
+			break;
+		}
+		AStarHeapSet(ctx, pos, ctx.OpenSet[z][child], z);
+		pos = child;
+	}
+	AStarHeapSet(ctx, pos, open, z);
+}
 //Wyrmgus end
 
 /**
@@ -508,17 +657,21 @@ static void CostMoveToCacheCleanUp(int z)
 */
 //Wyrmgus start
 //static void AStarRemoveMinimum(int pos)
-static void AStarRemoveMinimum(int pos, int z)
+static void AStarRemoveMinimum(AStarContext &ctx, int pos, int z)
 //Wyrmgus end
 {
 	//Wyrmgus start
 //	Assert(pos == OpenSetSize - 1);
-	Assert(pos == OpenSetSize[z] - 1);
-	//Wyrmgus end
-
-	//Wyrmgus start
+//
 //	OpenSetSize--;
-	OpenSetSize[z]--;
+	Assert(pos == 0 && ctx.OpenSetSize[z] > 0);
+
+	ctx.Matrix[z][ctx.OpenSet[z][0].O].OpenIndex = 0;
+	ctx.OpenSetSize[z]--;
+	if (ctx.OpenSetSize[z] > 0) {
+		ctx.OpenSet[z][0] = ctx.OpenSet[z][ctx.OpenSetSize[z]];
+		AStarHeapSiftDown(ctx, 0, z);
+	}
 	//Wyrmgus end
 }
 
@@ -529,130 +682,57 @@ static void AStarRemoveMinimum(int pos, int z)
 */
 //Wyrmgus start
 //static inline int AStarAddNode(const Vec2i &pos, int o, int costs)
-static inline int AStarAddNode(const Vec2i &pos, int o, int costs, int z)
+static inline int AStarAddNode(AStarContext &ctx, const Vec2i &pos, int o, int costs, int z)
 //Wyrmgus end
 {
-	ProfileBegin("AStarAddNode");
-
-	//Wyrmgus start
-//	int bigi = 0, smalli = OpenSetSize;
-	int bigi = 0, smalli = OpenSetSize[z];
-	//Wyrmgus end
-	int midcost;
-	int midi;
-	int midCostToGoal;
-	int midDist;
-	const Open *open;
-
 	//Wyrmgus start
 //	if (OpenSetSize + 1 >= OpenSetMaxSize) {
-	if (OpenSetSize[z] + 1 >= OpenSetMaxSize[z]) {
+	if (ctx.OpenSetSize[z] + 1 > ctx.OpenSetMaxSize[z]) {
 	//Wyrmgus end
 		fprintf(stderr, "A* internal error: raise Open Set Max Size "
 				//Wyrmgus start
 //				"(current value %d)\n", OpenSetMaxSize);
-				"(current value %d)\n", OpenSetMaxSize[z]);
+				"(current value %d)\n", ctx.OpenSetMaxSize[z]);
 				//Wyrmgus end
-		ProfileEnd("AStarAddNode");
 		return PF_FAILED;
 	}
 
 	//Wyrmgus start
-//	const int costToGoal = AStarMatrix[o].CostToGoal;
-	const int costToGoal = AStarMatrix[z][o].CostToGoal;
-	//Wyrmgus end
-	const int dist = MyAbs(pos.x - AStarGoalX) + MyAbs(pos.y - AStarGoalY);
+	Assert(ctx.Matrix[z][o].OpenIndex == 0);
 
-	// find where we should insert this node.
-	// binary search where to insert the new node
-	while (bigi < smalli) {
-		midi = (smalli + bigi) >> 1;
-		//Wyrmgus start
-//		open = &OpenSet[midi];
-		open = &OpenSet[z][midi];
-		//Wyrmgus end
-		midcost = open->Costs;
-		//Wyrmgus start
-//		midCostToGoal = AStarMatrix[open->O].CostToGoal;
-		midCostToGoal = AStarMatrix[z][open->O].CostToGoal;
-		//Wyrmgus end
-		midDist = MyAbs(open->pos.x - AStarGoalX) + MyAbs(open->pos.y - AStarGoalY);
-		if (costs > midcost || (costs == midcost
-								&& (costToGoal > midCostToGoal || (costToGoal == midCostToGoal
-																   && dist > midDist)))) {
-			smalli = midi;
-		} else if (costs < midcost || (costs == midcost
-									   && (costToGoal < midCostToGoal || (costToGoal == midCostToGoal
-											   && dist < midDist)))) {
-			if (bigi == midi) {
-				bigi++;
-			} else {
-				bigi = midi;
-			}
-		} else {
-			bigi = midi;
-			smalli = midi;
-		}
-	}
+	Open &open = ctx.OpenSet[z][ctx.OpenSetSize[z]];
+	open.pos = pos;
+	open.O = o;
+	open.Costs = costs;
+	open.CostToGoal = ctx.Matrix[z][o].CostToGoal;
+	open.Distance = MyAbs(pos.x - ctx.GoalPos.x) + MyAbs(pos.y - ctx.GoalPos.y);
+	++ctx.OpenSetSize[z];
 
-	//Wyrmgus start
-//	if (OpenSetSize > bigi) {
-	if (OpenSetSize[z] > bigi) {
+	AStarHeapSiftUp(ctx, ctx.OpenSetSize[z] - 1, z);
 	//Wyrmgus end
-		// free a the slot for our node
-		//Wyrmgus start
-//		memmove(&OpenSet[bigi + 1], &OpenSet[bigi], (OpenSetSize - bigi) * sizeof(Open));
-		memmove(&OpenSet[z][bigi + 1], &OpenSet[z][bigi], (OpenSetSize[z] - bigi) * sizeof(Open));
-		//Wyrmgus end
-	}
-
-	// fill our new node
-	//Wyrmgus start
-//	OpenSet[bigi].pos = pos;
-//	OpenSet[bigi].O = o;
-//	OpenSet[bigi].Costs = costs;
-//	++OpenSetSize;
-	OpenSet[z][bigi].pos = pos;
-	OpenSet[z][bigi].O = o;
-	OpenSet[z][bigi].Costs = costs;
-	++OpenSetSize[z];
-	//Wyrmgus end
-
-	ProfileEnd("AStarAddNode");
 
 	return 0;
 }
 
 /**
 **  Change the cost associated to an open node.
-**  Can be further optimised knowing that the new cost MUST BE LOWER
-**  than the old one.
+**  The new cost MUST BE LOWER than the old one.
 */
 //Wyrmgus start
 //static void AStarReplaceNode(int pos)
-static void AStarReplaceNode(int pos, int z)
+static void AStarReplaceNode(AStarContext &ctx, int pos, int costs, int z)
 //Wyrmgus end
 {
-	ProfileBegin("AStarReplaceNode");
-
-	Open node;
-
-	// Remove the outdated node
 	//Wyrmgus start
-//	node = OpenSet[pos];
-//	OpenSetSize--;
-//	memmove(&OpenSet[pos], &OpenSet[pos+1], sizeof(Open) * (OpenSetSize-pos));
-	node = OpenSet[z][pos];
-	OpenSetSize[z]--;
-	memmove(&OpenSet[z][pos], &OpenSet[z][pos+1], sizeof(Open) * (OpenSetSize[z]-pos));
-	//Wyrmgus end
+	Open &open = ctx.OpenSet[z][pos];
 
-	// Re-add the node with the new cost
-	//Wyrmgus start
-//	AStarAddNode(node.pos, node.O, node.Costs);
-	AStarAddNode(node.pos, node.O, node.Costs, z);
+	Assert(costs <= open.Costs);
+	open.Costs = costs;
+	open.CostToGoal = ctx.Matrix[z][open.O].CostToGoal;
+
+	// decreasing the key can only move the node towards the root
+	AStarHeapSiftUp(ctx, pos, z);
 	//Wyrmgus end
-	ProfileEnd("AStarReplaceNode");
 }
 
 
@@ -663,25 +743,13 @@ static void AStarReplaceNode(int pos, int z)
 */
 //Wyrmgus start
 //static int AStarFindNode(int eo)
-static int AStarFindNode(int eo, int z)
+static int AStarFindNode(AStarContext &ctx, int eo, int z)
 //Wyrmgus end
 {
-	ProfileBegin("AStarFindNode");
-
 	//Wyrmgus start
-//	for (int i = 0; i < OpenSetSize; ++i) {
-	for (int i = 0; i < OpenSetSize[z]; ++i) {
+	const int i = ctx.Matrix[z][eo].OpenIndex - 1;
 	//Wyrmgus end
-		//Wyrmgus start
-//		if (OpenSet[i].O == eo) {
-		if (OpenSet[z][i].O == eo) {
-		//Wyrmgus end
-			ProfileEnd("AStarFindNode");
-			return i;
-		}
-	}
-	ProfileEnd("AStarFindNode");
-	return -1;
+	return i;
 }
 
 /**
@@ -689,16 +757,16 @@ static int AStarFindNode(int eo, int z)
 */
 //Wyrmgus start
 //static void AStarAddToClose(int node)
-static void AStarAddToClose(int node, int z)
+static void AStarAddToClose(AStarContext &ctx, int node, int z)
 //Wyrmgus end
 {
 	//Wyrmgus start
 //	if (CloseSetSize < Threshold) {
-	if (CloseSetSize[z] < Threshold[z]) {
+	if (ctx.CloseSetSize[z] < ctx.Threshold[z]) {
 	//Wyrmgus end
 		//Wyrmgus start
 //		CloseSet[CloseSetSize++] = node;
-		CloseSet[z][CloseSetSize[z]++] = node;
+		ctx.CloseSet[z][ctx.CloseSetSize[z]++] = node;
 		//Wyrmgus end
 	}
 }
@@ -829,7 +897,7 @@ static int CostMoveToCallBack_Default(unsigned int index, const CUnit &unit, int
 */
 //Wyrmgus start
 //static inline int CostMoveTo(unsigned int index, const CUnit &unit)
-static inline int CostMoveTo(unsigned int index, const CUnit &unit, int z)
+static inline int CostMoveTo(AStarContext &ctx, unsigned int index, const CUnit &unit, int z)
 //Wyrmgus end
 {
 	//Wyrmgus start
@@ -840,7 +908,7 @@ static inline int CostMoveTo(unsigned int index, const CUnit &unit, int z)
 	//Wyrmgus end
 	//Wyrmgus start
 //	int *c = &CostMoveToCache[index];
-	int *c = &CostMoveToCache[z][index];
+	int *c = &ctx.CostMoveToCache[z][index];
 	//Wyrmgus end
 	if (*c != CacheNotSet) {
 		return *c;
@@ -855,8 +923,12 @@ static inline int CostMoveTo(unsigned int index, const CUnit &unit, int z)
 class AStarGoalMarker
 {
 public:
-	AStarGoalMarker(const CUnit &unit, bool *goal_reachable) :
-		unit(unit), goal_reachable(goal_reachable)
+	//Wyrmgus start
+//	AStarGoalMarker(const CUnit &unit, bool *goal_reachable) :
+//		unit(unit), goal_reachable(goal_reachable)
+	AStarGoalMarker(AStarContext &ctx, const CUnit &unit, bool *goal_reachable) :
+		ctx(ctx), unit(unit), goal_reachable(goal_reachable)
+	//Wyrmgus end
 	{}
 
 	//Wyrmgus start
@@ -866,20 +938,23 @@ public:
 	{
 		//Wyrmgus start
 //		if (CostMoveTo(offset, unit) >= 0) {
-		if (CostMoveTo(offset, unit, z) >= 0) {
+		if (CostMoveTo(ctx, offset, unit, z) >= 0) {
 		//Wyrmgus end
 			//Wyrmgus start
 //			AStarMatrix[offset].InGoal = 1;
-			AStarMatrix[z][offset].InGoal = 1;
+			ctx.Matrix[z][offset].InGoal = 1;
 			//Wyrmgus end
 			*goal_reachable = true;
 		}
 		//Wyrmgus start
 //		AStarAddToClose(offset);
-		AStarAddToClose(offset, z);
+		AStarAddToClose(ctx, offset, z);
 		//Wyrmgus end
 	}
 private:
+	//Wyrmgus start
+	AStarContext &ctx;
+	//Wyrmgus end
 	const CUnit &unit;
 	bool *goal_reachable;
 };
@@ -1110,36 +1185,33 @@ private:
 /**
 **  MarkAStarGoal
 */
-static int AStarMarkGoal(const Vec2i &goal, int gw, int gh,
+static int AStarMarkGoal(AStarContext &ctx, const Vec2i &goal, int gw, int gh,
 						 //Wyrmgus start
 //						 int tilesizex, int tilesizey, int minrange, int maxrange, const CUnit &unit)
 						 int tilesizex, int tilesizey, int minrange, int maxrange, const CUnit &unit, int z)
 						 //Wyrmgus end
 {
-	ProfileBegin("AStarMarkGoal");
+	PROFILE_SCOPE("AStarMarkGoal");
 
 	if (minrange == 0 && maxrange == 0 && gw == 0 && gh == 0) {
 		//Wyrmgus start
 //		if (goal.x + tilesizex > AStarMapWidth || goal.y + tilesizey > AStarMapHeight) {
 		if (goal.x + tilesizex - 1 > AStarMapWidth[z] || goal.y + tilesizey - 1 > AStarMapHeight[z]) {
 		//Wyrmgus end
-			ProfileEnd("AStarMarkGoal");
 			return 0;
 		}
 		//Wyrmgus start
 //		unsigned int offset = GetIndex(goal.x, goal.y);
 //		if (CostMoveTo(offset, unit) >= 0) {
 		unsigned int offset = GetIndex(goal.x, goal.y, z);
-		if (CostMoveTo(offset, unit, z) >= 0) {
+		if (CostMoveTo(ctx, offset, unit, z) >= 0) {
 		//Wyrmgus end
 			//Wyrmgus start
 //			AStarMatrix[offset].InGoal = 1;
-			AStarMatrix[z][offset].InGoal = 1;
+			ctx.Matrix[z][offset].InGoal = 1;
 			//Wyrmgus end
-			ProfileEnd("AStarMarkGoal");
 			return 1;
 		} else {
-			ProfileEnd("AStarMarkGoal");
 			return 0;
 		}
 	}
@@ -1149,7 +1221,10 @@ static int AStarMarkGoal(const Vec2i &goal, int gw, int gh,
 	gw = std::max(gw, 1);
 	gh = std::max(gh, 1);
 
-	AStarGoalMarker aStarGoalMarker(unit, &goal_reachable);
+	//Wyrmgus start
+//	AStarGoalMarker aStarGoalMarker(unit, &goal_reachable);
+	AStarGoalMarker aStarGoalMarker(ctx, unit, &goal_reachable);
+	//Wyrmgus end
 	MinMaxRangeVisitor<AStarGoalMarker> visitor(aStarGoalMarker);
 
 	const Vec2i goalBottomRigth(goal.x + gw - 1, goal.y + gh - 1);
@@ -1165,7 +1240,6 @@ static int AStarMarkGoal(const Vec2i &goal, int gw, int gh,
 
 	visitor.Visit();
 
-	ProfileEnd("AStarMarkGoal");
 	return goal_reachable;
 }
 
@@ -1176,10 +1250,10 @@ static int AStarMarkGoal(const Vec2i &goal, int gw, int gh,
 */
 //Wyrmgus start
 //static int AStarSavePath(const Vec2i &startPos, const Vec2i &endPos, char *path, int pathLen)
-static int AStarSavePath(const Vec2i &startPos, const Vec2i &endPos, char *path, int pathLen, int z)
+static int AStarSavePath(AStarContext &ctx, const Vec2i &startPos, const Vec2i &endPos, char *path, int pathLen, int z)
 //Wyrmgus end
 {
-	ProfileBegin("AStarSavePath");
+	PROFILE_SCOPE("AStarSavePath");
 
 	int fullPathLength;
 	int pathPos;
@@ -1195,7 +1269,7 @@ static int AStarSavePath(const Vec2i &startPos, const Vec2i &endPos, char *path,
 	while (curr != startPos) {
 		//Wyrmgus start
 //		direction = AStarMatrix[currO + curr.x].Direction;
-		direction = AStarMatrix[z][currO + curr.x].Direction;
+		direction = ctx.Matrix[z][currO + curr.x].Direction;
 		//Wyrmgus end
 		curr.x -= Heading2X[direction];
 		curr.y -= Heading2Y[direction];
@@ -1218,7 +1292,7 @@ static int AStarSavePath(const Vec2i &startPos, const Vec2i &endPos, char *path,
 		while (curr != startPos) {
 			//Wyrmgus start
 //			direction = AStarMatrix[currO + curr.x].Direction;
-			direction = AStarMatrix[z][currO + curr.x].Direction;
+			direction = ctx.Matrix[z][currO + curr.x].Direction;
 			//Wyrmgus end
 			curr.x -= Heading2X[direction];
 			curr.y -= Heading2Y[direction];
@@ -1233,7 +1307,6 @@ static int AStarSavePath(const Vec2i &startPos, const Vec2i &endPos, char *path,
 		}
 	}
 
-	ProfileEnd("AStarSavePath");
 	return fullPathLength;
 }
 
@@ -1248,19 +1321,15 @@ static int AStarFindSimplePath(const Vec2i &startPos, const Vec2i &goal, int gw,
 							   char *path, const CUnit &unit, int z, bool allow_diagonal)
 							   //Wyrmgus end
 {
-	ProfileBegin("AStarFindSimplePath");
+	PROFILE_SCOPE("AStarFindSimplePath");
 	// At exact destination point already
 	if (goal == startPos && minrange == 0) {
-		ProfileEnd("AStarFindSimplePath");
 		return PF_REACHED;
 	}
 
 	// Don't allow unit inside destination area
 	if (goal.x <= startPos.x && startPos.x <= goal.x + gw - 1
 		&& goal.y <= startPos.y && startPos.y <= goal.y + gh - 1) {
-		//Wyrmgus start
-		ProfileEnd("AStarFindSimplePath"); // seems like this should be here
-		//Wyrmgus end
 		return PF_FAILED;
 	}
 
@@ -1269,7 +1338,6 @@ static int AStarFindSimplePath(const Vec2i &startPos, const Vec2i &goal, int gw,
 
 	// Within range of destination
 	if (minrange <= distance && distance <= maxrange) {
-		ProfileEnd("AStarFindSimplePath");
 		return PF_REACHED;
 	}
 
@@ -1280,27 +1348,555 @@ static int AStarFindSimplePath(const Vec2i &startPos, const Vec2i &goal, int gw,
 		// Move to adjacent cell
 		//Wyrmgus start
 //		if (CostMoveTo(GetIndex(goal.x, goal.y), unit) == -1) {
-		if (CostMoveTo(GetIndex(goal.x, goal.y, z), unit, z) == -1) {
+		// the cost cache isn't initialized yet for this search, so don't use it
+		if (CostMoveToCallBack_Default(GetIndex(goal.x, goal.y, z), unit, z) == -1) {
 		//Wyrmgus end
-			ProfileEnd("AStarFindSimplePath");
 			return PF_UNREACHABLE;
 		}
 
 		if (path) {
 			path[0] = XY2Heading[diff.x + 1][diff.y + 1];
 		}
-		ProfileEnd("AStarFindSimplePath");
 		return 1;
 	}
 
-	ProfileEnd("AStarFindSimplePath");
 	return PF_FAILED;
 }
 
+//Wyrmgus start
+static int AStarFindPath(AStarContext &ctx, const Vec2i &startPos, const Vec2i &goalPos, int gw, int gh,
+						 int tilesizex, int tilesizey, int minrange, int maxrange,
+						 char *path, int pathlen, const CUnit &unit, int max_length, int z, bool allow_diagonal);
+
+HPAGraph::HPAGraph(int mask, bool allow_diagonal, int player, int z) :
+	MovementMask(mask), AllowDiagonal(allow_diagonal), Player(player), MapLayer(z),
+	Width((AStarMapWidth[z] + HPA_CLUSTER_SIZE - 1) / HPA_CLUSTER_SIZE),
+	Height((AStarMapHeight[z] + HPA_CLUSTER_SIZE - 1) / HPA_CLUSTER_SIZE),
+	Dirty(true)
+{
+	this->Clusters.resize(this->Width * this->Height);
+}
+
+/**
+**  Check whether the terrain of a tile can be crossed, ignoring the units on it.
+*/
+bool HPAGraph::IsPassable(const Vec2i &pos) const
+{
+	const CMapField &mf = *Map.Field(pos, this->MapLayer);
+
+	// same as CostMoveToCallBack_Default, which doesn't know what is on unexplored tiles
+	if (!this->IsExplored(mf)) {
+		return true;
+	}
+	int check_flags = mf.Flags;
+	if (check_flags & MapFieldBridge) {
+		check_flags &= ~(MapFieldWaterAllowed | MapFieldCoastAllowed);
+	}
+	return (check_flags & this->MovementMask & ~(MapFieldLandUnit | MapFieldAirUnit | MapFieldSeaUnit)) == 0;
+}
+
+/**
+**  Get the cost of stepping onto a tile, as counted by the A* search for its terrain.
+*/
+int HPAGraph::GetStepCost(const Vec2i &pos) const
+{
+	const CMapField &mf = *Map.Field(pos, this->MapLayer);
+	int cost = 1 + mf.getCost();
+
+	if (!this->IsExplored(mf)) {
+		// Tend against unknown tiles.
+		cost += AStarUnknownTerrainCost;
+	}
+	return cost;
+}
+
+/**
+**  Check whether the player of the graph knows the terrain of a tile.
+*/
+bool HPAGraph::IsExplored(const CMapField &mf) const
+{
+	return this->Player == -1 || mf.playerInfo.IsTeamExplored(Players[this->Player]);
+}
+
+/**
+**  Get the tiles covered by a cluster, the last clusters of a row or column may be smaller.
+*/
+void HPAGraph::GetClusterArea(int cluster, Vec2i &pos, Vec2i &size) const
+{
+	pos.x = (cluster % this->Width) * HPA_CLUSTER_SIZE;
+	pos.y = (cluster / this->Width) * HPA_CLUSTER_SIZE;
+	size.x = std::min<int>(HPA_CLUSTER_SIZE, AStarMapWidth[this->MapLayer] - pos.x);
+	size.y = std::min<int>(HPA_CLUSTER_SIZE, AStarMapHeight[this->MapLayer] - pos.y);
+}
+
+/**
+**  Compute the paths from a tile to every tile of its cluster, without leaving the cluster.
+**
+**  @param cluster  Cluster of the tile.
+**  @param from     Start tile.
+**  @param costs    Filled with the cost to reach each tile of the cluster, -1 if it can't be reached.
+**  @param lengths  Filled with the number of steps to reach each tile of the cluster.
+*/
+void HPAGraph::Search(int cluster, const Vec2i &from, int *costs, int *lengths) const
+{
+	Vec2i clusterPos;
+	Vec2i clusterSize;
+	this->GetClusterArea(cluster, clusterPos, clusterSize);
+
+	for (int i = 0; i < HPA_CLUSTER_SIZE * HPA_CLUSTER_SIZE; ++i) {
+		costs[i] = -1;
+		lengths[i] = 0;
+	}
+
+	// pairs of cost and index of the tile in the cluster
+	std::priority_queue<std::pair<int, int>, std::vector<std::pair<int, int> >, std::greater<std::pair<int, int> > > open;
+	const int start = (from.y - clusterPos.y) * HPA_CLUSTER_SIZE + from.x - clusterPos.x;
+	costs[start] = 0;
+	open.push(std::make_pair(0, start));
+
+	while (!open.empty()) {
+		const int cost = open.top().first;
+		const int index = open.top().second;
+		open.pop();
+		if (cost > costs[index]) {
+			continue;
+		}
+		const Vec2i pos(clusterPos.x + index % HPA_CLUSTER_SIZE, clusterPos.y + index / HPA_CLUSTER_SIZE);
+
+		for (int i = 0; i < 8; ++i) {
+			if (!this->AllowDiagonal && Heading2X[i] != 0 && Heading2Y[i] != 0) {
+				continue;
+			}
+			const Vec2i next(pos.x + Heading2X[i], pos.y + Heading2Y[i]);
+			if (next.x < clusterPos.x || next.x >= clusterPos.x + clusterSize.x
+				|| next.y < clusterPos.y || next.y >= clusterPos.y + clusterSize.y
+				|| !this->IsPassable(next)) {
+				continue;
+			}
+			const int next_index = (next.y - clusterPos.y) * HPA_CLUSTER_SIZE + next.x - clusterPos.x;
+			const int next_cost = cost + this->GetStepCost(next);
+			if (costs[next_index] == -1 || next_cost < costs[next_index]) {
+				costs[next_index] = next_cost;
+				lengths[next_index] = lengths[index] + 1;
+				open.push(std::make_pair(next_cost, next_index));
+			}
+		}
+	}
+}
+
+/**
+**  Add a node to a cluster.
+*/
+int HPAGraph::NewNode(const Vec2i &pos, int cluster, int border)
+{
+	int node;
+	if (this->FreeNodes.empty()) {
+		node = this->Nodes.size();
+		this->Nodes.push_back(HPANode());
+	} else {
+		node = this->FreeNodes.back();
+		this->FreeNodes.pop_back();
+	}
+
+	HPANode &n = this->Nodes[node];
+	n.Pos = pos;
+	n.Cluster = cluster;
+	n.Border = border;
+	n.Pair = -1;
+	n.PairCost = 0;
+	n.Edges.clear();
+	this->Clusters[cluster].Nodes.push_back(node);
+	return node;
+}
+
+/**
+**  Add the pair of nodes of an entrance.
+**
+**  @param pos       Tile of the entrance in the cluster.
+**  @param step      Offset to the tile of the entrance in the neighbor cluster.
+*/
+void HPAGraph::AddEntrance(const Vec2i &pos, const Vec2i &step, int cluster, int neighbor, int border)
+{
+	const int inside = this->NewNode(pos, cluster, border);
+	const int outside = this->NewNode(pos + step, neighbor, border);
+
+	this->Nodes[inside].Pair = outside;
+	this->Nodes[inside].PairCost = this->GetStepCost(pos + step);
+	this->Nodes[outside].Pair = inside;
+	this->Nodes[outside].PairCost = this->GetStepCost(pos);
+}
+
+/**
+**  Remove the entrances of a border.
+**
+**  Borders are numbered twice the index of the cluster to their north or west,
+**  plus one for borders between a cluster and the one to its south.
+*/
+void HPAGraph::RemoveBorder(int border)
+{
+	const int clusters[2] = { border / 2, border / 2 + ((border % 2) ? this->Width : 1) };
+
+	for (int i = 0; i < 2; ++i) {
+		std::vector<int> &nodes = this->Clusters[clusters[i]].Nodes;
+		for (size_t j = 0; j < nodes.size();) {
+			HPANode &node = this->Nodes[nodes[j]];
+			if (node.Border != border) {
+				++j;
+				continue;
+			}
+			node.Border = -1;
+			node.Edges.clear();
+			this->FreeNodes.push_back(nodes[j]);
+			nodes.erase(nodes.begin() + j);
+		}
+	}
+}
+
+/**
+**  Find the entrances of a border.
+*/
+void HPAGraph::BuildBorder(int border)
+{
+	const int cluster = border / 2;
+	const bool south = (border % 2) != 0;
+	const int neighbor = cluster + (south ? this->Width : 1);
+
+	Vec2i clusterPos;
+	Vec2i clusterSize;
+	this->GetClusterArea(cluster, clusterPos, clusterSize);
+
+	const Vec2i step(south ? 0 : 1, south ? 1 : 0);
+	const Vec2i along(south ? 1 : 0, south ? 0 : 1);
+	const Vec2i first(south ? clusterPos.x : clusterPos.x + clusterSize.x - 1, south ? clusterPos.y + clusterSize.y - 1 : clusterPos.y);
+	const int count = south ? clusterSize.x : clusterSize.y;
+
+	// each row of tiles passable on both sides of the border is an entrance
+	int row_start = -1;
+	for (int i = 0; i <= count; ++i) {
+		const Vec2i pos = first + along * i;
+		if (i < count && this->IsPassable(pos) && this->IsPassable(pos + step)) {
+			if (row_start == -1) {
+				row_start = i;
+			}
+			continue;
+		}
+		if (row_start == -1) {
+			continue;
+		}
+
+		const int row_length = i - row_start;
+		if (row_length >= HPA_LONG_ENTRANCE) {
+			this->AddEntrance(first + along * row_start, step, cluster, neighbor, border);
+			this->AddEntrance(first + along * (i - 1), step, cluster, neighbor, border);
+		} else {
+			this->AddEntrance(first + along * (row_start + row_length / 2), step, cluster, neighbor, border);
+		}
+		row_start = -1;
+	}
+}
+
+/**
+**  Sort the nodes by position, so that the searches don't depend on the order in which the nodes were created.
+*/
+class HPANodeLess
+{
+public:
+	explicit HPANodeLess(const HPAGraph &graph) : graph(graph) {}
+
+	bool operator()(int lhs, int rhs) const
+	{
+		const HPANode &l = graph.Nodes[lhs];
+		const HPANode &r = graph.Nodes[rhs];
+		if (l.Pos.y != r.Pos.y) {
+			return l.Pos.y < r.Pos.y;
+		}
+		if (l.Pos.x != r.Pos.x) {
+			return l.Pos.x < r.Pos.x;
+		}
+		return l.Border < r.Border;
+	}
+
+private:
+	const HPAGraph &graph;
+};
+
+/**
+**  Compute the paths between the entrances of a cluster.
+*/
+void HPAGraph::BuildEdges(int cluster)
+{
+	std::vector<int> &nodes = this->Clusters[cluster].Nodes;
+	std::sort(nodes.begin(), nodes.end(), HPANodeLess(*this));
+
+	Vec2i clusterPos;
+	Vec2i clusterSize;
+	this->GetClusterArea(cluster, clusterPos, clusterSize);
+
+	int costs[HPA_CLUSTER_SIZE * HPA_CLUSTER_SIZE];
+	int lengths[HPA_CLUSTER_SIZE * HPA_CLUSTER_SIZE];
+
+	for (size_t i = 0; i < nodes.size(); ++i) {
+		HPANode &node = this->Nodes[nodes[i]];
+		node.Edges.clear();
+		this->Search(cluster, node.Pos, costs, lengths);
+
+		for (size_t j = 0; j < nodes.size(); ++j) {
+			const Vec2i &pos = this->Nodes[nodes[j]].Pos;
+			const int index = (pos.y - clusterPos.y) * HPA_CLUSTER_SIZE + pos.x - clusterPos.x;
+			if (j == i || costs[index] == -1) {
+				continue;
+			}
+			HPAEdge edge;
+			edge.Node = nodes[j];
+			edge.Cost = costs[index];
+			edge.Length = lengths[index];
+			node.Edges.push_back(edge);
+		}
+	}
+}
+
+/**
+**  Rebuild the entrances and paths around the clusters whose terrain has changed.
+*/
+void HPAGraph::Update()
+{
+	if (!this->Dirty) {
+		return;
+	}
+
+	std::vector<bool> build_border(this->Clusters.size() * 2, false);
+	std::vector<bool> build_edges(this->Clusters.size(), false);
+
+	for (int i = 0; i < (int) this->Clusters.size(); ++i) {
+		if (!this->Clusters[i].Dirty) {
+			continue;
+		}
+		const int x = i % this->Width;
+		const int y = i / this->Width;
+		if (x + 1 < this->Width) {
+			build_border[i * 2] = true;
+		}
+		if (y + 1 < this->Height) {
+			build_border[i * 2 + 1] = true;
+		}
+		if (x > 0) {
+			build_border[(i - 1) * 2] = true;
+		}
+		if (y > 0) {
+			build_border[(i - this->Width) * 2 + 1] = true;
+		}
+		build_edges[i] = true;
+		this->Clusters[i].Dirty = false;
+	}
+
+	for (int border = 0; border < (int) build_border.size(); ++border) {
+		if (!build_border[border]) {
+			continue;
+		}
+		this->RemoveBorder(border);
+		this->BuildBorder(border);
+		build_edges[border / 2] = true;
+		build_edges[border / 2 + ((border % 2) ? this->Width : 1)] = true;
+	}
+
+	for (int i = 0; i < (int) this->Clusters.size(); ++i) {
+		if (build_edges[i]) {
+			this->BuildEdges(i);
+		}
+	}
+
+	this->Dirty = false;
+}
+
+/**
+**  Get the abstract graph of a movement mask, creating or updating it if needed.
+**
+**  This can be called from several searches at the same time.
+**
+**  @param player  Player whose explored terrain is used, -1 to use all the terrain.
+*/
+static const HPAGraph &HPAGetGraph(int mask, bool allow_diagonal, int player, int z)
+{
+	SDL_LockMutex(HPALock);
+	std::vector<HPAGraph *> &graphs = HPAGraphs[z];
+	HPAGraph *graph = NULL;
+	for (size_t i = 0; i < graphs.size(); ++i) {
+		if (graphs[i]->MovementMask == mask && graphs[i]->AllowDiagonal == allow_diagonal && graphs[i]->Player == player) {
+			graph = graphs[i];
+			break;
+		}
+	}
+	if (graph == NULL) {
+		graph = new HPAGraph(mask, allow_diagonal, player, z);
+		graphs.push_back(graph);
+	}
+	graph->Update();
+	SDL_UnlockMutex(HPALock);
+	return *graph;
+}
+
+/// Node in the open set of the abstract search
+struct HPAOpen {
+	int Costs;   /// complete costs to goal
+	int Cost;    /// cost from the start
+	Vec2i Pos;   /// position of the node, first tie-breaker
+	int Border;  /// border of the node, second tie-breaker
+	int Node;
+};
+
+/// Ordering of the open set of the abstract search, the smallest costs come first
+struct HPAOpenGreater {
+	bool operator()(const HPAOpen &lhs, const HPAOpen &rhs) const
+	{
+		if (lhs.Costs != rhs.Costs) {
+			return lhs.Costs > rhs.Costs;
+		}
+		if (lhs.Pos.y != rhs.Pos.y) {
+			return lhs.Pos.y > rhs.Pos.y;
+		}
+		if (lhs.Pos.x != rhs.Pos.x) {
+			return lhs.Pos.x > rhs.Pos.x;
+		}
+		return lhs.Border > rhs.Border;
+	}
+};
+
+typedef std::priority_queue<HPAOpen, std::vector<HPAOpen>, HPAOpenGreater> HPAOpenSet;
+
+/**
+**  Reach a node of the abstract graph, if this is the best way found so far.
+*/
+static void HPAReachNode(AStarContext &ctx, const HPAGraph &graph, HPAOpenSet &open, const Vec2i &goalPos,
+						 int node, int parent, int cost, int length)
+{
+	if (ctx.HPAVisit[node] == ctx.HPASearch && ctx.HPACost[node] <= cost) {
+		return;
+	}
+	ctx.HPAVisit[node] = ctx.HPASearch;
+	ctx.HPACost[node] = cost;
+	ctx.HPALength[node] = length;
+	ctx.HPAParent[node] = parent;
+
+	const HPANode &n = graph.Nodes[node];
+	HPAOpen item;
+	item.Costs = cost + AStarCosts(n.Pos, goalPos);
+	item.Cost = cost;
+	item.Pos = n.Pos;
+	item.Border = n.Border;
+	item.Node = node;
+	open.push(item);
+}
+
+/**
+**  Find a path through the abstract graph, then search tile by tile
+**  the part of it up to the furthest entrance close enough to the start.
+**
+**  @return  Same as AStarFindPath. When a path is requested, the length is that of
+**           the part of it stored in the path, up to the waypoint; otherwise it is
+**           estimated from the abstract path. PF_FAILED if a normal search has to
+**           be done instead.
+*/
+static int AStarFindHierarchicalPath(AStarContext &ctx, const Vec2i &startPos, const Vec2i &goalPos, int gw, int gh,
+									 char *path, int pathlen, const CUnit &unit, int z, bool allow_diagonal)
+{
+	const HPAGraph &graph = HPAGetGraph(unit.Type->MovementMask, allow_diagonal, AStarKnowUnseenTerrain ? -1 : unit.Player->Index, z);
+
+	const Vec2i goalCenter(std::min<int>(goalPos.x + gw / 2, AStarMapWidth[z] - 1), std::min<int>(goalPos.y + gh / 2, AStarMapHeight[z] - 1));
+	const int startCluster = graph.GetCluster(startPos);
+	const int goalCluster = graph.GetCluster(goalCenter);
+	if (startCluster == goalCluster) {
+		return PF_FAILED;
+	}
+
+	if (ctx.HPAVisit.size() < graph.Nodes.size()) {
+		ctx.HPACost.resize(graph.Nodes.size());
+		ctx.HPALength.resize(graph.Nodes.size());
+		ctx.HPAParent.resize(graph.Nodes.size());
+		ctx.HPAVisit.resize(graph.Nodes.size(), 0);
+	}
+	if (++ctx.HPASearch == 0) {
+		std::fill(ctx.HPAVisit.begin(), ctx.HPAVisit.end(), 0);
+		ctx.HPASearch = 1;
+	}
+
+	HPAOpenSet open;
+
+	// link the start to the entrances of its cluster
+	Vec2i clusterPos;
+	Vec2i clusterSize;
+	graph.GetClusterArea(startCluster, clusterPos, clusterSize);
+	int costs[HPA_CLUSTER_SIZE * HPA_CLUSTER_SIZE];
+	int lengths[HPA_CLUSTER_SIZE * HPA_CLUSTER_SIZE];
+	graph.Search(startCluster, startPos, costs, lengths);
+
+	const std::vector<int> &startNodes = graph.Clusters[startCluster].Nodes;
+	for (size_t i = 0; i < startNodes.size(); ++i) {
+		const Vec2i &pos = graph.Nodes[startNodes[i]].Pos;
+		const int index = (pos.y - clusterPos.y) * HPA_CLUSTER_SIZE + pos.x - clusterPos.x;
+		if (costs[index] != -1) {
+			HPAReachNode(ctx, graph, open, goalCenter, startNodes[i], -1, costs[index], lengths[index]);
+		}
+	}
+
+	int found = -1;
+	while (!open.empty()) {
+		const HPAOpen current = open.top();
+		open.pop();
+		if (current.Cost > ctx.HPACost[current.Node]) {
+			// a better way to this node was found meanwhile
+			continue;
+		}
+		const HPANode &node = graph.Nodes[current.Node];
+		if (node.Cluster == goalCluster) {
+			found = current.Node;
+			break;
+		}
+
+		HPAReachNode(ctx, graph, open, goalCenter, node.Pair, current.Node, current.Cost + node.PairCost, ctx.HPALength[current.Node] + 1);
+		for (size_t i = 0; i < node.Edges.size(); ++i) {
+			const HPAEdge &edge = node.Edges[i];
+			HPAReachNode(ctx, graph, open, goalCenter, edge.Node, current.Node, current.Cost + edge.Cost, ctx.HPALength[current.Node] + edge.Length);
+		}
+	}
+
+	if (found == -1) {
+		// the goal may still be in range from another cluster, let the normal search decide
+		return PF_FAILED;
+	}
+
+	std::vector<int> nodes;
+	for (int node = found; node != -1; node = ctx.HPAParent[node]) {
+		nodes.push_back(node);
+	}
+
+	// nodes go from the goal to the start, pick the waypoint from the start on
+	size_t waypoint = nodes.size() - 1;
+	while (waypoint > 0
+		   && (graph.Nodes[nodes[waypoint]].Cluster == startCluster || ctx.HPALength[nodes[waypoint - 1]] <= HPA_WAYPOINT_LENGTH)) {
+		--waypoint;
+	}
+
+	// units may stand on the waypoint, so getting next to it is enough
+	const int ret = AStarFindPath(ctx, startPos, graph.Nodes[nodes[waypoint]].Pos, 1, 1, 1, 1, 0, 1,
+								  path, pathlen, unit, HPA_REFINE_MAX_LENGTH, z, allow_diagonal);
+	if (ret <= 0) {
+		return PF_FAILED;
+	}
+	if (path != NULL) {
+		// the unit walks to the waypoint, and searches again from there
+		return ret;
+	}
+	return ret + ctx.HPALength[found] - ctx.HPALength[nodes[waypoint]] + AStarCosts(graph.Nodes[found].Pos, goalCenter);
+}
+//Wyrmgus end
+
 /**
 **  Find path.
 */
-int AStarFindPath(const Vec2i &startPos, const Vec2i &goalPos, int gw, int gh,
+//Wyrmgus start
+//int AStarFindPath(const Vec2i &startPos, const Vec2i &goalPos, int gw, int gh,
+static int AStarFindPath(AStarContext &ctx, const Vec2i &startPos, const Vec2i &goalPos, int gw, int gh,
+//Wyrmgus end
 				  int tilesizex, int tilesizey, int minrange, int maxrange,
 				  //Wyrmgus start
 //				  char *path, int pathlen, const CUnit &unit)
@@ -1316,12 +1912,14 @@ int AStarFindPath(const Vec2i &startPos, const Vec2i &goalPos, int gw, int gh,
 	}
 	
 	allow_diagonal = allow_diagonal && !unit.Type->BoolFlag[RAIL_INDEX].value; //rail units cannot move diagonally
+
+	ctx.InitLayer(z);
 	//Wyrmgus end
 
-	ProfileBegin("AStarFindPath");
+	PROFILE_SCOPE("AStarFindPath");
 
-	AStarGoalX = goalPos.x;
-	AStarGoalY = goalPos.y;
+	ctx.GoalPos.x = goalPos.x;
+	ctx.GoalPos.y = goalPos.y;
 
 	//  Check for simple cases first
 	int ret = AStarFindSimplePath(startPos, goalPos, gw, gh, tilesizex, tilesizey,
@@ -1330,32 +1928,40 @@ int AStarFindPath(const Vec2i &startPos, const Vec2i &goalPos, int gw, int gh,
 								  minrange, maxrange, path, unit, z, allow_diagonal);
 								  //Wyrmgus end
 	if (ret != PF_FAILED) {
-		ProfileEnd("AStarFindPath");
 		return ret;
 	}
 
+	//Wyrmgus start
+	// long searches go through the abstract graph first
+	if (AStarHierarchical && max_length == 0 && tilesizex == 1 && tilesizey == 1 && AStarCosts(startPos, goalPos) >= HPA_MIN_DISTANCE) {
+		ret = AStarFindHierarchicalPath(ctx, startPos, goalPos, gw, gh, path, pathlen, unit, z, allow_diagonal);
+		if (ret != PF_FAILED) {
+			return ret;
+		}
+	}
+	//Wyrmgus end
+
 	//  Initialize
 	//Wyrmgus start
 //	AStarCleanUp();
 //	CostMoveToCacheCleanUp();
-	AStarCleanUp(z);
-	CostMoveToCacheCleanUp(z);
+	AStarCleanUp(ctx, z);
+	CostMoveToCacheCleanUp(ctx, z);
 	//Wyrmgus end
 
 	//Wyrmgus start
 //	OpenSetSize = 0;
 //	CloseSetSize = 0;
-	OpenSetSize[z] = 0;
-	CloseSetSize[z] = 0;
+	ctx.OpenSetSize[z] = 0;
+	ctx.CloseSetSize[z] = 0;
 	//Wyrmgus end
 
 	//Wyrmgus start
 //	if (!AStarMarkGoal(goalPos, gw, gh, tilesizex, tilesizey, minrange, maxrange, unit)) {
-	if (!AStarMarkGoal(goalPos, gw, gh, tilesizex, tilesizey, minrange, maxrange, unit, z)) {
+	if (!AStarMarkGoal(ctx, goalPos, gw, gh, tilesizex, tilesizey, minrange, maxrange, unit, z)) {
 	//Wyrmgus end
 		// goal is not reachable
 		ret = PF_UNREACHABLE;
-		ProfileEnd("AStarFindPath");
 		return ret;
 	}
 
@@ -1367,12 +1973,12 @@ int AStarFindPath(const Vec2i &startPos, const Vec2i &goalPos, int gw, int gh,
 	// 0 as a way to represent nodes that we have not visited yet.
 	//Wyrmgus start
 //	AStarMatrix[eo].CostFromStart = 1;
-	AStarMatrix[z][eo].CostFromStart = 1;
+	ctx.Matrix[z][eo].CostFromStart = 1;
 	//Wyrmgus end
 	// 8 to say we are came from nowhere.
 	//Wyrmgus start
 //	AStarMatrix[eo].Direction = 8;
-	AStarMatrix[z][eo].Direction = 8;
+	ctx.Matrix[z][eo].Direction = 8;
 	//Wyrmgus end
 
 	// place start point in open, it that failed, try another pathfinder
@@ -1380,21 +1986,19 @@ int AStarFindPath(const Vec2i &startPos, const Vec2i &goalPos, int gw, int gh,
 	//Wyrmgus start
 //	AStarMatrix[eo].CostToGoal = costToGoal;
 //	if (AStarAddNode(startPos, eo, 1 + costToGoal) == PF_FAILED) {
-	AStarMatrix[z][eo].CostToGoal = costToGoal;
-	if (AStarAddNode(startPos, eo, 1 + costToGoal, z) == PF_FAILED) {
+	ctx.Matrix[z][eo].CostToGoal = costToGoal;
+	if (AStarAddNode(ctx, startPos, eo, 1 + costToGoal, z) == PF_FAILED) {
 	//Wyrmgus end
 		ret = PF_FAILED;
-		ProfileEnd("AStarFindPath");
 		return ret;
 	}
 	//Wyrmgus start
 //	AStarAddToClose(OpenSet[0].O);
 //	if (AStarMatrix[eo].InGoal) {
-	AStarAddToClose(OpenSet[z][0].O, z);
-	if (AStarMatrix[z][eo].InGoal) {
+	AStarAddToClose(ctx, ctx.OpenSet[z][0].O, z);
+	if (ctx.Matrix[z][eo].InGoal) {
 	//Wyrmgus end
 		ret = PF_REACHED;
-		ProfileEnd("AStarFindPath");
 		return ret;
 	}
 	Vec2i endPos;
@@ -1408,7 +2012,6 @@ int AStarFindPath(const Vec2i &startPos, const Vec2i &goalPos, int gw, int gh,
 		//Wyrmgus start
 		if (max_length != 0 && length > max_length) {
 			ret = PF_FAILED;
-			ProfileEnd("AStarFindPath");
 			return ret;
 		}
 		//Wyrmgus end
@@ -1420,20 +2023,20 @@ int AStarFindPath(const Vec2i &startPos, const Vec2i &goalPos, int gw, int gh,
 //		const int y = OpenSet[shortest].pos.y;
 //		const int o = OpenSet[shortest].O;
 		const int shortest = AStarFindMinimum(z);
-		const int x = OpenSet[z][shortest].pos.x;
-		const int y = OpenSet[z][shortest].pos.y;
-		const int o = OpenSet[z][shortest].O;
+		const int x = ctx.OpenSet[z][shortest].pos.x;
+		const int y = ctx.OpenSet[z][shortest].pos.y;
+		const int o = ctx.OpenSet[z][shortest].O;
 		//Wyrmgus end
 
 		//Wyrmgus start
 //		AStarRemoveMinimum(shortest);
-		AStarRemoveMinimum(shortest, z);
+		AStarRemoveMinimum(ctx, shortest, z);
 		//Wyrmgus end
 
 		// If we have reached the goal, then exit.
 		//Wyrmgus start
 //		if (AStarMatrix[o].InGoal == 1) {
-		if (AStarMatrix[z][o].InGoal == 1) {
+		if (ctx.Matrix[z][o].InGoal == 1) {
 		//Wyrmgus end
 			endPos.x = x;
 			endPos.y = y;
@@ -1447,7 +2050,6 @@ int AStarFindPath(const Vec2i &startPos, const Vec2i &goalPos, int gw, int gh,
 			// Nearest point to goal.
 			AstarDebugPrint("way too long\n");
 			ret = PF_FAILED;
-			ProfileEnd("AStarFindPath");
 			return ret;
 		}
 #endif
@@ -1458,8 +2060,8 @@ int AStarFindPath(const Vec2i &startPos, const Vec2i &goalPos, int gw, int gh,
 		//Wyrmgus start
 //		const int px = x - Heading2X[(int)AStarMatrix[o].Direction];
 //		const int py = y - Heading2Y[(int)AStarMatrix[o].Direction];
-		const int px = x - Heading2X[(int)AStarMatrix[z][o].Direction];
-		const int py = y - Heading2Y[(int)AStarMatrix[z][o].Direction];
+		const int px = x - Heading2X[(int)ctx.Matrix[z][o].Direction];
+		const int py = y - Heading2Y[(int)ctx.Matrix[z][o].Direction];
 		//Wyrmgus end
 
 		for (int i = 0; i < 8; ++i) {
@@ -1503,7 +2105,7 @@ int AStarFindPath(const Vec2i &startPos, const Vec2i &goalPos, int gw, int gh,
 			// or if we have a better path to it, we add it to open set
 			//Wyrmgus start
 //			int new_cost = CostMoveTo(eo, unit);
-			int new_cost = CostMoveTo(eo, unit, z);
+			int new_cost = CostMoveTo(ctx, eo, unit, z);
 			//Wyrmgus end
 			if (new_cost == -1) {
 				// uncrossable tile
@@ -1515,59 +2117,57 @@ int AStarFindPath(const Vec2i &startPos, const Vec2i &goalPos, int gw, int gh,
 			//Wyrmgus start
 //			new_cost += AStarMatrix[o].CostFromStart;
 //			if (AStarMatrix[eo].CostFromStart == 0) {
-			new_cost += AStarMatrix[z][o].CostFromStart;
-			if (AStarMatrix[z][eo].CostFromStart == 0) {
+			new_cost += ctx.Matrix[z][o].CostFromStart;
+			if (ctx.Matrix[z][eo].CostFromStart == 0) {
 			//Wyrmgus end
 				// we are sure the current node has not been already visited
 				//Wyrmgus start
 //				AStarMatrix[eo].CostFromStart = new_cost;
 //				AStarMatrix[eo].Direction = i;
-				AStarMatrix[z][eo].CostFromStart = new_cost;
-				AStarMatrix[z][eo].Direction = i;
+				ctx.Matrix[z][eo].CostFromStart = new_cost;
+				ctx.Matrix[z][eo].Direction = i;
 				//Wyrmgus end
 				costToGoal = AStarCosts(endPos, goalPos);
 				//Wyrmgus start
 //				AStarMatrix[eo].CostToGoal = costToGoal;
 //				if (AStarAddNode(endPos, eo, AStarMatrix[eo].CostFromStart + costToGoal) == PF_FAILED) {
-				AStarMatrix[z][eo].CostToGoal = costToGoal;
-				if (AStarAddNode(endPos, eo, AStarMatrix[z][eo].CostFromStart + costToGoal, z) == PF_FAILED) {
+				ctx.Matrix[z][eo].CostToGoal = costToGoal;
+				if (AStarAddNode(ctx, endPos, eo, ctx.Matrix[z][eo].CostFromStart + costToGoal, z) == PF_FAILED) {
 				//Wyrmgus end
 					ret = PF_FAILED;
-					ProfileEnd("AStarFindPath");
 					return ret;
 				}
 				// we add the point to the close set
 				//Wyrmgus start
 //				AStarAddToClose(eo);
-				AStarAddToClose(eo, z);
+				AStarAddToClose(ctx, eo, z);
 				//Wyrmgus end
 			//Wyrmgus start
 //			} else if (new_cost < AStarMatrix[eo].CostFromStart) {
-			} else if (new_cost < AStarMatrix[z][eo].CostFromStart) {
+			} else if (new_cost < ctx.Matrix[z][eo].CostFromStart) {
 			//Wyrmgus end
 				// Already visited node, but we have here a better path
 				// I know, it's redundant (but simpler like this)
 				//Wyrmgus start
 //				AStarMatrix[eo].CostFromStart = new_cost;
 //				AStarMatrix[eo].Direction = i;
-				AStarMatrix[z][eo].CostFromStart = new_cost;
-				AStarMatrix[z][eo].Direction = i;
+				ctx.Matrix[z][eo].CostFromStart = new_cost;
+				ctx.Matrix[z][eo].Direction = i;
 				//Wyrmgus end
 				// this point might be already in the OpenSet
 				//Wyrmgus start
 //				const int j = AStarFindNode(eo);
-				const int j = AStarFindNode(eo, z);
+				const int j = AStarFindNode(ctx, eo, z);
 				//Wyrmgus end
 				if (j == -1) {
 					costToGoal = AStarCosts(endPos, goalPos);
 					//Wyrmgus start
 //					AStarMatrix[eo].CostToGoal = costToGoal;
 //					if (AStarAddNode(endPos, eo, AStarMatrix[eo].CostFromStart + costToGoal) == PF_FAILED) {
-					AStarMatrix[z][eo].CostToGoal = costToGoal;
-					if (AStarAddNode(endPos, eo, AStarMatrix[z][eo].CostFromStart + costToGoal, z) == PF_FAILED) {
+					ctx.Matrix[z][eo].CostToGoal = costToGoal;
+					if (AStarAddNode(ctx, endPos, eo, ctx.Matrix[z][eo].CostFromStart + costToGoal, z) == PF_FAILED) {
 					//Wyrmgus end
 						ret = PF_FAILED;
-						ProfileEnd("AStarFindPath");
 						return ret;
 					}
 				} else {
@@ -1575,8 +2175,8 @@ int AStarFindPath(const Vec2i &startPos, const Vec2i &goalPos, int gw, int gh,
 					//Wyrmgus start
 //					AStarMatrix[eo].CostToGoal = costToGoal;
 //					AStarReplaceNode(j);
-					AStarMatrix[z][eo].CostToGoal = costToGoal;
-					AStarReplaceNode(j, z);
+					ctx.Matrix[z][eo].CostToGoal = costToGoal;
+					AStarReplaceNode(ctx, j, ctx.Matrix[z][eo].CostFromStart + costToGoal, z);
 					//Wyrmgus end
 				}
 				// we don't have to add this point to the close set
@@ -1584,10 +2184,9 @@ int AStarFindPath(const Vec2i &startPos, const Vec2i &goalPos, int gw, int gh,
 		}
 		//Wyrmgus start
 //		if (OpenSetSize <= 0) { // no new nodes generated
-		if (OpenSetSize[z] <= 0) { // no new nodes generated
+		if (ctx.OpenSetSize[z] <= 0) { // no new nodes generated
 		//Wyrmgus end
 			ret = PF_UNREACHABLE;
-			ProfileEnd("AStarFindPath");
 			return ret;
 		}
 		
@@ -1598,15 +2197,100 @@ int AStarFindPath(const Vec2i &startPos, const Vec2i &goalPos, int gw, int gh,
 
 	//Wyrmgus start
 //	const int path_length = AStarSavePath(startPos, endPos, path, pathlen);
-	const int path_length = AStarSavePath(startPos, endPos, path, pathlen, z);
+	const int path_length = AStarSavePath(ctx, startPos, endPos, path, pathlen, z);
 	//Wyrmgus end
 
 	ret = path_length;
 
-	ProfileEnd("AStarFindPath");
 	return ret;
 }
 
+//Wyrmgus start
+/**
+**  Find path.
+**
+**  A context is borrowed from the pool for the duration of the search,
+**  so this can be called from several threads at the same time as long as
+**  the map and the units aren't modified meanwhile.
+*/
+int AStarFindPath(const Vec2i &startPos, const Vec2i &goalPos, int gw, int gh,
+				  int tilesizex, int tilesizey, int minrange, int maxrange,
+				  char *path, int pathlen, const CUnit &unit, int max_length, int z, bool allow_diagonal)
+{
+	AStarContextGuard guard;
+
+	return AStarFindPath(guard.ctx, startPos, goalPos, gw, gh, tilesizex, tilesizey, minrange, maxrange,
+						 path, pathlen, unit, max_length, z, allow_diagonal);
+}
+
+/**
+**  Mark the clusters of the abstract graphs covering an area as outdated.
+**
+**  @param explored_only  Only mark the graphs which depend on the explored terrain.
+*/
+static void HPAMarkDirty(const Vec2i &pos, const Vec2i &size, int z, bool explored_only)
+{
+	if (z >= (int) HPAGraphs.size()) {
+		return;
+	}
+
+	const int x1 = std::max<int>(pos.x, 0) / HPA_CLUSTER_SIZE;
+	const int y1 = std::max<int>(pos.y, 0) / HPA_CLUSTER_SIZE;
+	const int x2 = std::min<int>(pos.x + size.x - 1, AStarMapWidth[z] - 1) / HPA_CLUSTER_SIZE;
+	const int y2 = std::min<int>(pos.y + size.y - 1, AStarMapHeight[z] - 1) / HPA_CLUSTER_SIZE;
+
+	for (size_t i = 0; i < HPAGraphs[z].size(); ++i) {
+		HPAGraph &graph = *HPAGraphs[z][i];
+		if (explored_only && graph.Player == -1) {
+			continue;
+		}
+		for (int y = y1; y <= y2; ++y) {
+			for (int x = x1; x <= x2; ++x) {
+				graph.Clusters[y * graph.Width + x].Dirty = true;
+				graph.Dirty = true;
+			}
+		}
+	}
+}
+
+/**
+**  Tell the pathfinder that the terrain flags of an area have changed.
+**
+**  The abstract graphs are rebuilt around the area before their next search.
+**
+**  @param pos   Top left tile of the area.
+**  @param size  Size of the area in tiles.
+**  @param z     Map layer of the area.
+*/
+void AStarTerrainChanged(const Vec2i &pos, const Vec2i &size, int z)
+{
+	HPAMarkDirty(pos, size, z, false);
+}
+
+/**
+**  Tell the pathfinder that the tiles of an area have been explored, or are
+**  no longer explored, by a player or by the players sharing vision with it.
+**
+**  @param pos   Top left tile of the area.
+**  @param size  Size of the area in tiles.
+**  @param z     Map layer of the area.
+*/
+void AStarExplorationChanged(const Vec2i &pos, const Vec2i &size, int z)
+{
+	HPAMarkDirty(pos, size, z, true);
+}
+
+/**
+**  Tell the pathfinder that the explored tiles of the whole map may have changed.
+*/
+void AStarMapExplorationChanged()
+{
+	for (size_t z = 0; z < HPAGraphs.size(); ++z) {
+		HPAMarkDirty(Vec2i(0, 0), Vec2i(AStarMapWidth[z], AStarMapHeight[z]), z, true);
+	}
+}
+//Wyrmgus end
+
 struct StatsNode {
 	StatsNode() : Direction(0), InGoal(0), CostFromStart(0), Costs(0), CostToGoal(0) {}
 
@@ -1623,13 +2307,20 @@ StatsNode *AStarGetStats(int z)
 //Wyrmgus end
 {
 	//Wyrmgus start
+	// the stats are those of the last search done with the first context
+	Assert(!AStarContexts.empty());
+	AStarContext &ctx = *AStarContexts[0];
+	ctx.InitLayer(z);
+	//Wyrmgus end
+
+	//Wyrmgus start
 //	StatsNode *stats = new StatsNode[AStarMapWidth * AStarMapHeight];
 	StatsNode *stats = new StatsNode[AStarMapWidth[z] * AStarMapHeight[z]];
 	//Wyrmgus end
 	StatsNode *s = stats;
 	//Wyrmgus start
 //	Node *m = AStarMatrix;
-	Node *m = AStarMatrix[z];
+	Node *m = ctx.Matrix[z];
 	//Wyrmgus end
 
 	//Wyrmgus start
@@ -1651,11 +2342,11 @@ StatsNode *AStarGetStats(int z)
 
 	//Wyrmgus start
 //	for (int i = 0; i < OpenSetSize; ++i) {
-	for (int i = 0; i < OpenSetSize[z]; ++i) {
+	for (int i = 0; i < ctx.OpenSetSize[z]; ++i) {
 	//Wyrmgus end
 		//Wyrmgus start
 //		stats[OpenSet[i].O].Costs = OpenSet[i].Costs;
-		stats[OpenSet[z][i].O].Costs = OpenSet[z][i].Costs;
+		stats[ctx.OpenSet[z][i].O].Costs = ctx.OpenSet[z][i].Costs;
 		//Wyrmgus end
 	}
 	return stats;
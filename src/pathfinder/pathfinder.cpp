@@ -41,9 +41,16 @@
 
 #include "actions.h"
 #include "map.h"
+//Wyrmgus start
+#include "thread_pool.h"
+//Wyrmgus end
 #include "unittype.h"
 #include "unit.h"
 
+//Wyrmgus start
+#include "SDL.h"
+//Wyrmgus end
+
 //astar.cpp
 
 /// Init the a* data structures
@@ -71,9 +78,64 @@ extern int AStarFindPath(const Vec2i &startPos, const Vec2i &goalPos, int gw, in
 --  Variables
 ----------------------------------------------------------------------------*/
 
+//Wyrmgus start
+std::vector<TerrainTraversal::Storage *> TerrainTraversal::FreeStorages;
+/// Protects the storage list
+static SDL_mutex *TerrainTraversalLock = NULL;
+
+/**
+**  Borrow the memory of a traversal from the pool.
+*/
+TerrainTraversal::Storage *TerrainTraversal::BorrowStorage()
+{
+	// the first traversal is always done by the game thread, before any worker may do one
+	if (TerrainTraversalLock == NULL) {
+		TerrainTraversalLock = SDL_CreateMutex();
+	}
+
+	SDL_LockMutex(TerrainTraversalLock);
+	Storage *storage;
+	if (FreeStorages.empty()) {
+		storage = new Storage;
+	} else {
+		storage = FreeStorages.back();
+		FreeStorages.pop_back();
+	}
+	SDL_UnlockMutex(TerrainTraversalLock);
+	return storage;
+}
+
+/**
+**  Give the memory of a traversal back to the pool.
+*/
+void TerrainTraversal::ReturnStorage(TerrainTraversal::Storage *storage)
+{
+	SDL_LockMutex(TerrainTraversalLock);
+	FreeStorages.push_back(storage);
+	SDL_UnlockMutex(TerrainTraversalLock);
+}
+
+TerrainTraversal::TerrainTraversal() :
+	m_storage(BorrowStorage()), m_queue_head(0), m_extented_width(0), m_height(0), allow_diagonal(true)
+{
+}
+
+TerrainTraversal::~TerrainTraversal()
+{
+	ReturnStorage(m_storage);
+}
+//Wyrmgus end
+
 void TerrainTraversal::SetSize(unsigned int width, unsigned int height)
 {
-	m_values.resize((width + 2) * (height + 2));
+	//Wyrmgus start
+//	m_values.resize((width + 2) * (height + 2));
+	const size_t size = (width + 2) * (height + 2);
+	if (m_storage->values.size() < size) {
+		m_storage->values.resize(size);
+		m_storage->generations.resize(size, 0);
+	}
+	//Wyrmgus end
 	m_extented_width = width + 2;
 	m_height = height;
 }
@@ -89,6 +151,8 @@ void TerrainTraversal::Init()
 	const unsigned int width = m_extented_width - 2;
 	const unsigned int width_ext = m_extented_width;
 
+	//Wyrmgus start
+	/*
 	memset(&m_values[0], '\xFF', width_ext * sizeof(dataType));
 	for (unsigned i = 1; i < 1 + height; ++i) {
 		m_values[i * width_ext] = -1;
@@ -96,12 +160,33 @@ void TerrainTraversal::Init()
 		m_values[i * width_ext + width + 1] = -1;
 	}
 	memset(&m_values[(height + 1) * width_ext], '\xFF', width_ext * sizeof(dataType));
+	*/
+	// values of previous traversals now read as 0, only the border has to be set
+	if (++m_storage->generation == 0) {
+		std::fill(m_storage->generations.begin(), m_storage->generations.end(), 0);
+		m_storage->generation = 1;
+	}
+	m_storage->queue.clear();
+	m_queue_head = 0;
+
+	for (unsigned i = 0; i < width_ext; ++i) {
+		SetIndex(i, -1);
+		SetIndex((height + 1) * width_ext + i, -1);
+	}
+	for (unsigned i = 1; i < 1 + height; ++i) {
+		SetIndex(i * width_ext, -1);
+		SetIndex(i * width_ext + width + 1, -1);
+	}
+	//Wyrmgus end
 }
 
 void TerrainTraversal::PushPos(const Vec2i &pos)
 {
 	if (IsVisited(pos) == false) {
-		m_queue.push(PosNode(pos, pos));
+		//Wyrmgus start
+//		m_queue.push(PosNode(pos, pos));
+		m_storage->queue.push_back(PosNode(pos, pos));
+		//Wyrmgus end
 		Set(pos, 1);
 	}
 }
@@ -117,7 +202,10 @@ void TerrainTraversal::PushNeighbor(const Vec2i &pos)
 		const Vec2i newPos = pos + offsets[i];
 
 		if (IsVisited(newPos) == false) {
-			m_queue.push(PosNode(newPos, pos));
+			//Wyrmgus start
+//			m_queue.push(PosNode(newPos, pos));
+			m_storage->queue.push_back(PosNode(newPos, pos));
+			//Wyrmgus end
 			Set(newPos, Get(pos) + 1);
 		}
 	}
@@ -162,13 +250,28 @@ bool TerrainTraversal::IsInvalid(const Vec2i &pos) const
 
 TerrainTraversal::dataType TerrainTraversal::Get(const Vec2i &pos) const
 {
-	return m_values[m_extented_width + 1 + pos.y * m_extented_width + pos.x];
+	//Wyrmgus start
+//	return m_values[m_extented_width + 1 + pos.y * m_extented_width + pos.x];
+	const unsigned int index = m_extented_width + 1 + pos.y * m_extented_width + pos.x;
+	return m_storage->generations[index] == m_storage->generation ? m_storage->values[index] : 0;
+	//Wyrmgus end
 }
 
 void TerrainTraversal::Set(const Vec2i &pos, TerrainTraversal::dataType value)
 {
-	m_values[m_extented_width + 1 + pos.y * m_extented_width + pos.x] = value;
+	//Wyrmgus start
+//	m_values[m_extented_width + 1 + pos.y * m_extented_width + pos.x] = value;
+	SetIndex(m_extented_width + 1 + pos.y * m_extented_width + pos.x, value);
+	//Wyrmgus end
+}
+
+//Wyrmgus start
+void TerrainTraversal::SetIndex(unsigned int index, TerrainTraversal::dataType value)
+{
+	m_storage->values[index] = value;
+	m_storage->generations[index] = m_storage->generation;
 }
+//Wyrmgus end
 
 /*----------------------------------------------------------------------------
 --  Functions
@@ -407,32 +510,39 @@ PathFinderOutput::PathFinderOutput()
 	memset(this, 0, sizeof(*this));
 }
 
+//Wyrmgus start
 /**
-**  Find new path.
+**  Search a new path, without changing the path finder data.
 **
-**  The destination could be a unit or a field.
-**  Range gives how far we must reach the goal.
+**  @param input  Path finder input of the unit.
+**  @param path   Buffer for the path, of PathFinderOutput::MAX_PATH_LENGTH elements.
 **
-**  @note  The destination could become negative coordinates!
+**  @return       Result of the A* search.
+*/
+static int FindNewPath(const PathFinderInput &input, char *path)
+{
+	return AStarFindPath(input.GetUnitPos(),
+						 input.GetGoalPos(),
+						 input.GetGoalSize().x, input.GetGoalSize().y,
+						 input.GetUnitSize().x, input.GetUnitSize().y,
+						 input.GetMinRange(), input.GetMaxRange(),
+						 path, PathFinderOutput::MAX_PATH_LENGTH,
+						 *input.GetUnit(), 0, input.GetGoalMapLayer());
+}
+
+/**
+**  Store the result of a path search in the path finder data.
 **
-**  @param unit  Path for this unit.
+**  @param input   Path finder input of the unit.
+**  @param output  Path finder output of the unit, its path must already be filled.
+**  @param i       Result of the A* search.
 **
-**  @return      >0 remaining path length, 0 wait for path, -1
-**               reached goal, -2 can't reach the goal.
+**  @return        >0 remaining path length, 0 wait for path, -1
+**                 reached goal, -2 can't reach the goal.
 */
-static int NewPath(PathFinderInput &input, PathFinderOutput &output)
+static int ApplyNewPath(PathFinderInput &input, PathFinderOutput &output, int i)
 {
 	char *path = output.Path;
-	int i = AStarFindPath(input.GetUnitPos(),
-						  input.GetGoalPos(),
-						  input.GetGoalSize().x, input.GetGoalSize().y,
-						  input.GetUnitSize().x, input.GetUnitSize().y,
-						  input.GetMinRange(), input.GetMaxRange(),
-						  path, PathFinderOutput::MAX_PATH_LENGTH,
-						  //Wyrmgus start
-//						  *input.GetUnit());
-						  *input.GetUnit(), 0, input.GetGoalMapLayer());
-						  //Wyrmgus end
 	input.PathRacalculated();
 	if (i == PF_FAILED) {
 		i = PF_UNREACHABLE;
@@ -448,6 +558,132 @@ static int NewPath(PathFinderInput &input, PathFinderOutput &output)
 	}
 	return i;
 }
+//Wyrmgus end
+
+/**
+**  Find new path.
+**
+**  The destination could be a unit or a field.
+**  Range gives how far we must reach the goal.
+**
+**  @note  The destination could become negative coordinates!
+**
+**  @param unit  Path for this unit.
+**
+**  @return      >0 remaining path length, 0 wait for path, -1
+**               reached goal, -2 can't reach the goal.
+*/
+static int NewPath(PathFinderInput &input, PathFinderOutput &output)
+{
+	//Wyrmgus start
+	const int i = FindNewPath(input, output.Path);
+
+	return ApplyNewPath(input, output, i);
+	//Wyrmgus end
+}
+
+//Wyrmgus start
+/**
+**  Path search requested by a unit in a batch.
+*/
+struct PathRequest {
+	CUnit *Unit;
+	int Result;
+	char Path[PathFinderOutput::MAX_PATH_LENGTH];
+};
+
+/**
+**  Check whether a unit is going to ask for a new path during its next action.
+**
+**  This refreshes the goal of the path finder input from the current order,
+**  just as NextPathElement does. The first path of an order is still searched
+**  when the order asks for it, since the order is only known to use the path
+**  finder from then on.
+*/
+static bool IsNewPathPending(CUnit &unit)
+{
+	if (unit.Destroyed || !unit.IsAliveOnMap() || !unit.CanMove() || unit.pathFinderData == NULL) {
+		return false;
+	}
+	// in the middle of a step, or waiting: the path won't be needed this cycle
+	if (unit.Moving || unit.Wait || unit.Anim.Unbreakable || unit.CriticalOrder != NULL) {
+		return false;
+	}
+
+	COrder &order = *unit.CurrentOrder();
+	if (order.Finished) {
+		return false;
+	}
+	// only orders which already asked for a path, the others may not use the path finder at all
+	if (!order.PathFinderUsed) {
+		return false;
+	}
+	if (order.HasGoal() && !order.GetGoal()->IsAliveOnMap()) {
+		return false;
+	}
+
+	PathFinderInput &input = unit.pathFinderData->input;
+	order.UpdatePathFinderData(input);
+	return unit.pathFinderData->output.Length <= 0 || input.IsRecalculateNeeded();
+}
+
+static void FindPathJob(void *data, int index)
+{
+	PathRequest &request = static_cast<PathRequest *>(data)[index];
+
+	request.Result = FindNewPath(request.Unit->pathFinderData->input, request.Path);
+}
+
+/**
+**  Compute in advance the new paths the given units are about to ask for.
+**
+**  The searches are split over the thread pool. They only read the map and
+**  the units, so their results don't depend on the number of threads nor on
+**  the order in which they finish. The results are then stored in the order
+**  of the given units, so that the game state stays the same on all peers.
+**
+**  @param units  Units to check, usually the whole unit manager table.
+*/
+void FindPendingPaths(const std::vector<CUnit *> &units)
+{
+	PROFILE_SCOPE("FindPendingPaths");
+
+	static std::vector<PathRequest> requests;
+
+	requests.clear();
+	for (size_t i = 0; i < units.size(); ++i) {
+		if (IsNewPathPending(*units[i])) {
+			PathRequest request;
+			request.Unit = units[i];
+			request.Result = PF_FAILED;
+			requests.push_back(request);
+		}
+	}
+
+	if (requests.empty()) {
+		return;
+	}
+
+	ThreadPool.Run(FindPathJob, &requests[0], requests.size());
+
+	for (size_t i = 0; i < requests.size(); ++i) {
+		PathRequest &request = requests[i];
+		PathFinderData &data = *request.Unit->pathFinderData;
+
+		memcpy(data.output.Path, request.Path, sizeof(request.Path));
+		const int result = ApplyNewPath(data.input, data.output, request.Result);
+		if (result == PF_UNREACHABLE) {
+			data.output.Length = 0;
+		}
+
+		// let NextPathElement use the result, instead of searching again if no path was found
+		COrder &order = *request.Unit->CurrentOrder();
+		order.HasPathFinderResult = true;
+		order.PathFinderResult = result;
+		order.PathFinderResultCycle = GameCycle;
+	}
+}
+//Wyrmgus end
 
 /**
 **  Returns the next element of a path.
@@ -464,14 +700,32 @@ int NextPathElement(CUnit &unit, short int *pxd, short int *pyd)
 	PathFinderInput &input = unit.pathFinderData->input;
 	PathFinderOutput &output = unit.pathFinderData->output;
 
-	unit.CurrentOrder()->UpdatePathFinderData(input);
+	//Wyrmgus start
+//	unit.CurrentOrder()->UpdatePathFinderData(input);
+	COrder &order = *unit.CurrentOrder();
+	order.UpdatePathFinderData(input);
+	order.PathFinderUsed = true;
+
+	// a path searched in advance this cycle, see FindPendingPaths
+	const bool has_result = order.HasPathFinderResult && order.PathFinderResultCycle == GameCycle && !input.IsRecalculateNeeded();
+	order.HasPathFinderResult = false;
+	//Wyrmgus end
 	// Attempt to use path cache
 	// FIXME: If there is a goal, it may have moved, ruining the cache
 	*pxd = 0;
 	*pyd = 0;
 
+	//Wyrmgus start
+	if (has_result && output.Length <= 0) { // the goal was reached, or can't be reached
+		return order.PathFinderResult;
+	}
+	//Wyrmgus end
+
 	// Goal has moved, need to recalculate path or no cached path
-	if (output.Length <= 0 || input.IsRecalculateNeeded()) {
+	//Wyrmgus start
+//	if (output.Length <= 0 || input.IsRecalculateNeeded()) {
+	if (!has_result && (output.Length <= 0 || input.IsRecalculateNeeded())) {
+	//Wyrmgus end
 		const int result = NewPath(input, output);
 
 		if (result == PF_UNREACHABLE) {
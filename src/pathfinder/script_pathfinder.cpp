@@ -84,6 +84,12 @@ static int CclAStar(lua_State *l)
 			AStarKnowUnseenTerrain = true;
 		} else if (!strcmp(value, "dont-know-unseen-terrain")) {
 			AStarKnowUnseenTerrain = false;
+		//Wyrmgus start
+		} else if (!strcmp(value, "hierarchical")) {
+			AStarHierarchical = true;
+		} else if (!strcmp(value, "not-hierarchical")) {
+			AStarHierarchical = false;
+		//Wyrmgus end
 		} else if (!strcmp(value, "unseen-terrain-cost")) {
 			++j;
 			i = LuaToNumber(l, j + 1);
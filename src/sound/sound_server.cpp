@@ -110,6 +110,11 @@ static struct {
 
 	int *MixerBuffer;
 	Uint8 *Buffer;
+	//Wyrmgus start
+	short *MusicBuffer;      /// music converted to the output format, for each mix
+	char *MusicReadBuffer;   /// music read from its sample, for each mix
+	int MusicBufferSize;     /// number of samples which fit into MusicBuffer
+	//Wyrmgus end
 	bool Running;
 } Audio;
 
@@ -160,6 +165,83 @@ static int ConvertToStereo32(const char *src, char *dest, int frequency,
 	return acvt.len_mult * bytes;
 }
 
+//Wyrmgus start
+/**
+**  Check whether a sample is in the output format of the mixer, 44100 hz, stereo, 16 bits per channel.
+*/
+static bool IsSampleInMixerFormat(const CSample *sample)
+{
+	return sample->Frequency == 44100 && sample->Channels == 2 && sample->SampleSize == 16;
+}
+
+/**
+**  Convert a sample loaded in memory to the output format of the mixer.
+**
+**  This is done once when the sample is loaded, so that mixing the sample is
+**  only adding it to the mixer buffer.
+**
+**  @param sample  Sample to convert, its buffer is replaced.
+*/
+static void ConvertSampleToMixerFormat(CSample *sample)
+{
+	if (IsSampleInMixerFormat(sample)) {
+		sample->Len &= ~3; // whole stereo frames, as the mixer would never consume a trailing half frame
+		return;
+	}
+	if (sample->Buffer == NULL || sample->Len <= 0) {
+		return;
+	}
+
+	SDL_AudioCVT acvt;
+	const Uint16 format = sample->SampleSize == 8 ? AUDIO_U8 : AUDIO_S16SYS;
+	if (SDL_BuildAudioCVT(&acvt, format, sample->Channels, sample->Frequency, AUDIO_S16SYS, 2, 44100) < 0) {
+		return;
+	}
+
+	acvt.len = sample->Len;
+	acvt.buf = new Uint8[sample->Len * acvt.len_mult];
+	memcpy(acvt.buf, sample->Buffer, sample->Len);
+	if (SDL_ConvertAudio(&acvt) < 0) {
+		delete[] acvt.buf;
+		return;
+	}
+
+	delete[] sample->Buffer;
+	sample->Buffer = acvt.buf;
+	sample->Len = acvt.len_cvt & ~3; // whole stereo frames
+	sample->Pos = 0;
+	sample->Frequency = 44100;
+	sample->Channels = 2;
+	sample->SampleSize = 16;
+	sample->BitsPerSample = 16;
+}
+
+/**
+**  Add stereo 16 bit samples to stereo 32 bit, with a volume for each side.
+**
+**  The volumes are products of the channel volume and the stereo position, and the
+**  single division is the same as dividing by 128, by MaxVolume and by 2 in turn.
+**  The loop has no branches and no dependencies between iterations, so that the
+**  compiler can vectorize it.
+**
+**  @param src           Input samples.
+**  @param size          Number of samples in the input, counting both channels.
+**  @param left_volume   Volume of the left channel.
+**  @param right_volume  Volume of the right channel.
+**  @param buffer        Buffer for mixed samples.
+*/
+static void MixStereo16ToStereo32(const short *src, int size, int left_volume, int right_volume, int *buffer)
+{
+	// FIXME: why taking out '/ 2' leads to distortion
+	const int divisor = 128 * MaxVolume * 2;
+
+	for (int i = 0; i < size - 1; i += 2) {
+		buffer[i] += src[i] * left_volume / divisor;
+		buffer[i + 1] += src[i + 1] * right_volume / divisor;
+	}
+}
+//Wyrmgus end
+
 /**
 **  Mix music to stereo 32 bit.
 **
@@ -174,9 +256,15 @@ static void MixMusicToStereo32(int *buffer, int size)
 	if (MusicPlaying) {
 		Assert(MusicChannel.Sample);
 
-		short *buf = new short[size];
+		//Wyrmgus start
+//		short *buf = new short[size];
+//		int len = size * sizeof(short);
+//		char *tmp = new char[len];
+		Assert(size <= Audio.MusicBufferSize);
+		short *buf = Audio.MusicBuffer;
 		int len = size * sizeof(short);
-		char *tmp = new char[len];
+		char *tmp = Audio.MusicReadBuffer;
+		//Wyrmgus end
 
 		int div = 176400 / (MusicChannel.Sample->Frequency * (MusicChannel.Sample->SampleSize / 8) * MusicChannel.Sample->Channels);
 
@@ -191,8 +279,10 @@ static void MixMusicToStereo32(int *buffer, int size)
 			buffer[i] += buf[i] * MusicVolume / MaxVolume / 2;
 		}
 
-		delete[] tmp;
-		delete[] buf;
+		//Wyrmgus start
+//		delete[] tmp;
+//		delete[] buf;
+		//Wyrmgus end
 
 		if (n < len) { // End reached
 			MusicPlaying = false;
@@ -243,6 +333,15 @@ static int MixSampleToStereo32(CSample *sample, int index, unsigned char volume,
 
 	Assert(!(index & 1));
 
+	//Wyrmgus start
+	if (IsSampleInMixerFormat(sample)) {
+		// samples loaded in memory were converted when loading them, so they can be added directly
+		size = std::min((sample->Len - index) / 2, size) & ~1;
+		MixStereo16ToStereo32((const short *)(sample->Buffer + index), size, local_volume * left, local_volume * right, buffer);
+		return 2 * size;
+	}
+	//Wyrmgus end
+
 	size = std::min((sample->Len - index) * div / 2, size);
 
 	size = ConvertToStereo32((char *)(sample->Buffer + index), (char *)buf, sample->Frequency,
@@ -250,11 +349,16 @@ static int MixSampleToStereo32(CSample *sample, int index, unsigned char volume,
 							 size * 2 / div);
 
 	size /= 2;
+	//Wyrmgus start
+	/*
 	for (int i = 0; i < size; i += 2) {
 		// FIXME: why taking out '/ 2' leads to distortion
 		buffer[i] += ((short *)buf)[i] * local_volume * left / 128 / MaxVolume / 2;
 		buffer[i + 1] += ((short *)buf)[i + 1] * local_volume * right / 128 / MaxVolume / 2;
 	}
+	*/
+	MixStereo16ToStereo32((const short *) buf, size, local_volume * left, local_volume * right, buffer);
+	//Wyrmgus end
 
 	return 2 * size / div;
 }
@@ -302,6 +406,8 @@ static int MixChannelsToStereo32(int *buffer, int size)
 */
 static void ClipMixToStereo16(const int *mix, int size, short *output)
 {
+	//Wyrmgus start
+	/*
 	const int *end = mix + size;
 
 	while (mix < end) {
@@ -309,6 +415,12 @@ static void ClipMixToStereo16(const int *mix, int size, short *output)
 		clamp(&s, SHRT_MIN, SHRT_MAX);
 		*output++ = s;
 	}
+	*/
+	// indexed and without branches, so that the compiler can vectorize it
+	for (int i = 0; i < size; ++i) {
+		output[i] = (short) std::min(std::max(mix[i], (int) SHRT_MIN), (int) SHRT_MAX);
+	}
+	//Wyrmgus end
 }
 
 /**
@@ -663,6 +775,11 @@ CSample *LoadSample(const std::string &name)
 	if (sample == NULL) {
 		fprintf(stderr, "Can't load the sound '%s'\n", name.c_str());
 	}
+	//Wyrmgus start
+	else {
+		ConvertSampleToMixerFormat(sample);
+	}
+	//Wyrmgus end
 	return sample;
 }
 
@@ -1103,6 +1220,11 @@ int InitSound()
 	memset(Audio.MixerBuffer, 0, Audio.Format.samples * Audio.Format.channels * sizeof(int));
 	Audio.Buffer = new Uint8[Audio.Format.size];
 	memset(Audio.Buffer, 0, Audio.Format.size);
+	//Wyrmgus start
+	Audio.MusicBufferSize = Audio.Format.samples * Audio.Format.channels;
+	Audio.MusicBuffer = new short[Audio.MusicBufferSize];
+	Audio.MusicReadBuffer = new char[Audio.MusicBufferSize * sizeof(short)];
+	//Wyrmgus end
 	Audio.Lock = SDL_CreateMutex();
 	Audio.Cond = SDL_CreateCond();
 	Audio.Running = true;
@@ -1137,6 +1259,13 @@ void QuitSound()
 	Audio.MixerBuffer = NULL;
 	delete[] Audio.Buffer;
 	Audio.Buffer = NULL;
+	//Wyrmgus start
+	delete[] Audio.MusicBuffer;
+	Audio.MusicBuffer = NULL;
+	delete[] Audio.MusicReadBuffer;
+	Audio.MusicReadBuffer = NULL;
+	Audio.MusicBufferSize = 0;
+	//Wyrmgus end
 #ifdef USE_FLUIDSYNTH
 	CleanFluidSynth();
 #endif
@@ -145,6 +145,9 @@
 			unit->Variable[i].Increase = this->Var[i].Increase;
 		}
 		unit->Variable[i].Increase += this->Var[i].AddIncrease;
+		//Wyrmgus start
+		unit->VariablesIncrease = true;
+		//Wyrmgus end
 
 		// Value field
 		if (this->Var[i].ModifValue) {
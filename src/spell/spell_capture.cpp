@@ -113,6 +113,9 @@
 		caster.Variable[KILL_INDEX].Value++;
 		caster.Variable[KILL_INDEX].Max++;
 		caster.Variable[KILL_INDEX].Enable = 1;
+		//Wyrmgus start
+		caster.VariablesIncrease = true;
+		//Wyrmgus end
 	}
 	target->ChangeOwner(*caster.Player);
 	UnitClearOrders(*target);
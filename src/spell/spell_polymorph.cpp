@@ -162,6 +162,9 @@
 		caster.Variable[KILL_INDEX].Value++;
 		caster.Variable[KILL_INDEX].Max++;
 		caster.Variable[KILL_INDEX].Enable = 1;
+		//Wyrmgus start
+		caster.VariablesIncrease = true;
+		//Wyrmgus end
 	}
 
 	// as said somewhere else -- no corpses :)
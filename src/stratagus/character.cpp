@@ -258,10 +258,11 @@ void CleanCharacters()
 	CustomHeroes.clear();
 }
 
-CCharacter *GetCharacter(std::string character_ident)
+CCharacter *GetCharacter(const std::string &character_ident)
 {
-	if (Characters.find(character_ident) != Characters.end()) {
-		return Characters[character_ident];
+	std::map<std::string, CCharacter *>::const_iterator find_iterator = Characters.find(character_ident);
+	if (find_iterator != Characters.end()) {
+		return find_iterator->second;
 	}
 	
 	for (std::map<std::string, CCharacter *>::iterator iterator = Characters.begin(); iterator != Characters.end(); ++iterator) { // for backwards compatibility
@@ -147,6 +147,26 @@ int GetConstructionsCount()
 	return count;
 }
 
+/**
+**  Get the graphic files of the constructions.
+**
+**  @param files  Vector to which the files are added.
+*/
+void GetConstructionFiles(std::vector<std::string> &files)
+{
+	for (std::vector<CConstruction *>::iterator it = Constructions.begin();
+		 it != Constructions.end();
+		 ++it) {
+		const CConstruction &construction = **it;
+
+		if (construction.Ident.empty()) {
+			continue;
+		}
+		files.push_back(construction.File.File);
+		files.push_back(construction.ShadowFile.File);
+	}
+}
+
 /**
 **  Load the graphics for the constructions.
 **
@@ -70,7 +70,7 @@ int GrandStrategyMonth = 0;
 std::string GrandStrategyWorld;
 int PopulationGrowthThreshold = 1000;
 CGrandStrategyGame GrandStrategyGame;
-std::map<std::string, int> GrandStrategyHeroStringToIndex;
+std::unordered_map<std::string, int> GrandStrategyHeroStringToIndex;
 std::vector<CGrandStrategyEvent *> GrandStrategyEvents;
 std::map<std::string, CGrandStrategyEvent *> GrandStrategyEventStringToPointer;
 
@@ -280,10 +280,15 @@ bool CGrandStrategyGame::TradePriority(CGrandStrategyFaction &faction_a, CGrandS
 	return faction_a.Resources[PrestigeCost] > faction_b.Resources[PrestigeCost];
 }
 
-CGrandStrategyHero *CGrandStrategyGame::GetHero(std::string hero_full_name)
+CGrandStrategyHero *CGrandStrategyGame::GetHero(const std::string &hero_full_name)
 {
-	if (!hero_full_name.empty() && GrandStrategyHeroStringToIndex.find(hero_full_name) != GrandStrategyHeroStringToIndex.end()) {
-		return this->Heroes[GrandStrategyHeroStringToIndex[hero_full_name]];
+	if (hero_full_name.empty()) {
+		return NULL;
+	}
+	
+	std::unordered_map<std::string, int>::const_iterator find_iterator = GrandStrategyHeroStringToIndex.find(hero_full_name);
+	if (find_iterator != GrandStrategyHeroStringToIndex.end()) {
+		return this->Heroes[find_iterator->second];
 	} else {
 		return NULL;
 	}
@@ -75,6 +75,9 @@ public:
 	int seek(long offset, int whence);
 	long tell();
 	int write(const void *buf, size_t len);
+	//Wyrmgus start
+	std::string TakeMemoryData();
+	//Wyrmgus end
 
 private:
 	PImpl(const PImpl &rhs); // No implementation
@@ -92,6 +95,9 @@ private:
 #ifdef USE_PHYSFS
 	PHYSFS_File *cl_pf;
 #endif
+	//Wyrmgus start
+	std::string cl_memory;	/// data of a file kept in memory
+	//Wyrmgus end
 };
 
 CFile::CFile() : pimpl(new CFile::PImpl)
@@ -160,6 +166,31 @@ long CFile::tell()
 	return pimpl->tell();
 }
 
+//Wyrmgus start
+/**
+**  Take the data written to a file opened with CL_WRITE_MEMORY, leaving it empty.
+**
+**  @return  The data written so far
+*/
+std::string CFile::TakeMemoryData()
+{
+	return pimpl->TakeMemoryData();
+}
+
+/**
+**  Write raw data to the file.
+**
+**  @param buf  Pointer to the data
+**  @param len  Length of the data in bytes
+**
+**  @return     Number of bytes written
+*/
+int CFile::write(const void *buf, size_t len)
+{
+	return pimpl->write(buf, len);
+}
+//Wyrmgus end
+
 /**
 **  CLprintf Library file write
 **
@@ -168,7 +199,23 @@ long CFile::tell()
 */
 int CFile::printf(const char *format, ...)
 {
+	//Wyrmgus start
+	// most lines fit in a small buffer, so try it first and spare the heap allocation
+	char buffer[1024];
+	va_list stack_ap;
+	va_start(stack_ap, format);
+	const int stack_n = vsnprintf(buffer, sizeof(buffer), format, stack_ap);
+	va_end(stack_ap);
+	if (stack_n > -1 && stack_n < (int) sizeof(buffer)) {
+		return pimpl->write(buffer, stack_n);
+	}
+	//Wyrmgus end
 	int size = 500;
+	//Wyrmgus start
+	if (stack_n > -1) {
+		size = stack_n + 1;
+	}
+	//Wyrmgus end
 	char *p = new char[size];
 	if (p == NULL) {
 		return -1;
@@ -285,6 +332,14 @@ int CFile::PImpl::open(const char *name, long openflags)
 
 	cl_type = CLF_TYPE_INVALID;
 
+	//Wyrmgus start
+	if ((openflags & CL_OPEN_WRITE) && (openflags & CL_WRITE_MEMORY)) {
+		cl_memory.clear();
+		cl_type = CLF_TYPE_MEMORY;
+		return 0;
+	}
+	//Wyrmgus end
+
 	if (openflags & CL_OPEN_WRITE) {
 #ifdef USE_BZ2LIB
 		if ((openflags & CL_WRITE_BZ2)
@@ -392,6 +447,11 @@ int CFile::PImpl::close()
 			ret = PHYSFS_close(cl_pf);
 		}
 #endif // USE_PHYSFS
+		//Wyrmgus start
+		if (tp == CLF_TYPE_MEMORY) {
+			ret = 0;
+		}
+		//Wyrmgus end
 	} else {
 		errno = EBADF;
 	}
@@ -468,12 +528,27 @@ int CFile::PImpl::write(const void *buf, size_t size)
 			ret = BZ2_bzwrite(cl_bz, const_cast<void *>(buf), size);
 		}
 #endif // USE_BZ2LIB
+		//Wyrmgus start
+		if (tp == CLF_TYPE_MEMORY) {
+			cl_memory.append(static_cast<const char *>(buf), size);
+			ret = size;
+		}
+		//Wyrmgus end
 	} else {
 		errno = EBADF;
 	}
 	return ret;
 }
 
+//Wyrmgus start
+std::string CFile::PImpl::TakeMemoryData()
+{
+	std::string data;
+	data.swap(cl_memory);
+	return data;
+}
+//Wyrmgus end
+
 int CFile::PImpl::seek(long offset, int whence)
 {
 	int ret = -1;
@@ -859,4 +934,153 @@ FileWriter *CreateFileWriter(const std::string &filename)
 	}
 }
 
+//Wyrmgus start
+void CBinaryWriter::WriteUnsigned(unsigned long long value)
+{
+	while (value >= 0x80) {
+		this->Data.push_back((unsigned char) ((value & 0x7F) | 0x80));
+		value >>= 7;
+	}
+	this->Data.push_back((unsigned char) value);
+}
+
+void CBinaryWriter::WriteSigned(long long value)
+{
+	this->WriteUnsigned((((unsigned long long) value) << 1) ^ (unsigned long long) (value >> 63));
+}
+
+void CBinaryWriter::WriteString(const std::string &value)
+{
+	this->WriteUnsigned(value.size());
+	this->Data.insert(this->Data.end(), value.begin(), value.end());
+}
+
+unsigned char CBinaryReader::ReadByte()
+{
+	if (this->Failed || this->Position >= this->Data.size()) {
+		this->Failed = true;
+		return 0;
+	}
+	return this->Data[this->Position++];
+}
+
+unsigned long long CBinaryReader::ReadUnsigned()
+{
+	unsigned long long value = 0;
+	for (int shift = 0; shift < 64; shift += 7) {
+		const unsigned char byte = this->ReadByte();
+		if (this->Failed) {
+			return 0;
+		}
+		value |= ((unsigned long long) (byte & 0x7F)) << shift;
+		if ((byte & 0x80) == 0) {
+			return value;
+		}
+	}
+	this->Failed = true;
+	return 0;
+}
+
+long long CBinaryReader::ReadSigned()
+{
+	const unsigned long long value = this->ReadUnsigned();
+	return (long long) (value >> 1) ^ -((long long) (value & 1));
+}
+
+std::string CBinaryReader::ReadString()
+{
+	const unsigned long long length = this->ReadUnsigned();
+	if (this->Failed || length > this->Data.size() - this->Position) {
+		this->Failed = true;
+		return std::string();
+	}
+	const char *start = reinterpret_cast<const char *>(&this->Data[0]) + this->Position;
+	this->Position += (size_t) length;
+	return std::string(start, (size_t) length);
+}
+
+static const char Base64Chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/**
+**  Encode binary data as base64 text.
+**
+**  @param data  Data to encode
+**
+**  @return      The base64 text, padded with '='
+*/
+std::string EncodeBase64(const std::vector<unsigned char> &data)
+{
+	std::string text;
+	text.reserve((data.size() + 2) / 3 * 4);
+	for (size_t i = 0; i < data.size(); i += 3) {
+		const size_t remaining = data.size() - i;
+		unsigned int block = data[i] << 16;
+		if (remaining > 1) {
+			block |= data[i + 1] << 8;
+		}
+		if (remaining > 2) {
+			block |= data[i + 2];
+		}
+		text += Base64Chars[(block >> 18) & 0x3F];
+		text += Base64Chars[(block >> 12) & 0x3F];
+		text += remaining > 1 ? Base64Chars[(block >> 6) & 0x3F] : '=';
+		text += remaining > 2 ? Base64Chars[block & 0x3F] : '=';
+	}
+	return text;
+}
+
+static int DecodeBase64Char(char c)
+{
+	if (c >= 'A' && c <= 'Z') {
+		return c - 'A';
+	} else if (c >= 'a' && c <= 'z') {
+		return c - 'a' + 26;
+	} else if (c >= '0' && c <= '9') {
+		return c - '0' + 52;
+	} else if (c == '+') {
+		return 62;
+	} else if (c == '/') {
+		return 63;
+	}
+	return -1;
+}
+
+/**
+**  Decode base64 text.
+**
+**  @param text  Base64 text, its length must be a multiple of 4
+**  @param data  Receives the decoded data
+**
+**  @return      True if the text was valid base64
+*/
+bool DecodeBase64(const std::string &text, std::vector<unsigned char> &data)
+{
+	data.clear();
+	if (text.size() % 4 != 0) {
+		return false;
+	}
+	data.reserve(text.size() / 4 * 3);
+	for (size_t i = 0; i < text.size(); i += 4) {
+		const bool last = i + 4 == text.size();
+		const int padding = (last && text[i + 3] == '=') ? (text[i + 2] == '=' ? 2 : 1) : 0;
+		unsigned int block = 0;
+		for (int j = 0; j < 4 - padding; ++j) {
+			const int value = DecodeBase64Char(text[i + j]);
+			if (value < 0) {
+				return false;
+			}
+			block |= value << (18 - 6 * j);
+		}
+		data.push_back((block >> 16) & 0xFF);
+		if (padding < 2) {
+			data.push_back((block >> 8) & 0xFF);
+		}
+		if (padding < 1) {
+			data.push_back(block & 0xFF);
+		}
+	}
+	return true;
+}
+//Wyrmgus end
+
 //@}
@@ -33,6 +33,9 @@
 
 #include "luacallback.h"
 
+//Wyrmgus start
+#include "profile.h"
+//Wyrmgus end
 #include "script.h"
 
 /**
@@ -145,6 +148,10 @@ int LuaCallback::popInteger()
 */
 void LuaCallback::run(int results)
 {
+	//Wyrmgus start
+	PROFILE_SCOPE("LuaCallback::run");
+	//Wyrmgus end
+	
 	//FIXME call error reporting function
 	int status = lua_pcall(luastate, arguments, results, base);
 
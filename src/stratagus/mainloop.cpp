@@ -55,6 +55,7 @@
 #include "network.h"
 #include "particle.h"
 //Wyrmgus start
+#include "profile.h"
 #include "quest.h"
 //Wyrmgus end
 #include "replay.h"
@@ -101,6 +102,28 @@ int MouseScrollState = ScrollNone;
 EventCallback GameCallbacks;   /// Game callbacks
 EventCallback EditorCallbacks; /// Editor callbacks
 
+//Wyrmgus start
+/// Game logic phases timed in headless mode
+enum HeadlessPhases {
+	HeadlessPhaseTriggers,
+	HeadlessPhaseUnitActions,
+	HeadlessPhaseMissileActions,
+	HeadlessPhasePlayersEachCycle,
+	HeadlessPhaseAi,
+	MaxHeadlessPhases
+};
+
+static const char *HeadlessPhaseNames[MaxHeadlessPhases] = {
+	"TriggersEachCycle",
+	"UnitActions",
+	"MissileActions",
+	"PlayersEachCycle",
+	"AI (each second)"
+};
+
+static long long HeadlessPhaseTimes[MaxHeadlessPhases]; /// nanoseconds spent in each phase in headless mode
+//Wyrmgus end
+
 //----------------------------------------------------------------------------
 // Functions
 //----------------------------------------------------------------------------
@@ -184,6 +207,10 @@ void DoScrollArea(int state, bool fast, bool isKeyboard)
 */
 void DrawMapArea()
 {
+	//Wyrmgus start
+	PROFILE_SCOPE("DrawMapArea");
+	//Wyrmgus end
+	
 	// Draw all of the viewports
 	for (CViewport *vp = UI.Viewports; vp < UI.Viewports + UI.NumViewports; ++vp) {
 		// Center viewport on tracked unit
@@ -209,6 +236,10 @@ void DrawMapArea()
 */
 void UpdateDisplay()
 {
+	//Wyrmgus start
+	PROFILE_SCOPE("UpdateDisplay");
+	//Wyrmgus end
+	
 	if (GameRunning || Editor.Running == EditorEditing) {
 		// to prevent empty spaces in the UI
 #if defined(USE_OPENGL) || defined(USE_GLES)
@@ -302,6 +333,25 @@ void UpdateDisplay()
 	Invalidate();
 }
 
+//Wyrmgus start
+/**
+**  Add the time spent since the start of a phase to its total, and start the next phase.
+**
+**  @param phase        Phase which has just ended.
+**  @param phase_start  Start time of the phase, set to the current time.
+*/
+static void EndHeadlessPhase(int phase, long long &phase_start)
+{
+	if (!HeadlessMode) {
+		return;
+	}
+
+	const long long now = GetProfileTime();
+	HeadlessPhaseTimes[phase] += now - phase_start;
+	phase_start = now;
+}
+//Wyrmgus end
+
 static void InitGameCallbacks()
 {
 	GameCallbacks.ButtonPressed = HandleButtonDown;
@@ -316,6 +366,10 @@ static void InitGameCallbacks()
 
 static void GameLogicLoop()
 {
+	//Wyrmgus start
+	PROFILE_SCOPE("GameLogicLoop");
+	//Wyrmgus end
+	
 	// Can't find a better place.
 	// FIXME: We need to find a better place!
 	SaveGameLoading = false;
@@ -335,33 +389,27 @@ static void GameLogicLoop()
 		++GameCycle;
 		MultiPlayerReplayEachCycle();
 		NetworkCommands(); // Get network commands
+		//Wyrmgus start
+		long long phase_start = HeadlessMode ? GetProfileTime() : 0;
+		//Wyrmgus end
 		TriggersEachCycle();// handle triggers
+		//Wyrmgus start
+		EndHeadlessPhase(HeadlessPhaseTriggers, phase_start);
+		//Wyrmgus end
 		UnitActions();      // handle units
+		//Wyrmgus start
+		EndHeadlessPhase(HeadlessPhaseUnitActions, phase_start);
+		//Wyrmgus end
 		MissileActions();   // handle missiles
+		//Wyrmgus start
+		EndHeadlessPhase(HeadlessPhaseMissileActions, phase_start);
+		//Wyrmgus end
 		PlayersEachCycle(); // handle players
+		//Wyrmgus start
+		EndHeadlessPhase(HeadlessPhasePlayersEachCycle, phase_start);
+		//Wyrmgus end
 		UpdateTimer();      // update game timer
 
-		//do tile animation
-		if (GameCycle != 0 && GameCycle % (CYCLES_PER_SECOND / 4) == 0) { // same speed as color-cycling
-			for (size_t z = 0; z < Map.Fields.size(); ++z) {
-				for (int i = 0; i < Map.Info.MapWidths[z] * Map.Info.MapHeights[z]; ++i) {
-					CMapField &mf = Map.Fields[z][i];
-					if (mf.Terrain && mf.Terrain->SolidAnimationFrames > 0) {
-						mf.AnimationFrame += 1;
-						if (mf.AnimationFrame >= mf.Terrain->SolidAnimationFrames) {
-							mf.AnimationFrame = 0;
-						}
-					}
-					if (mf.OverlayTerrain && mf.OverlayTerrain->SolidAnimationFrames > 0) {
-						mf.OverlayAnimationFrame += 1;
-						if (mf.OverlayAnimationFrame >= mf.OverlayTerrain->SolidAnimationFrames) {
-							mf.OverlayAnimationFrame = 0;
-						}
-					}
-				}
-			}
-		}
-
 		//
 		// Work todo each second.
 		// Split into different frames, to reduce cpu time.
@@ -410,6 +458,10 @@ static void GameLogicLoop()
 		}
 		
 		//Wyrmgus start
+		if (HeadlessMode) {
+			phase_start = GetProfileTime();
+		}
+		
 		int player = (GameCycle - 1) % CYCLES_PER_SECOND;
 		Assert(player >= 0);
 		if (player < NumPlayers) {
@@ -430,6 +482,8 @@ static void GameLogicLoop()
 		if (player < NumPlayers) {
 			PlayersEachMinute(player);
 		}
+		
+		EndHeadlessPhase(HeadlessPhaseAi, phase_start);
 		//Wyrmgus end
 		
 		//Wyrmgus start
@@ -483,16 +537,24 @@ static void GameLogicLoop()
 			UI.StatusLine.Set(_("Autosave"));
 			//Wyrmgus start
 //			SaveGame("autosave.sav");
+			SaveGameInBackground = true;
 			CclCommand("if (RunSaveGame ~= nil) then RunSaveGame(\"autosave.sav\") end;");
+			SaveGameInBackground = false;
 			//Wyrmgus end
 		}
+		//Wyrmgus start
+		CheckBackgroundSave();
+		//Wyrmgus end
 	}
 
 	UpdateMessages();     // update messages
 	ParticleManager.update(); // handle particles
 	CheckMusicFinished(); // Check for next song
 
-	if (FastForwardCycle <= GameCycle || !(GameCycle & 0x3f)) {
+	//Wyrmgus start
+//	if (FastForwardCycle <= GameCycle || !(GameCycle & 0x3f)) {
+	if (!HeadlessMode && (FastForwardCycle <= GameCycle || !(GameCycle & 0x3f))) {
+	//Wyrmgus end
 		WaitEventsOneFrame();
 	}
 
@@ -508,6 +570,10 @@ static	int RealVideoSyncSpeed;
 
 static void DisplayLoop()
 {
+	//Wyrmgus start
+	PROFILE_SCOPE("DisplayLoop");
+	//Wyrmgus end
+	
 #if defined(USE_OPENGL) || defined(USE_GLES)
 	if (UseOpenGL) {
 		/* update only if screen changed */
@@ -561,11 +627,66 @@ static void DisplayLoop()
 #endif
 }
 
+//Wyrmgus start
+/**
+**  Print the speed of the game logic and the time spent in each of its phases.
+**
+**  @param cycles  Number of game cycles run.
+**  @param time    Time spent running them, in nanoseconds.
+*/
+static void PrintHeadlessReport(unsigned long cycles, long long time)
+{
+	const double seconds = std::max(time, 1LL) / 1000000000.0;
+
+	fprintf(stdout, "Headless run: %lu cycles in %.3f s, %.1f cycles/s\n", cycles, seconds, cycles / seconds);
+	long long other_time = time;
+	for (int i = 0; i < MaxHeadlessPhases; ++i) {
+		fprintf(stdout, "  %-20s %10.3f s %6.1f%%\n", HeadlessPhaseNames[i], HeadlessPhaseTimes[i] / 1000000000.0, HeadlessPhaseTimes[i] * 100.0 / std::max(time, 1LL));
+		other_time -= HeadlessPhaseTimes[i];
+	}
+	fprintf(stdout, "  %-20s %10.3f s %6.1f%%\n", "Other", other_time / 1000000000.0, other_time * 100.0 / std::max(time, 1LL));
+	fprintf(stdout, "Final cycle: %lu, SyncHash: 0x%08x\n", GameCycle, SyncHash);
+	fflush(stdout);
+}
+
+/**
+**  Run only the game logic as fast as possible, until the game ends or the headless cycle limit is reached.
+*/
+static void HeadlessGameLoop()
+{
+	const unsigned long start_cycle = GameCycle;
+	for (int i = 0; i < MaxHeadlessPhases; ++i) {
+		HeadlessPhaseTimes[i] = 0;
+	}
+	const long long start_time = GetProfileTime();
+
+	while (GameRunning) {
+		GameLogicLoop();
+		if (HeadlessCycles != 0 && GameCycle - start_cycle >= HeadlessCycles) {
+			StopGame(GameExit);
+		}
+		Profiler.EndFrame();
+	}
+
+	PrintHeadlessReport(GameCycle - start_cycle, GetProfileTime() - start_time);
+}
+//Wyrmgus end
+
 static void SingleGameLoop()
 {
+	//Wyrmgus start
+	if (HeadlessMode) {
+		HeadlessGameLoop();
+		return;
+	}
+	//Wyrmgus end
+	
 	while (GameRunning) {
 		DisplayLoop();
 		GameLogicLoop();
+		//Wyrmgus start
+		Profiler.EndFrame();
+		//Wyrmgus end
 	}
 }
 
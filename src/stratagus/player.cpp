@@ -62,11 +62,16 @@
 #include "netconnect.h"
 //Wyrmgus start
 #include "parameters.h"
+#include "pathfinder.h"
+#include "profile.h"
 #include "quest.h"
 #include "settings.h"
 //Wyrmgus end
 #include "sound.h"
 #include "translate.h"
+//Wyrmgus start
+#include "trigger.h"
+//Wyrmgus end
 #include "unitsound.h"
 #include "unittype.h"
 #include "unit.h"
@@ -1566,6 +1571,7 @@ void CPlayer::Init(/* PlayerTypes */ int type)
 
 	//Wyrmgus start
 	this->UnitTypesCount.clear();
+	InvalidateDependCache(*this);
 	this->UnitTypesUnderConstructionCount.clear();
 	this->UnitTypesAiActiveCount.clear();
 	this->Heroes.clear();
@@ -1871,7 +1877,7 @@ void CPlayer::ShareUpgradeProgress(CPlayer &player, CUnit &unit)
 		
 		CUpgrade *upgrade = AllUpgrades[upgrade_id];
 		
-		if (player.Allow.Upgrades[upgrade->ID] != 'A' || !CheckDependByIdent(player, upgrade->Ident)) {
+		if (player.Allow.Upgrades[upgrade->ID] != 'A' || !CheckDependByUpgrade(player, *upgrade)) {
 			continue;
 		}
 	
@@ -2456,6 +2462,10 @@ std::vector<CUpgrade *> CPlayer::GetResearchableUpgrades()
 */
 void CPlayer::Clear()
 {
+	//Wyrmgus start
+	// the counts the cached dependencies rely on are cleared below, and the index is needed to find the cache
+	InvalidateDependCache(*this);
+	//Wyrmgus end
 	Index = 0;
 	Name.clear();
 	Type = 0;
@@ -2940,7 +2950,7 @@ bool CPlayer::CanAcceptQuest(CQuest *quest)
 				}
 			}
 				
-			if (!has_researcher || this->Allow.Upgrades[upgrade->ID] != 'A' || !CheckDependByIdent(*this, upgrade->Ident)) {
+			if (!has_researcher || this->Allow.Upgrades[upgrade->ID] != 'A' || !CheckDependByUpgrade(*this, *upgrade)) {
 				return false;
 			}
 		} else if (objective->ObjectiveType == RecruitHeroObjectiveType) {
@@ -3081,7 +3091,7 @@ std::string CPlayer::HasFailedQuest(CQuest *quest) // returns the reason for fai
 					}
 				}
 				
-				if (!has_researcher || this->Allow.Upgrades[upgrade->ID] != 'A' || !CheckDependByIdent(*this, upgrade->Ident)) {
+				if (!has_researcher || this->Allow.Upgrades[upgrade->ID] != 'A' || !CheckDependByUpgrade(*this, *upgrade)) {
 					return "You can no longer research the required upgrade.";
 				}
 			}
@@ -3240,6 +3250,10 @@ void CPlayer::ChangeResource(const int resource, const int value, const bool sto
 			this->Resources[resource] += value;
 		}
 	}
+	
+	//Wyrmgus start
+	TriggerResourceChanged(resource);
+	//Wyrmgus end
 }
 
 /**
@@ -3264,6 +3278,10 @@ void CPlayer::SetResource(const int resource, const int value, const int type)
 	} else if (type == STORE_OVERALL) {
 		this->Resources[resource] = value;
 	}
+	
+	//Wyrmgus start
+	TriggerResourceChanged(resource);
+	//Wyrmgus end
 }
 
 /**
@@ -3756,6 +3774,9 @@ void CPlayer::SetUnitTypeCount(const CUnitType *type, int quantity)
 	} else {
 		this->UnitTypesCount[type] = quantity;
 	}
+	
+	InvalidateDependCache(*this);
+	TriggerUnitTypeCountChanged(type);
 }
 
 void CPlayer::ChangeUnitTypeCount(const CUnitType *type, int quantity)
@@ -3945,12 +3966,17 @@ void PlayersInitAi()
 */
 void PlayersEachCycle()
 {
+	//Wyrmgus start
+	PROFILE_SCOPE("PlayersEachCycle");
+	//Wyrmgus end
+	
 	for (int player = 0; player < NumPlayers; ++player) {
 		CPlayer &p = Players[player];
 		
 		//Wyrmgus start
 		if (p.LostTownHallTimer && !p.Revealed && p.LostTownHallTimer < ((int) GameCycle) && ThisPlayer->HasContactWith(p)) {
 			p.Revealed = true;
+			AStarMapExplorationChanged();
 			for (int j = 0; j < NumPlayers; ++j) {
 				if (player != j && Players[j].Type != PlayerNobody) {
 					Players[j].Notify(_("%s's units have been revealed!"), p.Name.c_str());
@@ -3986,6 +4012,10 @@ void PlayersEachCycle()
 */
 void PlayersEachSecond(int playerIdx)
 {
+	//Wyrmgus start
+	PROFILE_SCOPE("PlayersEachSecond");
+	//Wyrmgus end
+	
 	CPlayer &player = Players[playerIdx];
 
 	if ((GameCycle / CYCLES_PER_SECOND) % 10 == 0) {
@@ -4013,6 +4043,10 @@ void PlayersEachSecond(int playerIdx)
 */
 void PlayersEachHalfMinute(int playerIdx)
 {
+	//Wyrmgus start
+	PROFILE_SCOPE("PlayersEachHalfMinute");
+	//Wyrmgus end
+	
 	CPlayer &player = Players[playerIdx];
 
 	if (player.AiEnabled) {
@@ -4029,6 +4063,10 @@ void PlayersEachHalfMinute(int playerIdx)
 */
 void PlayersEachMinute(int playerIdx)
 {
+	//Wyrmgus start
+	PROFILE_SCOPE("PlayersEachMinute");
+	//Wyrmgus end
+	
 	CPlayer &player = Players[playerIdx];
 
 	if (player.AiEnabled) {
@@ -0,0 +1,253 @@
+//       _________ __                 __
+//      /   _____//  |_____________ _/  |______     ____  __ __  ______
+//      \_____  \\   __\_  __ \__  \\   __\__  \   / ___\|  |  \/  ___/
+//      /        \|  |  |  | \// __ \|  |  / __ \_/ /_/  >  |  /\___ |
+//     /_______  /|__|  |__|  (____  /__| (____  /\___  /|____//____  >
+//             \/                  \/          \//_____/            \/
+//  ______________________                           ______________________
+//                        T H E   W A R   B E G I N S
+//         Stratagus - A free fantasy real time strategy game engine
+//
+/**@name profile.cpp - The profiler. */
+//
+//      (c) Copyright 2018 by Andrettin
+//
+//      This program is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; only version 2 of the License.
+//
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+//      02111-1307, USA.
+//
+
+
+//@{
+
+/*----------------------------------------------------------------------------
+--  Includes
+----------------------------------------------------------------------------*/
+
+#include "stratagus.h"
+
+#include "profile.h"
+
+#include "parameters.h"
+
+#include "SDL.h"
+
+#include <chrono>
+
+/*----------------------------------------------------------------------------
+--  Variables
+----------------------------------------------------------------------------*/
+
+CProfiler Profiler;
+
+/*----------------------------------------------------------------------------
+--  Functions
+----------------------------------------------------------------------------*/
+
+/**
+**  Get the current time of the profiling clock.
+**
+**  @return  The current time, in nanoseconds.
+*/
+long long GetProfileTime()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+**  Start or stop recording scopes and counters.
+**
+**  Starting clears the frames recorded before, stopping keeps them so that they can still be saved.
+**  The scopes are recorded for the thread which starts the profiler.
+**
+**  @param enabled  Whether to record scopes and counters.
+*/
+void CProfiler::SetEnabled(bool enabled)
+{
+	if (enabled == this->Enabled) {
+		return;
+	}
+
+	if (enabled) {
+		this->ThreadId = SDL_ThreadID();
+		this->Frames.resize(PROFILE_FRAME_COUNT);
+		this->FrameCount = 0;
+		this->NextFrame = 0;
+		this->SlowestFrame = Frame();
+		this->CurrentFrame.Events.clear();
+		this->CurrentFrame.Counters.clear();
+		this->CurrentFrame.DroppedEvents = 0;
+		this->CurrentFrame.Start = GetProfileTime();
+	}
+	this->Enabled = enabled;
+}
+
+/**
+**  End the frame being recorded and add it to the ring buffer.
+*/
+void CProfiler::EndFrame()
+{
+	if (!this->Enabled) {
+		return;
+	}
+
+	const long long now = GetProfileTime();
+	Frame &frame = this->CurrentFrame;
+	frame.Cycle = GameCycle;
+	frame.Duration = now - frame.Start;
+	if (frame.Duration > this->SlowestFrame.Duration) {
+		this->SlowestFrame = frame;
+	}
+
+	// swap the frame into the ring buffer, so that the vectors of the frame it replaces are reused
+	std::swap(this->Frames[this->NextFrame], frame);
+	this->NextFrame = (this->NextFrame + 1) % PROFILE_FRAME_COUNT;
+	this->FrameCount = std::min(this->FrameCount + 1, PROFILE_FRAME_COUNT);
+
+	frame.Events.clear();
+	frame.Counters.clear();
+	frame.DroppedEvents = 0;
+	frame.Start = now;
+}
+
+/**
+**  Start a timed scope.
+**
+**  @return  The start time of the scope, or -1 if it is not on the profiled thread.
+*/
+long long CProfiler::BeginScope() const
+{
+	if (SDL_ThreadID() != this->ThreadId) {
+		return -1;
+	}
+	return GetProfileTime();
+}
+
+/**
+**  End a timed scope and add it to the current frame.
+**
+**  @param name   Name of the scope.
+**  @param start  Start time of the scope, as returned by BeginScope.
+*/
+void CProfiler::EndScope(const char *name, long long start)
+{
+	if (this->CurrentFrame.Events.size() >= PROFILE_MAX_FRAME_EVENTS) {
+		this->CurrentFrame.DroppedEvents++;
+		return;
+	}
+
+	Event event;
+	event.Name = name;
+	event.Start = start;
+	event.Duration = GetProfileTime() - start;
+	this->CurrentFrame.Events.push_back(event);
+}
+
+/**
+**  Add a value to a counter of the current frame, if profiling is enabled.
+**
+**  @param name   Name of the counter.
+**  @param value  Value to add.
+*/
+void CProfiler::Count(const char *name, long long value)
+{
+	if (!this->Enabled || SDL_ThreadID() != this->ThreadId) {
+		return;
+	}
+
+	std::vector<Counter> &counters = this->CurrentFrame.Counters;
+	for (size_t i = 0; i < counters.size(); ++i) {
+		if (counters[i].Name == name) {
+			counters[i].Value += value;
+			return;
+		}
+	}
+
+	Counter counter;
+	counter.Name = name;
+	counter.Value = value;
+	counters.push_back(counter);
+}
+
+/**
+**  Write a frame as trace events.
+**
+**  @param file   File to write to.
+**  @param frame  Frame to write.
+**  @param base   Time written as 0, in nanoseconds.
+*/
+static void SaveTraceFrame(FILE *file, const CProfiler::Frame &frame, long long base)
+{
+	fprintf(file, ",\n{\"name\":\"Frame\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"cycle\":%lu,\"dropped\":%d}}",
+		(frame.Start - base) / 1000.0, frame.Duration / 1000.0, frame.Cycle, frame.DroppedEvents);
+
+	for (size_t i = 0; i < frame.Events.size(); ++i) {
+		const CProfiler::Event &event = frame.Events[i];
+		fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f}",
+			event.Name, (event.Start - base) / 1000.0, event.Duration / 1000.0);
+	}
+
+	for (size_t i = 0; i < frame.Counters.size(); ++i) {
+		const CProfiler::Counter &counter = frame.Counters[i];
+		fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"C\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"args\":{\"value\":%lld}}",
+			counter.Name, (frame.Start - base) / 1000.0, counter.Value);
+	}
+}
+
+/**
+**  Save the recorded frames in the Chrome trace event format.
+**
+**  The slowest frame is saved as well if it is not in the ring buffer anymore.
+**
+**  @param filename  Name of the file, in the user directory.
+**
+**  @return  True if the file could be written.
+*/
+bool CProfiler::SaveTrace(const std::string &filename) const
+{
+	if (filename.find_first_of("\\/") != std::string::npos) {
+		fprintf(stderr, "\\ or / not allowed in SaveProfileTrace filename\n");
+		return false;
+	}
+
+	const std::string destination = Parameters::Instance.GetUserDirectory() + "/" + filename;
+	FILE *file = fopen(destination.c_str(), "wb");
+	if (!file) {
+		fprintf(stderr, "Can't save to '%s'\n", destination.c_str());
+		return false;
+	}
+
+	const int first_frame = (this->NextFrame - this->FrameCount + PROFILE_FRAME_COUNT) % PROFILE_FRAME_COUNT;
+	const bool save_slowest_frame = this->SlowestFrame.Duration > 0 && (this->FrameCount == 0 || this->SlowestFrame.Start < this->Frames[first_frame].Start);
+	long long base = 0;
+	if (save_slowest_frame) {
+		base = this->SlowestFrame.Start;
+	} else if (this->FrameCount > 0) {
+		base = this->Frames[first_frame].Start;
+	}
+
+	fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"Main\"}}");
+	if (save_slowest_frame) {
+		SaveTraceFrame(file, this->SlowestFrame, base);
+	}
+	for (int i = 0; i < this->FrameCount; ++i) {
+		SaveTraceFrame(file, this->Frames[(first_frame + i) % PROFILE_FRAME_COUNT], base);
+	}
+	fprintf(file, "\n]}\n");
+	fclose(file);
+
+	return true;
+}
+
+//@}
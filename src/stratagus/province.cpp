@@ -54,7 +54,7 @@ std::vector<CWorld *> Worlds;
 std::vector<CRegion *> Regions;
 std::vector<CProvince *> Provinces;
 std::vector<CWorldMapTerrainType *> WorldMapTerrainTypes;
-std::map<std::string, int> WorldMapTerrainTypeStringToIndex;
+std::unordered_map<std::string, int> WorldMapTerrainTypeStringToIndex;
 
 /*----------------------------------------------------------------------------
 --  Functions
@@ -164,8 +164,9 @@ int GetWorldMapTerrainTypeId(std::string terrain_type_name)
 		return -1;
 	}
 	
-	if (WorldMapTerrainTypeStringToIndex.find(terrain_type_name) != WorldMapTerrainTypeStringToIndex.end()) {
-		return WorldMapTerrainTypeStringToIndex[terrain_type_name];
+	std::unordered_map<std::string, int>::const_iterator find_iterator = WorldMapTerrainTypeStringToIndex.find(terrain_type_name);
+	if (find_iterator != WorldMapTerrainTypeStringToIndex.end()) {
+		return find_iterator->second;
 	}
 	
 	return -1;
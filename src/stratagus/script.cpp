@@ -60,6 +60,7 @@
 #include "parameters.h"
 //Wyrmgus start
 #include "player.h"
+#include "profile.h"
 #include "spells.h"
 //Wyrmgus end
 #include "translate.h"
@@ -182,6 +183,10 @@ static int luatraceback(lua_State *L)
 */
 int LuaCall(int narg, int clear, bool exitOnError)
 {
+	//Wyrmgus start
+	PROFILE_SCOPE("LuaCall");
+	//Wyrmgus end
+	
 	const int base = lua_gettop(Lua) - narg;  // function index
 	lua_pushcfunction(Lua, luatraceback);  // push traceback function
 	lua_insert(Lua, base);  // put it under chunk and args
@@ -3200,6 +3205,10 @@ void CclGetDate(lua_State *l, CDate *d, const int offset)
 */
 int CclCommand(const std::string &command, bool exitOnError)
 {
+	//Wyrmgus start
+	PROFILE_SCOPE("CclCommand");
+	//Wyrmgus end
+	
 	const int status = luaL_loadbuffer(Lua, command.c_str(), command.size(), command.c_str());
 
 	if (!status) {
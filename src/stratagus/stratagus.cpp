@@ -198,6 +198,9 @@ extern void beos_init(int argc, char **argv);
 #include "results.h"
 #include "settings.h"
 #include "sound_server.h"
+//Wyrmgus start
+#include "thread_pool.h"
+//Wyrmgus end
 #include "title.h"
 #include "translate.h"
 #include "ui.h"
@@ -251,6 +254,14 @@ std::string MenuRace;
 bool EnableDebugPrint;				/// if enabled, print the debug messages
 bool EnableAssert;					/// if enabled, halt on assertion failures
 bool EnableUnitDebug;				/// if enabled, a unit info dump will be created
+//Wyrmgus start
+bool HeadlessMode;					/// if enabled, only the game logic is run, without display, sound or input
+unsigned long HeadlessCycles;		/// number of cycles to run in headless mode, 0 to run until the game ends
+static std::string HeadlessReplayName;	/// replay to play in headless mode
+
+extern void StartMap(const std::string &filename, bool clean);
+extern void StartReplay(const std::string &filename, bool reveal);
+//Wyrmgus end
 
 /*============================================================================
 ==  MAIN
@@ -316,6 +327,38 @@ static int MenuLoop()
 	return status;
 }
 
+//Wyrmgus start
+/**
+**  Play the map or replay given on the command line in headless mode.
+*/
+static void HeadlessLoop()
+{
+	initGuichan();
+	InterfaceState = IfaceStateMenu;
+
+	if (!HeadlessReplayName.empty()) {
+		StartReplay(HeadlessReplayName, false);
+	} else {
+		StartMap(CliMapName, true);
+	}
+}
+
+/**
+**  Make SDL use its dummy drivers, so that no window or sound device is needed in headless mode.
+*/
+static void SetHeadlessDrivers()
+{
+	SDL_putenv(strdup("SDL_VIDEODRIVER=dummy"));
+	SDL_putenv(strdup("SDL_AUDIODRIVER=dummy"));
+	Video.FullScreen = 0;
+#if defined(USE_OPENGL) || defined(USE_GLES)
+	ForceUseOpenGL = 1;
+	UseOpenGL = 0;
+	ZoomNoResize = 0;
+#endif
+}
+//Wyrmgus end
+
 //----------------------------------------------------------------------------
 
 /**
@@ -419,6 +462,10 @@ void Exit(int err)
 	StopMusic();
 	QuitSound();
 	NetworkQuitGame();
+	//Wyrmgus start
+	WaitForBackgroundSave();
+	ThreadPool.Exit();
+	//Wyrmgus end
 
 	ExitNetwork1();
 	CleanModules();
@@ -476,6 +523,10 @@ static void Usage()
 		"\t-F\t\tFull screen video mode\n"
 		"\t-G \"options\"\tGame options (passed to game scripts)\n"
 		"\t-h\t\tHelp shows this page\n"
+		//Wyrmgus start
+		"\t-H cycles\tHeadless mode: run only the game logic of the map or replay as fast as possible,\n"
+		"\t  \t\tfor the given number of cycles (0 = until the game ends), then print its timings\n"
+		//Wyrmgus end
 		"\t-i\t\tEnables unit info dumping into log (for debugging)\n"
 		"\t-I addr\t\tNetwork address to use\n"
 		"\t-l\t\tDisable command log\n"
@@ -486,6 +537,9 @@ static void Usage()
 #endif
 		"\t-p\t\tEnables debug messages printing in console\n"
 		"\t-P port\t\tNetwork port to use\n"
+		//Wyrmgus start
+		"\t-R replay\tReplay to play in headless mode\n"
+		//Wyrmgus end
 		"\t-s sleep\tNumber of frames for the AI to sleep before it starts\n"
 		"\t-S speed\tSync speed (100 = 30 frames/s)\n"
 		"\t-u userpath\tPath where stratagus saves preferences, log and savegame\n"
@@ -543,7 +597,10 @@ static void RedirectOutput()
 void ParseCommandLine(int argc, char **argv, Parameters &parameters)
 {
 	for (;;) {
-		switch (getopt(argc, argv, "ac:d:D:eE:FG:hiI:lN:oOP:ps:S:u:v:Wx:Z?-")) {
+		//Wyrmgus start
+//		switch (getopt(argc, argv, "ac:d:D:eE:FG:hiI:lN:oOP:ps:S:u:v:Wx:Z?-")) {
+		switch (getopt(argc, argv, "ac:d:D:eE:FG:hH:iI:lN:oOP:pR:s:S:u:v:Wx:Z?-")) {
+		//Wyrmgus end
 			case 'a':
 				EnableAssert = true;
 				continue;
@@ -578,6 +635,12 @@ void ParseCommandLine(int argc, char **argv, Parameters &parameters)
 			case 'G':
 				parameters.luaScriptArguments = optarg;
 				continue;
+			//Wyrmgus start
+			case 'H':
+				HeadlessMode = true;
+				HeadlessCycles = strtoul(optarg, NULL, 10);
+				continue;
+			//Wyrmgus end
 			case 'i':
 				EnableUnitDebug = true;
 				continue;
@@ -611,6 +674,11 @@ void ParseCommandLine(int argc, char **argv, Parameters &parameters)
 			case 'p':
 				EnableDebugPrint = true;
 				continue;
+			//Wyrmgus start
+			case 'R':
+				HeadlessReplayName = optarg;
+				continue;
+			//Wyrmgus end
 			case 's':
 				AiSleepCycles = atoi(optarg);
 				continue;
@@ -694,6 +762,20 @@ void ParseCommandLine(int argc, char **argv, Parameters &parameters)
 			CliMapName[index] = '/';
 		}
 	}
+	
+	//Wyrmgus start
+	if (HeadlessMode && CliMapName.empty() && HeadlessReplayName.empty()) {
+		fprintf(stderr, "headless mode needs a map file or a replay\n");
+		Usage();
+		ExitFatal(-1);
+	}
+	
+	if (!HeadlessReplayName.empty() && !HeadlessMode) {
+		fprintf(stderr, "a replay can only be given in headless mode\n");
+		Usage();
+		ExitFatal(-1);
+	}
+	//Wyrmgus end
 }
 
 #ifdef USE_WIN32
@@ -783,16 +865,30 @@ int stratagusMain(int argc, char **argv)
 	// Initialise AI module
 	InitAiModule();
 
+	//Wyrmgus start
+	// Start the worker threads
+	ThreadPool.Init();
+	//Wyrmgus end
+
 	LoadCcl(parameters.luaStartFilename, parameters.luaScriptArguments);
 
 	PrintHeader();
 	PrintLicense();
 
+	//Wyrmgus start
+	if (HeadlessMode) {
+		SetHeadlessDrivers();
+	}
+	//Wyrmgus end
+
 	// Setup video display
 	InitVideo();
 
 	// Setup sound card
-	if (!InitSound()) {
+	//Wyrmgus start
+//	if (!InitSound()) {
+	if (!HeadlessMode && !InitSound()) {
+	//Wyrmgus end
 		InitMusic();
 	}
 
@@ -805,7 +901,12 @@ int stratagusMain(int argc, char **argv)
 	LoadFonts();
 	SetClipping(0, 0, Video.Width - 1, Video.Height - 1);
 	Video.ClearScreen();
-	ShowTitleScreens();
+	//Wyrmgus start
+//	ShowTitleScreens();
+	if (!HeadlessMode) {
+		ShowTitleScreens();
+	}
+	//Wyrmgus end
 
 	// Init player data
 	ThisPlayer = NULL;
@@ -816,7 +917,14 @@ int stratagusMain(int argc, char **argv)
 	UnitManager.Init();	// Units memory management
 	PreMenuSetup();		// Load everything needed for menus
 
-	MenuLoop();
+	//Wyrmgus start
+//	MenuLoop();
+	if (HeadlessMode) {
+		HeadlessLoop();
+	} else {
+		MenuLoop();
+	}
+	//Wyrmgus end
 
 	Exit(0);
 #ifdef USE_STACKTRACE
@@ -0,0 +1,256 @@
+//       _________ __                 __
+//      /   _____//  |_____________ _/  |______     ____  __ __  ______
+//      \_____  \\   __\_  __ \__  \\   __\__  \   / ___\|  |  \/  ___/
+//      /        \|  |  |  | \// __ \|  |  / __ \_/ /_/  >  |  /\___ |
+//     /_______  /|__|  |__|  (____  /__| (____  /\___  /|____//____  >
+//             \/                  \/          \//_____/            \/
+//  ______________________                           ______________________
+//                        T H E   W A R   B E G I N S
+//         Stratagus - A free fantasy real time strategy game engine
+//
+/**@name thread_pool.cpp - The worker thread pool. */
+//
+//      (c) Copyright 2018 by Andrettin
+//
+//      This program is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; only version 2 of the License.
+//
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+//      02111-1307, USA.
+//
+
+//@{
+
+/*----------------------------------------------------------------------------
+--  Includes
+----------------------------------------------------------------------------*/
+
+#include "stratagus.h"
+
+#include "thread_pool.h"
+
+#include "SDL.h"
+
+#ifdef USE_WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+/*----------------------------------------------------------------------------
+--  Variables
+----------------------------------------------------------------------------*/
+
+CThreadPool ThreadPool;
+
+/*----------------------------------------------------------------------------
+--  Functions
+----------------------------------------------------------------------------*/
+
+/**
+**  Get the number of processors available to the process.
+**
+**  @return  The number of processors, at least 1.
+*/
+int GetProcessorCount()
+{
+#ifdef USE_WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	const int count = info.dwNumberOfProcessors;
+#elif defined(_SC_NPROCESSORS_ONLN)
+	const int count = sysconf(_SC_NPROCESSORS_ONLN);
+#else
+	const int count = 1;
+#endif
+	return std::max(1, count);
+}
+
+/**
+**  Start the worker threads.
+**
+**  @param thread_count  Number of worker threads to start, -1 to use one less than the number of processors.
+*/
+void CThreadPool::Init(int thread_count)
+{
+	Assert(this->Threads.empty());
+
+	if (thread_count < 0) {
+		thread_count = GetProcessorCount() - 1;
+	}
+
+	this->Lock = SDL_CreateMutex();
+	this->JobCond = SDL_CreateCond();
+	this->DoneCond = SDL_CreateCond();
+	this->Running = true;
+
+	for (int i = 0; i < thread_count; ++i) {
+		SDL_Thread *thread = SDL_CreateThread(CThreadPool::WorkerThread, this);
+		if (thread == NULL) {
+			fprintf(stderr, "Could not create worker thread: %s\n", SDL_GetError());
+			break;
+		}
+		this->Threads.push_back(thread);
+	}
+}
+
+/**
+**  Stop the worker threads.
+*/
+void CThreadPool::Exit()
+{
+	if (this->Lock == NULL) {
+		return;
+	}
+
+	SDL_LockMutex(this->Lock);
+	this->Running = false;
+	SDL_CondBroadcast(this->JobCond);
+	SDL_UnlockMutex(this->Lock);
+
+	for (size_t i = 0; i < this->Threads.size(); ++i) {
+		SDL_WaitThread(this->Threads[i], NULL);
+	}
+	this->Threads.clear();
+
+	SDL_DestroyCond(this->DoneCond);
+	SDL_DestroyCond(this->JobCond);
+	SDL_DestroyMutex(this->Lock);
+	this->DoneCond = NULL;
+	this->JobCond = NULL;
+	this->Lock = NULL;
+}
+
+/**
+**  Run a batch of jobs and wait for all of them to be done.
+**
+**  @param function  Function called for each job.
+**  @param data      User data passed to the function.
+**  @param count     Number of jobs, the function is called with every index from 0 to count - 1.
+*/
+void CThreadPool::Run(JobFunction function, void *data, int count)
+{
+	if (this->Threads.empty() || count <= 1) {
+		for (int i = 0; i < count; ++i) {
+			function(data, i);
+		}
+		return;
+	}
+
+	SDL_LockMutex(this->Lock);
+	Assert(this->PendingJobs == 0);
+	this->Function = function;
+	this->Data = data;
+	this->JobCount = count;
+	this->NextJob = 0;
+	this->PendingJobs = count;
+	SDL_CondBroadcast(this->JobCond);
+
+	// help the workers while there are jobs left
+	while (this->NextJob < this->JobCount) {
+		const int index = this->NextJob++;
+		SDL_UnlockMutex(this->Lock);
+		function(data, index);
+		SDL_LockMutex(this->Lock);
+		--this->PendingJobs;
+	}
+
+	while (this->PendingJobs > 0) {
+		SDL_CondWait(this->DoneCond, this->Lock);
+	}
+	this->Function = NULL;
+	this->Data = NULL;
+	this->JobCount = 0;
+	this->NextJob = 0;
+	SDL_UnlockMutex(this->Lock);
+}
+
+/**
+**  Rows of an image split into slices, each slice being one job.
+*/
+struct RowSlices
+{
+	CThreadPool::RowsFunction Function;  /// function called for each slice
+	void *Data;                          /// user data passed to the function
+	int RowCount;                        /// total number of rows
+	int SliceRows;                       /// number of rows of each slice but the last one
+};
+
+static void RunRowSlice(void *data, int index)
+{
+	const RowSlices &slices = *static_cast<RowSlices *>(data);
+	const int first_row = index * slices.SliceRows;
+	const int last_row = std::min(first_row + slices.SliceRows, slices.RowCount);
+
+	slices.Function(slices.Data, first_row, last_row);
+}
+
+/**
+**  Process the rows of an image in slices spread over the threads, and wait for all of them to be done.
+**
+**  The slices do not overlap, so each row is written by one job only; the function may
+**  still read rows outside of its slice as long as no job writes them.
+**
+**  @param function   Function called with the half-open range [first_row, last_row) of each slice.
+**  @param data       User data passed to the function.
+**  @param row_count  Number of rows to process.
+**  @param min_rows   Minimum number of rows of a slice, to keep the jobs worth their overhead.
+*/
+void CThreadPool::RunRows(RowsFunction function, void *data, int row_count, int min_rows)
+{
+	if (row_count <= 0) {
+		return;
+	}
+
+	// a few slices per thread, so that uneven rows still keep every thread busy
+	const int max_slices = std::max(1, row_count / std::max(1, min_rows));
+	const int slice_count = std::min(this->GetThreadCount() * 4, max_slices);
+
+	RowSlices slices;
+	slices.Function = function;
+	slices.Data = data;
+	slices.RowCount = row_count;
+	slices.SliceRows = (row_count + slice_count - 1) / slice_count;
+	this->Run(RunRowSlice, &slices, (row_count + slices.SliceRows - 1) / slices.SliceRows);
+}
+
+int CThreadPool::WorkerThread(void *data)
+{
+	static_cast<CThreadPool *>(data)->WorkerLoop();
+	return 0;
+}
+
+void CThreadPool::WorkerLoop()
+{
+	SDL_LockMutex(this->Lock);
+	while (true) {
+		while (this->Running && this->NextJob >= this->JobCount) {
+			SDL_CondWait(this->JobCond, this->Lock);
+		}
+		if (!this->Running) {
+			break;
+		}
+
+		const int index = this->NextJob++;
+		JobFunction function = this->Function;
+		void *data = this->Data;
+		SDL_UnlockMutex(this->Lock);
+		function(data, index);
+		SDL_LockMutex(this->Lock);
+
+		if (--this->PendingJobs == 0) {
+			SDL_CondSignal(this->DoneCond);
+		}
+	}
+	SDL_UnlockMutex(this->Lock);
+}
+
+//@}
@@ -372,6 +372,22 @@ int GetIconsCount()
 	return Icons.size();
 }
 
+/**
+**  Get the graphic files of the icons which have not been loaded yet.
+**
+**  @param files  Vector to which the files are added.
+*/
+void GetIconFiles(std::vector<std::string> &files)
+{
+	for (IconMap::iterator it = Icons.begin(); it != Icons.end(); ++it) {
+		const CIcon &icon = *(*it).second;
+
+		if (icon.G && !icon.G->IsLoaded()) {
+			files.push_back(icon.G->File);
+		}
+	}
+}
+
 /**
 **  Load the graphics for the icons.
 */
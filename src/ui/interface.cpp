@@ -50,6 +50,9 @@
 //Wyrmgus end
 #include "network.h"
 #include "player.h"
+//Wyrmgus start
+#include "profile.h"
+//Wyrmgus end
 #include "replay.h"
 #include "sound.h"
 #include "sound_server.h"
@@ -1218,6 +1221,18 @@ static int InputKey(int key)
 				FastForwardCycle = atoi(&Input[4]);
 			}
 
+			//Wyrmgus start
+			// Toggle profiling, or save the profiled frames
+			if (strcmp(Input, "profile") == 0) {
+				Profiler.SetEnabled(!Profiler.IsEnabled());
+				SetMessage("%s", Profiler.IsEnabled() ? _("Profiling enabled") : _("Profiling disabled"));
+			} else if (strcmp(Input, "profile save") == 0) {
+				if (Profiler.SaveTrace("profile.json")) {
+					SetMessage("%s", _("Profile saved to profile.json"));
+				}
+			}
+			//Wyrmgus end
+
 			if (Input[0]) {
 				// Replace ~ with ~~
 				ReplaceTildeBy2Tilde(Input);
@@ -48,6 +48,10 @@
 #include "upgrade_structs.h"
 #include "upgrade.h"
 
+//Wyrmgus start
+#include <bitset>
+//Wyrmgus end
+
 /*----------------------------------------------------------------------------
 --  Variables
 ----------------------------------------------------------------------------*/
@@ -57,12 +61,129 @@ static DependRule *DependHash[101];
 //Wyrmgus start
 /// All predependencies hash (predependencies are checked to see whether a button should be displayed at all)
 static DependRule *PredependHash[101];
+
+/// Rules of each unit type and upgrade target, indexed by unit type slot or upgrade ID, so that checks don't have to walk the hash chains
+static std::vector<DependRule *> UnitTypeDependRules;
+static std::vector<DependRule *> UpgradeDependRules;
+static std::vector<DependRule *> UnitTypePredependRules;
+static std::vector<DependRule *> UpgradePredependRules;
+
+/// Number of combinations of the ignore_units, is_predependency and is_neutral_use check options
+static const int DependCheckVariantCount = 8;
+
+/**
+**  Cached results of the dependency checks of a player.
+**
+**  The results only depend on the player's units, upgrade and unit allow states and faction,
+**  so they are thrown away by InvalidateDependCache() when any of those changes.
+*/
+class CDependCache
+{
+public:
+	CDependCache() : Faction(-1) {}
+
+	void Clear()
+	{
+		for (int i = 0; i < DependCheckVariantCount; ++i) {
+			UnitTypeKnown[i].reset();
+			UpgradeKnown[i].reset();
+		}
+	}
+
+	int Faction;														/// faction of the player when the results were cached
+	std::bitset<UnitTypeMax> UnitTypeKnown[DependCheckVariantCount];	/// whether the result for a unit type has been cached
+	std::bitset<UnitTypeMax> UnitTypeAllowed[DependCheckVariantCount];	/// cached result for a unit type
+	std::bitset<UpgradeMax> UpgradeKnown[DependCheckVariantCount];		/// whether the result for an upgrade has been cached
+	std::bitset<UpgradeMax> UpgradeAllowed[DependCheckVariantCount];	/// cached result for an upgrade
+};
+
+static CDependCache DependCaches[PlayerMax];
 //Wyrmgus end
 
 /*----------------------------------------------------------------------------
 --  Functions
 ----------------------------------------------------------------------------*/
 
+//Wyrmgus start
+static std::vector<DependRule *> &GetDependRules(char type, bool is_predependency)
+{
+	if (type == DependRuleUnitType) {
+		return is_predependency ? UnitTypePredependRules : UnitTypeDependRules;
+	} else {
+		return is_predependency ? UpgradePredependRules : UpgradeDependRules;
+	}
+}
+
+static int GetDependRuleIndex(const DependRule &rule)
+{
+	if (rule.Type == DependRuleUnitType) {
+		return rule.Kind.UnitType ? rule.Kind.UnitType->Slot : -1;
+	} else {
+		return rule.Kind.Upgrade ? rule.Kind.Upgrade->ID : -1;
+	}
+}
+
+/**
+**  Find the rules of a unit type or upgrade.
+**
+**  @param rule              Rule giving the target.
+**  @param is_predependency  Whether to find the predependency rules instead of the dependency ones.
+**
+**  @return  The base rule of the target, or null if it has no rules.
+*/
+static const DependRule *FindDependRule(const DependRule &rule, bool is_predependency)
+{
+	const std::vector<DependRule *> &rules = GetDependRules(rule.Type, is_predependency);
+	const int index = GetDependRuleIndex(rule);
+	if (index < 0 || index >= (int) rules.size()) {
+		return NULL;
+	}
+	return rules[index];
+}
+
+static int GetDependCheckVariant(bool ignore_units, bool is_predependency, bool is_neutral_use)
+{
+	return (ignore_units ? 1 : 0) | (is_predependency ? 2 : 0) | (is_neutral_use ? 4 : 0);
+}
+
+/**
+**  Get the dependency check cache of a player.
+**
+**  @return  The cache, or null if the player has none.
+*/
+static CDependCache *GetDependCache(const CPlayer &player)
+{
+	if (player.Index < 0 || player.Index >= PlayerMax) {
+		return NULL;
+	}
+	CDependCache &cache = DependCaches[player.Index];
+	if (cache.Faction != player.Faction) {
+		cache.Clear();
+		cache.Faction = player.Faction;
+	}
+	return &cache;
+}
+
+/**
+**  Throw away the cached dependency check results of a player.
+**
+**  Must be called whenever the player's units, or the allow state of unit types or upgrades for the player change.
+*/
+void InvalidateDependCache(const CPlayer &player)
+{
+	if (player.Index >= 0 && player.Index < PlayerMax) {
+		DependCaches[player.Index].Clear();
+	}
+}
+
+static void InvalidateAllDependCaches()
+{
+	for (int i = 0; i < PlayerMax; ++i) {
+		DependCaches[i].Clear();
+	}
+}
+//Wyrmgus end
+
 /**
 **  Add a new dependency. If already exits append to and rule.
 **
@@ -145,6 +266,18 @@ static void AddDependency(const std::string &target, const std::string &required
 		//Wyrmgus end
 	}
 
+	//Wyrmgus start
+	const int index = GetDependRuleIndex(*node);
+	if (index >= 0) {
+		std::vector<DependRule *> &rules = GetDependRules(node->Type, is_predependency);
+		if (index >= (int) rules.size()) {
+			rules.resize(index + 1, NULL);
+		}
+		rules[index] = node;
+	}
+	InvalidateAllDependCaches();
+	//Wyrmgus end
+
 	//  Adjust count.
 	if (count < 0 || count > 255) {
 		DebugPrint("wrong count `%d' range 0 .. 255\n" _C_ count);
@@ -234,14 +367,10 @@ static bool CheckDependByRule(const CPlayer &player, DependRule &rule, bool igno
 	//Wyrmgus end
 	
 	//  Find rule
-	int i = (int)((intptr_t)rule.Kind.UnitType % (sizeof(DependHash) / sizeof(*DependHash)));
 	//Wyrmgus start
-	if (is_predependency) {
-		i = (int)((intptr_t)rule.Kind.UnitType % (sizeof(PredependHash) / sizeof(*PredependHash)));
-	}
-//	const DependRule *node = DependHash[i];
-	const DependRule *node = is_predependency ? PredependHash[i] : DependHash[i];
-	//Wyrmgus end
+	/*
+	int i = (int)((intptr_t)rule.Kind.UnitType % (sizeof(DependHash) / sizeof(*DependHash)));
+	const DependRule *node = DependHash[i];
 
 	if (node) {  // find correct entry
 		while (node->Type != rule.Type || node->Kind.Upgrade != rule.Kind.Upgrade) {
@@ -253,6 +382,13 @@ static bool CheckDependByRule(const CPlayer &player, DependRule &rule, bool igno
 	} else {
 		return true;
 	}
+	*/
+	int i;
+	const DependRule *node = FindDependRule(rule, is_predependency);
+	if (!node) {
+		return true;
+	}
+	//Wyrmgus end
 
 	//  Prove the rules
 	node = node->Rule;
@@ -311,20 +447,9 @@ static bool CheckDependByRule(const CUnit &unit, DependRule &rule, bool ignore_u
 	}
 	
 	//  Find rule
-	int i = (int)((intptr_t)rule.Kind.UnitType % (sizeof(DependHash) / sizeof(*DependHash)));
-	if (is_predependency) {
-		i = (int)((intptr_t)rule.Kind.UnitType % (sizeof(PredependHash) / sizeof(*PredependHash)));
-	}
-	const DependRule *node = is_predependency ? PredependHash[i] : DependHash[i];
-	
-	if (node) {  // find correct entry
-		while (node->Type != rule.Type || node->Kind.Upgrade != rule.Kind.Upgrade) {
-			if (!node->Next) {  // end of list
-				return true;
-			}
-			node = node->Next;
-		}
-	} else {
+	int i;
+	const DependRule *node = FindDependRule(rule, is_predependency);
+	if (!node) {
 		return true;
 	}
 
@@ -402,6 +527,8 @@ std::string PrintDependencies(const CPlayer &player, const ButtonAction &button)
 	}
 
 	//  Find rule
+	//Wyrmgus start
+	/*
 	int i = (int)((intptr_t)rule.Kind.UnitType % (sizeof(DependHash) / sizeof(*DependHash)));
 	const DependRule *node = DependHash[i];
 
@@ -415,6 +542,13 @@ std::string PrintDependencies(const CPlayer &player, const ButtonAction &button)
 	} else {
 		return rules;
 	}
+	*/
+	int i;
+	const DependRule *node = FindDependRule(rule, false);
+	if (!node) {
+		return rules;
+	}
+	//Wyrmgus end
 
 	//  Prove the rules
 	node = node->Rule;
@@ -464,6 +598,8 @@ std::string PrintDependencies(const CPlayer &player, const ButtonAction &button)
 bool CheckDependByIdent(const CPlayer &player, const std::string &target, bool ignore_units, bool is_predependency, bool is_neutral_use)
 //Wyrmgus end
 {
+	//Wyrmgus start
+	/*
 	DependRule rule;
 
 	//
@@ -479,41 +615,81 @@ bool CheckDependByIdent(const CPlayer &player, const std::string &target, bool i
 	} else if (!strncmp(target.c_str(), "upgrade-", 8)) {
 		// target string refers to upgrade-XXX
 		rule.Kind.Upgrade = CUpgrade::Get(target);
-		//Wyrmgus start
-//		if (UpgradeIdAllowed(player, rule.Kind.Upgrade->ID) != 'A') {
-		if (UpgradeIdAllowed(player, rule.Kind.Upgrade->ID) != 'A' && !((is_predependency || is_neutral_use) && UpgradeIdAllowed(player, rule.Kind.Upgrade->ID) == 'R')) {
-		//Wyrmgus end
+		if (UpgradeIdAllowed(player, rule.Kind.Upgrade->ID) != 'A') {
 			return false;
 		}
-		//Wyrmgus start
-		if (player.Faction != -1 && PlayerRaces.Factions[player.Faction]->Type == FactionTypeHolyOrder) { // if the player is a holy order, and the upgrade is incompatible with its deity, don't allow it
-			if (PlayerRaces.Factions[player.Faction]->HolyOrderDeity) {
-				CUpgrade *deity_upgrade = CUpgrade::Get("upgrade-deity-" + PlayerRaces.Factions[player.Faction]->HolyOrderDeity->Ident);
-				if (deity_upgrade) {
-					for (size_t z = 0; z < rule.Kind.Upgrade->UpgradeModifiers.size(); ++z) {
-						if (std::find(rule.Kind.Upgrade->UpgradeModifiers[z]->RemoveUpgrades.begin(), rule.Kind.Upgrade->UpgradeModifiers[z]->RemoveUpgrades.end(), deity_upgrade) != rule.Kind.Upgrade->UpgradeModifiers[z]->RemoveUpgrades.end()) {
-							return false;
-						}
+		rule.Type = DependRuleUpgrade;
+	} else {
+		DebugPrint("target '%s' should be unit-type or upgrade\n" _C_ target.c_str());
+		return false;
+	}
+	return CheckDependByRule(player, rule);
+	*/
+	if (!strncmp(target.c_str(), "unit-", 5)) {
+		// target string refers to unit-XXX
+		return CheckDependByType(player, *UnitTypeByIdent(target), ignore_units, is_predependency);
+	} else if (!strncmp(target.c_str(), "upgrade-", 8)) {
+		// target string refers to upgrade-XXX
+		return CheckDependByUpgrade(player, *CUpgrade::Get(target), ignore_units, is_predependency, is_neutral_use);
+	} else {
+		DebugPrint("target '%s' should be unit-type or upgrade\n" _C_ target.c_str());
+		return false;
+	}
+	//Wyrmgus end
+}
+
+//Wyrmgus start
+/**
+**  Check if this upgrade is available.
+**
+**  @param player   For this player available.
+**  @param upgrade  Upgrade.
+**
+**  @return         True if available, false otherwise.
+*/
+bool CheckDependByUpgrade(const CPlayer &player, const CUpgrade &upgrade, bool ignore_units, bool is_predependency, bool is_neutral_use)
+{
+	CDependCache *cache = GetDependCache(player);
+	const int variant = GetDependCheckVariant(ignore_units, is_predependency, is_neutral_use);
+	if (cache && cache->UpgradeKnown[variant][upgrade.ID]) {
+		return cache->UpgradeAllowed[variant][upgrade.ID];
+	}
+
+	bool allowed = true;
+	if (UpgradeIdAllowed(player, upgrade.ID) != 'A' && !((is_predependency || is_neutral_use) && UpgradeIdAllowed(player, upgrade.ID) == 'R')) {
+		allowed = false;
+	}
+	if (allowed && player.Faction != -1 && PlayerRaces.Factions[player.Faction]->Type == FactionTypeHolyOrder) { // if the player is a holy order, and the upgrade is incompatible with its deity, don't allow it
+		if (PlayerRaces.Factions[player.Faction]->HolyOrderDeity) {
+			CUpgrade *deity_upgrade = CUpgrade::Get("upgrade-deity-" + PlayerRaces.Factions[player.Faction]->HolyOrderDeity->Ident);
+			if (deity_upgrade) {
+				for (size_t z = 0; z < upgrade.UpgradeModifiers.size() && allowed; ++z) {
+					if (std::find(upgrade.UpgradeModifiers[z]->RemoveUpgrades.begin(), upgrade.UpgradeModifiers[z]->RemoveUpgrades.end(), deity_upgrade) != upgrade.UpgradeModifiers[z]->RemoveUpgrades.end()) {
+						allowed = false;
 					}
-					for (size_t z = 0; z < deity_upgrade->UpgradeModifiers.size(); ++z) {
-						if (std::find(deity_upgrade->UpgradeModifiers[z]->RemoveUpgrades.begin(), deity_upgrade->UpgradeModifiers[z]->RemoveUpgrades.end(), rule.Kind.Upgrade) != deity_upgrade->UpgradeModifiers[z]->RemoveUpgrades.end()) {
-							return false;
-						}
+				}
+				for (size_t z = 0; z < deity_upgrade->UpgradeModifiers.size() && allowed; ++z) {
+					if (std::find(deity_upgrade->UpgradeModifiers[z]->RemoveUpgrades.begin(), deity_upgrade->UpgradeModifiers[z]->RemoveUpgrades.end(), &upgrade) != deity_upgrade->UpgradeModifiers[z]->RemoveUpgrades.end()) {
+						allowed = false;
 					}
 				}
 			}
 		}
-		//Wyrmgus end
+	}
+	if (allowed) {
+		DependRule rule;
+		rule.Kind.Upgrade = &upgrade;
 		rule.Type = DependRuleUpgrade;
-	} else {
-		DebugPrint("target '%s' should be unit-type or upgrade\n" _C_ target.c_str());
-		return false;
+		allowed = CheckDependByRule(player, rule, ignore_units, is_predependency);
 	}
-	//Wyrmgus start
-//	return CheckDependByRule(player, rule);
-	return CheckDependByRule(player, rule, ignore_units, is_predependency);
-	//Wyrmgus end
+
+	if (cache) {
+		cache->UpgradeKnown[variant][upgrade.ID] = true;
+		cache->UpgradeAllowed[variant][upgrade.ID] = allowed;
+	}
+	return allowed;
 }
+//Wyrmgus end
 
 //Wyrmgus start
 /**
@@ -565,6 +741,16 @@ bool CheckDependByIdent(const CUnit &unit, const std::string &target, bool ignor
 bool CheckDependByType(const CPlayer &player, const CUnitType &type, bool ignore_units, bool is_predependency)
 //Wyrmgus end
 {
+	//Wyrmgus start
+	CDependCache *cache = GetDependCache(player);
+	const int variant = GetDependCheckVariant(ignore_units, is_predependency, false);
+	if (cache && cache->UnitTypeKnown[variant][type.Slot]) {
+		return cache->UnitTypeAllowed[variant][type.Slot];
+	}
+	//Wyrmgus end
+	
+	//Wyrmgus start
+	/*
 	if (UnitIdAllowed(player, type.Slot) == 0) {
 		return false;
 	}
@@ -572,9 +758,21 @@ bool CheckDependByType(const CPlayer &player, const CUnitType &type, bool ignore
 
 	rule.Kind.UnitType = &type;
 	rule.Type = DependRuleUnitType;
-	//Wyrmgus start
-//	return CheckDependByRule(player, rule);
-	return CheckDependByRule(player, rule, ignore_units, is_predependency);
+	return CheckDependByRule(player, rule);
+	*/
+	bool allowed = UnitIdAllowed(player, type.Slot) != 0;
+	if (allowed) {
+		DependRule rule;
+		rule.Kind.UnitType = &type;
+		rule.Type = DependRuleUnitType;
+		allowed = CheckDependByRule(player, rule, ignore_units, is_predependency);
+	}
+
+	if (cache) {
+		cache->UnitTypeKnown[variant][type.Slot] = true;
+		cache->UnitTypeAllowed[variant][type.Slot] = allowed;
+	}
+	return allowed;
 	//Wyrmgus end
 }
 
@@ -666,6 +864,12 @@ void CleanDependencies()
 		}
 		PredependHash[u] = NULL;
 	}
+	
+	UnitTypeDependRules.clear();
+	UpgradeDependRules.clear();
+	UnitTypePredependRules.clear();
+	UpgradePredependRules.clear();
+	InvalidateAllDependCaches();
 	//Wyrmgus end
 }
 
@@ -739,6 +739,9 @@ static int CclUnit(lua_State *l)
 			if (index != -1) { // Valid index
 				lua_rawgeti(l, 2, j + 1);
 				DefineVariableField(l, unit->Variable + index, -1);
+				//Wyrmgus start
+				unit->VariablesIncrease = true;
+				//Wyrmgus end
 				lua_pop(l, 1);
 				continue;
 			}
@@ -1188,6 +1191,9 @@ static int CclSetResourcesHeld(lua_State *l)
 	unit->Variable[GIVERESOURCE_INDEX].Value = value;
 	unit->Variable[GIVERESOURCE_INDEX].Max = value;
 	unit->Variable[GIVERESOURCE_INDEX].Enable = 1;
+	//Wyrmgus start
+	unit->VariablesIncrease = true;
+	//Wyrmgus end
 
 	return 0;
 }
@@ -1954,6 +1960,9 @@ static int CclSetUnitVariable(lua_State *l)
 	} else if (!strcmp(name, "RegenerationRate")) {
 		value = LuaToNumber(l, 3);
 		unit->Variable[HP_INDEX].Increase = std::min(unit->Variable[HP_INDEX].Max, value);
+		//Wyrmgus start
+		unit->VariablesIncrease = true;
+		//Wyrmgus end
 	} else if (!strcmp(name, "IndividualUpgrade")) {
 		LuaCheckArgs(l, 4);
 		std::string upgrade_ident = LuaToString(l, 3);
@@ -2120,6 +2129,7 @@ static int CclSetUnitVariable(lua_State *l)
 			}
 		}
 		//Wyrmgus start
+		unit->VariablesIncrease = true;
 		if (index == ATTACKRANGE_INDEX && unit->Container) {
 			unit->Container->UpdateContainerAttackRange();
 		} else if (index == LEVELUP_INDEX) {
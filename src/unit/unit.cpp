@@ -389,6 +389,38 @@ static unsigned long HelpMeLastCycle;     /// Last cycle HelpMe sound played
 static int HelpMeLastX;                   /// Last X coordinate HelpMe sound played
 static int HelpMeLastY;                   /// Last Y coordinate HelpMe sound played
 
+//Wyrmgus start
+/**
+**  Influence grid of an aura on a map layer.
+**
+**  Each tile has a bit set in Players for each player with a carrier of the aura
+**  covering the tile, and in Overlap for each player with more than one.
+*/
+struct AuraInfluenceGrid
+{
+	std::vector<Uint32> Players;          /// players with a carrier covering each tile
+	std::vector<Uint32> Overlap;          /// players with several carriers covering each tile
+};
+
+/**
+**  Area stamped onto an aura influence grid, to be cleared on the next update.
+*/
+struct AuraInfluenceArea
+{
+	int Aura;                             /// index of the aura in AuraIndexes
+	int MapLayer;                         /// map layer of the grid
+	Vec2i MinPos;                         /// top left tile of the area
+	Vec2i MaxPos;                         /// bottom right tile of the area
+};
+
+static const int AuraIndexes[] = {LEADERSHIPAURA_INDEX, REGENERATIONAURA_INDEX, HYDRATINGAURA_INDEX};
+static const int AuraCount = sizeof(AuraIndexes) / sizeof(*AuraIndexes);
+static_assert(PlayerMax <= 32, "AuraInfluenceGrid needs a bit for each player");
+
+static std::vector<AuraInfluenceGrid> AuraInfluence[AuraCount];  /// influence grids of each aura, per map layer
+static std::vector<AuraInfluenceArea> AuraInfluenceAreas;        /// areas stamped by the last update
+//Wyrmgus end
+
 /*----------------------------------------------------------------------------
 --  Functions
 ----------------------------------------------------------------------------*/
@@ -507,6 +539,9 @@ void CUnit::Init()
 	memset(VisCount, 0, sizeof(VisCount));
 	memset(&Seen, 0, sizeof(Seen));
 	Variable = NULL;
+	//Wyrmgus start
+	VariablesIncrease = true;
+	//Wyrmgus end
 	TTL = 0;
 	Threshold = 0;
 	GroupId = 0;
@@ -672,6 +707,9 @@ void CUnit::ReplaceOnTop(CUnit &replaced_unit)
 	this->Variable[GIVERESOURCE_INDEX].Value = replaced_unit.Variable[GIVERESOURCE_INDEX].Value;
 	this->Variable[GIVERESOURCE_INDEX].Max = replaced_unit.Variable[GIVERESOURCE_INDEX].Max;
 	this->Variable[GIVERESOURCE_INDEX].Enable = replaced_unit.Variable[GIVERESOURCE_INDEX].Enable;
+	//Wyrmgus start
+	this->VariablesIncrease = true;
+	//Wyrmgus end
 	
 	replaced_unit.Remove(NULL); // Destroy building beneath
 	UnitLost(replaced_unit);
@@ -803,6 +841,7 @@ void CUnit::IncreaseLevel(int level_quantity, bool automatic_learning)
 	}
 	
 	this->Variable[LEVELUP_INDEX].Enable = 1;
+	this->VariablesIncrease = true;
 	
 	this->Player->UpdateLevelUpUnits();
 }
@@ -835,6 +874,7 @@ void CUnit::Retrain()
 						this->Variable[LEVELUP_INDEX].Value += 1;
 						this->Variable[LEVELUP_INDEX].Max = this->Variable[LEVELUP_INDEX].Value;
 						this->Variable[LEVELUP_INDEX].Enable = 1;
+						this->VariablesIncrease = true;
 						TransformUnitIntoType(*this, *UnitTypes[i]);
 						if (!IsNetworkGame() && Character != NULL) {	//save the unit-type experience upgrade for persistent characters
 							if (Character->Type->Slot != i) {
@@ -936,6 +976,7 @@ void CUnit::SetCharacter(std::string character_full_name, bool custom_hero)
 		}
 		
 		memcpy(Variable, this->Character->Type->Stats[this->Player->Index].Variables, UnitTypeVar.GetNumberVariable() * sizeof(*Variable));
+		this->VariablesIncrease = true;
 	} else {
 		fprintf(stderr, "Character \"%s\" has no unit type.\n", character_full_name.c_str());
 		return;
@@ -987,6 +1028,7 @@ void CUnit::SetCharacter(std::string character_full_name, bool custom_hero)
 	}
 	
 	this->Variable[XP_INDEX].Enable = 1;
+	this->VariablesIncrease = true;
 	this->Variable[XP_INDEX].Value = this->Variable[XPREQUIRED_INDEX].Value * this->Character->ExperiencePercent / 100;
 	this->Variable[XP_INDEX].Max = this->Variable[XP_INDEX].Value;
 	
@@ -1054,6 +1096,7 @@ void CUnit::SetCharacter(std::string character_full_name, bool custom_hero)
 	}
 
 	this->Variable[HERO_INDEX].Max = this->Variable[HERO_INDEX].Value = this->Variable[HERO_INDEX].Enable = 1;
+	this->VariablesIncrease = true;
 	
 	this->ChooseVariation(); //choose a new variation now
 	for (int i = 0; i < MaxImageLayers; ++i) {
@@ -1490,6 +1533,7 @@ void CUnit::EquipItem(CUnit &item, bool affect_character)
 			Variable[HP_INDEX].Value += item.Variable[i].Value;
 			Variable[HP_INDEX].Max += item.Variable[i].Max;
 			Variable[HP_INDEX].Increase += item.Variable[i].Increase;
+			VariablesIncrease = true;
 		} else if (i == SIGHTRANGE_INDEX || i == DAYSIGHTRANGEBONUS_INDEX || i == NIGHTSIGHTRANGEBONUS_INDEX) {
 			if (!SaveGameLoading) {
 				MapUnmarkUnitSight(*this);
@@ -1526,6 +1570,7 @@ void CUnit::DeequipItem(CUnit &item, bool affect_character)
 			Variable[HP_INDEX].Value -= item.Variable[i].Value;
 			Variable[HP_INDEX].Max -= item.Variable[i].Max;
 			Variable[HP_INDEX].Increase -= item.Variable[i].Increase;
+			VariablesIncrease = true;
 		} else if (i == SIGHTRANGE_INDEX || i == DAYSIGHTRANGEBONUS_INDEX || i == NIGHTSIGHTRANGEBONUS_INDEX) {
 			MapUnmarkUnitSight(*this);
 			Variable[i].Value -= item.Variable[i].Value;
@@ -1669,34 +1714,17 @@ void CUnit::ConsumeElixir(CUpgrade *elixir, bool affect_character)
 	}
 }
 
-void CUnit::ApplyAura(int aura_index)
+/**
+**  Apply the effects of the auras covering the unit.
+**
+**  The auras are read from the influence grids, so UpdateAuraInfluence must have
+**  been called for the current second.
+*/
+void CUnit::ApplyAuras()
 {
-	if (aura_index == LEADERSHIPAURA_INDEX) {
-		if (!this->IsInCombat()) {
-			return;
-		}
-	}
-	
-	this->ApplyAuraEffect(aura_index);
-			
-	//apply aura to all appropriate nearby units
-	int aura_range = AuraRange - (this->Type->TileWidth - 1);
-	std::vector<CUnit *> table;
-	SelectAroundUnit(*this, aura_range, table, MakeOrPredicate(HasSamePlayerAs(*this->Player), IsAlliedWith(*this->Player)), true);
-	for (size_t i = 0; i != table.size(); ++i) {
-		table[i]->ApplyAuraEffect(aura_index);
-	}
-	
-	table.clear();
-	SelectAroundUnit(*this, aura_range, table, MakeOrPredicate(MakeOrPredicate(HasSamePlayerAs(*this->Player), IsAlliedWith(*this->Player)), HasSamePlayerAs(Players[PlayerNumNeutral])), true);
-	for (size_t i = 0; i != table.size(); ++i) {
-		if (table[i]->UnitInside) {
-			CUnit *uins = table[i]->UnitInside;
-			for (int j = 0; j < table[i]->InsideCount; ++j, uins = uins->NextContained) {
-				if (uins->Player == this->Player || uins->IsAllied(*this->Player)) {
-					uins->ApplyAuraEffect(aura_index);
-				}
-			}
+	for (int i = 0; i < AuraCount; ++i) {
+		if (this->IsUnderAura(AuraIndexes[i])) {
+			this->ApplyAuraEffect(AuraIndexes[i]);
 		}
 	}
 }
@@ -1855,6 +1883,7 @@ void CUnit::SetUnique(CUniqueItem *unique)
 			this->Variable[GIVERESOURCE_INDEX].Value = unique->ResourcesHeld;
 			this->Variable[GIVERESOURCE_INDEX].Max = unique->ResourcesHeld;
 			this->Variable[GIVERESOURCE_INDEX].Enable = 1;
+			this->VariablesIncrease = true;
 		}
 		if (unique->Set) {
 			this->Variable[MAGICLEVEL_INDEX].Value += unique->Set->MagicLevel;
@@ -2113,7 +2142,7 @@ void CUnit::GeneratePrefix(CUnit *dropper, CPlayer *dropper_player)
 	}
 	if (dropper_player != NULL) {
 		for (size_t i = 0; i < AllUpgrades.size(); ++i) {
-			if (this->Type->ItemClass != -1 && AllUpgrades[i]->ItemPrefix[Type->ItemClass] && CheckDependByIdent(*dropper_player, AllUpgrades[i]->Ident)) {
+			if (this->Type->ItemClass != -1 && AllUpgrades[i]->ItemPrefix[Type->ItemClass] && CheckDependByUpgrade(*dropper_player, *AllUpgrades[i])) {
 				potential_prefixes.push_back(AllUpgrades[i]);
 			}
 		}
@@ -2136,7 +2165,7 @@ void CUnit::GenerateSuffix(CUnit *dropper, CPlayer *dropper_player)
 	}
 	if (dropper_player != NULL) {
 		for (size_t i = 0; i < AllUpgrades.size(); ++i) {
-			if (this->Type->ItemClass != -1 && AllUpgrades[i]->ItemSuffix[Type->ItemClass] && CheckDependByIdent(*dropper_player, AllUpgrades[i]->Ident)) {
+			if (this->Type->ItemClass != -1 && AllUpgrades[i]->ItemSuffix[Type->ItemClass] && CheckDependByUpgrade(*dropper_player, *AllUpgrades[i])) {
 				if (Prefix == NULL || !AllUpgrades[i]->IncompatibleAffixes[Prefix->ID]) { //don't allow a suffix incompatible with the prefix to appear
 					potential_suffixes.push_back(AllUpgrades[i]);
 				}
@@ -2175,7 +2204,7 @@ void CUnit::GenerateWork(CUnit *dropper, CPlayer *dropper_player)
 	}
 	if (dropper_player != NULL) {
 		for (size_t i = 0; i < AllUpgrades.size(); ++i) {
-			if (this->Type->ItemClass != -1 && AllUpgrades[i]->Work == this->Type->ItemClass && CheckDependByIdent(*dropper_player, AllUpgrades[i]->Ident) && !AllUpgrades[i]->UniqueOnly) {
+			if (this->Type->ItemClass != -1 && AllUpgrades[i]->Work == this->Type->ItemClass && CheckDependByUpgrade(*dropper_player, *AllUpgrades[i]) && !AllUpgrades[i]->UniqueOnly) {
 				potential_works.push_back(AllUpgrades[i]);
 			}
 		}
@@ -2194,17 +2223,17 @@ void CUnit::GenerateUnique(CUnit *dropper, CPlayer *dropper_player)
 			Type == UniqueItems[i]->Type
 			&& ( //the dropper unit must be capable of generating this unique item's prefix to drop the item, or else the unit must be capable of generating it on its own
 				UniqueItems[i]->Prefix == NULL
-				|| (dropper_player != NULL && CheckDependByIdent(*dropper_player, UniqueItems[i]->Prefix->Ident))
+				|| (dropper_player != NULL && CheckDependByUpgrade(*dropper_player, *UniqueItems[i]->Prefix))
 				|| std::find(this->Type->Affixes.begin(), this->Type->Affixes.end(), UniqueItems[i]->Prefix) != this->Type->Affixes.end()
 			)
 			&& ( //the dropper unit must be capable of generating this unique item's suffix to drop the item, or else the unit must be capable of generating it on its own
 				UniqueItems[i]->Suffix == NULL
-				|| (dropper_player != NULL && CheckDependByIdent(*dropper_player, UniqueItems[i]->Suffix->Ident))
+				|| (dropper_player != NULL && CheckDependByUpgrade(*dropper_player, *UniqueItems[i]->Suffix))
 				|| std::find(this->Type->Affixes.begin(), this->Type->Affixes.end(), UniqueItems[i]->Suffix) != this->Type->Affixes.end()
 			)
 			&& ( //the dropper unit must be capable of generating this unique item's set to drop the item
 				UniqueItems[i]->Set == NULL
-				|| (dropper_player != NULL && CheckDependByIdent(*dropper_player, UniqueItems[i]->Set->Ident))
+				|| (dropper_player != NULL && CheckDependByUpgrade(*dropper_player, *UniqueItems[i]->Set))
 			)
 			&& ( //the dropper unit must be capable of generating this unique item's spell to drop the item
 				UniqueItems[i]->Spell == NULL
@@ -2213,12 +2242,12 @@ void CUnit::GenerateUnique(CUnit *dropper, CPlayer *dropper_player)
 			&& ( //the dropper unit must be capable of generating this unique item's work to drop the item, or else the unit must be capable of generating it on its own
 				UniqueItems[i]->Work == NULL
 				|| std::find(this->Type->Affixes.begin(), this->Type->Affixes.end(), UniqueItems[i]->Work) != this->Type->Affixes.end()
-				|| (dropper_player != NULL && CheckDependByIdent(*dropper_player, UniqueItems[i]->Work->Ident))
+				|| (dropper_player != NULL && CheckDependByUpgrade(*dropper_player, *UniqueItems[i]->Work))
 			)
 			&& ( //the dropper unit must be capable of generating this unique item's elixir to drop the item, or else the unit must be capable of generating it on its own
 				UniqueItems[i]->Elixir == NULL
 				|| std::find(this->Type->Affixes.begin(), this->Type->Affixes.end(), UniqueItems[i]->Elixir) != this->Type->Affixes.end()
-				|| (dropper_player != NULL && CheckDependByIdent(*dropper_player, UniqueItems[i]->Elixir->Ident))
+				|| (dropper_player != NULL && CheckDependByUpgrade(*dropper_player, *UniqueItems[i]->Elixir))
 			)
 			&& UniqueItems[i]->CanDrop()
 		) {
@@ -2503,6 +2532,9 @@ void CUnit::Init(const CUnitType &type)
 		const unsigned int size = UnitTypeVar.GetNumberVariable();
 		Variable = new CVariable[size];
 		std::copy(type.MapDefaultStat.Variables, type.MapDefaultStat.Variables + size, Variable);
+		//Wyrmgus start
+		VariablesIncrease = true;
+		//Wyrmgus end
 	} else {
 		Variable = NULL;
 	}
@@ -2682,6 +2714,9 @@ void CUnit::AssignToPlayer(CPlayer &player)
 			Assert(Variable);
 			Assert(Stats->Variables);
 			memcpy(Variable, Stats->Variables, UnitTypeVar.GetNumberVariable() * sizeof(*Variable));
+			//Wyrmgus start
+			VariablesIncrease = true;
+			//Wyrmgus end
 		}
 	}
 	
@@ -2692,6 +2727,7 @@ void CUnit::AssignToPlayer(CPlayer &player)
 			this->Variable[GENDER_INDEX].Value = SyncRand(2) + 1;
 			this->Variable[GENDER_INDEX].Max = MaxGenders;
 			this->Variable[GENDER_INDEX].Enable = 1;
+			this->VariablesIncrease = true;
 		}
 		
 		//generate a personal name for the unit, if applicable
@@ -2833,6 +2869,38 @@ static void MapMarkUnitSightRec(const CUnit &unit, const Vec2i &pos, int width,
 	}
 }
 
+//Wyrmgus start
+/**
+**  Move on vision table the Sight of the unit
+**  (and units inside for transporter (recursively)), after its first container moved by one tile.
+**
+**  @param unit     Unit to move the sight of.
+**  @param old_pos  Old coord of first container of unit.
+**  @param pos      Coord of first container of unit.
+**  @param width    Width of the first container of unit.
+**  @param height   Height of the first container of unit.
+*/
+static void MapMoveUnitSightRec(const CUnit &unit, const Vec2i &old_pos, const Vec2i &pos, int width, int height)
+{
+	const int range = unit.Container && unit.Container->CurrentSightRange >= unit.CurrentSightRange ? unit.Container->CurrentSightRange : unit.CurrentSightRange;
+
+	MapSightMove(*unit.Player, old_pos, pos, width, height, range, MapUnmarkTileSight, MapMarkTileSight, unit.MapLayer);
+
+	if (unit.Type && unit.Type->BoolFlag[DETECTCLOAK_INDEX].value) {
+		MapSightMove(*unit.Player, old_pos, pos, width, height, range, MapUnmarkTileDetectCloak, MapMarkTileDetectCloak, unit.MapLayer);
+	}
+	
+	if (unit.Variable[ETHEREALVISION_INDEX].Value) {
+		MapSightMove(*unit.Player, old_pos, pos, width, height, range, MapUnmarkTileDetectEthereal, MapMarkTileDetectEthereal, unit.MapLayer);
+	}
+
+	CUnit *unit_inside = unit.UnitInside;
+	for (int i = unit.InsideCount; i--; unit_inside = unit_inside->NextContained) {
+		MapMoveUnitSightRec(*unit_inside, old_pos, pos, width, height);
+	}
+}
+//Wyrmgus end
+
 /**
 **  Return the unit not transported, by viewing the container recursively.
 **
@@ -2854,19 +2922,29 @@ CUnit *GetFirstContainer(const CUnit &unit)
 **  Mark on vision table the Sight of the unit
 **  (and units inside for transporter)
 **
-**  @param unit  unit to unmark its vision.
+**  @param unit    unit to unmark its vision.
+**  @param vision  false to only mark the radar and the ownership influence.
 **  @see MapUnmarkUnitSight.
 */
-void MapMarkUnitSight(CUnit &unit)
+//Wyrmgus start
+//void MapMarkUnitSight(CUnit &unit)
+void MapMarkUnitSight(CUnit &unit, bool vision)
+//Wyrmgus end
 {
 	CUnit *container = GetFirstContainer(unit);// First container of the unit.
 	Assert(container->Type);
 
+	//Wyrmgus start
+	if (vision) {
+	//Wyrmgus end
 	MapMarkUnitSightRec(unit, container->tilePos, container->Type->TileWidth, container->Type->TileHeight,
 						//Wyrmgus start
 //						MapMarkTileSight, MapMarkTileDetectCloak);
 						MapMarkTileSight, MapMarkTileDetectCloak, MapMarkTileDetectEthereal);
 						//Wyrmgus end
+	//Wyrmgus start
+	}
+	//Wyrmgus end
 
 	// Never mark radar, except if the top unit, and unit is usable
 	if (&unit == container && !unit.IsUnusable()) {
@@ -2899,20 +2977,30 @@ void MapMarkUnitSight(CUnit &unit)
 **  (and units inside for transporter)
 **
 **  @param unit    unit to unmark its vision.
+**  @param vision  false to only unmark the radar and the ownership influence.
 **  @see MapMarkUnitSight.
 */
-void MapUnmarkUnitSight(CUnit &unit)
+//Wyrmgus start
+//void MapUnmarkUnitSight(CUnit &unit)
+void MapUnmarkUnitSight(CUnit &unit, bool vision)
+//Wyrmgus end
 {
 	Assert(unit.Type);
 
 	CUnit *container = GetFirstContainer(unit);
 	Assert(container->Type);
+	//Wyrmgus start
+	if (vision) {
+	//Wyrmgus end
 	MapMarkUnitSightRec(unit,
 						container->tilePos, container->Type->TileWidth, container->Type->TileHeight,
 						//Wyrmgus start
 //						MapUnmarkTileSight, MapUnmarkTileDetectCloak);
 						MapUnmarkTileSight, MapUnmarkTileDetectCloak, MapUnmarkTileDetectEthereal);
 						//Wyrmgus end
+	//Wyrmgus start
+	}
+	//Wyrmgus end
 
 	// Never mark radar, except if the top unit?
 	if (&unit == container && !unit.IsUnusable()) {
@@ -2941,6 +3029,26 @@ void MapUnmarkUnitSight(CUnit &unit)
 	//Wyrmgus end
 }
 
+//Wyrmgus start
+/**
+**  Move on vision table the Sight of the unit
+**  (and units inside for transporter), after it moved by one tile.
+**
+**  Only the vision is moved, the radar and ownership influence must be unmarked and marked again.
+**
+**  @param unit     unit which moved.
+**  @param old_pos  coord of the unit before the move.
+**  @see CanMoveSight.
+*/
+void MapMoveUnitSight(CUnit &unit, const Vec2i &old_pos)
+{
+	Assert(unit.Type);
+	Assert(!unit.Container);
+
+	MapMoveUnitSightRec(unit, old_pos, unit.tilePos, unit.Type->TileWidth, unit.Type->TileHeight);
+}
+//Wyrmgus end
+
 /**
 **  Update the Unit Current sight range to good value and transported units inside.
 **
@@ -3034,6 +3142,11 @@ void MarkUnitFieldFlags(const CUnit &unit)
 		index += Map.Info.MapWidths[unit.MapLayer];
 		//Wyrmgus end
 	} while (--h);
+	//Wyrmgus start
+	if (flags & ~(MapFieldLandUnit | MapFieldAirUnit | MapFieldSeaUnit)) {
+		AStarTerrainChanged(unit.tilePos, Vec2i(unit.Type->TileWidth, unit.Type->TileHeight), unit.MapLayer);
+	}
+	//Wyrmgus end
 }
 
 class _UnmarkUnitFieldFlags
@@ -3088,6 +3201,11 @@ void UnmarkUnitFieldFlags(const CUnit &unit)
 		index += Map.Info.MapWidths[unit.MapLayer];
 		//Wyrmgus end
 	} while (--h);
+	//Wyrmgus start
+	if (unit.Type->FieldFlags & ~(MapFieldLandUnit | MapFieldAirUnit | MapFieldSeaUnit)) {
+		AStarTerrainChanged(unit.tilePos, Vec2i(unit.Type->TileWidth, unit.Type->TileHeight), unit.MapLayer);
+	}
+	//Wyrmgus end
 }
 
 /**
@@ -3157,6 +3275,7 @@ void CUnit::UpdateContainerAttackRange()
 			for (int i = 0; i < this->InsideCount; ++i, boarded_unit = boarded_unit->NextContained) {
 				if (boarded_unit->GetModifiedVariable(ATTACKRANGE_INDEX) > this->Variable[ATTACKRANGE_INDEX].Value && boarded_unit->Type->BoolFlag[ATTACKFROMTRANSPORTER_INDEX].value) { //if container has no range by itself, but the unit has range, and the unit can attack from a transporter, change the container's range to the unit's
 					this->Variable[ATTACKRANGE_INDEX].Enable = 1;
+					this->VariablesIncrease = true;
 					this->Variable[ATTACKRANGE_INDEX].Max = boarded_unit->GetModifiedVariable(ATTACKRANGE_INDEX);
 					this->Variable[ATTACKRANGE_INDEX].Value = boarded_unit->GetModifiedVariable(ATTACKRANGE_INDEX);
 				}
@@ -3179,6 +3298,7 @@ void CUnit::UpdateXPRequired()
 	this->Variable[XPREQUIRED_INDEX].Max = this->Variable[XPREQUIRED_INDEX].Value;
 	this->Variable[XPREQUIRED_INDEX].Enable = 1;
 	this->Variable[XP_INDEX].Enable = 1;
+	this->VariablesIncrease = true;
 }
 
 void CUnit::UpdatePersonalName(bool update_settlement_name)
@@ -3397,7 +3517,13 @@ static void UnitInXY(CUnit &unit, const Vec2i &pos, int z)
 void CUnit::MoveToXY(const Vec2i &pos, int z)
 //Wyrmgus end
 {
-	MapUnmarkUnitSight(*this);
+	//Wyrmgus start
+	// for steps of one tile, only (un)mark the tiles going out of sight and coming into it once the unit has moved
+	const Vec2i old_pos = this->tilePos;
+	const bool move_sight = !this->Container && CanMoveSight(old_pos, this->MapLayer, pos, z);
+//	MapUnmarkUnitSight(*this);
+	MapUnmarkUnitSight(*this, !move_sight);
+	//Wyrmgus end
 	Map.Remove(*this);
 	UnmarkUnitFieldFlags(*this);
 
@@ -3415,7 +3541,13 @@ void CUnit::MoveToXY(const Vec2i &pos, int z)
 	MarkUnitFieldFlags(*this);
 	//  Recalculate the seen count.
 	UnitCountSeen(*this);
-	MapMarkUnitSight(*this);
+	//Wyrmgus start
+//	MapMarkUnitSight(*this);
+	if (move_sight) {
+		MapMoveUnitSight(*this, old_pos);
+	}
+	MapMarkUnitSight(*this, !move_sight);
+	//Wyrmgus end
 	
 	//Wyrmgus start
 	// if there is a trap in the new tile, trigger it
@@ -3943,6 +4075,7 @@ void UnitLost(CUnit &unit)
 					temp->Variable[GIVERESOURCE_INDEX].Value = unit.Variable[GIVERESOURCE_INDEX].Value;
 					temp->Variable[GIVERESOURCE_INDEX].Max = unit.Variable[GIVERESOURCE_INDEX].Max;
 					temp->Variable[GIVERESOURCE_INDEX].Enable = unit.Variable[GIVERESOURCE_INDEX].Enable;
+					temp->VariablesIncrease = true;
 				}
 				//Wyrmgus end
 			}
@@ -4003,6 +4136,7 @@ void UpdateForNewUnit(const CUnit &unit, int upgrade)
 	if (player.LostTownHallTimer != 0 && type.BoolFlag[TOWNHALL_INDEX].value && ThisPlayer->HasContactWith(player)) {
 		player.LostTownHallTimer = 0;
 		player.Revealed = false;
+		AStarMapExplorationChanged();
 		for (int j = 0; j < NumPlayers; ++j) {
 			if (player.Index != j && Players[j].Type != PlayerNobody) {
 				Players[j].Notify(_("%s has rebuilt a town hall, and will no longer be revealed!"), player.Name.c_str());
@@ -4473,6 +4607,11 @@ void CUnit::ChangeOwner(CPlayer &newplayer, bool show_change)
 
 	MapUnmarkUnitSight(*this);
 	newplayer.AddUnit(*this);
+	//Wyrmgus start
+	if (!this->Removed) {
+		Map.ChangeUnitOwner(*this);
+	}
+	//Wyrmgus end
 	Stats = &Type->Stats[newplayer.Index];
 
 	//  Must change food/gold and other.
@@ -5633,6 +5772,200 @@ bool CUnit::IsInCombat() const
 	return false;
 }
 
+/**
+**  Check whether the unit's aura is in effect.
+**
+**  @param aura_index  Variable of the aura.
+*/
+bool CUnit::HasActiveAura(int aura_index) const
+{
+	if (this->Variable[aura_index].Value <= 0 || !this->IsAlive() || this->CurrentAction() == UnitActionBuilt || this->Type->BoolFlag[DECORATION_INDEX].value) {
+		return false;
+	}
+	
+	if (aura_index == LEADERSHIPAURA_INDEX && !this->IsInCombat()) {
+		return false;
+	}
+	
+	return true;
+}
+
+/**
+**  Get the area covered by the aura of a unit, as selected by SelectAroundUnit.
+*/
+static void GetAuraArea(const CUnit &unit, Vec2i &minPos, Vec2i &maxPos, double &middle_x, double &middle_y, double &radius)
+{
+	const int aura_range = AuraRange - (unit.Type->TileWidth - 1);
+	const Vec2i offset(aura_range, aura_range);
+	const CUnit *firstContainer = unit.Container ? unit.Container : &unit;
+	const Vec2i typeSize(firstContainer->Type->TileWidth - 1, firstContainer->Type->TileHeight - 1);
+
+	minPos = unit.tilePos - offset;
+	maxPos = unit.tilePos + typeSize + offset;
+	Map.FixSelectionArea(minPos, maxPos, unit.MapLayer);
+	middle_x = (maxPos.x + minPos.x) / 2;
+	middle_y = (maxPos.y + minPos.y) / 2;
+	radius = ((middle_x - minPos.x) + (middle_y - minPos.y)) / 2;
+}
+
+/**
+**  Check whether the unit is covered by an aura.
+**
+**  A unit is covered by its own aura, by the auras of its player and allies around it,
+**  and if it is garrisoned, by those around its container if the container belongs to
+**  the carrier's player, to an ally of it or to the neutral player. The container
+**  itself doesn't cover the units inside it.
+**
+**  @param aura_index  Variable of the aura.
+*/
+bool CUnit::IsUnderAura(int aura_index) const
+{
+	if (this->HasActiveAura(aura_index)) {
+		return true;
+	}
+	
+	const CUnit *container = this;
+	if (this->Removed) {
+		if (this->Container == NULL || this->Container->Removed) {
+			return false;
+		}
+		container = this->Container;
+	}
+	
+	const int aura = std::find(AuraIndexes, AuraIndexes + AuraCount, aura_index) - AuraIndexes;
+	const int z = container->MapLayer;
+	if (aura == AuraCount || z < 0 || z >= (int) AuraInfluence[aura].size() || AuraInfluence[aura][z].Players.empty()) {
+		return false;
+	}
+	const AuraInfluenceGrid &grid = AuraInfluence[aura][z];
+	
+	// the bit of a container carrying the aura only counts where another carrier of its player covers it as well
+	Uint32 container_bit = 0;
+	Vec2i container_minPos;
+	Vec2i container_maxPos;
+	double middle_x = 0;
+	double middle_y = 0;
+	double radius = 0;
+	if (container != this && container->HasActiveAura(aura_index)) {
+		container_bit = 1u << container->Player->Index;
+		GetAuraArea(*container, container_minPos, container_maxPos, middle_x, middle_y, radius);
+	}
+	
+	Vec2i minPos = container->tilePos;
+	Vec2i maxPos(container->tilePos.x + container->Type->TileWidth - 1, container->tilePos.y + container->Type->TileHeight - 1);
+	Map.FixSelectionArea(minPos, maxPos, z);
+	
+	Uint32 players = 0;
+	for (Vec2i pos = minPos; pos.y <= maxPos.y; ++pos.y) {
+		for (pos.x = minPos.x; pos.x <= maxPos.x; ++pos.x) {
+			const unsigned int index = Map.getIndex(pos, z);
+			Uint32 tile_players = grid.Players[index];
+			if (
+				container_bit
+				&& pos.x >= container_minPos.x && pos.x <= container_maxPos.x && pos.y >= container_minPos.y && pos.y <= container_maxPos.y
+				&& IsInSelectionCircle(pos, middle_x, middle_y, radius)
+			) {
+				tile_players &= ~container_bit | grid.Overlap[index];
+			}
+			players |= tile_players;
+		}
+	}
+	
+	for (int p = 0; players != 0; ++p, players >>= 1) {
+		if (!(players & 1)) {
+			continue;
+		}
+		const CPlayer &player = Players[p];
+		if (container != this && container->Player != &player && !container->IsAllied(player) && container->Player != &Players[PlayerNumNeutral]) {
+			continue;
+		}
+		if (this->Player == &player || this->IsAllied(player)) {
+			return true;
+		}
+	}
+	
+	return false;
+}
+
+/**
+**  Update the aura influence grids from the units carrying an active aura.
+**
+**  Each carrier stamps the area it would have selected around itself onto the grid
+**  of its aura, so that every unit can then check whether an aura covers it with
+**  the few tiles it stands on.
+*/
+void UpdateAuraInfluence()
+{
+	bool resized = false;
+	for (int aura = 0; aura < AuraCount; ++aura) {
+		const std::vector<AuraInfluenceGrid> &grids = AuraInfluence[aura];
+		resized = resized || grids.size() != Map.Info.MapWidths.size();
+		for (size_t z = 0; z < grids.size() && !resized; ++z) {
+			resized = grids[z].Players.size() != (size_t) Map.Info.MapWidths[z] * Map.Info.MapHeights[z];
+		}
+	}
+	
+	if (resized) {
+		// the map changed, so allocate new grids
+		for (int aura = 0; aura < AuraCount; ++aura) {
+			std::vector<AuraInfluenceGrid> &grids = AuraInfluence[aura];
+			grids.resize(Map.Info.MapWidths.size());
+			for (size_t z = 0; z < grids.size(); ++z) {
+				const size_t size = (size_t) Map.Info.MapWidths[z] * Map.Info.MapHeights[z];
+				grids[z].Players.assign(size, 0);
+				grids[z].Overlap.assign(size, 0);
+			}
+		}
+	} else {
+		// clear the areas stamped by the last update
+		for (size_t i = 0; i < AuraInfluenceAreas.size(); ++i) {
+			const AuraInfluenceArea &area = AuraInfluenceAreas[i];
+			AuraInfluenceGrid &grid = AuraInfluence[area.Aura][area.MapLayer];
+			for (Vec2i pos = area.MinPos; pos.y <= area.MaxPos.y; ++pos.y) {
+				const unsigned int index = Map.getIndex(area.MinPos.x, pos.y, area.MapLayer);
+				std::fill(grid.Players.begin() + index, grid.Players.begin() + index + area.MaxPos.x - area.MinPos.x + 1, 0);
+				std::fill(grid.Overlap.begin() + index, grid.Overlap.begin() + index + area.MaxPos.x - area.MinPos.x + 1, 0);
+			}
+		}
+	}
+	AuraInfluenceAreas.clear();
+	
+	for (CUnitManager::Iterator it = UnitManager.begin(); it != UnitManager.end(); ++it) {
+		const CUnit &unit = **it;
+		
+		for (int aura = 0; aura < AuraCount; ++aura) {
+			if (unit.MapLayer < 0 || unit.MapLayer >= (int) AuraInfluence[aura].size() || !unit.HasActiveAura(AuraIndexes[aura])) {
+				continue;
+			}
+			
+			AuraInfluenceArea area;
+			area.Aura = aura;
+			area.MapLayer = unit.MapLayer;
+			double middle_x;
+			double middle_y;
+			double radius;
+			GetAuraArea(unit, area.MinPos, area.MaxPos, middle_x, middle_y, radius);
+			if (area.MinPos.x > area.MaxPos.x || area.MinPos.y > area.MaxPos.y) {
+				continue;
+			}
+			
+			AuraInfluenceGrid &grid = AuraInfluence[aura][area.MapLayer];
+			const Uint32 player_bit = 1u << unit.Player->Index;
+			for (Vec2i pos = area.MinPos; pos.y <= area.MaxPos.y; ++pos.y) {
+				for (pos.x = area.MinPos.x; pos.x <= area.MaxPos.x; ++pos.x) {
+					if (!IsInSelectionCircle(pos, middle_x, middle_y, radius)) {
+						continue;
+					}
+					const unsigned int index = Map.getIndex(pos, area.MapLayer);
+					grid.Overlap[index] |= grid.Players[index] & player_bit;
+					grid.Players[index] |= player_bit;
+				}
+			}
+			AuraInfluenceAreas.push_back(area);
+		}
+	}
+}
+
 bool CUnit::CanHarvest(const CUnit *dest, bool only_harvestable) const
 {
 	if (!dest) {
@@ -6667,6 +7000,9 @@ static void HitUnit_IncreaseScoreForKill(CUnit &attacker, CUnit &target)
 	attacker.Variable[KILL_INDEX].Value++;
 	attacker.Variable[KILL_INDEX].Max++;
 	attacker.Variable[KILL_INDEX].Enable = 1;
+	//Wyrmgus start
+	attacker.VariablesIncrease = true;
+	//Wyrmgus end
 	
 	//Wyrmgus start
 	for (size_t i = 0; i < attacker.Player->QuestObjectives.size(); ++i) {
@@ -6799,6 +7135,9 @@ static void HitUnit_ChangeVariable(CUnit &target, const Missile &missile)
 	const int var = missile.Type->ChangeVariable;
 
 	target.Variable[var].Enable = 1;
+	//Wyrmgus start
+	target.VariablesIncrease = true;
+	//Wyrmgus end
 	target.Variable[var].Value += missile.Type->ChangeAmount;
 	if (target.Variable[var].Value > target.Variable[var].Max) {
 		if (missile.Type->ChangeMax) {
@@ -7680,6 +8019,13 @@ void CleanUnits()
 
 	FancyBuildings = false;
 	HelpMeLastCycle = 0;
+	
+	//Wyrmgus start
+	for (int aura = 0; aura < AuraCount; ++aura) {
+		AuraInfluence[aura].clear();
+	}
+	AuraInfluenceAreas.clear();
+	//Wyrmgus end
 }
 
 //@}
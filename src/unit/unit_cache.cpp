@@ -44,6 +44,190 @@
 #include "unittype.h"
 #include "map.h"
 
+//Wyrmgus start
+/*----------------------------------------------------------------------------
+-- Variables
+----------------------------------------------------------------------------*/
+
+/// Number of buffer sizes kept for reuse, from 4 units on
+#define UNIT_CACHE_BUFFER_CLASSES 16
+
+/// Buffers released by unit caches, by size, to be reused by the next caches which grow
+static std::vector<CUnit **> UnitCacheFreeBuffers[UNIT_CACHE_BUFFER_CLASSES];
+
+/*----------------------------------------------------------------------------
+-- Functions
+----------------------------------------------------------------------------*/
+
+static int UnitCacheBufferClass(unsigned int capacity)
+{
+	int buffer_class = 0;
+	while ((4u << buffer_class) < capacity) {
+		++buffer_class;
+	}
+	return buffer_class;
+}
+
+/**
+**  Get a buffer for the units of a cache, reusing a released one if possible.
+**
+**  Unit caches are only changed by the game thread, so the pool isn't locked.
+**
+**  @param capacity  Number of units of the buffer, a power of two of at least 4.
+*/
+CUnit **CUnitCache::AllocateBuffer(unsigned int capacity)
+{
+	const int buffer_class = UnitCacheBufferClass(capacity);
+	if (buffer_class < UNIT_CACHE_BUFFER_CLASSES && !UnitCacheFreeBuffers[buffer_class].empty()) {
+		CUnit **buffer = UnitCacheFreeBuffers[buffer_class].back();
+		UnitCacheFreeBuffers[buffer_class].pop_back();
+		return buffer;
+	}
+	return new CUnit *[capacity];
+}
+
+/**
+**  Release the buffer of a cache.
+*/
+void CUnitCache::FreeBuffer(CUnit **buffer, unsigned int capacity)
+{
+	const int buffer_class = UnitCacheBufferClass(capacity);
+	if (buffer_class < UNIT_CACHE_BUFFER_CLASSES) {
+		UnitCacheFreeBuffers[buffer_class].push_back(buffer);
+	} else {
+		delete[] buffer;
+	}
+}
+
+CUnitBucketGrid::CUnitBucketGrid(int map_width, int map_height) :
+	MapWidth(map_width), MapHeight(map_height),
+	Width((map_width + UNIT_BUCKET_SIZE - 1) / UNIT_BUCKET_SIZE),
+	Height((map_height + UNIT_BUCKET_SIZE - 1) / UNIT_BUCKET_SIZE),
+	MaxUnitWidth(1), MaxUnitHeight(1)
+{
+	this->Buckets.resize(this->Width * this->Height);
+}
+
+/**
+**  Add a unit placed on the map layer to the bucket of its top-left tile.
+*/
+void CUnitBucketGrid::Insert(CUnit &unit)
+{
+	Entry entry;
+	entry.Unit = &unit;
+	entry.X = unit.tilePos.x;
+	entry.Y = unit.tilePos.y;
+	entry.Width = std::min<int>(unit.Type->TileWidth, this->MapWidth - unit.tilePos.x);
+	entry.Height = std::min<int>(unit.Type->TileHeight, this->MapHeight - unit.tilePos.y);
+	entry.Player = unit.Player->Index;
+
+	Bucket &bucket = this->GetBucket(entry.X, entry.Y);
+	bucket.Entries.push_back(entry);
+	bucket.PlayerUnits[entry.Player]++;
+
+	this->MaxUnitWidth = std::max<int>(this->MaxUnitWidth, entry.Width);
+	this->MaxUnitHeight = std::max<int>(this->MaxUnitHeight, entry.Height);
+}
+
+/**
+**  Remove a unit from the bucket of its top-left tile.
+*/
+void CUnitBucketGrid::Remove(CUnit &unit)
+{
+	Bucket &bucket = this->GetBucket(unit.tilePos.x, unit.tilePos.y);
+
+	for (size_t i = 0; i < bucket.Entries.size(); ++i) {
+		if (bucket.Entries[i].Unit == &unit) {
+			bucket.PlayerUnits[bucket.Entries[i].Player]--;
+			bucket.Entries[i] = bucket.Entries.back();
+			bucket.Entries.pop_back();
+			return;
+		}
+	}
+	DebugPrint("Unit %d not found in its bucket\n" _C_ UnitNumber(unit));
+}
+
+/**
+**  Count a unit placed on the map layer for its new owner.
+*/
+void CUnitBucketGrid::ChangeOwner(CUnit &unit)
+{
+	Bucket &bucket = this->GetBucket(unit.tilePos.x, unit.tilePos.y);
+
+	for (size_t i = 0; i < bucket.Entries.size(); ++i) {
+		Entry &entry = bucket.Entries[i];
+		if (entry.Unit == &unit) {
+			bucket.PlayerUnits[entry.Player]--;
+			entry.Player = unit.Player->Index;
+			bucket.PlayerUnits[entry.Player]++;
+			return;
+		}
+	}
+}
+
+/**
+**  Get the buckets which may hold units covering tiles of an area.
+*/
+void CUnitBucketGrid::GetBucketArea(int min_x, int min_y, int max_x, int max_y, int &bucket_min_x, int &bucket_min_y, int &bucket_max_x, int &bucket_max_y) const
+{
+	// units are kept in the bucket of their top-left tile, so big units may come from further up and left
+	bucket_min_x = std::max(0, min_x - this->MaxUnitWidth + 1) / UNIT_BUCKET_SIZE;
+	bucket_min_y = std::max(0, min_y - this->MaxUnitHeight + 1) / UNIT_BUCKET_SIZE;
+	bucket_max_x = std::min(max_x / UNIT_BUCKET_SIZE, this->Width - 1);
+	bucket_max_y = std::min(max_y / UNIT_BUCKET_SIZE, this->Height - 1);
+}
+
+/**
+**  Find the units covering at least one tile of an area.
+**
+**  @param entries  Receives the entries of the units found, in no particular order.
+*/
+void CUnitBucketGrid::FindUnits(int min_x, int min_y, int max_x, int max_y, std::vector<const Entry *> &entries) const
+{
+	int bucket_min_x, bucket_min_y, bucket_max_x, bucket_max_y;
+	this->GetBucketArea(min_x, min_y, max_x, max_y, bucket_min_x, bucket_min_y, bucket_max_x, bucket_max_y);
+
+	for (int by = bucket_min_y; by <= bucket_max_y; ++by) {
+		for (int bx = bucket_min_x; bx <= bucket_max_x; ++bx) {
+			const std::vector<Entry> &bucket_entries = this->Buckets[by * this->Width + bx].Entries;
+
+			for (size_t i = 0; i < bucket_entries.size(); ++i) {
+				const Entry &entry = bucket_entries[i];
+				if (entry.X <= max_x && entry.X + entry.Width > min_x && entry.Y <= max_y && entry.Y + entry.Height > min_y) {
+					entries.push_back(&entry);
+				}
+			}
+		}
+	}
+}
+
+/**
+**  Check whether any unit of another player than the given one covers a tile of an area.
+*/
+bool CUnitBucketGrid::HasUnitsNotOwnedBy(int min_x, int min_y, int max_x, int max_y, int player) const
+{
+	int bucket_min_x, bucket_min_y, bucket_max_x, bucket_max_y;
+	this->GetBucketArea(min_x, min_y, max_x, max_y, bucket_min_x, bucket_min_y, bucket_max_x, bucket_max_y);
+
+	for (int by = bucket_min_y; by <= bucket_max_y; ++by) {
+		for (int bx = bucket_min_x; bx <= bucket_max_x; ++bx) {
+			const Bucket &bucket = this->Buckets[by * this->Width + bx];
+			if ((int) bucket.Entries.size() == bucket.PlayerUnits[player]) {
+				continue;
+			}
+
+			for (size_t i = 0; i < bucket.Entries.size(); ++i) {
+				const Entry &entry = bucket.Entries[i];
+				if (entry.Player != player && entry.X <= max_x && entry.X + entry.Width > min_x && entry.Y <= max_y && entry.Y + entry.Height > min_y) {
+					return true;
+				}
+			}
+		}
+	}
+	return false;
+}
+//Wyrmgus end
+
 /**
 **  Insert new unit into cache.
 **
@@ -76,6 +260,16 @@ void CMap::Insert(CUnit &unit)
 //	} while (--i && unit.tilePos.y + (i - h) < Info.MapHeight);
 	} while (--i && unit.tilePos.y + (i - h) < Info.MapHeights[unit.MapLayer]);
 	//Wyrmgus end
+	
+	//Wyrmgus start
+	if ((int) this->UnitBuckets.size() <= unit.MapLayer) {
+		this->UnitBuckets.resize(unit.MapLayer + 1, NULL);
+	}
+	if (this->UnitBuckets[unit.MapLayer] == NULL) {
+		this->UnitBuckets[unit.MapLayer] = new CUnitBucketGrid(Info.MapWidths[unit.MapLayer], Info.MapHeights[unit.MapLayer]);
+	}
+	this->UnitBuckets[unit.MapLayer]->Insert(unit);
+	//Wyrmgus end
 }
 
 /**
@@ -110,8 +304,36 @@ void CMap::Remove(CUnit &unit)
 //	} while (--i && unit.tilePos.y + (i - h) < Info.MapHeight);
 	} while (--i && unit.tilePos.y + (i - h) < Info.MapHeights[unit.MapLayer]);
 	//Wyrmgus end
+	
+	//Wyrmgus start
+	this->UnitBuckets[unit.MapLayer]->Remove(unit);
+	//Wyrmgus end
 }
 
+//Wyrmgus start
+/**
+**  Update the unit buckets after the owner of a unit changed.
+**
+**  @param unit  Unit which changed owner.
+*/
+void CMap::ChangeUnitOwner(CUnit &unit)
+{
+	if (unit.MapLayer < (int) this->UnitBuckets.size() && this->UnitBuckets[unit.MapLayer] != NULL) {
+		this->UnitBuckets[unit.MapLayer]->ChangeOwner(unit);
+	}
+}
+
+/**
+**  Get the unit buckets of a map layer.
+**
+**  @return  The buckets, or NULL if no unit was ever placed on the layer.
+*/
+const CUnitBucketGrid *CMap::GetUnitBuckets(int z) const
+{
+	return z < (int) this->UnitBuckets.size() ? this->UnitBuckets[z] : NULL;
+}
+//Wyrmgus end
+
 //Wyrmgus start
 //void CMap::Clamp(Vec2i &pos) const
 void CMap::Clamp(Vec2i &pos, int z) const
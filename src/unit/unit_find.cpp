@@ -1569,6 +1569,41 @@ bool CheckObstaclesBetweenTiles(const Vec2i &unitPos, const Vec2i &goalPos, unsi
 	return true;
 }
 
+//Wyrmgus start
+/**
+**  Check whether there may be units to attack around a unit, by looking at who owns the units nearby.
+**
+**  @param unit   Unit looking for targets.
+**  @param range  Distance range to look.
+**
+**  @return       False if no unit around could be a target.
+*/
+static bool MayHaveTargetsAround(const CUnit &unit, int range)
+{
+	const CPlayer &player = *unit.Player;
+
+	// neutral fauna may attack units of its own player
+	if (player.Type == PlayerNeutral || player.IsEnemy(player)) {
+		return true;
+	}
+
+	// If unit is removed, use containers x and y
+	const CUnit *firstContainer = unit.Container ? unit.Container : &unit;
+	const CUnitBucketGrid *buckets = Map.GetUnitBuckets(firstContainer->MapLayer);
+	if (buckets == NULL) {
+		return true;
+	}
+
+	const Vec2i offset(range, range);
+	const Vec2i typeSize(firstContainer->Type->TileWidth - 1, firstContainer->Type->TileHeight - 1);
+	Vec2i minPos = firstContainer->tilePos - offset;
+	Vec2i maxPos = firstContainer->tilePos + typeSize + offset;
+	Map.FixSelectionArea(minPos, maxPos, firstContainer->MapLayer);
+
+	return buckets->HasUnitsNotOwnedBy(minPos.x, minPos.y, maxPos.x, maxPos.y, player.Index);
+}
+//Wyrmgus end
+
 /**
 **  Attack units in distance.
 **
@@ -1605,6 +1640,11 @@ CUnit *AttackUnitsInDistance(const CUnit &unit, int range, CUnitFilter pred, boo
 
 		// If unit is removed, use containers x and y
 		const CUnit *firstContainer = unit.Container ? unit.Container : &unit;
+		//Wyrmgus start
+		if (!MayHaveTargetsAround(unit, missile_range)) {
+			return NULL;
+		}
+		//Wyrmgus end
 		std::vector<CUnit *> table;
 		SelectAroundUnit(*firstContainer, missile_range, table,
 			//Wyrmgus start
@@ -1622,6 +1662,11 @@ CUnit *AttackUnitsInDistance(const CUnit &unit, int range, CUnitFilter pred, boo
 	} else {
 		// If unit is removed, use containers x and y
 		const CUnit *firstContainer = unit.Container ? unit.Container : &unit;
+		//Wyrmgus start
+		if (!MayHaveTargetsAround(unit, range)) {
+			return NULL;
+		}
+		//Wyrmgus end
 		std::vector<CUnit *> table;
 
 		SelectAroundUnit(*firstContainer, range, table,
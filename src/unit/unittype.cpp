@@ -473,7 +473,10 @@
 ----------------------------------------------------------------------------*/
 
 std::vector<CUnitType *> UnitTypes;   /// unit-types definition
-std::map<std::string, CUnitType *> UnitTypeMap;
+//Wyrmgus start
+//std::map<std::string, CUnitType *> UnitTypeMap;
+std::unordered_map<std::string, CUnitType *> UnitTypeMap;
+//Wyrmgus end
 
 /**
 **  Next unit type are used hardcoded in the source.
@@ -1477,7 +1480,10 @@ void SaveUnitTypes(CFile &file)
 */
 CUnitType *UnitTypeByIdent(const std::string &ident)
 {
-	std::map<std::string, CUnitType *>::iterator ret = UnitTypeMap.find(ident);
+	//Wyrmgus start
+//	std::map<std::string, CUnitType *>::iterator ret = UnitTypeMap.find(ident);
+	std::unordered_map<std::string, CUnitType *>::iterator ret = UnitTypeMap.find(ident);
+	//Wyrmgus end
 	if (ret != UnitTypeMap.end()) {
 		return (*ret).second;
 	}
@@ -1918,6 +1924,45 @@ int GetUnitTypesCount()
 	return count;
 }
 
+//Wyrmgus start
+/**
+**  Get the graphic files of the unit-types whose sprites have not been loaded yet.
+**
+**  @param files  Vector to which the files are added.
+*/
+void GetUnitTypeFiles(std::vector<std::string> &files)
+{
+#ifndef DYNAMIC_LOAD
+	for (std::vector<CUnitType *>::size_type i = 0; i < UnitTypes.size(); ++i) {
+		const CUnitType &type = *UnitTypes[i];
+
+		if (type.Sprite) {
+			continue;
+		}
+		files.push_back(type.File);
+		files.push_back(type.ShadowFile);
+		files.push_back(type.LightFile);
+		for (int j = 0; j < MaxImageLayers; ++j) {
+			files.push_back(type.LayerFiles[j]);
+		}
+
+		for (int j = 0; j < VariationMax; ++j) {
+			const VariationInfo *varinfo = type.VarInfo[j];
+			if (!varinfo) {
+				continue;
+			}
+			files.push_back(varinfo->File);
+			files.push_back(varinfo->ShadowFile);
+			files.push_back(varinfo->LightFile);
+			for (int k = 0; k < MaxImageLayers; ++k) {
+				files.push_back(varinfo->LayerFiles[k]);
+			}
+		}
+	}
+#endif
+}
+//Wyrmgus end
+
 /**
 ** Load the graphics for the unit-types.
 */
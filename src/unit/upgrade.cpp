@@ -37,6 +37,9 @@
 #include <string>
 #include <vector>
 #include <map>
+//Wyrmgus start
+#include <unordered_map>
+//Wyrmgus end
 
 #include "stratagus.h"
 
@@ -101,7 +104,10 @@ CUpgradeModifier *UpgradeModifiers[UPGRADE_MODIFIERS_MAX];
 /// Number of upgrades modifiers used
 int NumUpgradeModifiers;
 
-std::map<std::string, CUpgrade *> Upgrades;
+//Wyrmgus start
+//std::map<std::string, CUpgrade *> Upgrades;
+std::unordered_map<std::string, CUpgrade *> Upgrades;
+//Wyrmgus end
 
 /*----------------------------------------------------------------------------
 --  Functions
@@ -243,11 +249,18 @@ CUpgrade::~CUpgrade()
 */
 CUpgrade *CUpgrade::New(const std::string &ident)
 {
-	CUpgrade *upgrade = Upgrades[ident];
-	if (upgrade) {
-		return upgrade;
+	//Wyrmgus start
+//	CUpgrade *upgrade = Upgrades[ident];
+//	if (upgrade) {
+	std::unordered_map<std::string, CUpgrade *>::iterator find_iterator = Upgrades.find(ident);
+	if (find_iterator != Upgrades.end() && find_iterator->second) {
+		return find_iterator->second;
+	//Wyrmgus end
 	} else {
-		upgrade = new CUpgrade(ident);
+		//Wyrmgus start
+//		upgrade = new CUpgrade(ident);
+		CUpgrade *upgrade = new CUpgrade(ident);
+		//Wyrmgus end
 		Upgrades[ident] = upgrade;
 		upgrade->ID = AllUpgrades.size();
 		AllUpgrades.push_back(upgrade);
@@ -264,7 +277,12 @@ CUpgrade *CUpgrade::New(const std::string &ident)
 */
 CUpgrade *CUpgrade::Get(const std::string &ident)
 {
-	CUpgrade *upgrade = Upgrades[ident];
+	//Wyrmgus start
+	// don't use operator[], so that misses don't insert null entries into the table
+//	CUpgrade *upgrade = Upgrades[ident];
+	std::unordered_map<std::string, CUpgrade *>::const_iterator find_iterator = Upgrades.find(ident);
+	CUpgrade *upgrade = find_iterator != Upgrades.end() ? find_iterator->second : NULL;
+	//Wyrmgus end
 	if (!upgrade) {
 		DebugPrint("upgrade not found: %s\n" _C_ ident.c_str());
 	}
@@ -1439,6 +1457,9 @@ static void ApplyUpgradeModifier(CPlayer &player, const CUpgradeModifier *um)
 			}
 		}
 	}
+	//Wyrmgus start
+	InvalidateDependCache(player);
+	//Wyrmgus end
 	
 	//Wyrmgus start
 	for (size_t i = 0; i < um->RemoveUpgrades.size(); ++i) {
@@ -1461,6 +1482,11 @@ static void ApplyUpgradeModifier(CPlayer &player, const CUpgradeModifier *um)
 		// FIXME: check if modify is allowed
 
 		player.Allow.Units[z] += um->ChangeUnits[z];
+		//Wyrmgus start
+		if (um->ChangeUnits[z] != 0) {
+			InvalidateDependCache(player);
+		}
+		//Wyrmgus end
 
 		Assert(um->ApplyTo[z] == '?' || um->ApplyTo[z] == 'X');
 
@@ -1599,6 +1625,9 @@ static void ApplyUpgradeModifier(CPlayer &player, const CUpgradeModifier *um)
 					
 					for (unsigned int j = 0; j < UnitTypeVar.GetNumberVariable(); j++) {
 						unit.Variable[j].Enable |= um->Modifier.Variables[j].Enable;
+						//Wyrmgus start
+						unit.VariablesIncrease = true;
+						//Wyrmgus end
 						if (um->ModifyPercent[j]) {
 							if (j != MANA_INDEX || um->ModifyPercent[j] < 0) {
 								unit.Variable[j].Value += unit.Variable[j].Value * um->ModifyPercent[j] / 100;
@@ -1740,6 +1769,9 @@ static void RemoveUpgradeModifier(CPlayer &player, const CUpgradeModifier *um)
 			}
 		}
 	}
+	//Wyrmgus start
+	InvalidateDependCache(player);
+	//Wyrmgus end
 
 	for (size_t z = 0; z < UnitTypes.size(); ++z) {
 		CUnitStats &stat = UnitTypes[z]->Stats[pn];
@@ -1754,6 +1786,11 @@ static void RemoveUpgradeModifier(CPlayer &player, const CUpgradeModifier *um)
 		// FIXME: check if modify is allowed
 
 		player.Allow.Units[z] -= um->ChangeUnits[z];
+		//Wyrmgus start
+		if (um->ChangeUnits[z] != 0) {
+			InvalidateDependCache(player);
+		}
+		//Wyrmgus end
 
 		Assert(um->ApplyTo[z] == '?' || um->ApplyTo[z] == 'X');
 
@@ -1893,6 +1930,9 @@ static void RemoveUpgradeModifier(CPlayer &player, const CUpgradeModifier *um)
 					
 					for (unsigned int j = 0; j < UnitTypeVar.GetNumberVariable(); j++) {
 						unit.Variable[j].Enable |= um->Modifier.Variables[j].Enable;
+						//Wyrmgus start
+						unit.VariablesIncrease = true;
+						//Wyrmgus end
 						if (um->ModifyPercent[j]) {
 							if (j != MANA_INDEX || um->ModifyPercent[j] >= 0) {
 								unit.Variable[j].Value = unit.Variable[j].Value * 100 / (100 + um->ModifyPercent[j]);
@@ -2022,6 +2062,9 @@ void ApplyIndividualUpgradeModifier(CUnit &unit, const CUpgradeModifier *um)
 
 	for (unsigned int j = 0; j < UnitTypeVar.GetNumberVariable(); j++) {
 		unit.Variable[j].Enable |= um->Modifier.Variables[j].Enable;
+		//Wyrmgus start
+		unit.VariablesIncrease = true;
+		//Wyrmgus end
 		if (um->ModifyPercent[j]) {
 			if (j != MANA_INDEX || um->ModifyPercent[j] < 0) {
 				unit.Variable[j].Value += unit.Variable[j].Value * um->ModifyPercent[j] / 100;
@@ -2124,6 +2167,9 @@ void RemoveIndividualUpgradeModifier(CUnit &unit, const CUpgradeModifier *um)
 	
 	for (unsigned int j = 0; j < UnitTypeVar.GetNumberVariable(); j++) {
 		unit.Variable[j].Enable |= um->Modifier.Variables[j].Enable;
+		//Wyrmgus start
+		unit.VariablesIncrease = true;
+		//Wyrmgus end
 		if (um->ModifyPercent[j]) {
 			if (j != MANA_INDEX || um->ModifyPercent[j] >= 0) {
 				unit.Variable[j].Value = unit.Variable[j].Value * 100 / (100 + um->ModifyPercent[j]);
@@ -2377,6 +2423,7 @@ void AbilityLost(CUnit &unit, CUpgrade *upgrade, bool lose_all)
 	unit.Variable[LEVELUP_INDEX].Value += 1;
 	unit.Variable[LEVELUP_INDEX].Max = unit.Variable[LEVELUP_INDEX].Value;
 	unit.Variable[LEVELUP_INDEX].Enable = 1;
+	unit.VariablesIncrease = true;
 	if (!IsNetworkGame() && unit.Character != NULL) {
 		if (std::find(unit.Character->Abilities.begin(), unit.Character->Abilities.end(), upgrade) != unit.Character->Abilities.end()) {
 			if (unit.Player->AiEnabled == false) { //save ability learning, if unit has a character and it is persistent, and the character doesn't have the ability yet
@@ -2560,6 +2607,9 @@ void AllowUnitId(CPlayer &player, int id, int units)
 //Wyrmgus end
 {
 	player.Allow.Units[id] = units;
+	//Wyrmgus start
+	InvalidateDependCache(player);
+	//Wyrmgus end
 }
 
 /**
@@ -2573,6 +2623,9 @@ void AllowUpgradeId(CPlayer &player, int id, char af)
 {
 	Assert(af == 'A' || af == 'F' || af == 'R');
 	player.Allow.Upgrades[id] = af;
+	//Wyrmgus start
+	InvalidateDependCache(player);
+	//Wyrmgus end
 }
 
 /**
@@ -39,9 +39,13 @@
 #include <string>
 #include <map>
 #include <list>
+//Wyrmgus start
+#include <set>
+//Wyrmgus end
 
 //Wyrmgus start
 #include "grand_strategy.h"
+#include "graphic_cache.h"
 //Wyrmgus end
 #include "video.h"
 #include "player.h"
@@ -53,6 +57,8 @@
 //Wyrmgus end
 #include "ui.h"
 //Wyrmgus start
+#include "thread_pool.h"
+#include "translate.h"
 #include "unit.h" //for using CPreference
 #include "xbrz.h"
 //Wyrmgus end
@@ -64,6 +70,16 @@
 static int HashCount;
 static std::map<std::string, CGraphic *> GraphicHash;
 static std::list<CGraphic *> Graphics;
+//Wyrmgus start
+/// Surface decoded in advance, waiting for its graphic to be loaded
+struct DecodedSurface
+{
+	SDL_Surface *Surface;   /// decoded surface, NULL while it is being decoded
+	std::string CacheKey;   /// key of the file in the graphic cache
+};
+static std::map<std::string, DecodedSurface> DecodedSurfaces;	/// Surfaces decoded in advance, by file
+static std::set<SDL_Surface *> SharedPixelSurfaces;	/// Surfaces using the pixels of another surface, which must not free them
+//Wyrmgus end
 
 /*----------------------------------------------------------------------------
 --  Functions
@@ -457,6 +473,39 @@ void CGraphic::DrawFrameClipTrans(unsigned frame, int x, int y, int alpha, bool
 }
 
 //Wyrmgus start
+/**
+**  Make a surface which uses the pixels of another one, with its own palette and color key.
+**
+**  Time of day and player color variants of a palettized surface only differ in their
+**  palette, so they don't need copies of the pixels.
+**
+**  @param base  Surface whose pixels are used, which must be freed after the new surface.
+**
+**  @return      The new surface.
+*/
+static SDL_Surface *MakeSharedSurface(SDL_Surface *base)
+{
+	// RLE encoding would move the pixels of the base surface away
+	if (base->flags & SDL_SRCCOLORKEY) {
+		SDL_SetColorKey(base, SDL_SRCCOLORKEY, base->format->colorkey);
+	}
+
+	const SDL_PixelFormat &format = *base->format;
+	SDL_Surface *surface = SDL_CreateRGBSurfaceFrom(base->pixels, base->w, base->h, format.BitsPerPixel, base->pitch,
+													format.Rmask, format.Gmask, format.Bmask, format.Amask);
+	if (format.palette) {
+		SDL_SetPalette(surface, SDL_LOGPAL | SDL_PHYSPAL, format.palette->colors, 0, format.palette->ncolors);
+	}
+	if (base->flags & SDL_SRCCOLORKEY) {
+		SDL_SetColorKey(surface, SDL_SRCCOLORKEY, format.colorkey);
+	}
+	if (base->flags & SDL_SRCALPHA) {
+		SDL_SetAlpha(surface, SDL_SRCALPHA, format.alpha);
+	}
+	SharedPixelSurfaces.insert(surface);
+	return surface;
+}
+
 void CPlayerColorGraphic::MakePlayerColorSurface(int player_color, bool flipped, int time_of_day)
 {
 #if defined(USE_OPENGL) || defined(USE_GLES)
@@ -499,33 +548,30 @@ void CPlayerColorGraphic::MakePlayerColorSurface(int player_color, bool flipped,
 	
 	if (time_of_day == 1) {
 		if (flipped) {
-			surface = PlayerColorSurfacesDawnFlip[player_color] = SDL_ConvertSurface(base_surface, base_surface->format, SDL_SWSURFACE);
+			surface = PlayerColorSurfacesDawnFlip[player_color] = MakeSharedSurface(base_surface);
 		} else {
-			surface = PlayerColorSurfacesDawn[player_color] = SDL_ConvertSurface(base_surface, base_surface->format, SDL_SWSURFACE);
+			surface = PlayerColorSurfacesDawn[player_color] = MakeSharedSurface(base_surface);
 		}
 	} else if (time_of_day == 5) {
 		if (flipped) {
-			surface = PlayerColorSurfacesDuskFlip[player_color] = SDL_ConvertSurface(base_surface, base_surface->format, SDL_SWSURFACE);
+			surface = PlayerColorSurfacesDuskFlip[player_color] = MakeSharedSurface(base_surface);
 		} else {
-			surface = PlayerColorSurfacesDusk[player_color] = SDL_ConvertSurface(base_surface, base_surface->format, SDL_SWSURFACE);
+			surface = PlayerColorSurfacesDusk[player_color] = MakeSharedSurface(base_surface);
 		}
 	} else if (time_of_day == 6 || time_of_day == 7 || time_of_day == 8) {
 		if (flipped) {
-			surface = PlayerColorSurfacesNightFlip[player_color] = SDL_ConvertSurface(base_surface, base_surface->format, SDL_SWSURFACE);
+			surface = PlayerColorSurfacesNightFlip[player_color] = MakeSharedSurface(base_surface);
 		} else {
-			surface = PlayerColorSurfacesNight[player_color] = SDL_ConvertSurface(base_surface, base_surface->format, SDL_SWSURFACE);
+			surface = PlayerColorSurfacesNight[player_color] = MakeSharedSurface(base_surface);
 		}
 	} else {
 		if (flipped) {
-			surface = PlayerColorSurfacesFlip[player_color] = SDL_ConvertSurface(base_surface, base_surface->format, SDL_SWSURFACE);
+			surface = PlayerColorSurfacesFlip[player_color] = MakeSharedSurface(base_surface);
 		} else {
-			surface = PlayerColorSurfaces[player_color] = SDL_ConvertSurface(base_surface, base_surface->format, SDL_SWSURFACE);
+			surface = PlayerColorSurfaces[player_color] = MakeSharedSurface(base_surface);
 		}
 	}
 
-	if (base_surface->flags & SDL_SRCCOLORKEY) {
-		SDL_SetColorKey(surface, SDL_SRCCOLORKEY | SDL_RLEACCEL, base_surface->format->colorkey);
-	}
 	if (surface->format->BytesPerPixel == 1) {
 		VideoPaletteListAdd(surface);
 	}
@@ -1533,6 +1579,165 @@ static void ConvertImageToMap(SDL_Surface *Surface, int Width, int Height)
 */
 //Wyrmgus end
 
+/**
+**  Graphic used to decode a file outside of the graphic hash.
+*/
+class CDecodedGraphic : public CGraphic
+{
+public:
+	CDecodedGraphic(const std::string &file)
+	{
+		this->File = file;
+	}
+};
+
+/**
+**  Batch of graphic files decoded by the worker threads.
+*/
+struct DecodeGraphicJob
+{
+	const std::string *Files;             /// files of the batch
+	std::vector<SDL_Surface *> Surfaces;  /// decoded surfaces, NULL if decoding failed
+	std::vector<std::string> CacheKeys;   /// keys of the files in the graphic cache
+};
+
+/**
+**  Get the key of the file of the graphic in the graphic cache.
+**
+**  The file is only hashed the first time the key is needed.
+*/
+const std::string &CGraphic::GetCacheKey()
+{
+	if (!this->HasCacheKey) {
+		this->CacheKey = GetGraphicCacheKey(this->File);
+		this->HasCacheKey = true;
+	}
+	return this->CacheKey;
+}
+
+/**
+**  Decode the file of a graphic into its surface, taking it from the graphic cache if possible.
+**
+**  @param g  Graphic to decode.
+**
+**  @return   0 for success, -1 for error.
+*/
+static int DecodeGraphic(CGraphic *g)
+{
+	const std::string &cache_key = g->GetCacheKey();
+	SDL_Surface *surface = LoadCachedSurface(cache_key, "plain");
+	if (surface) {
+		g->Surface = surface;
+		g->GraphicWidth = surface->w;
+		g->GraphicHeight = surface->h;
+		return 0;
+	}
+
+	if (LoadGraphicPNG(g) == -1) {
+		return -1;
+	}
+	SaveCachedSurface(cache_key, "plain", g->Surface);
+	return 0;
+}
+
+static void DecodeGraphicFile(void *data, int index)
+{
+	DecodeGraphicJob &job = *static_cast<DecodeGraphicJob *>(data);
+	CDecodedGraphic graphic(job.Files[index]);
+
+	if (DecodeGraphic(&graphic) == 0) {
+		job.Surfaces[index] = graphic.Surface;
+		job.CacheKeys[index] = graphic.GetCacheKey();
+	}
+}
+
+/**
+**  Decode graphic files in advance, spreading the work over the worker threads.
+**
+**  The decoded surfaces are picked up by CGraphic::Load, which then only has to do
+**  the processing which must happen in the main thread.
+**
+**  @param files  Graphic files to decode.
+*/
+void DecodeGraphicFiles(const std::vector<std::string> &files)
+{
+	std::vector<std::string> pending_files;
+	for (size_t i = 0; i < files.size(); ++i) {
+		if (!files[i].empty() && DecodedSurfaces.find(files[i]) == DecodedSurfaces.end()) {
+			DecodedSurfaces[files[i]].Surface = NULL;
+			pending_files.push_back(files[i]);
+		}
+	}
+
+	// decode in batches, so that the loading screen can show the progress
+	const int batch_size = ThreadPool.GetThreadCount() * 8;
+	const int file_count = (int) pending_files.size();
+	for (int i = 0; i < file_count; i += batch_size) {
+		ShowLoadProgress(_("Decoding Graphics (%d/%d)"), i, file_count);
+
+		DecodeGraphicJob job;
+		job.Files = &pending_files[i];
+		job.Surfaces.resize(std::min(batch_size, file_count - i), NULL);
+		job.CacheKeys.resize(job.Surfaces.size());
+		ThreadPool.Run(DecodeGraphicFile, &job, (int) job.Surfaces.size());
+
+		for (size_t j = 0; j < job.Surfaces.size(); ++j) {
+			if (job.Surfaces[j] != NULL) {
+				DecodedSurface &decoded = DecodedSurfaces[pending_files[i + j]];
+				decoded.Surface = job.Surfaces[j];
+				decoded.CacheKey = job.CacheKeys[j];
+			} else {
+				DecodedSurfaces.erase(pending_files[i + j]);
+			}
+		}
+	}
+}
+
+/**
+**  Free the decoded surfaces which have not been used by any graphic.
+*/
+void FreeDecodedGraphicFiles()
+{
+	for (std::map<std::string, DecodedSurface>::iterator it = DecodedSurfaces.begin(); it != DecodedSurfaces.end(); ++it) {
+		SDL_Surface *surface = it->second.Surface;
+		unsigned char *pixels = NULL;
+
+		// surfaces from the graphic cache own their pixels
+		if (surface->flags & SDL_PREALLOC) {
+			pixels = (unsigned char *)surface->pixels;
+		}
+		SDL_FreeSurface(surface);
+		delete[] pixels;
+	}
+	DecodedSurfaces.clear();
+}
+
+/**
+**  Give a graphic the surface decoded in advance for its file, if any.
+**
+**  @param g  Graphic to load.
+**
+**  @return   True if a decoded surface was available.
+*/
+static bool TakeDecodedSurface(CGraphic *g)
+{
+	std::map<std::string, DecodedSurface>::iterator it = DecodedSurfaces.find(g->File);
+	if (it == DecodedSurfaces.end()) {
+		return false;
+	}
+
+	g->Surface = it->second.Surface;
+	if (!g->HasCacheKey) {
+		// the file was already hashed when decoding it
+		g->CacheKey = it->second.CacheKey;
+		g->HasCacheKey = true;
+	}
+	g->GraphicWidth = g->Surface->w;
+	g->GraphicHeight = g->Surface->h;
+	DecodedSurfaces.erase(it);
+	return true;
+}
+
 /**
 **  Load a graphic
 **
@@ -1545,7 +1750,25 @@ void CGraphic::Load(bool grayscale)
 	}
 
 	// TODO: More formats?
-	if (LoadGraphicPNG(this) == -1) {
+	//Wyrmgus start
+//	if (LoadGraphicPNG(this) == -1) {
+	// grayscale graphics are looked up in the graphic cache with the conversion already applied
+	std::string grayscale_cache_key;
+	std::string grayscale_cache_variant;
+	if (grayscale) {
+		char variant[64];
+		snprintf(variant, sizeof(variant), "%s-%dx%d", Preference.SepiaForGrayscale ? "sepia" : "gray", Width, Height);
+		grayscale_cache_variant = variant;
+		grayscale_cache_key = GetCacheKey();
+		Surface = LoadCachedSurface(grayscale_cache_key, grayscale_cache_variant);
+		if (Surface) {
+			GraphicWidth = Surface->w;
+			GraphicHeight = Surface->h;
+		}
+	}
+	const bool converted = Surface != NULL;
+	if (!converted && !TakeDecodedSurface(this) && DecodeGraphic(this) == -1) {
+	//Wyrmgus end
 		fprintf(stderr, "Can't load the graphic '%s'\n", File.c_str());
 		ExitFatal(-1);
 	}
@@ -1577,10 +1800,13 @@ void CGraphic::Load(bool grayscale)
 		//Wyrmgus start
 		this->Grayscale = true;
 //		ApplyGrayScale(Surface, Width, Height);
-		if (Preference.SepiaForGrayscale) {
-			ApplySepiaScale(Surface, Width, Height);
-		} else {
-			ApplyGrayScale(Surface, Width, Height);
+		if (!converted) {
+			if (Preference.SepiaForGrayscale) {
+				ApplySepiaScale(Surface, Width, Height);
+			} else {
+				ApplyGrayScale(Surface, Width, Height);
+			}
+			SaveCachedSurface(grayscale_cache_key, grayscale_cache_variant, Surface);
 		}
 		//Wyrmgus end
 	}
@@ -1614,7 +1840,10 @@ static void FreeSurface(SDL_Surface **surface)
 
 	unsigned char *pixels = NULL;
 
-	if ((*surface)->flags & SDL_PREALLOC) {
+	//Wyrmgus start
+//	if ((*surface)->flags & SDL_PREALLOC) {
+	if (((*surface)->flags & SDL_PREALLOC) && SharedPixelSurfaces.erase(*surface) == 0) {
+	//Wyrmgus end
 		pixels = (unsigned char *)(*surface)->pixels;
 	}
 
@@ -1623,6 +1852,57 @@ static void FreeSurface(SDL_Surface **surface)
 	*surface = NULL;
 }
 
+//Wyrmgus start
+/**
+**  Free the time of day surfaces of a graphic, except those of a given time of day.
+**
+**  @param g     The graphic.
+**  @param time  Time of day whose surfaces are kept, or NoTimeOfDay to free all of them.
+*/
+static void FreeTimeOfDaySurfaces(CGraphic *g, int time)
+{
+	if (time != DawnTimeOfDay) {
+		FreeSurface(&g->DawnSurface);
+		FreeSurface(&g->DawnSurfaceFlip);
+	}
+	if (time != DuskTimeOfDay) {
+		FreeSurface(&g->DuskSurface);
+		FreeSurface(&g->DuskSurfaceFlip);
+	}
+	if (time != FirstWatchTimeOfDay && time != MidnightTimeOfDay && time != SecondWatchTimeOfDay) {
+		FreeSurface(&g->NightSurface);
+		FreeSurface(&g->NightSurfaceFlip);
+	}
+}
+
+/**
+**  Free the time of day and player color surfaces of a graphic.
+**
+**  They have to be freed before the surfaces they are made from are changed, as
+**  palettized ones use the pixels of those.
+**
+**  @param g  The graphic.
+*/
+static void FreeVariantSurfaces(CGraphic *g)
+{
+	FreeTimeOfDaySurfaces(g, NoTimeOfDay);
+
+	CPlayerColorGraphic *cg = dynamic_cast<CPlayerColorGraphic *>(g);
+	if (cg) {
+		for (int i = 0; i < PlayerColorMax; ++i) {
+			FreeSurface(&cg->PlayerColorSurfaces[i]);
+			FreeSurface(&cg->PlayerColorSurfacesFlip[i]);
+			FreeSurface(&cg->PlayerColorSurfacesDawn[i]);
+			FreeSurface(&cg->PlayerColorSurfacesDawnFlip[i]);
+			FreeSurface(&cg->PlayerColorSurfacesDusk[i]);
+			FreeSurface(&cg->PlayerColorSurfacesDuskFlip[i]);
+			FreeSurface(&cg->PlayerColorSurfacesNight[i]);
+			FreeSurface(&cg->PlayerColorSurfacesNightFlip[i]);
+		}
+	}
+}
+//Wyrmgus end
+
 /**
 **  Free a graphic
 **
@@ -1709,54 +1989,7 @@ void CGraphic::Free(CGraphic *g)
 			g->frameFlip_map = NULL;
 			
 			//Wyrmgus start
-			if (g->DawnSurface) {
-				FreeSurface(&g->DawnSurface);
-			}
-			if (g->DawnSurfaceFlip) {
-				FreeSurface(&g->DawnSurfaceFlip);
-			}
-			if (g->DuskSurface) {
-				FreeSurface(&g->DuskSurface);
-			}
-			if (g->DuskSurfaceFlip) {
-				FreeSurface(&g->DuskSurfaceFlip);
-			}
-			if (g->NightSurface) {
-				FreeSurface(&g->NightSurface);
-			}
-			if (g->NightSurfaceFlip) {
-				FreeSurface(&g->NightSurfaceFlip);
-			}
-
-			CPlayerColorGraphic *cg = dynamic_cast<CPlayerColorGraphic *>(g);
-			if (cg) {
-				for (int i = 0; i < PlayerColorMax; ++i) {
-					if (cg->PlayerColorSurfaces[i]) {
-						FreeSurface(&cg->PlayerColorSurfaces[i]);
-					}
-					if (cg->PlayerColorSurfacesFlip[i]) {
-						FreeSurface(&cg->PlayerColorSurfacesFlip[i]);
-					}
-					if (cg->PlayerColorSurfacesDawn[i]) {
-						FreeSurface(&cg->PlayerColorSurfacesDawn[i]);
-					}
-					if (cg->PlayerColorSurfacesDawnFlip[i]) {
-						FreeSurface(&cg->PlayerColorSurfacesDawnFlip[i]);
-					}
-					if (cg->PlayerColorSurfacesDusk[i]) {
-						FreeSurface(&cg->PlayerColorSurfacesDusk[i]);
-					}
-					if (cg->PlayerColorSurfacesDuskFlip[i]) {
-						FreeSurface(&cg->PlayerColorSurfacesDuskFlip[i]);
-					}
-					if (cg->PlayerColorSurfacesNight[i]) {
-						FreeSurface(&cg->PlayerColorSurfacesNight[i]);
-					}
-					if (cg->PlayerColorSurfacesNightFlip[i]) {
-						FreeSurface(&cg->PlayerColorSurfacesNightFlip[i]);
-					}
-				}
-			}
+			FreeVariantSurfaces(g);
 			//Wyrmgus end
 		}
 
@@ -1906,6 +2139,26 @@ void CGraphic::Flip()
 		return;
 	}
 
+	//Wyrmgus start
+	// the flipped surface is cached for the state of the surface it is made from
+	std::string cache_key;
+	char cache_variant[64];
+	if (!Resized) {
+		cache_key = GetCacheKey();
+	}
+	snprintf(cache_variant, sizeof(cache_variant), "%s-flip-%d-%x-%u",
+			 Grayscale ? (Preference.SepiaForGrayscale ? "sepia" : "gray") : "plain",
+			 Surface->format->BytesPerPixel, Surface->flags & (SDL_SRCCOLORKEY | SDL_SRCALPHA), (unsigned int) Surface->format->alpha);
+	SurfaceFlip = LoadCachedSurface(cache_key, cache_variant);
+	if (SurfaceFlip) {
+		if (SurfaceFlip->format->BytesPerPixel == 1) {
+			VideoPaletteListAdd(SurfaceFlip);
+		}
+		GenFlipFramesMap();
+		return;
+	}
+	//Wyrmgus end
+
 	SDL_Surface *s = SurfaceFlip = SDL_ConvertSurface(Surface, Surface->format, SDL_SWSURFACE);
 	if (Surface->flags & SDL_SRCCOLORKEY) {
 		SDL_SetColorKey(SurfaceFlip, SDL_SRCCOLORKEY | SDL_RLEACCEL, Surface->format->colorkey);
@@ -2003,6 +2256,17 @@ void CGraphic::Flip()
 	SDL_UnlockSurface(Surface);
 	SDL_UnlockSurface(s);
 
+	//Wyrmgus start
+	SaveCachedSurface(cache_key, cache_variant, SurfaceFlip);
+	GenFlipFramesMap();
+}
+
+/**
+**  Generate the frame positions of the flipped surface.
+*/
+void CGraphic::GenFlipFramesMap()
+{
+	//Wyrmgus end
 	delete[] frameFlip_map;
 
 	frameFlip_map = new frame_pos_t[NumFrames];
@@ -2023,6 +2287,10 @@ void CGraphic::UseDisplayFormat()
 	if (UseOpenGL) { return; }
 #endif
 
+	//Wyrmgus start
+	FreeVariantSurfaces(this);
+	//Wyrmgus end
+
 	SDL_Surface *s = Surface;
 
 	if (s->format->Amask != 0) {
@@ -2030,8 +2298,11 @@ void CGraphic::UseDisplayFormat()
 	} else {
 		Surface = SDL_DisplayFormat(s);
 	}
-	VideoPaletteListRemove(s);
-	SDL_FreeSurface(s);
+	//Wyrmgus start
+//	VideoPaletteListRemove(s);
+//	SDL_FreeSurface(s);
+	FreeSurface(&s); // also frees the pixels of surfaces from the graphic cache
+	//Wyrmgus end
 
 	if (SurfaceFlip) {
 		s = SurfaceFlip;
@@ -2040,8 +2311,11 @@ void CGraphic::UseDisplayFormat()
 		} else {
 			SurfaceFlip = SDL_DisplayFormat(s);
 		}
-		VideoPaletteListRemove(s);
-		SDL_FreeSurface(s);
+		//Wyrmgus start
+//		VideoPaletteListRemove(s);
+//		SDL_FreeSurface(s);
+		FreeSurface(&s);
+		//Wyrmgus end
 	}
 }
 
@@ -2440,6 +2714,72 @@ void MakePlayerColorTexture(CPlayerColorGraphic *g, int player, int time_of_day)
 
 #endif
 
+//Wyrmgus start
+/**
+**  Rows of a resized image, computed by the worker threads.
+*/
+struct ResizeJob
+{
+	const unsigned char *Pixels;  /// pixels of the original surface
+	int Pitch;                    /// pitch of the original surface
+	int SurfaceWidth;             /// width of the original surface
+	int SurfaceHeight;            /// height of the original surface
+	int Width;                    /// original width
+	int Height;                   /// original height
+	int NewWidth;                 /// new width
+	int NewHeight;                /// new height
+	int BytesPerPixel;            /// bytes per pixel of both images
+	unsigned char *Data;          /// pixels of the resized image
+};
+
+/**
+**  Compute rows of a resized image by interpolating the original pixels.
+**
+**  Each row reads up to two rows of the original surface, which is not written to,
+**  so the slices need no overlap.
+*/
+static void ResizeRows(void *data, int first_row, int last_row)
+{
+	const ResizeJob &job = *static_cast<ResizeJob *>(data);
+	const unsigned char *pixels = job.Pixels;
+	const int bpp = job.BytesPerPixel;
+	const int w = job.NewWidth;
+	const int h = job.NewHeight;
+	int x = first_row * w;
+
+	for (int i = first_row; i < last_row; ++i) {
+		float fy = (float)i * job.Height / h;
+		int iy = (int)fy;
+		fy -= iy;
+		for (int j = 0; j < w; ++j) {
+			float fx = (float)j * job.Width / w;
+			int ix = (int)fx;
+			fx -= ix;
+			float fz = (fx + fy) / 2;
+
+			const unsigned char *p1 = &pixels[iy * job.Pitch + ix * bpp];
+			const unsigned char *p2 = (iy != job.SurfaceHeight - 1) ?
+									  &pixels[(iy + 1) * job.Pitch + ix * bpp] :
+									  p1;
+			const unsigned char *p3 = (ix != job.SurfaceWidth - 1) ?
+									  &pixels[iy * job.Pitch + (ix + 1) * bpp] :
+									  p1;
+			const unsigned char *p4 = (iy != job.SurfaceHeight - 1 && ix != job.SurfaceWidth - 1) ?
+									  &pixels[(iy + 1) * job.Pitch + (ix + 1) * bpp] :
+									  p1;
+
+			for (int c = 0; c < std::min(bpp, 4); ++c) {
+				job.Data[x * bpp + c] = static_cast<unsigned char>(
+											(p1[c] * (1 - fy) + p2[c] * fy +
+											 p1[c] * (1 - fx) + p3[c] * fx +
+											 p1[c] * (1 - fz) + p4[c] * fz) / 3.0 + .5);
+			}
+			++x;
+		}
+	}
+}
+//Wyrmgus end
+
 /**
 **  Resize a graphic
 **
@@ -2464,6 +2804,9 @@ void CGraphic::Resize(int w, int h)
 	}
 
 	Resized = true;
+	//Wyrmgus start
+	FreeVariantSurfaces(this);
+	//Wyrmgus end
 	Uint32 ckey = Surface->format->colorkey;
 	int useckey = Surface->flags & SDL_SRCCOLORKEY;
 
@@ -2488,7 +2831,10 @@ void CGraphic::Resize(int w, int h)
 		VideoPaletteListRemove(Surface);
 
 		memcpy(pal, Surface->format->palette->colors, sizeof(SDL_Color) * 256);
-		SDL_FreeSurface(Surface);
+		//Wyrmgus start
+//		SDL_FreeSurface(Surface);
+		FreeSurface(&Surface); // also frees the pixels of surfaces from the graphic cache
+		//Wyrmgus end
 
 		Surface = SDL_CreateRGBSurfaceFrom(data, w, h, 8, w, 0, 0, 0, 0);
 		if (Surface->format->BytesPerPixel == 1) {
@@ -2500,50 +2846,64 @@ void CGraphic::Resize(int w, int h)
 
 		unsigned char *pixels = (unsigned char *)Surface->pixels;
 		unsigned char *data = new unsigned char[w * h * bpp];
-		int x = 0;
-
-		for (int i = 0; i < h; ++i) {
-			float fy = (float)i * Height / h;
-			int iy = (int)fy;
-			fy -= iy;
-			for (int j = 0; j < w; ++j) {
-				float fx = (float)j * Width / w;
-				int ix = (int)fx;
-				fx -= ix;
-				float fz = (fx + fy) / 2;
-
-				unsigned char *p1 = &pixels[iy * Surface->pitch + ix * bpp];
-				unsigned char *p2 = (iy != Surface->h - 1) ?
-									&pixels[(iy + 1) * Surface->pitch + ix * bpp] :
-									p1;
-				unsigned char *p3 = (ix != Surface->w - 1) ?
-									&pixels[iy * Surface->pitch + (ix + 1) * bpp] :
-									p1;
-				unsigned char *p4 = (iy != Surface->h - 1 && ix != Surface->w - 1) ?
-									&pixels[(iy + 1) * Surface->pitch + (ix + 1) * bpp] :
-									p1;
-
-				data[x * bpp + 0] = static_cast<unsigned char>(
-										(p1[0] * (1 - fy) + p2[0] * fy +
-										 p1[0] * (1 - fx) + p3[0] * fx +
-										 p1[0] * (1 - fz) + p4[0] * fz) / 3.0 + .5);
-				data[x * bpp + 1] = static_cast<unsigned char>(
-										(p1[1] * (1 - fy) + p2[1] * fy +
-										 p1[1] * (1 - fx) + p3[1] * fx +
-										 p1[1] * (1 - fz) + p4[1] * fz) / 3.0 + .5);
-				data[x * bpp + 2] = static_cast<unsigned char>(
-										(p1[2] * (1 - fy) + p2[2] * fy +
-										 p1[2] * (1 - fx) + p3[2] * fx +
-										 p1[2] * (1 - fz) + p4[2] * fz) / 3.0 + .5);
-				if (bpp == 4) {
-					data[x * bpp + 3] = static_cast<unsigned char>(
-											(p1[3] * (1 - fy) + p2[3] * fy +
-											 p1[3] * (1 - fx) + p3[3] * fx +
-											 p1[3] * (1 - fz) + p4[3] * fz) / 3.0 + .5);
-				}
-				++x;
-			}
-		}
+		//Wyrmgus start
+//		int x = 0;
+
+//		for (int i = 0; i < h; ++i) {
+//			float fy = (float)i * Height / h;
+//			int iy = (int)fy;
+//			fy -= iy;
+//			for (int j = 0; j < w; ++j) {
+//				float fx = (float)j * Width / w;
+//				int ix = (int)fx;
+//				fx -= ix;
+//				float fz = (fx + fy) / 2;
+
+//				unsigned char *p1 = &pixels[iy * Surface->pitch + ix * bpp];
+//				unsigned char *p2 = (iy != Surface->h - 1) ?
+//									&pixels[(iy + 1) * Surface->pitch + ix * bpp] :
+//									p1;
+//				unsigned char *p3 = (ix != Surface->w - 1) ?
+//									&pixels[iy * Surface->pitch + (ix + 1) * bpp] :
+//									p1;
+//				unsigned char *p4 = (iy != Surface->h - 1 && ix != Surface->w - 1) ?
+//									&pixels[(iy + 1) * Surface->pitch + (ix + 1) * bpp] :
+//									p1;
+
+//				data[x * bpp + 0] = static_cast<unsigned char>(
+//										(p1[0] * (1 - fy) + p2[0] * fy +
+//										 p1[0] * (1 - fx) + p3[0] * fx +
+//										 p1[0] * (1 - fz) + p4[0] * fz) / 3.0 + .5);
+//				data[x * bpp + 1] = static_cast<unsigned char>(
+//										(p1[1] * (1 - fy) + p2[1] * fy +
+//										 p1[1] * (1 - fx) + p3[1] * fx +
+//										 p1[1] * (1 - fz) + p4[1] * fz) / 3.0 + .5);
+//				data[x * bpp + 2] = static_cast<unsigned char>(
+//										(p1[2] * (1 - fy) + p2[2] * fy +
+//										 p1[2] * (1 - fx) + p3[2] * fx +
+//										 p1[2] * (1 - fz) + p4[2] * fz) / 3.0 + .5);
+//				if (bpp == 4) {
+//					data[x * bpp + 3] = static_cast<unsigned char>(
+//											(p1[3] * (1 - fy) + p2[3] * fy +
+//											 p1[3] * (1 - fx) + p3[3] * fx +
+//											 p1[3] * (1 - fz) + p4[3] * fz) / 3.0 + .5);
+//				}
+//				++x;
+//			}
+//		}
+		ResizeJob job;
+		job.Pixels = pixels;
+		job.Pitch = Surface->pitch;
+		job.SurfaceWidth = Surface->w;
+		job.SurfaceHeight = Surface->h;
+		job.Width = Width;
+		job.Height = Height;
+		job.NewWidth = w;
+		job.NewHeight = h;
+		job.BytesPerPixel = bpp;
+		job.Data = data;
+		ThreadPool.RunRows(ResizeRows, &job, h);
+		//Wyrmgus end
 
 		int Rmask = Surface->format->Rmask;
 		int Gmask = Surface->format->Gmask;
@@ -2551,8 +2911,11 @@ void CGraphic::Resize(int w, int h)
 		int Amask = Surface->format->Amask;
 
 		SDL_UnlockSurface(Surface);
-		VideoPaletteListRemove(Surface);
-		SDL_FreeSurface(Surface);
+		//Wyrmgus start
+//		VideoPaletteListRemove(Surface);
+//		SDL_FreeSurface(Surface);
+		FreeSurface(&Surface);
+		//Wyrmgus end
 
 		Surface = SDL_CreateRGBSurfaceFrom(data, w, h, 8 * bpp, w * bpp,
 										   Rmask, Gmask, Bmask, Amask);
@@ -2586,6 +2949,9 @@ void CGraphic::SetOriginalSize()
 		return;
 	}
 
+	//Wyrmgus start
+	FreeVariantSurfaces(this);
+	//Wyrmgus end
 	
 	if (Surface) {
 		FreeSurface(&Surface);
@@ -2621,6 +2987,41 @@ void CGraphic::SetOriginalSize()
 }
 
 //Wyrmgus start
+/**
+**  Rows of a surface tinted by the worker threads.
+*/
+struct TintJob
+{
+	SDL_Surface *Surface;  /// 32 bpp surface to tint in place
+	int Red;               /// change of the red component
+	int Green;             /// change of the green component
+	int Blue;              /// change of the blue component
+};
+
+/**
+**  Tint rows of a surface for a time of day.
+*/
+static void TintRows(void *data, int first_row, int last_row)
+{
+	const TintJob &job = *static_cast<TintJob *>(data);
+	SDL_Surface *surface = job.Surface;
+	const int bpp = surface->format->BytesPerPixel;
+
+	for (int y = first_row; y < last_row; ++y) {
+		for (int x = 0; x < surface->w; ++x) {
+			Uint32 c;
+			SDL_PixelFormat *f = surface->format;
+			c = *(Uint32 *)&((Uint8 *)surface->pixels)[x * bpp + y * surface->pitch];
+			Uint8 red = (std::max<int>(0,std::min<int>(255, ((c & f->Rmask) >> f->Rshift) + job.Red)));
+			Uint8 green = (std::max<int>(0,std::min<int>(255, ((c & f->Gmask) >> f->Gshift) + job.Green)));
+			Uint8 blue = (std::max<int>(0,std::min<int>(255, ((c & f->Bmask) >> f->Bshift) + job.Blue)));
+			Uint8 alpha = ((c & f->Amask) >> f->Ashift);
+			c = Video.MapRGBA(f, red, green, blue, alpha);
+			*(Uint32 *)&((Uint8 *)surface->pixels)[(x + y * surface->w) * bpp] = c;
+		}
+	}
+}
+
 /**
 **  Set a graphic's time of day
 **
@@ -2680,29 +3081,38 @@ SDL_Surface *CGraphic::SetTimeOfDay(int time, bool flipped)
 	int time_of_day_green = 0;
 	int time_of_day_blue = 0;
 
+	// palettized surfaces only need a palette of their own; truecolor ones need a tinted copy
+	// of the pixels, which is only kept for the time of day in use
+	if (base_surface->format->BytesPerPixel == 1) {
+		surface = MakeSharedSurface(base_surface);
+	} else {
+		FreeTimeOfDaySurfaces(this, time);
+		surface = SDL_ConvertSurface(base_surface, base_surface->format, SDL_SWSURFACE);
+	}
+
 	if (time == DawnTimeOfDay) {
 		if (flipped) {
-			surface = DawnSurfaceFlip = SDL_ConvertSurface(base_surface, base_surface->format, SDL_SWSURFACE);
+			DawnSurfaceFlip = surface;
 		} else {
-			surface = DawnSurface = SDL_ConvertSurface(base_surface, base_surface->format, SDL_SWSURFACE);
+			DawnSurface = surface;
 		}
 		time_of_day_red = -20;
 		time_of_day_green = -20;
 		time_of_day_blue = 0;
 	} else if (time == DuskTimeOfDay) {
 		if (flipped) {
-			surface = DuskSurfaceFlip = SDL_ConvertSurface(base_surface, base_surface->format, SDL_SWSURFACE);
+			DuskSurfaceFlip = surface;
 		} else {
-			surface = DuskSurface = SDL_ConvertSurface(base_surface, base_surface->format, SDL_SWSURFACE);
+			DuskSurface = surface;
 		}
 		time_of_day_red = 0;
 		time_of_day_green = -20;
 		time_of_day_blue = -20;
 	} else if (time == FirstWatchTimeOfDay || time == MidnightTimeOfDay || time == SecondWatchTimeOfDay) {
 		if (flipped) {
-			surface = NightSurfaceFlip = SDL_ConvertSurface(base_surface, base_surface->format, SDL_SWSURFACE);
+			NightSurfaceFlip = surface;
 		} else {
-			surface = NightSurface = SDL_ConvertSurface(base_surface, base_surface->format, SDL_SWSURFACE);
+			NightSurface = surface;
 		}
 		time_of_day_red = -45;
 		time_of_day_green = -35;
@@ -2726,19 +3136,12 @@ SDL_Surface *CGraphic::SetTimeOfDay(int time, bool flipped)
 			}
 			SDL_UnlockSurface(surface);
 		} else if (bpp == 4) {
-			for (int y = 0; y < surface->h; ++y) {
-				for (int x = 0; x < surface->w; ++x) {
-					Uint32 c;
-					SDL_PixelFormat *f = surface->format;
-					c = *(Uint32 *)&((Uint8 *)surface->pixels)[x * bpp + y * surface->pitch];
-					Uint8 red = (std::max<int>(0,std::min<int>(255, ((c & f->Rmask) >> f->Rshift) + time_of_day_red)));
-					Uint8 green = (std::max<int>(0,std::min<int>(255, ((c & f->Gmask) >> f->Gshift) + time_of_day_green)));
-					Uint8 blue = (std::max<int>(0,std::min<int>(255, ((c & f->Bmask) >> f->Bshift) + time_of_day_blue)));
-					Uint8 alpha = ((c & f->Amask) >> f->Ashift);
-					c = Video.MapRGBA(f, red, green, blue, alpha);
-					*(Uint32 *)&((Uint8 *)surface->pixels)[(x + y * surface->w) * bpp] = c;
-				}
-			}
+			TintJob job;
+			job.Surface = surface;
+			job.Red = time_of_day_red;
+			job.Green = time_of_day_green;
+			job.Blue = time_of_day_blue;
+			ThreadPool.RunRows(TintRows, &job, surface->h);
 		}
 	}
 	
@@ -0,0 +1,291 @@
+//       _________ __                 __
+//      /   _____//  |_____________ _/  |______     ____  __ __  ______
+//      \_____  \\   __\_  __ \__  \\   __\__  \   / ___\|  |  \/  ___/
+//      /        \|  |  |  | \// __ \|  |  / __ \_/ /_/  >  |  /\___ |
+//     /_______  /|__|  |__|  (____  /__| (____  /\___  /|____//____  >
+//             \/                  \/          \//_____/            \/
+//  ______________________                           ______________________
+//                        T H E   W A R   B E G I N S
+//         Stratagus - A free fantasy real time strategy game engine
+//
+/**@name graphic_cache.cpp - The processed graphic cache. */
+//
+//      (c) Copyright 2018 by Andrettin
+//
+//      This program is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; only version 2 of the License.
+//
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+//      02111-1307, USA.
+//
+
+//@{
+
+/*----------------------------------------------------------------------------
+--  Documentation
+----------------------------------------------------------------------------*/
+
+/**
+**  The graphic cache keeps the surfaces produced by decoding and processing
+**  graphic files in the user directory, so that later runs can load them
+**  directly instead of doing the work again.
+**
+**  Entries are keyed by a hash of the contents of the source file, so a
+**  modified file never matches a stale entry. Each entry holds a header, the
+**  palette and the pixel rows without padding, in the byte order of the
+**  machine which wrote it, so that the pixels can be read straight into the
+**  surface.
+**
+**  The functions only touch the files of the given entry, so they can be
+**  called from the worker threads.
+*/
+
+/*----------------------------------------------------------------------------
+--  Includes
+----------------------------------------------------------------------------*/
+
+#include "stratagus.h"
+
+#include "graphic_cache.h"
+
+#include "game.h"
+#include "iocompat.h"
+#include "iolib.h"
+#include "parameters.h"
+#include "unit.h" //for using CPreference
+
+#include "SDL.h"
+
+/*----------------------------------------------------------------------------
+--  Declarations
+----------------------------------------------------------------------------*/
+
+/**
+**  Header of a graphic cache entry.
+*/
+struct GraphicCacheHeader
+{
+	char Magic[4];          /// "WGFX"
+	Uint32 Version;         /// GraphicCacheVersion
+	Uint32 Width;           /// surface width
+	Uint32 Height;          /// surface height
+	Uint32 BytesPerPixel;   /// surface bytes per pixel
+	Uint32 Rmask;           /// surface red mask
+	Uint32 Gmask;           /// surface green mask
+	Uint32 Bmask;           /// surface blue mask
+	Uint32 Amask;           /// surface alpha mask
+	Uint32 ColorKeyFlags;   /// color key flags of the surface, 0 if it has no color key
+	Uint32 ColorKey;        /// color key of the surface
+	Uint32 PaletteColors;   /// number of palette colors following the header
+};
+
+/*----------------------------------------------------------------------------
+--  Variables
+----------------------------------------------------------------------------*/
+
+static const char GraphicCacheMagic[4] = {'W', 'G', 'F', 'X'};
+static const Uint32 GraphicCacheVersion = 1;
+
+/*----------------------------------------------------------------------------
+--  Functions
+----------------------------------------------------------------------------*/
+
+/**
+**  Get the directory of the graphic cache.
+*/
+static std::string GetGraphicCacheDir()
+{
+	std::string dir(Parameters::Instance.GetUserDirectory());
+	if (!GameName.empty()) {
+		dir += "/";
+		dir += GameName;
+	}
+	dir += "/cache";
+	return dir;
+}
+
+/**
+**  Get the file of a graphic cache entry.
+*/
+static std::string GetGraphicCacheFile(const std::string &key, const std::string &variant)
+{
+	return GetGraphicCacheDir() + "/" + key + "-" + variant + ".gfx";
+}
+
+/**
+**  Get the key of a graphic file in the graphic cache.
+**
+**  @param file  Graphic file, as given to LibraryFileName.
+**
+**  @return      Hash of the contents of the file, or an empty string if the cache is
+**               disabled or the file can't be read.
+*/
+std::string GetGraphicCacheKey(const std::string &file)
+{
+	if (!Preference.CacheGraphics || file.empty()) {
+		return std::string();
+	}
+
+	const std::string name = LibraryFileName(file.c_str());
+	FILE *fp = fopen(name.c_str(), "rb");
+	if (fp == NULL) {
+		return std::string();
+	}
+
+	// 64-bit FNV-1a
+	Uint64 hash = 14695981039346656037ULL;
+	std::vector<unsigned char> buffer(64 * 1024);
+	size_t size;
+	while ((size = fread(&buffer[0], 1, buffer.size(), fp)) > 0) {
+		for (size_t i = 0; i < size; ++i) {
+			hash ^= buffer[i];
+			hash *= 1099511628211ULL;
+		}
+	}
+	const bool failed = ferror(fp) != 0;
+	fclose(fp);
+	if (failed) {
+		return std::string();
+	}
+
+	char key[17];
+	snprintf(key, sizeof(key), "%08x%08x", (unsigned int) (hash >> 32), (unsigned int) (hash & 0xFFFFFFFF));
+	return key;
+}
+
+/**
+**  Load a processed surface from the graphic cache.
+**
+**  @param key      Key of the graphic file, from GetGraphicCacheKey.
+**  @param variant  Name of the processing applied to the surface.
+**
+**  @return         The surface, or NULL if the cache has no valid entry for it.
+**                  The pixels of the surface are allocated with new[].
+*/
+SDL_Surface *LoadCachedSurface(const std::string &key, const std::string &variant)
+{
+	if (key.empty()) {
+		return NULL;
+	}
+
+	FILE *fp = fopen(GetGraphicCacheFile(key, variant).c_str(), "rb");
+	if (fp == NULL) {
+		return NULL;
+	}
+
+	GraphicCacheHeader header;
+	SDL_Color colors[256];
+	bool valid = fread(&header, sizeof(header), 1, fp) == 1
+		&& memcmp(header.Magic, GraphicCacheMagic, sizeof(GraphicCacheMagic)) == 0
+		&& header.Version == GraphicCacheVersion
+		&& header.Width > 0 && header.Width <= 65536
+		&& header.Height > 0 && header.Height <= 65536
+		&& header.BytesPerPixel >= 1 && header.BytesPerPixel <= 4
+		&& header.PaletteColors <= 256
+		&& fread(colors, sizeof(SDL_Color), header.PaletteColors, fp) == header.PaletteColors;
+
+	unsigned char *pixels = NULL;
+	if (valid) {
+		const size_t size = (size_t) header.Width * header.Height * header.BytesPerPixel;
+		pixels = new unsigned char[size];
+		valid = fread(pixels, 1, size, fp) == size;
+	}
+	fclose(fp);
+
+	if (!valid) {
+		delete[] pixels;
+		return NULL;
+	}
+
+	SDL_Surface *surface = SDL_CreateRGBSurfaceFrom(pixels, header.Width, header.Height,
+													8 * header.BytesPerPixel, header.Width * header.BytesPerPixel,
+													header.Rmask, header.Gmask, header.Bmask, header.Amask);
+	if (surface == NULL) {
+		delete[] pixels;
+		return NULL;
+	}
+
+	if (header.PaletteColors > 0 && surface->format->palette) {
+		SDL_SetPalette(surface, SDL_LOGPAL | SDL_PHYSPAL, colors, 0, header.PaletteColors);
+		surface->format->palette->ncolors = header.PaletteColors;
+	}
+	if (header.ColorKeyFlags) {
+		SDL_SetColorKey(surface, header.ColorKeyFlags, header.ColorKey);
+	}
+	return surface;
+}
+
+/**
+**  Save a processed surface to the graphic cache.
+**
+**  @param key      Key of the graphic file, from GetGraphicCacheKey.
+**  @param variant  Name of the processing applied to the surface.
+**  @param surface  Surface to save.
+*/
+void SaveCachedSurface(const std::string &key, const std::string &variant, SDL_Surface *surface)
+{
+	if (key.empty() || surface == NULL) {
+		return;
+	}
+
+	const std::string dir = GetGraphicCacheDir();
+	struct stat tmp;
+	if (stat(dir.c_str(), &tmp) < 0) {
+		makedir(dir.c_str(), 0777);
+	}
+
+	const SDL_PixelFormat &format = *surface->format;
+	GraphicCacheHeader header;
+	memcpy(header.Magic, GraphicCacheMagic, sizeof(GraphicCacheMagic));
+	header.Version = GraphicCacheVersion;
+	header.Width = surface->w;
+	header.Height = surface->h;
+	header.BytesPerPixel = format.BytesPerPixel;
+	header.Rmask = format.Rmask;
+	header.Gmask = format.Gmask;
+	header.Bmask = format.Bmask;
+	header.Amask = format.Amask;
+	header.ColorKeyFlags = surface->flags & (SDL_SRCCOLORKEY | SDL_RLEACCEL);
+	header.ColorKey = format.colorkey;
+	header.PaletteColors = format.palette ? format.palette->ncolors : 0;
+
+	// write to a file of this thread first, so that a reader never sees a partial entry
+	const std::string cache_file = GetGraphicCacheFile(key, variant);
+	char thread_suffix[32];
+	snprintf(thread_suffix, sizeof(thread_suffix), ".%lu.tmp", (unsigned long) SDL_ThreadID());
+	const std::string temp_file = cache_file + thread_suffix;
+	FILE *fp = fopen(temp_file.c_str(), "wb");
+	if (fp == NULL) {
+		return;
+	}
+
+	bool ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+	if (ok && header.PaletteColors > 0) {
+		ok = fwrite(format.palette->colors, sizeof(SDL_Color), header.PaletteColors, fp) == header.PaletteColors;
+	}
+
+	const size_t row_size = (size_t) header.Width * header.BytesPerPixel;
+	SDL_LockSurface(surface);
+	for (int y = 0; ok && y < surface->h; ++y) {
+		ok = fwrite((unsigned char *) surface->pixels + y * surface->pitch, 1, row_size, fp) == row_size;
+	}
+	SDL_UnlockSurface(surface);
+
+	if (fclose(fp) != 0) {
+		ok = false;
+	}
+	if (!ok || rename(temp_file.c_str(), cache_file.c_str()) != 0) {
+		// the entry may already exist if it was written by another thread in the meantime
+		remove(temp_file.c_str());
+	}
+}
+
+//@}
@@ -87,6 +87,9 @@
 #include "minimap.h"
 #include "network.h"
 #include "parameters.h"
+//Wyrmgus start
+#include "profile.h"
+//Wyrmgus end
 #include "sound.h"
 #include "sound_server.h"
 #include "translate.h"
@@ -946,6 +949,10 @@ void PollEvents()
 */
 void WaitEventsOneFrame()
 {
+	//Wyrmgus start
+	PROFILE_SCOPE("WaitEventsOneFrame");
+	//Wyrmgus end
+	
 	++FrameCounter;
 
 	Uint32 ticks = SDL_GetTicks();